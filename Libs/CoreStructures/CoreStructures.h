@@ -11,6 +11,7 @@
 #include "GUVector3.h"
 #include "GUVector4.h"
 #include "GUMatrix4.h"
+#include "GUAffine2D.h"
 #include "GUQuaternion.h"
 #include "GUDualNumber.h"
 #include "GUDualQuaternion.h"
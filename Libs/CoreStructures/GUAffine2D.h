@@ -0,0 +1,200 @@
+//
+//  GUAffine2D.h
+//  CoreStructures
+//
+//  GUAffine2D models an affine transformation in R2 - a 2x2 linear part plus a translation - in 6 floats rather than the 16 of a GUMatrix4.  Like GUMatrix4 the data is column-major, so M = { m11, m21, m12, m22, tx, ty } and a point p maps to (m11 * p.x + m12 * p.y + tx, m21 * p.x + m22 * p.y + ty).  Composition, inversion and point transforms use SSE where available.  Header only (all methods inline) so it does not need CoreStructures.lib rebuilding.  Value semantics apply
+//
+
+#pragma once
+
+
+#include "gu_math.h"
+#include "GUVector2.h"
+#include "GUMatrix4.h"
+#include <cstddef>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define GU_AFFINE2D_SSE		1
+#include <xmmintrin.h>
+#endif
+
+namespace CoreStructures {
+
+	struct GUAffine2D {
+
+		float		M[6];		// column-major { m11, m21, m12, m22, tx, ty }
+
+
+		// static methods
+
+		static GUAffine2D identity() {  // create and return the identity transform
+
+			return GUAffine2D(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+		}
+
+		static GUAffine2D translation(const float tx, const float ty) {  // create and return the translation by (tx, ty)
+
+			return GUAffine2D(1.0f, 0.0f, 0.0f, 1.0f, tx, ty);
+		}
+
+		static GUAffine2D rotation(const float theta) {  // create and return the counter-clockwise rotation by theta radians
+
+			float c = cosf(theta), s = sinf(theta);
+			return GUAffine2D(c, s, -s, c, 0.0f, 0.0f);
+		}
+
+		static GUAffine2D scale(const float sx, const float sy) {  // create and return the scale by sx and sy along the x and y axes
+
+			return GUAffine2D(sx, 0.0f, 0.0f, sy, 0.0f, 0.0f);
+		}
+
+		static GUAffine2D TRS(const float tx, const float ty, const float theta, const float sx, const float sy) {  // create and return translation(tx, ty) * rotation(theta) * scale(sx, sy) directly, without composing three transforms
+
+			float c = cosf(theta), s = sinf(theta);
+			return GUAffine2D(c * sx, s * sx, -s * sy, c * sy, tx, ty);
+		}
+
+
+		// constructors
+
+		GUAffine2D() {  // the identity transform
+
+			M[0] = 1.0f; M[1] = 0.0f; M[2] = 0.0f; M[3] = 1.0f; M[4] = 0.0f; M[5] = 0.0f;
+		}
+
+		GUAffine2D(const float m11, const float m21, const float m12, const float m22, const float tx, const float ty) {  // parameters are given in storage (column-major) order
+
+			M[0] = m11; M[1] = m21; M[2] = m12; M[3] = m22; M[4] = tx; M[5] = ty;
+		}
+
+
+		// binary operators
+
+		GUAffine2D operator*(const GUAffine2D& B) const {  // return the composition *this * B (B is applied first)
+
+			GUAffine2D R;
+
+#if defined(GU_AFFINE2D_SSE)
+
+			// both linear columns of the result at once: (col0, col1) = (m11, m21, m11, m21) * (e, e, g, g) + (m12, m22, m12, m22) * (f, f, h, h)
+			__m128 A = _mm_loadu_ps(M);
+			__m128 L = _mm_loadu_ps(B.M);
+
+			__m128 r = _mm_add_ps(
+				_mm_mul_ps(_mm_shuffle_ps(A, A, _MM_SHUFFLE(1, 0, 1, 0)), _mm_shuffle_ps(L, L, _MM_SHUFFLE(2, 2, 0, 0))),
+				_mm_mul_ps(_mm_shuffle_ps(A, A, _MM_SHUFFLE(3, 2, 3, 2)), _mm_shuffle_ps(L, L, _MM_SHUFFLE(3, 3, 1, 1))));
+
+			_mm_storeu_ps(R.M, r);
+#else
+			R.M[0] = M[0] * B.M[0] + M[2] * B.M[1];
+			R.M[1] = M[1] * B.M[0] + M[3] * B.M[1];
+			R.M[2] = M[0] * B.M[2] + M[2] * B.M[3];
+			R.M[3] = M[1] * B.M[2] + M[3] * B.M[3];
+#endif
+
+			R.M[4] = M[0] * B.M[4] + M[2] * B.M[5] + M[4];
+			R.M[5] = M[1] * B.M[4] + M[3] * B.M[5] + M[5];
+
+			return R;
+		}
+
+		GUAffine2D& operator*=(const GUAffine2D& B) {  // *this = *this * B
+
+			*this = *this * B;
+			return *this;
+		}
+
+		GUVector2 operator*(const GUVector2& p) const {  // transform point p
+
+			return GUVector2(M[0] * p.x + M[2] * p.y + M[4], M[1] * p.x + M[3] * p.y + M[5]);
+		}
+
+
+		// methods
+
+		float det() const {  // return the determinant of the linear part
+
+			return M[0] * M[3] - M[2] * M[1];
+		}
+
+		GUAffine2D inverse() const {  // return the inverse transform.  If the transform is singular (det() == 0) the result is undefined
+
+			GUAffine2D R;
+
+			float rcpDet = 1.0f / det();
+
+#if defined(GU_AFFINE2D_SSE)
+
+			// (m22, -m21, -m12, m11) / det
+			__m128 A = _mm_loadu_ps(M);
+			__m128 L = _mm_mul_ps(_mm_shuffle_ps(A, A, _MM_SHUFFLE(0, 2, 1, 3)), _mm_setr_ps(rcpDet, -rcpDet, -rcpDet, rcpDet));
+
+			_mm_storeu_ps(R.M, L);
+#else
+			R.M[0] = M[3] * rcpDet;
+			R.M[1] = -M[1] * rcpDet;
+			R.M[2] = -M[2] * rcpDet;
+			R.M[3] = M[0] * rcpDet;
+#endif
+
+			// the translation undoes the original one in the inverted frame
+			R.M[4] = -(R.M[0] * M[4] + R.M[2] * M[5]);
+			R.M[5] = -(R.M[1] * M[4] + R.M[3] * M[5]);
+
+			return R;
+		}
+
+		void transformPoints(const float *xy, float *result, size_t count) const {  // transform count points stored as interleaved (x, y) pairs.  xy and result may be the same array
+
+			size_t i = 0;
+
+#if defined(GU_AFFINE2D_SSE)
+
+			// two points per iteration: (x0, y0, x1, y1) -> (x0, x0, x1, x1) * (m11, m21, m11, m21) + (y0, y0, y1, y1) * (m12, m22, m12, m22) + (tx, ty, tx, ty)
+			__m128 col0 = _mm_setr_ps(M[0], M[1], M[0], M[1]);
+			__m128 col1 = _mm_setr_ps(M[2], M[3], M[2], M[3]);
+			__m128 t = _mm_setr_ps(M[4], M[5], M[4], M[5]);
+
+			for (; i + 2 <= count; i += 2) {
+
+				__m128 p = _mm_loadu_ps(xy + i * 2);
+
+				__m128 r = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0)), col0),
+					_mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1)), col1)), t);
+
+				_mm_storeu_ps(result + i * 2, r);
+			}
+#endif
+
+			for (; i < count; ++i) {
+
+				float x = xy[i * 2], y = xy[i * 2 + 1];
+
+				result[i * 2] = M[0] * x + M[2] * y + M[4];
+				result[i * 2 + 1] = M[1] * x + M[3] * y + M[5];
+			}
+		}
+
+		void transformPoints(const GUVector2 *points, GUVector2 *result, size_t count) const {  // GUVector2 is two packed floats, so this is the interleaved version above
+
+			transformPoints(reinterpret_cast<const float*>(points), reinterpret_cast<float*>(result), count);
+		}
+
+		GUMatrix4 matrix4() const {  // return the equivalent GUMatrix4, acting in the z = 0 plane
+
+			return GUMatrix4(
+				M[0], M[2], 0.0f, M[4],
+				M[1], M[3], 0.0f, M[5],
+				0.0f, 0.0f, 1.0f, 0.0f,
+				0.0f, 0.0f, 0.0f, 1.0f);
+		}
+
+		void rowMajor3x2(float rows[8]) const {  // write the transform as two padded rows (m11, m12, tx, 0), (m21, m22, ty, 0) - the std140 layout of a row_major mat3x2, or two vec4s
+
+			rows[0] = M[0]; rows[1] = M[2]; rows[2] = M[4]; rows[3] = 0.0f;
+			rows[4] = M[1]; rows[5] = M[3]; rows[6] = M[5]; rows[7] = 0.0f;
+		}
+	};
+
+}
@@ -0,0 +1,16 @@
+#version 330
+
+// a flipbook frame, cross-faded into the next.  The atlas is premultiplied, so the result is too
+
+uniform sampler2D atlas;
+
+in vec2 frameCoord;
+in vec2 nextFrameCoord;
+in float crossFade;
+
+layout (location = 0) out vec4 fragmentColour;
+
+void main(void) {
+
+	fragmentColour = mix(texture(atlas, frameCoord), texture(atlas, nextFrameCoord), crossFade);
+}
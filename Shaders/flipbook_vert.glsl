@@ -0,0 +1,78 @@
+#version 330
+
+// one quad per playing copy of a flipbook, drawn as a 4 vertex strip per instance.  The frame, the cross-fade into the next frame, the size and the position all follow from how long the copy has been playing, so nothing but time changes from frame to frame
+
+#ifndef MAX_FLIPBOOK_FRAMES
+#define MAX_FLIPBOOK_FRAMES 64
+#endif
+
+// only the camera is needed from the frame's transforms (see scene_vert.glsl)
+layout (std140) uniform frameTransforms {
+
+	layout (column_major) mat4 camera;
+};
+
+// each frame's rectangle in the atlas - bottom left uv, then top right
+layout (std140) uniform flipbookFrames {
+
+	vec4 frames[MAX_FLIPBOOK_FRAMES];
+};
+
+// see flipbookInstance in flipbook.h
+layout (location = 0) in vec4 placement; // centre x, y when it starts, drift x, y per second
+layout (location = 1) in vec4 extent; // half width, half height at full size, scale on the first frame, start time
+
+uniform float time;
+uniform float framesPerSecond;
+uniform int frameCount;
+uniform int endMode; // 0 = hide after the last frame, 1 = hold the last frame, 2 = loop
+
+out vec2 frameCoord;
+out vec2 nextFrameCoord;
+out float crossFade;
+
+void main(void) {
+
+	float playing = time - extent.w;
+	float frame = playing * framesPerSecond;
+
+	frameCoord = vec2(0.0);
+	nextFrameCoord = vec2(0.0);
+	crossFade = 0.0;
+
+	// not started yet, or finished and hidden - all four corners outside the clip volume
+	if (frame < 0.0 || (endMode == 0 && frame >= float(frameCount))) {
+
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		return;
+	}
+
+	float first = floor(frame);
+	int current, next;
+
+	if (endMode == 2) {
+
+		current = int(mod(first, float(frameCount)));
+		next = (current + 1) % frameCount;
+
+	} else {
+
+		current = min(int(first), frameCount - 1);
+		next = min(current + 1, frameCount - 1);
+	}
+
+	crossFade = frame - first;
+
+	// grows and drifts over the first pass through the frames
+	float duration = float(frameCount) / framesPerSecond;
+	float grown = min(playing, duration);
+	float scale = mix(extent.z, 1.0, grown / duration);
+
+	vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+	vec2 centre = placement.xy + placement.zw * grown;
+
+	frameCoord = mix(frames[current].xy, frames[current].zw, corner);
+	nextFrameCoord = mix(frames[next].xy, frames[next].zw, corner);
+
+	gl_Position = camera * vec4(centre + (corner * 2.0 - 1.0) * extent.xy * scale, 0.0, 1.0);
+}
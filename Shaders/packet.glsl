@@ -0,0 +1,16 @@
+// vertex -> fragment packet shared by the scene shaders.  The vertex shader defines PACKET_OUT before including this
+
+#ifdef PACKET_OUT
+out packet {
+#else
+in packet {
+#endif
+
+	vec4 colour;
+	vec2 textureCoord;
+
+#ifdef PACKET_OUT
+} outputVertex;
+#else
+} inputFragment;
+#endif
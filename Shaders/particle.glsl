@@ -0,0 +1,28 @@
+// particle storage shared by the particle shaders (see particle_system.h).  The C++ side passes PARTICLE_GROUP_SIZE, and each shader declares the buffers it uses at these binding points
+
+#define PARTICLE_SOURCE_BINDING		0
+#define PARTICLE_TARGET_BINDING		1
+#define PARTICLE_COUNTER_BINDING	2
+#define PARTICLE_EMISSION_BINDING	3
+
+// 40 bytes.  Pairs of halves are packed with packHalf2x16 and colours with packUnorm4x8, so the draw can read ageLife, size and the colours as half float and normalised byte attributes
+struct particle {
+
+	vec2 position;
+	vec2 velocity;
+	uint ageLife; // age, lifetime (seconds)
+	uint size; // size at birth, size at death (world units)
+	uint colourStart;
+	uint colourEnd;
+	uint acceleration;
+	float drag; // fraction of the velocity lost per second
+};
+
+// counts and indirect command arguments, all kept on the GPU
+layout (std430, binding = PARTICLE_COUNTER_BINDING) buffer particleCounters {
+
+	uint alive; // particles in the source buffer
+	uint written; // particles written to the target buffer so far this step (can pass the capacity - the excess is dropped)
+	uint updateGroups[3]; // glDispatchComputeIndirect arguments for the next update (byte offset 8)
+	uint drawArgs[4]; // glDrawArraysIndirect arguments - one point, one instance per particle (byte offset 20)
+} counters;
@@ -0,0 +1,101 @@
+#version 430
+
+// appends this step's new particles to the target buffer after the survivors.  One invocation per new particle - each finds its emission by its index and picks its starting state at random within that emission's ranges
+
+#include "particle.glsl"
+
+layout (local_size_x = PARTICLE_GROUP_SIZE) in;
+
+layout (std430, binding = PARTICLE_TARGET_BINDING) writeonly buffer particleTarget {
+	particle target[];
+};
+
+// matches particleEmission in particle_system.h
+struct emission {
+
+	vec4 area; // centre x, y, half width, half height
+	vec4 velocity; // x, y, then the range of extra speed in a random direction
+	vec4 lifeSize; // lifetime range, size at birth, size at death
+	vec4 motion; // acceleration x, y, drag
+	uvec4 range; // start colour, end colour, first new particle, count
+};
+
+layout (std430, binding = PARTICLE_EMISSION_BINDING) readonly buffer particleEmissions {
+	emission emissions[];
+};
+
+uniform uint emissionCount;
+uniform uint newParticles;
+uniform uint capacity;
+uniform uint seed;
+
+shared uint groupNew;
+shared uint groupBase;
+
+// integer hash (PCG) -> [0, 1)
+uint hash(uint x) {
+
+	uint state = x * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+	return (word >> 22u) ^ word;
+}
+
+float random(inout uint state) {
+
+	state = hash(state);
+	return float(state >> 8) / 16777216.0;
+}
+
+void main(void) {
+
+	if (gl_LocalInvocationIndex == 0)
+		groupNew = 0;
+
+	memoryBarrierShared();
+	barrier();
+
+	uint i = gl_GlobalInvocationID.x;
+	bool emitted = i < newParticles;
+	uint slot = 0;
+
+	if (emitted)
+		slot = atomicAdd(groupNew, 1u);
+
+	memoryBarrierShared();
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0)
+		groupBase = atomicAdd(counters.written, groupNew);
+
+	memoryBarrierShared();
+	barrier();
+
+	// past the capacity new particles are dropped
+	if (!emitted || groupBase + slot >= capacity)
+		return;
+
+	uint e = 0;
+
+	while (e + 1 < emissionCount && i >= emissions[e].range.z + emissions[e].range.w)
+		e++;
+
+	uint state = i ^ (seed * 1664525u);
+
+	float angle = random(state) * 6.2831853;
+	float speed = mix(emissions[e].velocity.z, emissions[e].velocity.w, random(state));
+	vec2 offset = vec2(random(state), random(state)) * 2.0 - 1.0;
+
+	particle p;
+
+	p.position = emissions[e].area.xy + offset * emissions[e].area.zw;
+	p.velocity = emissions[e].velocity.xy + vec2(cos(angle), sin(angle)) * speed;
+	p.ageLife = packHalf2x16(vec2(0.0, mix(emissions[e].lifeSize.x, emissions[e].lifeSize.y, random(state))));
+	p.size = packHalf2x16(emissions[e].lifeSize.zw);
+	p.colourStart = emissions[e].range.x;
+	p.colourEnd = emissions[e].range.y;
+	p.acceleration = packHalf2x16(emissions[e].motion.xy);
+	p.drag = emissions[e].motion.z;
+
+	target[groupBase + slot] = p;
+}
@@ -0,0 +1,25 @@
+#version 430
+
+// ends a step (one invocation): the target buffer becomes the next source, and the next update dispatch and this frame's draw are sized from the count without it ever leaving the GPU
+
+#include "particle.glsl"
+
+layout (local_size_x = 1) in;
+
+uniform uint capacity;
+
+void main(void) {
+
+	uint alive = min(counters.written, capacity);
+
+	counters.alive = alive;
+	counters.written = 0;
+	counters.updateGroups[0] = (alive + uint(PARTICLE_GROUP_SIZE) - 1u) / uint(PARTICLE_GROUP_SIZE);
+	counters.updateGroups[1] = 1u;
+	counters.updateGroups[2] = 1u;
+
+	counters.drawArgs[0] = 1u;
+	counters.drawArgs[1] = alive;
+	counters.drawArgs[2] = 0u;
+	counters.drawArgs[3] = 0u;
+}
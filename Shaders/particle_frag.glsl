@@ -0,0 +1,20 @@
+#version 330
+
+// soft round sprite, premultiplied alpha
+
+in vec4 particleColour;
+
+layout (location = 0) out vec4 fragmentColour;
+
+void main(void) {
+
+	vec2 d = gl_PointCoord * 2.0 - 1.0;
+	float r2 = dot(d, d);
+
+	if (r2 > 1.0)
+		discard;
+
+	float alpha = particleColour.a * (1.0 - r2);
+
+	fragmentColour = vec4(particleColour.rgb * alpha, alpha);
+}
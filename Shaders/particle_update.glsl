@@ -0,0 +1,65 @@
+#version 430
+
+// integrates the particles in the source buffer and writes the survivors to the target buffer, packed together.  Each work group gathers its survivors first so there is one atomic on the shared counter per group rather than per particle
+
+#include "particle.glsl"
+
+layout (local_size_x = PARTICLE_GROUP_SIZE) in;
+
+layout (std430, binding = PARTICLE_SOURCE_BINDING) readonly buffer particleSource {
+	particle source[];
+};
+
+layout (std430, binding = PARTICLE_TARGET_BINDING) writeonly buffer particleTarget {
+	particle target[];
+};
+
+uniform float timeStep;
+
+shared uint groupSurvivors;
+shared uint groupBase;
+
+void main(void) {
+
+	if (gl_LocalInvocationIndex == 0)
+		groupSurvivors = 0;
+
+	memoryBarrierShared();
+	barrier();
+
+	uint i = gl_GlobalInvocationID.x;
+	bool survives = false;
+	uint slot = 0;
+	particle p;
+
+	if (i < counters.alive) {
+
+		p = source[i];
+
+		vec2 ageLife = unpackHalf2x16(p.ageLife);
+
+		ageLife.x += timeStep;
+		survives = ageLife.x < ageLife.y;
+
+		if (survives) {
+
+			p.velocity = (p.velocity + unpackHalf2x16(p.acceleration) * timeStep) * max(1.0 - p.drag * timeStep, 0.0);
+			p.position += p.velocity * timeStep;
+			p.ageLife = packHalf2x16(ageLife);
+
+			slot = atomicAdd(groupSurvivors, 1u);
+		}
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0)
+		groupBase = atomicAdd(counters.written, groupSurvivors);
+
+	memoryBarrierShared();
+	barrier();
+
+	if (survives)
+		target[groupBase + slot] = p;
+}
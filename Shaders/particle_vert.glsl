@@ -0,0 +1,28 @@
+#version 330
+
+// one point sprite per instance.  The particle buffer is bound as per-instance attributes (see the particle struct in particle.glsl), so nothing is copied out of it
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 ageLife;
+layout (location = 2) in vec2 size; // at birth, at death
+layout (location = 3) in vec4 colourStart;
+layout (location = 4) in vec4 colourEnd;
+
+// only the camera is needed from the frame's transforms (see scene_vert.glsl)
+layout (std140) uniform frameTransforms {
+
+	layout (column_major) mat4 camera;
+};
+
+uniform float pointScale; // pixels per world unit
+
+out vec4 particleColour;
+
+void main(void) {
+
+	float t = ageLife.x / ageLife.y;
+
+	particleColour = mix(colourStart, colourEnd, t);
+	gl_PointSize = max(mix(size.x, size.y, t) * pointScale, 1.0);
+	gl_Position = camera * vec4(position, 0.0, 1.0);
+}
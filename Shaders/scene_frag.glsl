@@ -0,0 +1,75 @@
+#version 330
+
+// fragment shader for every scene shape.  Compiled once per feature set (see shader_variants.h) with
+//   TEXTURED - sample textureImage
+//   TEXTURE_ARRAY - sample the layer of textureArray instead (always compiled with TEXTURED)
+//   VERTEX_COLOUR - multiply by the vertex colour (the colour on its own if not textured)
+//   ALPHA_KEY - discard fragments with no alpha rather than blending them
+
+#if defined(TEXTURE_ARRAY) && defined(GL_ARB_bindless_texture)
+#extension GL_ARB_bindless_texture : enable
+#endif
+
+// input packet
+#include "packet.glsl"
+
+#if defined(TEXTURE_ARRAY)
+
+// set once at startup - either a bindless handle or a texture unit
+#ifdef GL_ARB_bindless_texture
+layout (bindless_sampler) uniform sampler2DArray textureArray;
+#else
+uniform sampler2DArray textureArray;
+#endif
+
+// image to sample for this draw
+uniform int layer;
+
+#ifndef MAX_TEXTURE_ARRAY_LAYERS
+#define MAX_TEXTURE_ARRAY_LAYERS 16
+#endif
+
+// the part of each layer its image covers - images keep their own size in the bottom left corner
+uniform vec2 layerScales[MAX_TEXTURE_ARRAY_LAYERS];
+
+#elif defined(TEXTURED)
+
+uniform sampler2D textureImage;
+
+#endif
+
+#ifdef ALPHA_KEY
+const float alphaKeyThreshold = 1.0 / 255.0;
+#endif
+
+
+// output packet
+layout (location = 0) out vec4 fragmentColour;
+
+
+void main(void) {
+
+#if defined(TEXTURE_ARRAY)
+	// keep the filter footprint inside the image so its edges don't pick up the unused part of the layer
+	vec2 scale = layerScales[layer];
+	vec2 halfTexel = 0.5 / vec2(textureSize(textureArray, 0).xy);
+	vec2 uv = clamp(inputFragment.textureCoord * scale, halfTexel, scale - halfTexel);
+
+	vec4 colour = texture(textureArray, vec3(uv, float(layer)));
+#elif defined(TEXTURED)
+	vec4 colour = texture(textureImage, inputFragment.textureCoord);
+#else
+	vec4 colour = vec4(1.0);
+#endif
+
+#ifdef VERTEX_COLOUR
+	colour *= inputFragment.colour;
+#endif
+
+#ifdef ALPHA_KEY
+	if (colour.a < alphaKeyThreshold)
+		discard;
+#endif
+
+	fragmentColour = colour;
+}
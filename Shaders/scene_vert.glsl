@@ -0,0 +1,44 @@
+#version 330
+
+// vertex shader for every scene shape.  Compiled once per feature set (see shader_variants.h) with
+//   INSTANCED - take the transform from a per-instance attribute instead of the frame transform block
+
+#ifndef MAX_FRAME_TRANSFORMS
+#define MAX_FRAME_TRANSFORMS 255
+#endif
+
+// camera and object transforms for the whole frame, uploaded once per frame (see transform_buffer.h).  Object transforms are 2D affine - a mat3x2 maps (x, y, 1) to (x', y')
+layout (std140, row_major) uniform frameTransforms {
+
+	layout (column_major) mat4 camera;
+	mat3x2 objectT[MAX_FRAME_TRANSFORMS];
+};
+
+#ifdef INSTANCED
+layout (location = 3) in mat3x2 instanceT; // per-instance 2D affine transform (uses locations 3 - 5)
+#else
+uniform int transformIndex; // this draw's entry in objectT
+#endif
+
+// input vertex packet
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec4 colour;
+layout (location = 2) in vec2 textureCoord;
+
+// output vertex packet
+#define PACKET_OUT
+#include "packet.glsl"
+
+void main(void) {
+
+	outputVertex.colour = colour;
+	outputVertex.textureCoord = textureCoord;
+
+	vec3 pos = vec3(position.x, position.y, 1.0);
+
+#ifdef INSTANCED
+	gl_Position = camera * vec4(instanceT * pos, 0.0, 1.0);
+#else
+	gl_Position = camera * vec4(objectT[transformIndex] * pos, 0.0, 1.0);
+#endif
+}
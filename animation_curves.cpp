@@ -0,0 +1,371 @@
+#include "stdafx.h"
+#include "animation_curves.h"
+#include "thread_pool.h"
+#include <CoreStructures\CoreStructures.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define ANIMATION_CURVES_SSE	1
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+// Tracks per chunk at least - below this waking the workers costs more than the work
+static const int CURVE_GRAIN = 4096;
+
+#pragma region tracks
+
+int addCurveTrack(animationCurves& curves, const curveKey *keys, unsigned count, curveWrap wrap, unsigned output, float tension, float gain) {
+	if (count == 0)
+		return -1;
+
+	unsigned first = unsigned(curves.spanStart.size());
+	unsigned spans = (count > 1) ? count - 1 : 1;
+
+	for (unsigned k = 0; k < spans; ++k) {
+
+		float v0 = keys[k].value;
+		float c0 = v0, c1 = 0.0f, c2 = 0.0f, c3 = 0.0f;
+		float length = 0.0f;
+
+		if (count > 1) {
+
+			float v1 = keys[k + 1].value;
+
+			length = keys[k + 1].time - keys[k].time;
+
+			switch (keys[k].ease) {
+
+				case CURVE_STEP:
+					break;
+
+				case CURVE_LINEAR:
+					c1 = v1 - v0;
+					break;
+
+				case CURVE_SMOOTH:
+					// v0 + (v1 - v0) * smoothstep(u, 0, 1), where smoothstep is 3u^2 - 2u^3
+					c2 = 3.0f * (v1 - v0);
+					c3 = -2.0f * (v1 - v0);
+					break;
+
+				case CURVE_SPLINE: {
+					// the hermite segment cspline builds for this span, with its tangents already scaled by the span's length
+					float before = keys[(k > 0) ? k - 1 : k].value;
+					float after = keys[(k + 2 < count) ? k + 2 : k + 1].value;
+					float m0 = (v1 - before) * 0.5f * (1.0f - tension);
+					float m1 = (after - v0) * 0.5f * (1.0f - tension);
+
+					c1 = m0;
+					c2 = 3.0f * (v1 - v0) - 2.0f * m0 - m1;
+					c3 = 2.0f * (v0 - v1) + m0 + m1;
+					break;
+				}
+			}
+		}
+
+		curves.spanStart.push_back(keys[k].time);
+		curves.spanScale.push_back((length > 0.0f) ? 1.0f / length : 0.0f);
+		curves.c0.push_back(c0);
+		curves.c1.push_back(c1);
+		curves.c2.push_back(c2);
+		curves.c3.push_back(c3);
+	}
+
+	curves.time.push_back(keys[0].time);
+	curves.speed.push_back(1.0f);
+	curves.start.push_back(keys[0].time);
+	curves.duration.push_back(keys[count - 1].time - keys[0].time);
+	curves.gain.push_back(gain);
+	curves.wrap.push_back((unsigned char)wrap);
+	curves.firstSpan.push_back(first);
+	curves.spanCount.push_back(spans);
+	curves.cursor.push_back(first);
+	curves.output.push_back(output);
+
+	curves.u.push_back(0.0f);
+	curves.k0.push_back(0.0f);
+	curves.k1.push_back(0.0f);
+	curves.k2.push_back(0.0f);
+	curves.k3.push_back(0.0f);
+
+	return int(curves.tracks++);
+}
+
+void clearAnimationCurves(animationCurves& curves) {
+	curves = animationCurves();
+}
+
+void setCurveTime(animationCurves& curves, int track, float time) {
+	curves.time[track] = time;
+}
+
+void setCurveSpeed(animationCurves& curves, int track, float speed) {
+	curves.speed[track] = speed;
+}
+
+float curveDuration(const animationCurves& curves, int track) {
+	return curves.duration[track];
+}
+
+#pragma endregion
+
+#pragma region evaluation
+
+// time on a track's clock brought back into one period of its wrap - the same point on the curve, so clocks can be kept there and never lose precision
+static float periodTime(float time, float start, float duration, unsigned char wrap) {
+	if (duration <= 0.0f)
+		return start;
+
+	float t = time - start;
+
+	switch (wrap) {
+
+		case CURVE_LOOP:
+			t = modP(t, duration);
+			break;
+
+		case CURVE_PINGPONG:
+			t = modP(t, 2.0f * duration);
+			break;
+
+		default:
+			t = clamp(t, 0.0f, duration);
+	}
+
+	return start + t;
+}
+
+// time on a track's clock brought back between its first and last keys
+static float wrapTime(float time, float start, float duration, unsigned char wrap) {
+	float t = periodTime(time, start, duration, wrap);
+
+	// the second half of a ping pong period plays backwards
+	if (wrap == CURVE_PINGPONG && t > start + duration)
+		t = 2.0f * (start + duration) - t;
+
+	return t;
+}
+
+// where time is in span, shaped by the track's gain
+static float spanParameter(const animationCurves& curves, unsigned span, float time, float trackGain) {
+	float u = clamp((time - curves.spanStart[span]) * curves.spanScale[span], 0.0f, 1.0f);
+
+	return (trackGain != 0.5f) ? gain(u, trackGain) : u;
+}
+
+float curveValue(const animationCurves& curves, int track, float time) {
+	float t = wrapTime(time, curves.start[track], curves.duration[track], curves.wrap[track]);
+
+	// the last span starting at or before t
+	const float *first = &curves.spanStart[curves.firstSpan[track]];
+	unsigned span = curves.firstSpan[track];
+	unsigned after = unsigned(upper_bound(first + 1, first + curves.spanCount[track], t) - first);
+
+	span += after - 1;
+
+	float u = spanParameter(curves, span, t, curves.gain[track]);
+
+	return ((curves.c3[span] * u + curves.c2[span]) * u + curves.c1[span]) * u + curves.c0[span];
+}
+
+// Run the clocks of tracks [begin, end) on, find the span each is in - starting from the one it was in last time, since clocks move a little at a time - and gather its parameter and coefficients
+static void gatherTracks(animationCurves& curves, int begin, int end, float timeStep) {
+	float *time = &curves.time[0];
+	const float *speed = &curves.speed[0];
+	int i = begin;
+
+#ifdef ANIMATION_CURVES_SSE
+	const __m128 dt = _mm_set1_ps(timeStep);
+
+	for (; i + 4 <= end; i += 4)
+		_mm_storeu_ps(time + i, _mm_add_ps(_mm_loadu_ps(time + i), _mm_mul_ps(_mm_loadu_ps(speed + i), dt)));
+#endif
+
+	for (; i < end; ++i)
+		time[i] += speed[i] * timeStep;
+
+	for (i = begin; i < end; ++i) {
+
+		time[i] = periodTime(time[i], curves.start[i], curves.duration[i], curves.wrap[i]);
+
+		float t = wrapTime(time[i], curves.start[i], curves.duration[i], curves.wrap[i]);
+		unsigned first = curves.firstSpan[i];
+		unsigned last = first + curves.spanCount[i] - 1;
+		unsigned span = curves.cursor[i];
+
+		while (span < last && t >= curves.spanStart[span + 1])
+			++span;
+
+		while (span > first && t < curves.spanStart[span])
+			--span;
+
+		curves.cursor[i] = span;
+		curves.u[i] = spanParameter(curves, span, t, curves.gain[i]);
+		curves.k0[i] = curves.c0[span];
+		curves.k1[i] = curves.c1[span];
+		curves.k2[i] = curves.c2[span];
+		curves.k3[i] = curves.c3[span];
+	}
+}
+
+// Evaluate the gathered cubics of tracks [begin, end) and write each value to its slot
+static void evaluateTracks(const animationCurves& curves, int begin, int end, float *values) {
+	const float *u = &curves.u[0];
+	const float *k0 = &curves.k0[0], *k1 = &curves.k1[0], *k2 = &curves.k2[0], *k3 = &curves.k3[0];
+	const unsigned *output = &curves.output[0];
+	int i = begin;
+
+#ifdef ANIMATION_CURVES_SSE
+	for (; i + 4 <= end; i += 4) {
+
+		__m128 x = _mm_loadu_ps(u + i);
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(k3 + i), x), _mm_loadu_ps(k2 + i));
+
+		v = _mm_add_ps(_mm_mul_ps(v, x), _mm_loadu_ps(k1 + i));
+		v = _mm_add_ps(_mm_mul_ps(v, x), _mm_loadu_ps(k0 + i));
+
+		float result[4];
+
+		_mm_storeu_ps(result, v);
+
+		for (int j = 0; j < 4; ++j)
+			values[output[i + j]] = result[j];
+	}
+#endif
+
+	for (; i < end; ++i)
+		values[output[i]] = ((k3[i] * u[i] + k2[i]) * u[i] + k1[i]) * u[i] + k0[i];
+}
+
+static void updateTracks(animationCurves& curves, float timeStep, float *values, bool threaded) {
+	int count = int(curves.tracks);
+
+	if (count == 0)
+		return;
+
+	parallelJobFunc job = [&curves, timeStep, values](int begin, int end, int chunk) {
+		gatherTracks(curves, begin, end, timeStep);
+		evaluateTracks(curves, begin, end, values);
+	};
+
+	if (threaded)
+		parallelFor(count, CURVE_GRAIN, job);
+	else
+		job(0, count, 0);
+}
+
+void updateAnimationCurves(animationCurves& curves, float timeStep, float *values) {
+	auto start = chrono::high_resolution_clock::now();
+
+	updateTracks(curves, timeStep, values, true);
+
+	curves.lastUpdateMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	curves.updates++;
+}
+
+void reportAnimationCurveStats(const animationCurves& curves) {
+	cout << "Animation curves: " << curves.tracks << " tracks, " << curves.spanStart.size() << " spans, " << curves.updates << " updates, last took " << curves.lastUpdateMs * 1000.0 << " us\n";
+}
+
+#pragma endregion
+
+#pragma region benchmark
+
+static unsigned randomState = 1;
+
+static float randomCurve(void) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+
+	return float(randomState & 0xFFFFFF) / float(0x1000000);
+}
+
+// Tracks of 8 evenly spaced random keys.  Every third track is a Catmull-Rom spline, every third smoothstepped with a random gain and the rest straight lines, each with its own wrap, speed and starting point
+static void benchmarkCurves(animationCurves& curves, unsigned count) {
+	const unsigned keyCount = 8;
+	curveKey keys[keyCount];
+
+	clearAnimationCurves(curves);
+	randomState = 1;
+
+	for (unsigned i = 0; i < count; ++i) {
+
+		curveEase ease = (i % 3 == 0) ? CURVE_SPLINE : ((i % 3 == 1) ? CURVE_SMOOTH : CURVE_LINEAR);
+
+		for (unsigned k = 0; k < keyCount; ++k) {
+
+			keys[k].time = float(k) * 0.25f;
+			keys[k].value = randomCurve() * 2.0f - 1.0f;
+			keys[k].ease = ease;
+		}
+
+		float trackGain = (ease == CURVE_SMOOTH) ? 0.2f + randomCurve() * 0.6f : 0.5f;
+		int track = addCurveTrack(curves, keys, keyCount, curveWrap(i % 3), i, 0.0f, trackGain);
+
+		setCurveTime(curves, track, randomCurve() * 2.0f);
+		setCurveSpeed(curves, track, 0.5f + randomCurve() * 1.5f);
+	}
+}
+
+void animationCurveBenchmark(void) {
+	const unsigned sizes[] = { 10000, 100000, 1000000 };
+	const int runs = 20;
+	const float timeStep = 1.0f / 60.0f;
+
+	cout << "Animation curve benchmark (" << runs << " updates, " << threadPoolSize() << " threads)\n";
+
+	for (int s = 0; s < 3; ++s) {
+
+		unsigned size = sizes[s];
+		animationCurves single, serial, parallel;
+		vector<float> singleValues(size), serialValues(size), parallelValues(size);
+
+		benchmarkCurves(single, size);
+		benchmarkCurves(serial, size);
+		benchmarkCurves(parallel, size);
+
+		// one track at a time, searching for the span from scratch each time
+		auto start = chrono::high_resolution_clock::now();
+
+		for (int r = 0; r < runs; ++r) {
+
+			for (unsigned i = 0; i < size; ++i) {
+
+				single.time[i] += single.speed[i] * timeStep;
+				singleValues[single.output[i]] = curveValue(single, int(i), single.time[i]);
+			}
+		}
+
+		double singleMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+		start = chrono::high_resolution_clock::now();
+
+		for (int r = 0; r < runs; ++r)
+			updateTracks(serial, timeStep, &serialValues[0], false);
+
+		double serialMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+		start = chrono::high_resolution_clock::now();
+
+		for (int r = 0; r < runs; ++r)
+			updateTracks(parallel, timeStep, &parallelValues[0], true);
+
+		double parallelMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+		cout << "  " << size << " tracks\n";
+		cout << "    one at a time: " << singleMs << " ms per update (" << size / singleMs / 1000.0 << "M tracks/s)\n";
+		cout << "    1 thread:      " << serialMs << " ms per update (" << size / serialMs / 1000.0 << "M tracks/s, " << singleMs / serialMs << "x)\n";
+		cout << "    " << threadPoolSize() << " threads:     " << parallelMs << " ms per update (" << size / parallelMs / 1000.0 << "M tracks/s, " << singleMs / parallelMs << "x)\n";
+	}
+
+	cout << "\n";
+}
+
+#pragma endregion
@@ -0,0 +1,71 @@
+//
+// Keyframed animation curves.  Each span between two keys becomes one cubic when a track is added, and every track in a set is advanced and evaluated together, four at a time with SSE, into a block of floats
+//
+
+#pragma once
+
+#include <vector>
+
+// How a value gets from a key to the next
+enum curveEase {
+	CURVE_STEP = 0, // holds the key's value until the next key
+	CURVE_LINEAR = 1,
+	CURVE_SMOOTH = 2, // smoothstep
+	CURVE_SPLINE = 3 // cardinal spline through the keys either side, taking the keys as evenly spaced like cspline does.  The first and last keys are doubled up for the end tangents
+};
+
+// What a track does outside its first and last keys
+enum curveWrap {
+	CURVE_CLAMP = 0,
+	CURVE_LOOP = 1,
+	CURVE_PINGPONG = 2 // plays forwards then backwards
+};
+
+struct curveKey {
+	float		time, value; // time is in seconds on the track's own clock
+	curveEase	ease; // from this key to the next (ignored on the last key)
+};
+
+// A set of tracks.  Per track and per span fields are kept in parallel arrays
+struct animationCurves {
+	// per track
+	std::vector<float>			time, speed; // the track's clock (seconds) and how fast it runs (0 stops it)
+	std::vector<float>			start, duration; // the first key's time and how long to the last
+	std::vector<float>			gain; // applied to each span's parameter (0.5 leaves it alone)
+	std::vector<unsigned char>	wrap;
+	std::vector<unsigned>		firstSpan, spanCount, cursor; // cursor is the span the track was last evaluated in
+	std::vector<unsigned>		output; // slot in the float block the value is written to
+
+	// per span: value = ((c3 * u + c2) * u + c1) * u + c0 for u = (time - spanStart) * spanScale in [0, 1]
+	std::vector<float>			spanStart, spanScale;
+	std::vector<float>			c0, c1, c2, c3;
+
+	// each track's parameter and coefficients, gathered from its span for the cubic pass
+	std::vector<float>			u, k0, k1, k2, k3;
+
+	unsigned					tracks = 0;
+	unsigned					updates = 0;
+	double						lastUpdateMs = 0.0;
+};
+
+// Add a track through count keys (in time order), writing to slot output.  tension is the cardinal spline tension for CURVE_SPLINE spans (0 is Catmull-Rom, 1 straight lines) and gain is gu_math's gain applied to every span's parameter.  Returns the track's index, or -1 if there are no keys.  The track's clock starts at the first key's time, running at speed 1
+int addCurveTrack(animationCurves& curves, const curveKey *keys, unsigned count, curveWrap wrap, unsigned output, float tension = 0.0f, float gain = 0.5f);
+
+void clearAnimationCurves(animationCurves& curves);
+
+void setCurveTime(animationCurves& curves, int track, float time);
+void setCurveSpeed(animationCurves& curves, int track, float speed);
+
+// Seconds from a track's first key to its last
+float curveDuration(const animationCurves& curves, int track);
+
+// A track's value at time on its clock, evaluated on its own without touching the set.  Gives the same value updateAnimationCurves would
+float curveValue(const animationCurves& curves, int track, float time);
+
+// Run every track's clock on by timeStep seconds times its speed (kept within one period of the track's wrap), then write every track's value to values[output].  A timeStep of 0 just writes the values.  Large sets are split across the thread pool, so each slot must belong to one track
+void updateAnimationCurves(animationCurves& curves, float timeStep, float *values);
+
+void reportAnimationCurveStats(const animationCurves& curves);
+
+// Time updating 10,000, 100,000 and 1,000,000 tracks one at a time with curveValue, in batches on one thread and across the thread pool.  Doesn't need GL
+void animationCurveBenchmark(void);
@@ -0,0 +1,273 @@
+#include "stdafx.h"
+#include "asset_watcher.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+#if defined(__linux__)
+#define ASSET_WATCHER_INOTIFY	1
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+struct assetHandler {
+	string				extension;
+	assetPrepareFunc	prepare;
+	assetApplyFunc		apply;
+	assetReleaseFunc	release;
+};
+
+struct preparedAsset {
+	string				path;
+	void				*payload;
+	assetApplyFunc		apply;
+	assetReleaseFunc	release;
+};
+
+static mutex						watcherLock; // guards everything below that both threads touch
+static vector<assetHandler>			handlers;
+static map<string, time_t>			watchedFiles; // normalised path -> last seen modification time
+static vector<preparedAsset>		preparedAssets;
+
+static thread						*watcherThread = NULL;
+static atomic<bool>					watcherRunning(false);
+
+static unsigned						appliedChanges = 0; // GL thread only
+
+string normaliseAssetPath(const string& path) {
+	string p = path;
+
+	for (size_t i = 0; i < p.size(); ++i) {
+
+		if (p[i] == '\\')
+			p[i] = '/';
+	}
+
+	return p;
+}
+
+static time_t modificationTime(const string& path) {
+	struct stat fileStatus;
+	return (stat(path.c_str(), &fileStatus) == 0) ? fileStatus.st_mtime : 0;
+}
+
+static bool endsWith(const string& s, const string& suffix) {
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void addAssetHandler(const char *extension, assetPrepareFunc prepare, assetApplyFunc apply, assetReleaseFunc release) {
+	lock_guard<mutex> guard(watcherLock);
+
+	assetHandler h = { extension, prepare, apply, release };
+	handlers.push_back(h);
+}
+
+void watchAssetFile(const string& path) {
+	string p = normaliseAssetPath(path);
+	time_t t = modificationTime(p);
+
+	lock_guard<mutex> guard(watcherLock);
+
+	if (watchedFiles.find(p) == watchedFiles.end())
+		watchedFiles[p] = t;
+}
+
+// Run the prepare step for a changed file on the watcher thread and queue the result for the GL thread
+static void prepareChangedAsset(const string& path) {
+	assetHandler handler = { "", NULL, NULL, NULL };
+
+	{
+		lock_guard<mutex> guard(watcherLock);
+
+		for (size_t i = 0; i < handlers.size(); ++i) {
+
+			if (endsWith(path, handlers[i].extension))
+				handler = handlers[i];
+		}
+	}
+
+	if (!handler.apply)
+		return;
+
+	cout << "Asset watcher: " << path << " changed, reloading\n";
+
+	void *payload = handler.prepare ? handler.prepare(path) : NULL;
+
+	preparedAsset prepared = { path, payload, handler.apply, handler.release };
+
+	lock_guard<mutex> guard(watcherLock);
+	preparedAssets.push_back(prepared);
+}
+
+#pragma region watcher thread
+
+#if defined(ASSET_WATCHER_INOTIFY)
+
+// inotify reports changes per directory, so watch each directory holding a watched file and filter the events by name.  Editors often save by writing a temporary file and renaming it over the original, so IN_MOVED_TO is watched as well as IN_CLOSE_WRITE
+static void watcherMain(void) {
+	int fd = inotify_init();
+
+	if (fd < 0) {
+
+		cout << "Asset watcher: inotify unavailable, hot reload disabled\n";
+		return;
+	}
+
+	map<string, int> directoryWatches; // directory -> watch descriptor
+	map<int, string> watchDirectories;
+
+	char buffer[4096];
+
+	while (watcherRunning) {
+
+		// add watches for directories of any files registered since the last pass
+		{
+			lock_guard<mutex> guard(watcherLock);
+
+			for (map<string, time_t>::iterator f = watchedFiles.begin(); f != watchedFiles.end(); ++f) {
+
+				size_t slash = f->first.find_last_of('/');
+				string dir = (slash == string::npos) ? "." : f->first.substr(0, slash);
+
+				if (directoryWatches.find(dir) == directoryWatches.end()) {
+
+					int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+					directoryWatches[dir] = wd;
+
+					if (wd >= 0)
+						watchDirectories[wd] = (slash == string::npos) ? "" : dir + "/";
+				}
+			}
+		}
+
+		pollfd pfd = { fd, POLLIN, 0 };
+
+		if (poll(&pfd, 1, 250) <= 0)
+			continue;
+
+		// collect a short burst of events so a save that touches the file several times reloads once
+		set<string> changed;
+
+		do {
+
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+
+			for (ssize_t offset = 0; offset < length;) {
+
+				inotify_event *e = (inotify_event*)(buffer + offset);
+
+				if (e->len > 0 && watchDirectories.find(e->wd) != watchDirectories.end()) {
+
+					string path = watchDirectories[e->wd] + e->name;
+
+					lock_guard<mutex> guard(watcherLock);
+
+					if (watchedFiles.find(path) != watchedFiles.end())
+						changed.insert(path);
+				}
+
+				offset += sizeof(inotify_event) + e->len;
+			}
+
+		} while (poll(&pfd, 1, 50) > 0);
+
+		for (set<string>::iterator p = changed.begin(); p != changed.end(); ++p)
+			prepareChangedAsset(*p);
+	}
+
+	close(fd);
+}
+
+#else
+
+// Portable fallback - compare modification times twice a second
+static void watcherMain(void) {
+	while (watcherRunning) {
+
+		this_thread::sleep_for(chrono::milliseconds(500));
+
+		vector<string> changed;
+
+		{
+			lock_guard<mutex> guard(watcherLock);
+
+			for (map<string, time_t>::iterator f = watchedFiles.begin(); f != watchedFiles.end(); ++f) {
+
+				time_t t = modificationTime(f->first);
+
+				if (t != 0 && t != f->second) {
+
+					f->second = t;
+					changed.push_back(f->first);
+				}
+			}
+		}
+
+		for (size_t i = 0; i < changed.size(); ++i)
+			prepareChangedAsset(changed[i]);
+	}
+}
+
+#endif
+
+#pragma endregion
+
+void startAssetWatcher(void) {
+	if (watcherThread)
+		return;
+
+	watcherRunning = true;
+	watcherThread = new thread(watcherMain);
+
+	// glutMainLoop leaves through exit(), so make sure the thread is joined before static destructors run
+	atexit(stopAssetWatcher);
+}
+
+void stopAssetWatcher(void) {
+	if (!watcherThread)
+		return;
+
+	watcherRunning = false;
+	watcherThread->join();
+
+	delete watcherThread;
+	watcherThread = NULL;
+
+	// changes prepared but never applied are dropped - the process is exiting and the GL context may already be gone, so their payloads are freed without applying them
+	for (size_t i = 0; i < preparedAssets.size(); ++i) {
+
+		if (preparedAssets[i].payload && preparedAssets[i].release)
+			preparedAssets[i].release(preparedAssets[i].payload);
+	}
+
+	preparedAssets.clear();
+}
+
+void applyChangedAssets(void) {
+	vector<preparedAsset> ready;
+
+	{
+		lock_guard<mutex> guard(watcherLock);
+		ready.swap(preparedAssets);
+	}
+
+	for (size_t i = 0; i < ready.size(); ++i)
+		ready[i].apply(ready[i].path, ready[i].payload);
+
+	appliedChanges += unsigned(ready.size());
+}
+
+unsigned appliedAssetChanges(void) {
+	return appliedChanges;
+}
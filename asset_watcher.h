@@ -0,0 +1,35 @@
+//
+// Asset hot-reload.  A background thread watches asset files (inotify on Linux, timestamp polling elsewhere) and hands changes to per-extension handlers.  The expensive part of a reload (decoding) runs on the watcher thread, the GL part runs on the main thread from applyChangedAssets
+//
+
+#pragma once
+
+#include <string>
+
+// Called on the watcher thread when a watched file changes.  Returns a payload for the apply step (e.g. a decoded image) or NULL.  Must not make GL calls
+typedef void *(*assetPrepareFunc)(const std::string& path);
+
+// Called on the GL thread with the payload returned by the prepare step.  The apply function owns the payload
+typedef void (*assetApplyFunc)(const std::string& path, void *payload);
+
+// Frees a payload that will never be applied (the watcher was stopped first).  Must not make GL calls
+typedef void (*assetReleaseFunc)(void *payload);
+
+// Register the handler for files ending with extension (e.g. ".jpg").  prepare may be NULL, and release must be given if prepare returns anything
+void addAssetHandler(const char *extension, assetPrepareFunc prepare, assetApplyFunc apply, assetReleaseFunc release = NULL);
+
+// Watch a file for changes.  Paths may use either '\' or '/' separators
+void watchAssetFile(const std::string& path);
+
+// Start / stop the watcher thread.  stopAssetWatcher is also registered to run at exit
+void startAssetWatcher(void);
+void stopAssetWatcher(void);
+
+// Run the apply step for every change prepared since the last call.  Call once per frame on the GL thread
+void applyChangedAssets(void);
+
+// Number of changes applied so far.  Anything built from assets (e.g. a cached image) can compare this to notice edits
+unsigned appliedAssetChanges(void);
+
+// Convert path separators to '/' so paths from different sources compare equal
+std::string normaliseAssetPath(const std::string& path);
@@ -0,0 +1,71 @@
+#include "stdafx.h"
+#include "camera.h"
+
+using namespace CoreStructures;
+
+// Half the width and height of the view in world units
+static void viewExtent(const camera2D& camera, float *halfWidth, float *halfHeight) {
+	*halfHeight = 1.0f / camera.zoom;
+	*halfWidth = *halfHeight * camera.aspect;
+}
+
+void resetCamera(camera2D& camera, float aspect) {
+	camera.x = 0.0f;
+	camera.y = 0.0f;
+	camera.zoom = 1.0f;
+	camera.aspect = aspect;
+}
+
+void panCamera(camera2D& camera, float dx, float dy) {
+	float height = 2.0f / camera.zoom;
+
+	camera.x += dx * height;
+	camera.y += dy * height;
+}
+
+void zoomCamera(camera2D& camera, float factor, float screenX, float screenY) {
+	float anchorX, anchorY;
+
+	screenToWorld(camera, screenX, screenY, &anchorX, &anchorY);
+
+	camera.zoom = clamp(camera.zoom * factor, CAMERA_MIN_ZOOM, CAMERA_MAX_ZOOM);
+
+	// move the camera so the anchor is back under the same screen position
+	float halfWidth, halfHeight;
+	viewExtent(camera, &halfWidth, &halfHeight);
+
+	camera.x = anchorX - screenX * halfWidth;
+	camera.y = anchorY - screenY * halfHeight;
+}
+
+void screenToWorld(const camera2D& camera, float screenX, float screenY, float *worldX, float *worldY) {
+	float halfWidth, halfHeight;
+	viewExtent(camera, &halfWidth, &halfHeight);
+
+	*worldX = camera.x + screenX * halfWidth;
+	*worldY = camera.y + screenY * halfHeight;
+}
+
+void worldToScreen(const camera2D& camera, float worldX, float worldY, float *screenX, float *screenY) {
+	float halfWidth, halfHeight;
+	viewExtent(camera, &halfWidth, &halfHeight);
+
+	*screenX = (worldX - camera.x) / halfWidth;
+	*screenY = (worldY - camera.y) / halfHeight;
+}
+
+GUMatrix4 cameraMatrix(const camera2D& camera) {
+	float halfWidth, halfHeight;
+	viewExtent(camera, &halfWidth, &halfHeight);
+
+	// the scene is flat at z = 0, so any depth range containing it will do
+	return GUMatrix4::orthographicProjection(camera.x - halfWidth, camera.x + halfWidth, camera.y - halfHeight, camera.y + halfHeight, -1.0f, 1.0f);
+}
+
+spatialBounds cameraBounds(const camera2D& camera) {
+	float halfWidth, halfHeight;
+	viewExtent(camera, &halfWidth, &halfHeight);
+
+	spatialBounds view = { camera.x - halfWidth, camera.y - halfHeight, camera.x + halfWidth, camera.y + halfHeight };
+	return view;
+}
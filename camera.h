@@ -0,0 +1,39 @@
+//
+// 2D camera.  The view is an axis aligned rectangle of the world centred on the camera - zoom sets its height (zoom 1 shows the 2 x 2 square around the camera that the scene was built in) and the window's aspect ratio its width.  The camera matrix is an orthographic projection of that rectangle, so panning and zooming never touch object transforms
+//
+
+#pragma once
+
+#include <CoreStructures\CoreStructures.h>
+#include "spatial_hash.h"
+
+// Zoom limits.  The lower limit bounds how much of the world can be in view at once (16 units high), which is what keeps the per-frame cost of the tile world bounded
+#define CAMERA_MIN_ZOOM			0.125f
+#define CAMERA_MAX_ZOOM			16.0f
+
+struct camera2D {
+	float		x, y; // world position of the centre of the view
+	float		zoom; // the view is 2 / zoom units high
+	float		aspect; // window width / height
+};
+
+// Centre the camera on the origin at zoom 1
+void resetCamera(camera2D& camera, float aspect);
+
+// Move the camera by dx, dy view heights, so panning feels the same at any zoom
+void panCamera(camera2D& camera, float dx, float dy);
+
+// Multiply the zoom by factor (clamped to the limits), keeping the world point under (screenX, screenY) where it is.  Screen positions are normalised device coordinates
+void zoomCamera(camera2D& camera, float factor, float screenX = 0.0f, float screenY = 0.0f);
+
+// World position under a point on screen (normalised device coordinates)
+void screenToWorld(const camera2D& camera, float screenX, float screenY, float *worldX, float *worldY);
+
+// Screen position (normalised device coordinates) of a world position
+void worldToScreen(const camera2D& camera, float worldX, float worldY, float *screenX, float *screenY);
+
+// The view-projection matrix for beginTransformFrame
+CoreStructures::GUMatrix4 cameraMatrix(const camera2D& camera);
+
+// The part of the world in view
+spatialBounds cameraBounds(const camera2D& camera);
@@ -0,0 +1,597 @@
+#include "stdafx.h"
+#include "collision_world.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+// Bodies per chunk at least - below this waking the workers costs more than the work
+static const int COLLISION_GRAIN = 2048;
+
+// Cell coordinates are clamped to this so huge or infinite positions can't overflow
+static const float MAX_CELL = 1048576.0f;
+
+static const unsigned char BODY_REMOVED = 0;
+static const unsigned char BODY_FILED = 1; // in the bucket of its cell
+static const unsigned char BODY_OVERSIZED = 2; // on the oversized list
+
+#pragma region grid
+
+static int cellCoordinate(const collisionWorld& world, float x) {
+	float c = floorf(x * world.inverseCellSize);
+
+	// NaN fails both comparisons and ends up at 0
+	return int((c > -MAX_CELL) ? ((c < MAX_CELL) ? c : MAX_CELL) : -MAX_CELL);
+}
+
+// The grid wraps around onto the buckets rather than being hashed, so the cells around a cell are in the buckets around its bucket
+static unsigned bucketIndex(const collisionWorld& world, int cx, int cy) {
+	return (unsigned(cx) & world.columnMask) | ((unsigned(cy) & world.rowMask) << world.columnBits);
+}
+
+// where a body belongs - filed or oversized
+static unsigned char bodyState(const collisionWorld& world, const collisionBody& body) {
+	float size = 2.0f * max(body.halfWidth, body.halfHeight);
+
+	return (size > world.cellSize) ? BODY_OVERSIZED : BODY_FILED;
+}
+
+static void fileBody(collisionWorld& world, int id) {
+	collisionBody& body = world.bodies[id];
+
+	body.live = bodyState(world, body);
+	body.cellX = cellCoordinate(world, body.x);
+	body.cellY = cellCoordinate(world, body.y);
+
+	if (body.live == BODY_OVERSIZED) {
+
+		world.oversized.push_back(id);
+
+	} else {
+
+		vector<int>& bucket = world.buckets[bucketIndex(world, body.cellX, body.cellY)];
+
+		body.slot = unsigned(bucket.size());
+		bucket.push_back(id);
+	}
+}
+
+static void unfileBody(collisionWorld& world, int id) {
+	collisionBody& body = world.bodies[id];
+
+	if (body.live == BODY_OVERSIZED)
+		world.oversized.erase(find(world.oversized.begin(), world.oversized.end(), id));
+	else if (body.live == BODY_FILED) {
+
+		// the last body in the bucket takes its slot
+		vector<int>& bucket = world.buckets[bucketIndex(world, body.cellX, body.cellY)];
+
+		bucket[body.slot] = bucket.back();
+		world.bodies[bucket.back()].slot = body.slot;
+		bucket.pop_back();
+	}
+
+	body.live = BODY_REMOVED;
+}
+
+void initCollisionWorld(collisionWorld& world, float cellSize, unsigned bucketCount) {
+	unsigned bits = 0;
+
+	while ((1u << bits) < bucketCount)
+		++bits;
+
+	world = collisionWorld();
+	world.cellSize = cellSize;
+	world.inverseCellSize = 1.0f / cellSize;
+	world.columnBits = (bits + 1) / 2;
+	world.columnMask = (1u << world.columnBits) - 1;
+	world.rowMask = (1u << (bits - world.columnBits)) - 1;
+	world.buckets.assign(1u << bits, vector<int>());
+	world.bucketStart.assign((1u << bits) + 1, 0);
+}
+
+static int addBody(collisionWorld& world, float x, float y, float halfWidth, float halfHeight, collisionShape shape, unsigned group, unsigned mask) {
+	int id = int(world.bodies.size());
+	collisionBody body;
+
+	body.x = x;
+	body.y = y;
+	body.halfWidth = halfWidth;
+	body.halfHeight = halfHeight;
+	body.group = group;
+	body.mask = mask;
+	body.cellX = 0;
+	body.cellY = 0;
+	body.slot = 0;
+	body.shape = (unsigned char)shape;
+	body.live = BODY_REMOVED;
+
+	world.bodies.push_back(body);
+	fileBody(world, id);
+
+	return id;
+}
+
+int addCollisionBox(collisionWorld& world, const spatialBounds& bounds, unsigned group, unsigned mask) {
+	return addBody(world, (bounds.minX + bounds.maxX) * 0.5f, (bounds.minY + bounds.maxY) * 0.5f, (bounds.maxX - bounds.minX) * 0.5f, (bounds.maxY - bounds.minY) * 0.5f, COLLISION_BOX, group, mask);
+}
+
+int addCollisionCircle(collisionWorld& world, float x, float y, float radius, unsigned group, unsigned mask) {
+	return addBody(world, x, y, radius, radius, COLLISION_CIRCLE, group, mask);
+}
+
+void moveCollisionBody(collisionWorld& world, int id, float x, float y) {
+	world.bodies[id].x = x;
+	world.bodies[id].y = y;
+}
+
+void setCollisionBox(collisionWorld& world, int id, const spatialBounds& bounds) {
+	collisionBody& body = world.bodies[id];
+
+	body.x = (bounds.minX + bounds.maxX) * 0.5f;
+	body.y = (bounds.minY + bounds.maxY) * 0.5f;
+	body.halfWidth = (bounds.maxX - bounds.minX) * 0.5f;
+	body.halfHeight = (bounds.maxY - bounds.minY) * 0.5f;
+}
+
+void removeCollisionBody(collisionWorld& world, int id) {
+	if (world.bodies[id].live != BODY_REMOVED)
+		unfileBody(world, id);
+}
+
+#pragma endregion
+
+#pragma region narrowphase
+
+// The overlap of two boxes, pushed out along the axis they overlap least on
+static bool boxesTouch(float ax, float ay, float aw, float ah, float bx, float by, float bw, float bh, collisionContact& contact) {
+	float dx = bx - ax, dy = by - ay;
+	float overlapX = aw + bw - fabs(dx), overlapY = ah + bh - fabs(dy);
+
+	if (overlapX < 0.0f || overlapY < 0.0f)
+		return false;
+
+	contact.x = (max(ax - aw, bx - bw) + min(ax + aw, bx + bw)) * 0.5f;
+	contact.y = (max(ay - ah, by - bh) + min(ay + ah, by + bh)) * 0.5f;
+
+	if (overlapX < overlapY) {
+
+		contact.normalX = (dx < 0.0f) ? -1.0f : 1.0f;
+		contact.normalY = 0.0f;
+		contact.depth = overlapX;
+
+	} else {
+
+		contact.normalX = 0.0f;
+		contact.normalY = (dy < 0.0f) ? -1.0f : 1.0f;
+		contact.depth = overlapY;
+	}
+
+	return true;
+}
+
+static bool circlesTouch(float ax, float ay, float ar, float bx, float by, float br, collisionContact& contact) {
+	float dx = bx - ax, dy = by - ay;
+	float reach = ar + br;
+	float distanceSquared = dx * dx + dy * dy;
+
+	if (distanceSquared > reach * reach)
+		return false;
+
+	float distance = sqrtf(distanceSquared);
+
+	contact.normalX = (distance > 0.0f) ? dx / distance : 0.0f;
+	contact.normalY = (distance > 0.0f) ? dy / distance : 1.0f;
+	contact.depth = reach - distance;
+	contact.x = ax + contact.normalX * (ar - contact.depth * 0.5f);
+	contact.y = ay + contact.normalY * (ar - contact.depth * 0.5f);
+
+	return true;
+}
+
+// A box and a circle, by the point of the box nearest the circle's centre.  A centre inside the box is pushed out like a box the circle's size
+static bool boxCircleTouch(float ax, float ay, float aw, float ah, float bx, float by, float br, collisionContact& contact) {
+	float nearestX = min(max(bx, ax - aw), ax + aw);
+	float nearestY = min(max(by, ay - ah), ay + ah);
+	float dx = bx - nearestX, dy = by - nearestY;
+	float distanceSquared = dx * dx + dy * dy;
+
+	if (distanceSquared > br * br)
+		return false;
+
+	if (distanceSquared > 0.0f) {
+
+		float distance = sqrtf(distanceSquared);
+
+		contact.normalX = dx / distance;
+		contact.normalY = dy / distance;
+		contact.depth = br - distance;
+		contact.x = nearestX;
+		contact.y = nearestY;
+		return true;
+	}
+
+	boxesTouch(ax, ay, aw, ah, bx, by, br, br, contact);
+	contact.x = bx;
+	contact.y = by;
+
+	return true;
+}
+
+static bool bodiesTouch(const collisionBody& a, const collisionBody& b, collisionContact& contact) {
+	// every shape fits in its box, so most pairs stop here
+	if (fabs(b.x - a.x) > a.halfWidth + b.halfWidth || fabs(b.y - a.y) > a.halfHeight + b.halfHeight)
+		return false;
+
+	if (a.shape == COLLISION_BOX && b.shape == COLLISION_BOX)
+		return boxesTouch(a.x, a.y, a.halfWidth, a.halfHeight, b.x, b.y, b.halfWidth, b.halfHeight, contact);
+
+	if (a.shape == COLLISION_CIRCLE && b.shape == COLLISION_CIRCLE)
+		return circlesTouch(a.x, a.y, a.halfWidth, b.x, b.y, b.halfWidth, contact);
+
+	if (a.shape == COLLISION_BOX)
+		return boxCircleTouch(a.x, a.y, a.halfWidth, a.halfHeight, b.x, b.y, b.halfWidth, contact);
+
+	// the box is b, so the normal comes out the wrong way round
+	bool touching = boxCircleTouch(b.x, b.y, b.halfWidth, b.halfHeight, a.x, a.y, a.halfWidth, contact);
+
+	contact.normalX = -contact.normalX;
+	contact.normalY = -contact.normalY;
+
+	return touching;
+}
+
+#pragma endregion
+
+#pragma region update
+
+// The chunks a pass over count items is split into - across the pool, or one chunk on this thread.  Passes over the same count always split it the same way
+static int updateChunks(int count, bool threaded) {
+	if (count <= 0)
+		return 0;
+
+	return threaded ? parallelChunks(count, COLLISION_GRAIN) : 1;
+}
+
+static void runChunks(int count, bool threaded, const parallelJobFunc& job) {
+	if (threaded)
+		parallelFor(count, COLLISION_GRAIN, job);
+	else if (count > 0)
+		job(0, count, 0);
+}
+
+// Collect the bodies in [begin, end) that are no longer filed where they belong
+static void findMovedBodies(const collisionWorld& world, int begin, int end, vector<int>& moved) {
+	for (int i = begin; i < end; ++i) {
+
+		const collisionBody& body = world.bodies[i];
+
+		if (body.live == BODY_REMOVED)
+			continue;
+
+		unsigned char state = bodyState(world, body);
+
+		// oversized bodies aren't filed by cell, so only need moving if they shrink
+		if (state != body.live || (state == BODY_FILED && (body.cellX != cellCoordinate(world, body.x) || body.cellY != cellCoordinate(world, body.y))))
+			moved.push_back(i);
+	}
+}
+
+// Copy bodies [begin, end) out to where their buckets are packed - the contact pass then reads the bodies around each body from one place, rather than from wherever their ids put them
+static void packBodies(collisionWorld& world, int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+
+		const collisionBody& body = world.bodies[i];
+
+		if (body.live != BODY_FILED)
+			continue;
+
+		unsigned p = world.bucketStart[bucketIndex(world, body.cellX, body.cellY)] + body.slot;
+
+		world.packed[p] = body;
+		world.packedIds[p] = i;
+	}
+}
+
+static void testPair(const collisionBody& a, int idA, const collisionBody& b, int idB, vector<collisionContact>& contacts, unsigned& tested) {
+	if (((a.mask & b.group) | (b.mask & a.group)) == 0)
+		return;
+
+	collisionContact contact;
+
+	++tested;
+
+	// the lower id first, so a pair always has the same key
+	bool touching = (idB < idA) ? bodiesTouch(b, a, contact) : bodiesTouch(a, b, contact);
+
+	if (touching) {
+
+		contact.a = min(idA, idB);
+		contact.b = max(idA, idB);
+		contacts.push_back(contact);
+	}
+}
+
+// Find the touching pairs for the bodies packed from buckets [begin, end).  A filed body tests the bodies with higher ids in its own and the 8 cells around it, and every oversized body - so each pair is tested once
+static unsigned findContacts(const collisionWorld& world, int begin, int end, vector<collisionContact>& contacts) {
+	const collisionBody *packed = world.packed.empty() ? NULL : &world.packed[0];
+	const int *packedIds = world.packedIds.empty() ? NULL : &world.packedIds[0];
+	const unsigned *bucketStart = &world.bucketStart[0];
+	unsigned tested = 0;
+
+	for (unsigned p = bucketStart[begin]; p < bucketStart[end]; ++p) {
+
+		const collisionBody& body = packed[p];
+		int id = packedIds[p];
+
+		for (int cy = body.cellY - 1; cy <= body.cellY + 1; ++cy) {
+			for (int cx = body.cellX - 1; cx <= body.cellX + 1; ++cx) {
+
+				unsigned b = bucketIndex(world, cx, cy);
+
+				// a bucket also holds the cells the grid wraps onto it
+				for (unsigned q = bucketStart[b]; q < bucketStart[b + 1]; ++q) {
+
+					if (packedIds[q] > id && packed[q].cellX == cx && packed[q].cellY == cy)
+						testPair(body, id, packed[q], packedIds[q], contacts, tested);
+				}
+			}
+		}
+
+		for (size_t k = 0; k < world.oversized.size(); ++k)
+			testPair(body, id, world.bodies[world.oversized[k]], world.oversized[k], contacts, tested);
+	}
+
+	return tested;
+}
+
+static bool contactBefore(const collisionContact& p, const collisionContact& q) {
+	return p.a < q.a || (p.a == q.a && p.b < q.b);
+}
+
+// Pairs in contacts but not lastContacts begin, pairs in lastContacts but not contacts end
+static void makeEvents(collisionWorld& world) {
+	const vector<collisionContact>& now = world.contacts;
+	const vector<collisionContact>& before = world.lastContacts;
+	size_t i = 0, j = 0;
+
+	world.events.clear();
+
+	while (i < now.size() || j < before.size()) {
+
+		collisionEvent e;
+
+		if (j == before.size() || (i < now.size() && contactBefore(now[i], before[j]))) {
+
+			e.type = COLLISION_BEGIN;
+			e.contact = now[i++];
+
+		} else if (i == now.size() || contactBefore(before[j], now[i])) {
+
+			e.type = COLLISION_END;
+			e.contact = before[j++];
+
+		} else {
+
+			// still touching
+			++i;
+			++j;
+			continue;
+		}
+
+		world.events.push_back(e);
+	}
+}
+
+static void updateWorld(collisionWorld& world, bool threaded) {
+	int count = int(world.bodies.size());
+	int bucketCount = int(world.buckets.size());
+	int chunks = updateChunks(count, threaded);
+	int bucketChunks = updateChunks(bucketCount, threaded);
+	int used = max(chunks, bucketChunks);
+
+	if (int(world.chunkMoved.size()) < used) {
+
+		world.chunkMoved.resize(used);
+		world.chunkContacts.resize(used);
+		world.chunkTested.resize(used);
+	}
+
+	for (int c = 0; c < used; ++c) {
+
+		world.chunkMoved[c].clear();
+		world.chunkContacts[c].clear();
+	}
+
+	// find the bodies that changed cells in parallel, then refile them here - only the ones that crossed a cell boundary since the last update
+	runChunks(count, threaded, [&world](int begin, int end, int chunk) {
+		findMovedBodies(world, begin, end, world.chunkMoved[chunk]);
+	});
+
+	world.lastRefiled = 0;
+
+	for (int c = 0; c < chunks; ++c) {
+
+		for (size_t k = 0; k < world.chunkMoved[c].size(); ++k) {
+
+			int id = world.chunkMoved[c][k];
+
+			unfileBody(world, id);
+			fileBody(world, id);
+		}
+
+		world.lastRefiled += unsigned(world.chunkMoved[c].size());
+	}
+
+	for (int b = 0; b < bucketCount; ++b)
+		world.bucketStart[b + 1] = world.bucketStart[b] + unsigned(world.buckets[b].size());
+
+	world.packed.resize(world.bucketStart[bucketCount]);
+	world.packedIds.resize(world.bucketStart[bucketCount]);
+
+	runChunks(count, threaded, [&world](int begin, int end, int chunk) {
+		packBodies(world, begin, end);
+	});
+
+	runChunks(bucketCount, threaded, [&world](int begin, int end, int chunk) {
+		world.chunkTested[chunk] = findContacts(world, begin, end, world.chunkContacts[chunk]);
+	});
+
+	world.lastContacts.swap(world.contacts);
+	world.contacts.clear();
+	world.lastTested = 0;
+
+	// the few pairs of oversized bodies
+	for (size_t n = 0; n < world.oversized.size(); ++n) {
+		for (size_t k = n + 1; k < world.oversized.size(); ++k)
+			testPair(world.bodies[world.oversized[n]], world.oversized[n], world.bodies[world.oversized[k]], world.oversized[k], world.contacts, world.lastTested);
+	}
+
+	// the buckets aren't in id order, so the merged pairs are sorted for comparing with the last update's
+	for (int c = 0; c < bucketChunks; ++c) {
+
+		world.contacts.insert(world.contacts.end(), world.chunkContacts[c].begin(), world.chunkContacts[c].end());
+		world.lastTested += world.chunkTested[c];
+	}
+
+	sort(world.contacts.begin(), world.contacts.end(), contactBefore);
+
+	makeEvents(world);
+}
+
+void updateCollisionWorld(collisionWorld& world, bool threaded) {
+	auto start = chrono::high_resolution_clock::now();
+
+	updateWorld(world, threaded);
+
+	world.lastUpdateMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	world.updates++;
+}
+
+bool collisionBodiesTouch(const collisionBody& a, const collisionBody& b, collisionContact *contact) {
+	return bodiesTouch(a, b, *contact);
+}
+
+void reportCollisionStats(const collisionWorld& world) {
+	cout << "Collisions: " << world.bodies.size() << " bodies (" << world.oversized.size() << " oversized), " << world.contacts.size() << " touching, last update refiled " << world.lastRefiled << ", tested " << world.lastTested << " pairs, made " << world.events.size() << " events in " << world.lastUpdateMs << " ms\n";
+}
+
+#pragma endregion
+
+#pragma region benchmark
+
+static unsigned randomState = 1;
+
+static float randomBody(void) {
+	randomState = randomState * 1664525u + 1013904223u;
+
+	return float(randomState >> 8) / float(1 << 24);
+}
+
+// count missiles - circles and boxes 0.01 - 0.04 across - drifting over a square worldSize across, above a ground box and among a few clouds
+static void benchmarkWorld(collisionWorld& world, vector<float>& velocities, int count, float worldSize) {
+	initCollisionWorld(world, 0.05f, 1 << 17);
+	velocities.resize(count * 2);
+	randomState = 1;
+
+	unsigned missileMask = COLLISION_MISSILE | COLLISION_GROUND | COLLISION_CLOUD;
+
+	for (int i = 0; i < count; ++i) {
+
+		float x = (randomBody() - 0.5f) * worldSize, y = (randomBody() - 0.5f) * worldSize;
+		float size = 0.005f + randomBody() * 0.015f;
+
+		if (i % 2 == 0) {
+
+			addCollisionCircle(world, x, y, size, COLLISION_MISSILE, missileMask);
+
+		} else {
+
+			spatialBounds b = { x - size, y - size * 0.5f, x + size, y + size * 0.5f };
+			addCollisionBox(world, b, COLLISION_MISSILE, missileMask);
+		}
+
+		float angle = randomBody() * 6.2831853f, speed = 0.2f + randomBody() * 0.8f;
+
+		velocities[i * 2] = cosf(angle) * speed;
+		velocities[i * 2 + 1] = sinf(angle) * speed;
+	}
+
+	spatialBounds ground = { -worldSize, -worldSize, worldSize, -worldSize * 0.4f };
+	addCollisionBox(world, ground, COLLISION_GROUND, 0);
+
+	for (int c = 0; c < 8; ++c) {
+
+		float x = (randomBody() - 0.5f) * worldSize, y = (randomBody() - 0.5f) * worldSize;
+		spatialBounds cloud = { x - 0.5f, y - 0.2f, x + 0.5f, y + 0.2f };
+
+		addCollisionBox(world, cloud, COLLISION_CLOUD, 0);
+	}
+}
+
+// move the missiles on a frame, bouncing them off the edges of the world
+static void moveBenchmarkBodies(collisionWorld& world, vector<float>& velocities, int count, float worldSize, float timeStep) {
+	float edge = worldSize * 0.5f;
+
+	for (int i = 0; i < count; ++i) {
+
+		float *v = &velocities[i * 2];
+
+		v[0] = (fabs(world.bodies[i].x + v[0] * timeStep) > edge) ? -v[0] : v[0];
+		v[1] = (fabs(world.bodies[i].y + v[1] * timeStep) > edge) ? -v[1] : v[1];
+
+		moveCollisionBody(world, i, world.bodies[i].x + v[0] * timeStep, world.bodies[i].y + v[1] * timeStep);
+	}
+}
+
+void collisionBenchmark(void) {
+	const int noofBodies = 100000;
+	const float worldSize = 30.0f;
+	const int runs = 20;
+	const float timeStep = 1.0f / 60.0f;
+
+	cout << "Collision benchmark (" << noofBodies << " moving bodies, " << runs << " updates, " << threadPoolSize() << " threads)\n";
+
+	collisionWorld serial, parallel;
+	vector<float> serialVelocities, parallelVelocities;
+
+	benchmarkWorld(serial, serialVelocities, noofBodies, worldSize);
+	benchmarkWorld(parallel, parallelVelocities, noofBodies, worldSize);
+
+	double serialMs = 0.0, parallelMs = 0.0;
+	unsigned refiled = 0, tested = 0, events = 0;
+
+	for (int r = 0; r < runs; ++r) {
+
+		moveBenchmarkBodies(serial, serialVelocities, noofBodies, worldSize, timeStep);
+		moveBenchmarkBodies(parallel, parallelVelocities, noofBodies, worldSize, timeStep);
+
+		auto start = chrono::high_resolution_clock::now();
+		updateWorld(serial, false);
+		serialMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+		start = chrono::high_resolution_clock::now();
+		updateWorld(parallel, true);
+		parallelMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+		// the first update makes a begin event for every contact
+		if (r > 0) {
+
+			refiled += serial.lastRefiled;
+			tested += serial.lastTested;
+			events += unsigned(serial.events.size());
+		}
+	}
+
+	serialMs /= runs;
+	parallelMs /= runs;
+
+	cout << "  " << serial.contacts.size() << " touching, " << refiled / (runs - 1) << " bodies refiled, " << tested / (runs - 1) << " pairs tested and " << events / (runs - 1) << " events per update\n";
+	cout << "  1 thread:  " << serialMs << " ms per update\n";
+	cout << "  " << threadPoolSize() << " threads: " << parallelMs << " ms per update (" << serialMs / parallelMs << "x)\n\n";
+}
+
+#pragma endregion
@@ -0,0 +1,100 @@
+//
+// 2D collision detection.  Box and circle bodies are filed in a uniform grid by their centre, tested against the 8 cells around them, and each update turns the touching pairs into begin and end contact events
+//
+
+#pragma once
+
+#include <vector>
+#include "spatial_hash.h"
+
+enum collisionShape {
+	COLLISION_BOX = 0,
+	COLLISION_CIRCLE = 1
+};
+
+// Groups a body can belong to.  A pair is tested if either body's mask has the other's group in it
+enum collisionGroup {
+	COLLISION_MISSILE = 1,
+	COLLISION_GROUND = 2,
+	COLLISION_CLOUD = 4
+};
+
+enum collisionEventType {
+	COLLISION_BEGIN = 0, // started touching since the last update
+	COLLISION_END = 1 // stopped touching, or one of them was removed
+};
+
+// Two bodies touching, with a < b
+struct collisionContact {
+	int			a, b;
+	float		x, y; // about where they touch
+	float		normalX, normalY; // the way to push b out of a
+	float		depth; // how far to push it
+};
+
+struct collisionEvent {
+	collisionEventType	type;
+	collisionContact	contact; // as it was at the last update they touched, for COLLISION_END
+};
+
+// Everything the tests need to know about a body is kept together, so it can be copied out in one go
+struct collisionBody {
+	float			x, y; // centre
+	float			halfWidth, halfHeight; // halfWidth is the radius of a circle
+	unsigned		group, mask;
+	int				cellX, cellY; // cell it is filed under
+	unsigned		slot; // where it is in the cell's bucket
+	unsigned char	shape, live;
+};
+
+struct collisionWorld {
+	float								cellSize = 1.0f, inverseCellSize = 1.0f;
+	unsigned							columnBits = 0, columnMask = 0, rowMask = 0; // the buckets are a grid of powers of two columns and rows
+
+	std::vector<std::vector<int> >		buckets; // body ids
+	std::vector<int>					oversized; // bodies bigger than a cell - tested against every body
+
+	std::vector<collisionBody>			bodies; // by id
+
+	// the filed bodies copied out in bucket order at each update.  Bucket b's are packed[bucketStart[b]] up to packed[bucketStart[b + 1]]
+	std::vector<collisionBody>			packed;
+	std::vector<int>					packedIds;
+	std::vector<unsigned>				bucketStart;
+
+	// per chunk of the last update
+	std::vector<std::vector<int> >		chunkMoved; // bodies to refile
+	std::vector<std::vector<collisionContact> >	chunkContacts;
+	std::vector<unsigned>				chunkTested;
+
+	std::vector<collisionContact>		contacts, lastContacts; // touching after this update and the one before, ordered by a then b
+	std::vector<collisionEvent>			events; // from the last update, ordered by a then b
+
+	unsigned							updates = 0;
+	unsigned							lastRefiled = 0, lastTested = 0; // bodies that changed cells and pairs in groups that collide tested in the last update
+	double								lastUpdateMs = 0.0;
+};
+
+// Set up an empty world.  cellSize should be around the size of the bigger moving bodies.  bucketCount is rounded up to a power of two
+void initCollisionWorld(collisionWorld& world, float cellSize, unsigned bucketCount = 4096);
+
+// Add a body and return its id
+int addCollisionBox(collisionWorld& world, const spatialBounds& bounds, unsigned group, unsigned mask);
+int addCollisionCircle(collisionWorld& world, float x, float y, float radius, unsigned group, unsigned mask);
+
+// Move a body (or resize a box).  Nothing is refiled or tested until the next update
+void moveCollisionBody(collisionWorld& world, int id, float x, float y);
+void setCollisionBox(collisionWorld& world, int id, const spatialBounds& bounds);
+
+// Remove a body - its contacts end at the next update.  Its id is not reused
+void removeCollisionBody(collisionWorld& world, int id);
+
+// Refile the bodies that changed cells, find every touching pair and make the events for the pairs that started or stopped touching.  The passes run across the thread pool unless threaded is false
+void updateCollisionWorld(collisionWorld& world, bool threaded = true);
+
+// Whether two bodies touch, whatever their groups, filling in contact (all but its ids) if they do
+bool collisionBodiesTouch(const collisionBody& a, const collisionBody& b, collisionContact *contact);
+
+void reportCollisionStats(const collisionWorld& world);
+
+// Time 20 updates of 100,000 moving bodies on one thread and across the thread pool.  Doesn't need GL
+void collisionBenchmark(void);
@@ -0,0 +1,128 @@
+#include "stdafx.h"
+#include "command_list.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace CoreStructures;
+
+void resetCommandList(commandList& list) {
+	list.commands.clear();
+}
+
+void recordCommand(commandList& list, const renderCommand& command, unsigned layer) {
+	recordedCommand r = { command, layer };
+	list.commands.push_back(r);
+}
+
+void submitCommandLists(const commandList *lists, size_t count, unsigned firstLayer) {
+	for (size_t i = 0; i < count; ++i) {
+
+		const vector<recordedCommand>& commands = lists[i].commands;
+
+		for (size_t c = 0; c < commands.size(); ++c) {
+
+			if (commands[c].layer >= firstLayer)
+				submitRenderCommand(commands[c].command, commands[c].layer);
+		}
+	}
+}
+
+#pragma region benchmark
+
+// What the benchmark frame does for each object: compose its world transform, cull its bounds against the view and record a draw if it is visible
+static void prepareObjects(int begin, int end, const vector<GUAffine2D>& parents, const vector<GUAffine2D>& locals, vector<GUAffine2D>& world, commandList& list) {
+	for (int i = begin; i < end; ++i) {
+
+		world[i] = parents[i / 16] * locals[i];
+
+		// a unit quad's bounds, as the scene culls each node
+		float corners[8] = { -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f };
+		world[i].transformPoints(corners, corners, 4);
+
+		float minX = corners[0], maxX = corners[0], minY = corners[1], maxY = corners[1];
+
+		for (int c = 2; c < 8; c += 2) {
+			minX = (corners[c] < minX) ? corners[c] : minX;
+			maxX = (corners[c] > maxX) ? corners[c] : maxX;
+			minY = (corners[c + 1] < minY) ? corners[c + 1] : minY;
+			maxY = (corners[c + 1] > maxY) ? corners[c + 1] : maxY;
+		}
+
+		if (maxX < -2.0f || minX > 2.0f || maxY < -2.0f || minY > 2.0f)
+			continue;
+
+		renderCommand command;
+
+		command.program = 1 + GLuint(i % 3);
+		command.texture = 0;
+		command.textureLayer = i % 5;
+		command.blend = i % 2;
+		command.vao = 1 + GLuint(i % 7);
+		command.primitive = GL_TRIANGLE_STRIP;
+		command.first = 0;
+		command.count = 4;
+		command.indexType = GL_UNSIGNED_SHORT;
+		command.transform = i;
+
+		recordCommand(list, command, unsigned(i % 4));
+	}
+}
+
+void commandListBenchmark(void) {
+	const int noofObjects = 50000;
+	const int grain = 1024;
+	const int runs = 20;
+
+	// objects scattered over [-4, 4] in groups of 16 sharing a parent, so about a quarter are in view
+	vector<GUAffine2D> parents(noofObjects / 16 + 1), locals(noofObjects);
+	unsigned seed = 12345;
+
+	for (size_t i = 0; i < parents.size(); ++i) {
+
+		seed = seed * 1664525u + 1013904223u;
+		parents[i] = GUAffine2D::TRS(float(seed >> 8) / float(1 << 24) * 8.0f - 4.0f, float(seed & 0xFFFF) / 65536.0f * 8.0f - 4.0f, 0.3f, 1.0f, 1.0f);
+	}
+
+	for (int i = 0; i < noofObjects; ++i) {
+
+		seed = seed * 1664525u + 1013904223u;
+		locals[i] = GUAffine2D::TRS(float(i % 4) * 0.1f, float(i % 16 / 4) * 0.1f, float(seed >> 8) / float(1 << 24) * 6.28f, 0.05f, 0.05f);
+	}
+
+	// one thread, one list
+	vector<GUAffine2D> serialWorld(noofObjects), parallelWorld(noofObjects);
+	commandList serialList;
+
+	auto start = chrono::high_resolution_clock::now();
+
+	for (int r = 0; r < runs; ++r) {
+
+		resetCommandList(serialList);
+		prepareObjects(0, noofObjects, parents, locals, serialWorld, serialList);
+	}
+
+	double serialMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+	// the pool, one list per chunk
+	vector<commandList> lists(parallelChunks(noofObjects, grain));
+
+	start = chrono::high_resolution_clock::now();
+
+	for (int r = 0; r < runs; ++r) {
+
+		parallelFor(noofObjects, grain, [&](int begin, int end, int chunk) {
+			resetCommandList(lists[chunk]);
+			prepareObjects(begin, end, parents, locals, parallelWorld, lists[chunk]);
+		});
+	}
+
+	double parallelMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+	cout << "Command list benchmark (" << noofObjects << " objects, " << serialList.commands.size() << " recorded)\n";
+	cout << "  1 thread:      " << serialMs << " ms\n";
+	cout << "  " << threadPoolSize() << " threads:     " << parallelMs << " ms (" << lists.size() << " lists, " << serialMs / parallelMs << "x)\n\n";
+}
+
+#pragma endregion
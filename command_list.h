@@ -0,0 +1,28 @@
+//
+// Command lists.  Draws are recorded as plain data into a list owned by one thread, so threads can record without locking, then submitted to the render queue in order on the GL thread
+//
+
+#pragma once
+
+#include "render_queue.h"
+#include <vector>
+
+struct recordedCommand {
+	renderCommand		command;
+	unsigned			layer;
+};
+
+struct commandList {
+	std::vector<recordedCommand>	commands;
+};
+
+// Empty a list for reuse.  Its memory is kept, so once lists have grown to a frame's size recording doesn't allocate
+void resetCommandList(commandList& list);
+
+void recordCommand(commandList& list, const renderCommand& command, unsigned layer);
+
+// Submit the commands in lists[0], then lists[1] and so on, skipping any below firstLayer (e.g. layers that are already cached).  GL thread only
+void submitCommandLists(const commandList *lists, size_t count, unsigned firstLayer = 0);
+
+// Time preparing a 50,000 object frame (world transforms, culling and recording) on one thread and across the thread pool
+void commandListBenchmark(void);
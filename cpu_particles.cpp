@@ -0,0 +1,578 @@
+#include "stdafx.h"
+#include "cpu_particles.h"
+#include "gl_extensions.h"
+#include "shader_source.h"
+#include "thread_pool.h"
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define CPU_PARTICLES_SSE		1
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+// Particles per chunk at least - below this waking the workers costs more than the work
+static const int PARTICLE_GRAIN = 4096;
+
+// Longest a step waits for the GPU to finish drawing a region before writing it anyway (ns)
+static const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+static void resizePool(cpuParticlePool& pool, unsigned capacity) {
+	vector<float> *fields[] = { &pool.x, &pool.y, &pool.velocityX, &pool.velocityY, &pool.accelerationX, &pool.accelerationY, &pool.drag, &pool.age, &pool.life, &pool.sizeStart, &pool.sizeEnd };
+
+	for (int i = 0; i < 11; ++i)
+		fields[i]->assign(capacity, 0.0f);
+
+	pool.colourStart.assign(capacity, 0);
+	pool.colourEnd.assign(capacity, 0);
+	pool.count = 0;
+}
+
+void allocateCpuParticles(cpuParticleSystem& system, unsigned capacity) {
+	system = cpuParticleSystem();
+
+	for (int r = 0; r < CPU_PARTICLE_REGIONS; ++r) {
+
+		system.drawVAOs[r] = 0;
+		system.fences[r] = 0;
+	}
+
+	resizePool(system.pools[0], capacity);
+	resizePool(system.pools[1], capacity);
+
+	system.capacity = capacity;
+}
+
+static spatialBounds emptyBounds(void) {
+	spatialBounds b = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+	return b;
+}
+
+static void mergeBounds(spatialBounds& bounds, const spatialBounds& b) {
+	bounds.minX = (b.minX < bounds.minX) ? b.minX : bounds.minX;
+	bounds.minY = (b.minY < bounds.minY) ? b.minY : bounds.minY;
+	bounds.maxX = (b.maxX > bounds.maxX) ? b.maxX : bounds.maxX;
+	bounds.maxY = (b.maxY > bounds.maxY) ? b.maxY : bounds.maxY;
+}
+
+// The chunks a pass over count particles is split into - across the pool, or one chunk on this thread.  Passes over the same count always split it the same way
+static int stepChunks(int count, bool threaded) {
+	if (count <= 0)
+		return 0;
+
+	return threaded ? parallelChunks(count, PARTICLE_GRAIN) : 1;
+}
+
+static void runChunks(int count, bool threaded, const parallelJobFunc& job) {
+	if (threaded)
+		parallelFor(count, PARTICLE_GRAIN, job);
+	else if (count > 0)
+		job(0, count, 0);
+}
+
+#pragma region kernels
+
+// Age and integrate particles [begin, end) in place and return how many are still alive.  Dead particles are integrated along with the rest rather than branching around them - compaction drops them anyway
+static unsigned integrateParticles(cpuParticlePool& pool, int begin, int end, float timeStep) {
+	float *x = &pool.x[0], *y = &pool.y[0];
+	float *velocityX = &pool.velocityX[0], *velocityY = &pool.velocityY[0];
+	const float *accelerationX = &pool.accelerationX[0], *accelerationY = &pool.accelerationY[0], *drag = &pool.drag[0];
+	float *age = &pool.age[0];
+	const float *life = &pool.life[0];
+
+	unsigned survivors = 0;
+	int i = begin;
+
+#ifdef CPU_PARTICLES_SSE
+	// survivors in each 4 bit movemask
+	static const unsigned char bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+	const __m128 dt = _mm_set1_ps(timeStep);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= end; i += 4) {
+
+		__m128 a = _mm_add_ps(_mm_loadu_ps(age + i), dt);
+
+		_mm_storeu_ps(age + i, a);
+		survivors += bitCount[_mm_movemask_ps(_mm_cmplt_ps(a, _mm_loadu_ps(life + i)))];
+
+		__m128 damping = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(drag + i), dt)), zero);
+		__m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityX + i), _mm_mul_ps(_mm_loadu_ps(accelerationX + i), dt)), damping);
+		__m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityY + i), _mm_mul_ps(_mm_loadu_ps(accelerationY + i), dt)), damping);
+
+		_mm_storeu_ps(velocityX + i, vx);
+		_mm_storeu_ps(velocityY + i, vy);
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(vy, dt)));
+	}
+#endif
+
+	// the rest one at a time, with the same operations in the same order so results don't depend on where chunks start
+	for (; i < end; ++i) {
+
+		age[i] += timeStep;
+
+		if (age[i] < life[i])
+			survivors++;
+
+		float damping = 1.0f - drag[i] * timeStep;
+		damping = (damping > 0.0f) ? damping : 0.0f;
+
+		velocityX[i] = (velocityX[i] + accelerationX[i] * timeStep) * damping;
+		velocityY[i] = (velocityY[i] + accelerationY[i] * timeStep) * damping;
+		x[i] += velocityX[i] * timeStep;
+		y[i] += velocityY[i] * timeStep;
+	}
+
+	return survivors;
+}
+
+// write particle i's sprite (if there is anywhere to write it) and grow bounds to cover it at its largest
+static void writeSprite(const cpuParticlePool& pool, unsigned i, cpuParticleVertex *vertices, spatialBounds& bounds) {
+	float radius = ((pool.sizeStart[i] > pool.sizeEnd[i]) ? pool.sizeStart[i] : pool.sizeEnd[i]) * 0.5f;
+	spatialBounds b = { pool.x[i] - radius, pool.y[i] - radius, pool.x[i] + radius, pool.y[i] + radius };
+
+	mergeBounds(bounds, b);
+
+	if (!vertices)
+		return;
+
+	cpuParticleVertex& v = vertices[i];
+
+	v.x = pool.x[i];
+	v.y = pool.y[i];
+	v.age = pool.age[i];
+	v.life = pool.life[i];
+	v.sizeStart = pool.sizeStart[i];
+	v.sizeEnd = pool.sizeEnd[i];
+	v.colourStart = pool.colourStart[i];
+	v.colourEnd = pool.colourEnd[i];
+}
+
+// Copy the survivors among particles [begin, end) of from to to, packed together from offset, and write their sprites
+static void compactParticles(const cpuParticlePool& from, cpuParticlePool& to, int begin, int end, unsigned offset, cpuParticleVertex *vertices, spatialBounds& bounds) {
+	unsigned o = offset;
+
+	for (int i = begin; i < end; ++i) {
+
+		if (!(from.age[i] < from.life[i]))
+			continue;
+
+		to.x[o] = from.x[i];
+		to.y[o] = from.y[i];
+		to.velocityX[o] = from.velocityX[i];
+		to.velocityY[o] = from.velocityY[i];
+		to.accelerationX[o] = from.accelerationX[i];
+		to.accelerationY[o] = from.accelerationY[i];
+		to.drag[o] = from.drag[i];
+		to.age[o] = from.age[i];
+		to.life[o] = from.life[i];
+		to.sizeStart[o] = from.sizeStart[i];
+		to.sizeEnd[o] = from.sizeEnd[i];
+		to.colourStart[o] = from.colourStart[i];
+		to.colourEnd[o] = from.colourEnd[i];
+
+		writeSprite(to, o, vertices, bounds);
+		o++;
+	}
+}
+
+// integer hash (PCG) -> [0, 1), the same as Shaders\particle_emit.glsl so both systems start particles alike
+static unsigned hashParticle(unsigned x) {
+	unsigned state = x * 747796405u + 2891336453u;
+	unsigned word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+	return (word >> 22u) ^ word;
+}
+
+static float randomParticle(unsigned& state) {
+	state = hashParticle(state);
+	return float(state >> 8) / 16777216.0f;
+}
+
+// Start new particles [begin, end) of this step's emissions in to, after the first survivors, and write their sprites.  Each picks its starting state from its index and the step, so it doesn't matter which thread starts it
+static void emitNewParticles(const vector<particleEmission>& emissions, cpuParticlePool& to, int begin, int end, unsigned survivors, unsigned seed, cpuParticleVertex *vertices, spatialBounds& bounds) {
+	size_t e = 0;
+
+	for (int i = begin; i < end; ++i) {
+
+		while (e + 1 < emissions.size() && unsigned(i) >= emissions[e].first + emissions[e].count)
+			e++;
+
+		const particleEmission& emission = emissions[e];
+		unsigned state = unsigned(i) ^ (seed * 1664525u);
+
+		float angle = randomParticle(state) * 6.2831853f;
+		float speed = emission.speedMin + (emission.speedMax - emission.speedMin) * randomParticle(state);
+		float offsetX = randomParticle(state) * 2.0f - 1.0f;
+		float offsetY = randomParticle(state) * 2.0f - 1.0f;
+		float life = emission.lifeMin + (emission.lifeMax - emission.lifeMin) * randomParticle(state);
+
+		unsigned o = survivors + unsigned(i);
+
+		to.x[o] = emission.x + offsetX * emission.halfWidth;
+		to.y[o] = emission.y + offsetY * emission.halfHeight;
+		to.velocityX[o] = emission.velocityX + cosf(angle) * speed;
+		to.velocityY[o] = emission.velocityY + sinf(angle) * speed;
+		to.accelerationX[o] = emission.accelerationX;
+		to.accelerationY[o] = emission.accelerationY;
+		to.drag[o] = emission.drag;
+		to.age[o] = 0.0f;
+		to.life[o] = life;
+		to.sizeStart[o] = emission.sizeStart;
+		to.sizeEnd[o] = emission.sizeEnd;
+		to.colourStart[o] = emission.colourStart;
+		to.colourEnd[o] = emission.colourEnd;
+
+		writeSprite(to, o, vertices, bounds);
+	}
+}
+
+#pragma endregion
+
+#pragma region steps
+
+// First half of a step: age and integrate the live particles and work out where each chunk's survivors will go.  Returns the number of particles there will be after the step, new ones included
+static unsigned integrateStep(cpuParticleSystem& system, float timeStep, bool threaded) {
+	cpuParticlePool& pool = system.pools[system.current];
+	int chunks = stepChunks(int(pool.count), threaded);
+
+	system.chunkSurvivors.assign(chunks + 1, 0);
+
+	runChunks(int(pool.count), threaded, [&](int begin, int end, int chunk) {
+		system.chunkSurvivors[chunk] = integrateParticles(pool, begin, end, timeStep);
+	});
+
+	// survivor counts -> where each chunk's survivors start, with the total at the end
+	unsigned offset = 0;
+
+	for (int c = 0; c <= chunks; ++c) {
+
+		unsigned survivors = system.chunkSurvivors[c];
+
+		system.chunkSurvivors[c] = offset;
+		offset += survivors;
+	}
+
+	// new particles past the capacity are dropped
+	unsigned room = system.capacity - offset;
+
+	return offset + ((system.queued < room) ? system.queued : room);
+}
+
+// Second half: compact the survivors into the other pool, append the new particles and write count sprites to vertices (if not NULL)
+static void writeStep(cpuParticleSystem& system, float timeStep, unsigned count, cpuParticleVertex *vertices, bool threaded) {
+	const cpuParticlePool& from = system.pools[system.current];
+	cpuParticlePool& to = system.pools[1 - system.current];
+
+	int chunks = stepChunks(int(from.count), threaded);
+	unsigned survivors = system.chunkSurvivors[chunks];
+	int emitted = int(count - survivors);
+
+	system.chunkBounds.assign(chunks + stepChunks(emitted, threaded), emptyBounds());
+
+	runChunks(int(from.count), threaded, [&](int begin, int end, int chunk) {
+		compactParticles(from, to, begin, end, system.chunkSurvivors[chunk], vertices, system.chunkBounds[chunk]);
+	});
+
+	unsigned seed = system.steps + 1;
+
+	runChunks(emitted, threaded, [&](int begin, int end, int chunk) {
+		emitNewParticles(system.emissions, to, begin, end, survivors, seed, vertices, system.chunkBounds[chunks + chunk]);
+	});
+
+	system.lastBounds = system.bounds;
+	system.hadBounds = system.hasBounds;
+	system.bounds = emptyBounds();
+	system.hasBounds = count > 0;
+
+	for (size_t i = 0; i < system.chunkBounds.size(); ++i)
+		mergeBounds(system.bounds, system.chunkBounds[i]);
+
+	to.count = count;
+	system.current = 1 - system.current;
+
+	system.time += timeStep;
+	system.steps++;
+	system.lastEmitted = unsigned(emitted);
+
+	system.emissions.clear();
+	system.queued = 0;
+}
+
+#pragma endregion
+
+bool setupCpuParticleSystem(cpuParticleSystem& system, unsigned capacity) {
+	allocateCpuParticles(system, 0);
+
+	GLuint program = setupParticleSpriteProgram();
+
+	releaseShaderSourceMappings();
+
+	if (!program || capacity == 0) {
+
+		cout << "Particles: the particle shaders could not be built\n";
+
+		if (program)
+			glDeleteProgram(program);
+
+		return false;
+	}
+
+	allocateCpuParticles(system, capacity);
+	system.drawProgram = program;
+
+	// every region at once, so one mapping serves the lifetime of the buffer
+	GLsizeiptr regionSize = GLsizeiptr(capacity) * sizeof(cpuParticleVertex);
+
+	glGenBuffers(1, &system.streamBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, system.streamBuffer);
+
+	if (glextBufferStorage) {
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(GL_ARRAY_BUFFER, regionSize * CPU_PARTICLE_REGIONS, NULL, flags);
+		system.mapped = (cpuParticleVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * CPU_PARTICLE_REGIONS, flags);
+
+		// storage can't be respecified, so start again with an ordinary buffer
+		if (!system.mapped) {
+
+			glDeleteBuffers(1, &system.streamBuffer);
+			glGenBuffers(1, &system.streamBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, system.streamBuffer);
+		}
+	}
+
+	if (!system.mapped)
+		glBufferData(GL_ARRAY_BUFFER, regionSize * CPU_PARTICLE_REGIONS, NULL, GL_STREAM_DRAW);
+
+	// one VAO per region, with each sprite's attributes advancing per instance
+	glGenVertexArrays(CPU_PARTICLE_REGIONS, system.drawVAOs);
+
+	for (int r = 0; r < CPU_PARTICLE_REGIONS; ++r) {
+
+		size_t base = size_t(regionSize) * r;
+		GLsizei stride = sizeof(cpuParticleVertex);
+
+		glBindVertexArray(system.drawVAOs[r]);
+
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(cpuParticleVertex, x)));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(cpuParticleVertex, age)));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(cpuParticleVertex, sizeStart)));
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)(base + offsetof(cpuParticleVertex, colourStart)));
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)(base + offsetof(cpuParticleVertex, colourEnd)));
+
+		for (GLuint a = 0; a < 5; ++a) {
+
+			glEnableVertexAttribArray(a);
+			glVertexAttribDivisor(a, 1);
+		}
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	cout << "Particles: room for " << capacity << " on the CPU (" << threadPoolSize() << " threads, " << (system.mapped ? "persistently mapped" : "mapped each step") << ")\n";
+
+	return true;
+}
+
+bool emitCpuParticles(cpuParticleSystem& system, const particleEmission& emission) {
+	if (system.capacity == 0 || system.emissions.size() >= MAX_PARTICLE_EMISSIONS)
+		return false;
+
+	unsigned count = (emission.count < system.capacity - system.queued) ? emission.count : system.capacity - system.queued;
+
+	system.totalEmitted += emission.count;
+
+	if (count == 0)
+		return true;
+
+	particleEmission e = emission;
+
+	e.first = system.queued;
+	e.count = count;
+
+	system.emissions.push_back(e);
+	system.queued += count;
+
+	return true;
+}
+
+void updateCpuParticleSystem(cpuParticleSystem& system, float timeStep) {
+	if (system.capacity == 0)
+		return;
+
+	auto start = chrono::high_resolution_clock::now();
+
+	unsigned count = integrateStep(system, timeStep, true);
+
+	// the sprites go in the next region round, once the GPU has finished drawing what was last written there.  Integrating doesn't touch the buffer, so that has already given the GPU a little longer
+	int region = (system.region + 1) % CPU_PARTICLE_REGIONS;
+	auto waitStart = chrono::high_resolution_clock::now();
+
+	if (system.fences[region]) {
+
+		glClientWaitSync(system.fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+		glDeleteSync(system.fences[region]);
+		system.fences[region] = 0;
+	}
+
+	system.lastWaitMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - waitStart).count();
+
+	// the fence already keeps the writes clear of the GPU, so the fallback mapping needn't synchronise
+	cpuParticleVertex *vertices = NULL;
+
+	if (system.mapped) {
+
+		vertices = system.mapped + size_t(region) * system.capacity;
+	}
+	else if (count > 0) {
+
+		glBindBuffer(GL_ARRAY_BUFFER, system.streamBuffer);
+		vertices = (cpuParticleVertex*)glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(region) * system.capacity * sizeof(cpuParticleVertex), count * sizeof(cpuParticleVertex), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	}
+
+	writeStep(system, timeStep, count, vertices, true);
+
+	if (!system.mapped && count > 0) {
+
+		if (vertices)
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	system.region = region;
+	system.drawCount = vertices ? count : 0;
+
+	system.lastStepMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void stepCpuParticles(cpuParticleSystem& system, float timeStep, cpuParticleVertex *sprites, bool threaded) {
+	unsigned count = integrateStep(system, timeStep, threaded);
+	writeStep(system, timeStep, count, sprites, threaded);
+}
+
+void drawCpuParticleSystem(cpuParticleSystem& system, float pointScale) {
+	if (system.capacity == 0 || system.drawCount == 0)
+		return;
+
+	beginParticleSprites(system.drawProgram, pointScale);
+
+	glBindVertexArray(system.drawVAOs[system.region]);
+	glDrawArraysInstanced(GL_POINTS, 0, 1, system.drawCount);
+
+	// the step that next comes round to this region waits for the draw
+	if (system.fences[system.region])
+		glDeleteSync(system.fences[system.region]);
+
+	system.fences[system.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	endParticleSprites();
+}
+
+bool cpuParticleSystemBounds(const cpuParticleSystem& system, spatialBounds *bounds) {
+	if (!system.hasBounds && !system.hadBounds)
+		return false;
+
+	*bounds = emptyBounds();
+
+	if (system.hasBounds)
+		mergeBounds(*bounds, system.bounds);
+
+	if (system.hadBounds)
+		mergeBounds(*bounds, system.lastBounds);
+
+	return true;
+}
+
+bool reloadCpuParticleShaders(cpuParticleSystem& system, const string& path) {
+	if (system.capacity == 0 || !reloadParticleSpriteProgram(&system.drawProgram, path))
+		return false;
+
+	releaseShaderSourceMappings();
+
+	return true;
+}
+
+void reportCpuParticleSystemStats(const cpuParticleSystem& system) {
+	if (system.capacity == 0) {
+
+		cout << "Particles: off\n";
+		return;
+	}
+
+	cout << "Particles: " << system.pools[system.current].count << " live on the CPU, " << system.lastEmitted << " emitted last step, " << system.totalEmitted << " in " << system.steps << " steps, room for " << system.capacity << "\n";
+	cout << "  last step " << system.lastStepMs << " ms (" << system.lastWaitMs << " ms waiting for the GPU), " << (system.mapped ? "persistently mapped" : "mapped each step") << "\n";
+}
+
+#pragma region benchmark
+
+void cpuParticleBenchmark(void) {
+	const unsigned sizes[] = { 100000, 250000, 1000000 };
+	const int runs = 20;
+	const float timeStep = 1.0f / 60.0f;
+
+	cout << "CPU particle benchmark (" << runs << " steps, " << threadPoolSize() << " threads)\n";
+
+	for (int s = 0; s < 3; ++s) {
+
+		unsigned size = sizes[s];
+
+		// a pool full of particles with lives from 0.1 - 3 seconds, topped up each step as a scene's effects would
+		particleEmission fill = { 0.0f, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.1f, 3.0f, 0.02f, 0.01f, 0.0f, -1.0f, 0.5f, 0.0f, 0xFFFFFFFF, 0x00000000, 0, size };
+		particleEmission topUp = fill;
+
+		topUp.count = size / 30;
+
+		cpuParticleSystem serial, parallel;
+		vector<cpuParticleVertex> serialSprites(size), parallelSprites(size);
+
+		allocateCpuParticles(serial, size);
+		allocateCpuParticles(parallel, size);
+
+		emitCpuParticles(serial, fill);
+		emitCpuParticles(parallel, fill);
+
+		stepCpuParticles(serial, timeStep, serialSprites.data(), false);
+		stepCpuParticles(parallel, timeStep, parallelSprites.data(), true);
+
+		auto start = chrono::high_resolution_clock::now();
+
+		for (int r = 0; r < runs; ++r) {
+
+			emitCpuParticles(serial, topUp);
+			stepCpuParticles(serial, timeStep, serialSprites.data(), false);
+		}
+
+		double serialMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+		start = chrono::high_resolution_clock::now();
+
+		for (int r = 0; r < runs; ++r) {
+
+			emitCpuParticles(parallel, topUp);
+			stepCpuParticles(parallel, timeStep, parallelSprites.data(), true);
+		}
+
+		double parallelMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / runs;
+
+		unsigned live = serial.pools[serial.current].count;
+
+		cout << "  " << size << " particles (" << live << " live)\n";
+		cout << "    1 thread:    " << serialMs << " ms per step (" << live / serialMs / 1000.0 << "M particles/s)\n";
+		cout << "    " << threadPoolSize() << " threads:   " << parallelMs << " ms per step (" << live / parallelMs / 1000.0 << "M particles/s, " << serialMs / parallelMs << "x)\n";
+	}
+
+	cout << "\n";
+}
+
+#pragma endregion
@@ -0,0 +1,90 @@
+//
+// CPU particle system, for drivers without compute shaders.  Structure of arrays particles are integrated with SSE across the thread pool, compacted into a second pool and written as sprites into a mapped streaming buffer
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <string>
+#include <vector>
+#include "particle_system.h"
+#include "spatial_hash.h"
+
+// Copies of the sprites in the streaming buffer, written round robin so a step never writes sprites the GPU may still be drawing
+#define CPU_PARTICLE_REGIONS		3
+
+// One array per particle field, each capacity long.  The first count entries are live
+struct cpuParticlePool {
+	std::vector<float>			x, y, velocityX, velocityY;
+	std::vector<float>			accelerationX, accelerationY, drag; // drag is the fraction of the velocity lost per second
+	std::vector<float>			age, life, sizeStart, sizeEnd; // seconds, world units
+	std::vector<unsigned>		colourStart, colourEnd; // RGBA with red in the low byte
+	unsigned					count = 0;
+};
+
+// A particle's sprite in the streaming buffer - per-instance attributes 0 - 4 of the sprite program
+struct cpuParticleVertex {
+	float		x, y;
+	float		age, life;
+	float		sizeStart, sizeEnd;
+	unsigned	colourStart, colourEnd;
+};
+
+struct cpuParticleSystem {
+	unsigned						capacity = 0; // 0 if the system couldn't be set up
+	cpuParticlePool					pools[2]; // the live particles are in pools[current] after each step
+	int								current = 0;
+
+	std::vector<particleEmission>	emissions; // queued for the next step
+	unsigned						queued = 0; // particles in emissions
+
+	// per chunk survivor counts (then write offsets) and bounds, kept between steps so they don't reallocate
+	std::vector<unsigned>			chunkSurvivors;
+	std::vector<spatialBounds>		chunkBounds;
+	spatialBounds					bounds, lastBounds; // what the live particles covered after this step and the one before
+	bool							hasBounds = false, hadBounds = false;
+
+	// CPU_PARTICLE_REGIONS regions of capacity sprites, each with a VAO and a fence set when it was last drawn
+	GLuint							streamBuffer = 0;
+	GLuint							drawVAOs[CPU_PARTICLE_REGIONS];
+	GLsync							fences[CPU_PARTICLE_REGIONS];
+	GLuint							drawProgram = 0;
+	cpuParticleVertex				*mapped = NULL; // the whole buffer, when it is persistently mapped
+	int								region = 0; // holding the sprites of the last step
+	unsigned						drawCount = 0;
+
+	float							time = 0.0f; // seconds simulated
+	unsigned						steps = 0;
+	unsigned						lastEmitted = 0;
+	unsigned long long				totalEmitted = 0; // particles asked for, including any dropped when the pool was full
+	double							lastStepMs = 0.0, lastWaitMs = 0.0; // CPU time in the last step, and how much of it was spent waiting on a fence
+};
+
+// Allocate the pools and the streaming buffer for up to capacity particles and build the sprite program.  The buffer is persistently mapped when glextBufferStorage is set, otherwise each step maps its region unsynchronised.  Returns false, leaving capacity at 0, if the program doesn't build
+bool setupCpuParticleSystem(cpuParticleSystem& system, unsigned capacity);
+
+// Queue a batch of particles for the next step.  Returns false if MAX_PARTICLE_EMISSIONS are already queued
+bool emitCpuParticles(cpuParticleSystem& system, const particleEmission& emission);
+
+// Advance the particles by timeStep seconds, start the queued emissions and write the sprites for the next draw
+void updateCpuParticleSystem(cpuParticleSystem& system, float timeStep);
+
+// Set up the pools for capacity particles without any GL objects, for stepping with stepCpuParticles
+void allocateCpuParticles(cpuParticleSystem& system, unsigned capacity);
+
+// updateCpuParticleSystem without GL - the sprites go to sprites (capacity long), and the step runs across the thread pool if threaded is set or on this thread if not
+void stepCpuParticles(cpuParticleSystem& system, float timeStep, cpuParticleVertex *sprites, bool threaded);
+
+// Draw the sprites written by the last update, leaving no program, VAO or blending active.  pointScale is the number of pixels per world unit
+void drawCpuParticleSystem(cpuParticleSystem& system, float pointScale);
+
+// A box that holds the particles drawn now and on the frame before.  Returns false if there were none
+bool cpuParticleSystemBounds(const cpuParticleSystem& system, spatialBounds *bounds);
+
+// Rebuild the sprite program in place if path is one of its shaders or a file they include.  Returns true if it was rebuilt
+bool reloadCpuParticleShaders(cpuParticleSystem& system, const std::string& path);
+
+void reportCpuParticleSystemStats(const cpuParticleSystem& system);
+
+// Time the update at 100,000, 250,000 and 1,000,000 particles on one thread and across the thread pool.  Doesn't need GL
+void cpuParticleBenchmark(void);
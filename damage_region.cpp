@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "damage_region.h"
+#include <cmath>
+
+using namespace std;
+
+// Rectangles closer than this are merged - repairing a small gap costs less than an extra pass over the draws
+static const int		MERGE_DISTANCE = 16;
+
+static damageRect unite(const damageRect& a, const damageRect& b) {
+	int x0 = (a.x < b.x) ? a.x : b.x;
+	int y0 = (a.y < b.y) ? a.y : b.y;
+	int x1 = (a.x + a.width > b.x + b.width) ? a.x + a.width : b.x + b.width;
+	int y1 = (a.y + a.height > b.y + b.height) ? a.y + a.height : b.y + b.height;
+
+	damageRect r = { x0, y0, x1 - x0, y1 - y0 };
+	return r;
+}
+
+static bool closeTogether(const damageRect& a, const damageRect& b) {
+	return a.x <= b.x + b.width + MERGE_DISTANCE && b.x <= a.x + a.width + MERGE_DISTANCE && a.y <= b.y + b.height + MERGE_DISTANCE && b.y <= a.y + a.height + MERGE_DISTANCE;
+}
+
+void clearDamage(damageRegion& damage, int windowWidth, int windowHeight) {
+	damage.rects.clear();
+	damage.windowWidth = windowWidth;
+	damage.windowHeight = windowHeight;
+}
+
+void addDamage(damageRegion& damage, float minX, float minY, float maxX, float maxY) {
+	float halfWidth = 0.5f * float(damage.windowWidth), halfHeight = 0.5f * float(damage.windowHeight);
+
+	// NaN bounds (a node scaled by infinity, say) fail the comparisons below and end up covering the whole window, which is safe
+	float x0 = floorf((minX + 1.0f) * halfWidth) - 1.0f, y0 = floorf((minY + 1.0f) * halfHeight) - 1.0f;
+	float x1 = ceilf((maxX + 1.0f) * halfWidth) + 1.0f, y1 = ceilf((maxY + 1.0f) * halfHeight) + 1.0f;
+
+	x0 = (x0 > 0.0f) ? x0 : 0.0f;
+	y0 = (y0 > 0.0f) ? y0 : 0.0f;
+	x1 = (x1 < float(damage.windowWidth)) ? x1 : float(damage.windowWidth);
+	y1 = (y1 < float(damage.windowHeight)) ? y1 : float(damage.windowHeight);
+
+	if (!(x1 > x0 && y1 > y0))
+		return;
+
+	damageRect r = { int(x0), int(y0), int(x1 - x0), int(y1 - y0) };
+	damage.rects.push_back(r);
+}
+
+int finishDamage(damageRegion& damage) {
+	vector<damageRect>& rects = damage.rects;
+
+	// keep merging until no two rectangles are near each other - merging can bring a rectangle near one that was already checked
+	bool merged = true;
+
+	while (merged) {
+
+		merged = false;
+
+		for (size_t i = 0; i < rects.size() && !merged; ++i) {
+
+			for (size_t j = i + 1; j < rects.size(); ++j) {
+
+				if (closeTogether(rects[i], rects[j])) {
+
+					rects[i] = unite(rects[i], rects[j]);
+					rects.erase(rects.begin() + j);
+
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (rects.size() > MAX_DAMAGE_RECTS) {
+
+		for (size_t i = 1; i < rects.size(); ++i)
+			rects[0] = unite(rects[0], rects[i]);
+
+		rects.resize(1);
+	}
+
+	int area = 0;
+
+	for (size_t i = 0; i < rects.size(); ++i)
+		area += rects[i].width * rects[i].height;
+
+	return area;
+}
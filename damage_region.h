@@ -0,0 +1,29 @@
+//
+// Screen damage tracking.  The rectangles of the window that changed this frame are gathered (typically where moving objects were last frame and where they are now), merged into a few non-overlapping rectangles, and the frame repairs just those under the scissor test instead of redrawing the whole window
+//
+
+#pragma once
+
+#include <vector>
+
+// Most rectangles a frame is repaired with - past this they are merged into their bounding rectangle
+#define MAX_DAMAGE_RECTS		8
+
+// Window pixels, origin bottom left as glScissor expects
+struct damageRect {
+	int			x, y, width, height;
+};
+
+struct damageRegion {
+	std::vector<damageRect>		rects;
+	int							windowWidth, windowHeight;
+};
+
+// Start a frame's damage for a window of the given size
+void clearDamage(damageRegion& damage, int windowWidth, int windowHeight);
+
+// Add a rectangle given in normalised device coordinates.  It is grown to whole pixels plus a pixel of padding for filtering, and clipped to the window
+void addDamage(damageRegion& damage, float minX, float minY, float maxX, float maxY);
+
+// Merge overlapping and nearby rectangles (and everything into one if there are more than MAX_DAMAGE_RECTS) and return the number of pixels covered
+int finishDamage(damageRegion& damage);
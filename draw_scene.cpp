@@ -1,685 +1,913 @@
-#include <stack>
 #include "stdafx.h"
 #include "draw_scene.h"
+#include "asset_watcher.h"
+#include "texture_array.h"
+#include "program_cache.h"
+#include "shader_source.h"
+#include "shader_variants.h"
+#include "transform_buffer.h"
+#include "scene_graph.h"
+#include "scene_file.h"
+#include "render_queue.h"
+#include "spatial_hash.h"
+#include "camera.h"
+#include "tile_world.h"
+#include "layer_cache.h"
+#include "damage_region.h"
+#include "command_list.h"
+#include "thread_pool.h"
+#include "particle_system.h"
+#include "cpu_particles.h"
+#include "flipbook.h"
+#include "animation_curves.h"
+#include "collision_world.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 using namespace CoreStructures;
 
 //Define pi for use with angles
 static const float PI = 3.14159;
 
-//location of "T" uniform variables for each shader
-GLuint locT, locT2;
-
 //Shader program objects for applying shaders to shapes
 GLuint myShaderProgram;
 GLuint myShaderProgramNoTexture;
+GLuint myShaderProgramArray;
+
+//the scene description - meshes, materials, textures, the node hierarchy and animation parameters, used in place from the mapped scene file
+const sceneFileHeader *scene = NULL;
+
+//Texture handle for each scene texture (loaded on first use by the texture manager)
+std::vector<TextureHandle> sceneTextureHandles;
+
+//Texture array mode: the scene images share one GL_TEXTURE_2D_ARRAY that is attached to the array shader once at startup, so textured draws only select a layer (the scene texture index) instead of binding a texture
+bool useSceneTextureArray = true;
+textureArray sceneTextures;
+
+//one VAO for each scene mesh
+std::vector<GLuint> sceneMeshVAOs;
+
+//render queue blend state id for each scene material
+std::vector<int> sceneMaterialBlends;
+
+//scene graph holding the hierarchical model, with one node for each scene file node in the same order - e.g. the missile thrusters are children of the missile body and the smoke trails children of the thrusters
+sceneGraph sceneNodes;
+
+//this frame's GL texture for each scene material when the texture array isn't used, looked up on the GL thread before the draws are recorded so recording never touches the texture manager
+std::vector<GLuint> sceneMaterialTextures;
+
+//Frame preparation: the visible nodes' transforms and draws are recorded into one command list per range of nodes, on the thread pool once there are enough nodes to be worth splitting
+static const int NODES_PER_JOB = 512;
+std::vector<commandList> nodeCommandLists;
+size_t usedNodeLists = 0; //lists recorded this frame
+
+//Culling: every node with a mesh has its world bounds in a spatial hash, which is queried with the visible area each frame so only what is on screen is transformed and drawn
+spatialHash cullGrid;
+std::vector<spatialBounds> meshBounds;
+std::vector<int> nodeCullIds; //-1 for nodes without a mesh
+std::vector<SceneNode> cullIdNodes;
+
+//nodes that overlap the visible area this frame, in scene order
+std::vector<SceneNode> visibleNodes;
+
+//the camera the scene is viewed through - starts on the [-1, 1] square the scene was built in
+camera2D camera = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+//the streamed tile world around the scene: the chunks in view this frame, their transform buffer entries and the scene material for each tile type (-1 = untextured vertex colour)
+std::vector<tileChunkDraw> visibleChunks;
+std::vector<int> chunkTransforms;
+int tileMaterials[TILE_TYPE_COUNT] = { -1, -1, -1 };
+
+//the tile world is drawn under everything in the scene file, which starts at layer 1
+static const unsigned TILE_WORLD_LAYER = 0;
+
+//Layer cache: the layers below the lowest one holding anything animated (the tile world, sky and ground) don't change on their own, so they are drawn once into backgroundCache and blitted to the screen each frame after that
+bool useLayerCache = true;
+layerCache backgroundCache = { 0, 0, 0, 0, false, 0, 0 };
+unsigned firstDynamicLayer = 256; //layers below this are cached
+
+//what the cached image was drawn with - it is redrawn when the camera moves, tile chunks stream in or an asset changes (as well as on resize)
+camera2D cachedCamera;
+unsigned cachedTileUploads = 0;
+unsigned cachedAssetChanges = 0;
+
+//Damage tracking: frames are drawn into frameTarget, which keeps its contents from one frame to the next (the window's back buffer doesn't), and only the rectangles around nodes that moved are redrawn under the scissor test before it is copied to the window
+bool useDamageTracking = false;
+layerCache frameTarget = { 0, 0, 0, 0, false, 0, 0 };
+damageRegion damage;
+
+//world bounds of the nodes that moved this frame, before and after the move
+std::vector<spatialBounds> movedBounds;
+
+struct damageStatsAttrib {
+	unsigned partialFrames = 0;
+	unsigned fullFrames = 0;
+	int lastPixels = 0; //pixels redrawn last frame
+	size_t lastRects = 0;
+} damageStats;
+
+//particles for the missile exhaust and the explosion debris, drawn just under particleLayer.  They run on the GPU with compute shaders and on the CPU without them (or when the scene sets particles.cpu).  If neither can be set up the smoke meshes are drawn instead
+bool useParticles = false;
+bool particlesOnCpu = false;
+particleSystem particles;
+cpuParticleSystem cpuParticles;
+unsigned particleLayer = 3;
+int windowHeight = 800; //for sizing the point sprites
+bool debrisEmitted = false;
+
+//the explosion as a flipbook, drawn over the rest of the explosion node's layer.  If it can't be set up the explosion mesh grows instead
+bool useFlipbooks = false;
+flipbook explosionFlipbook;
+unsigned flipbookLayer = 7;
+bool explosionPlayed = false;
+
+//the animation moves everything a fixed amount per frame, so the particles and flipbooks step by a nominal 60Hz frame
+static const float FRAME_TIME_STEP = 1.0f / 60.0f;
+float sceneTime = 0.0f; //seconds of animation so far
+
+//the smoke, cloud and explosion are keyframed - their curves write these values once a frame
+enum animatedValue { SMOKE_SCALE_Y, SMOKE_OFFSET_Y, CLOUD_X, EXPLOSION_SCALE, EXPLOSION_Y, ANIMATED_VALUE_COUNT };
+animationCurves sceneCurves;
+float animatedValues[ANIMATED_VALUE_COUNT] = { 1.4f, -0.24f, 0.0f, 0.0f, -0.3f };
+int cloudTrack = -1, explosionTracks[2] = { -1, -1 };
+
+//the nodes moved by the animation (-1 if the scene doesn't have them)
+SceneNode explosionNode = -1, cloudNode = -1, missileBodyNode = -1, missileSmokeNodes[2] = { -1, -1 };
 
-//Textures
-GLuint skyTexture = 0;
-GLuint groundTexture = 1;
-GLuint grassTexture = 2;
-GLuint explosionTexture = 3;
-GLuint cloudTexture = 4;
+void setupTextures(void) {
+	if (!scene) {
+		return;
+	}
 
-//Creates the VAOs
-GLuint skyVAO, groundVAO, GrassVAO, missileBodyVAO, missileThrusterVAO, missileSmokeVAO, missileExplosionVAO, cloudVAO;
+	//register the scene's textures - nothing is loaded until the first frame that draws them
+	std::vector<const char*> files;
+	std::vector<unsigned> flags, targetWidths, targetHeights;
 
-//matrix stack used to store transformation matrices for hierarchical model (this allows the user to move back and forth around a complex hierarchical model more easily) 
-std::stack<GUMatrix4> matrixStack;
+	for (unsigned i = 0; i < scene->textures.count; i++) {
+		const sceneTextureRecord& texture = scene->textures[i];
 
-void setupTextures(void) {
-	skyTexture = fiLoadTexture("Assets\\sky.jpg");
-	groundTexture = fiLoadTexture("Assets\\ground.jpg");
-	grassTexture = fiLoadTexture("Assets\\grass.jpg");
-	explosionTexture = fiLoadTexture("Assets\\explosion.jpg");
-	cloudTexture = fiLoadTexture("Assets\\cloud.jpg");
+		sceneTextureHandles.push_back(registerTexture(texture.path.get(), texture.loadFlags, texture.targetWidth, texture.targetHeight));
+
+		files.push_back(texture.path.get());
+		flags.push_back(texture.loadFlags);
+		targetWidths.push_back(texture.targetWidth);
+		targetHeights.push_back(texture.targetHeight);
+	}
+
+	//the same images packed into one texture array (in scene texture order).  Falls back to individual textures if they can't be loaded
+	if (useSceneTextureArray) {
+		useSceneTextureArray = !files.empty() && fiLoadTextureArray(&files[0], &flags[0], &targetWidths[0], &targetHeights[0], int(files.size()), &sceneTextures);
+
+		//the texture manager reloads its layers when they change on disk and counts it against the budget
+		if (useSceneTextureArray) {
+			manageTextureArray(&sceneTextures, &files[0], &flags[0], &targetWidths[0], &targetHeights[0], int(files.size()));
+		}
+	}
+}
+
+//Shader variant used by each program - they are all built from Shaders\scene_vert.glsl and scene_frag.glsl
+struct shaderProgramVariant {
+	GLuint *program;
+	unsigned features;
+} shaderVariants[] = {
+	{ &myShaderProgram, SHADER_TEXTURED },
+	{ &myShaderProgramNoTexture, SHADER_VERTEX_COLOUR },
+	{ &myShaderProgramArray, SHADER_TEXTURED | SHADER_TEXTURE_ARRAY }
+};
+
+static void getUniformLocations(void) {
+	//the render queue looks up the "transformIndex" and "layer" uniforms itself - make it look again now the programs have been (re)linked
+	renderQueueProgramsChanged();
+
+	//connect every program to the per-frame transform buffer
+	for (auto& variant : shaderVariants) {
+		bindTransformBlock(*variant.program);
+	}
+
+	//(re)connect the texture array to the array shader - this is the only time it is ever bound
+	if (useSceneTextureArray) {
+		attachTextureArray(sceneTextures, myShaderProgramArray, "textureArray", 1);
+	}
+}
+
+//called by the asset watcher on the GL thread when a shader file changes - programs are rebuilt in place so the program names stay the same
+static void applyShaderReload(const std::string& path, void *payload) {
+	invalidateShaderSource(path);
+
+	if (reloadShaderVariants(path)) {
+		//variants that failed to build before may have a program now
+		for (auto& variant : shaderVariants) {
+			*variant.program = shaderVariant(variant.features);
+		}
+
+		getUniformLocations();
+	}
+
+	if (useParticles && particlesOnCpu) {
+		reloadCpuParticleShaders(cpuParticles, path);
+	} else if (useParticles) {
+		reloadParticleShaders(particles, path);
+	}
+
+	if (useFlipbooks) {
+		reloadFlipbookShaders(path);
+	}
 }
 
 void setupShaders(void) {
-	// Shader setup 
-	myShaderProgram = setupShaders(std::string("Shaders\\basic_vert.glsl"), std::string("Shaders\\basic_frag.glsl"));
-	myShaderProgramNoTexture = setupShaders(std::string("Shaders\\notexture_vert.glsl"), std::string("Shaders\\notexture_frag.glsl"));
-
-	// Get uniform location of "T" variable in shader program (we'll use this in the play function to give the uniform variable "T" a value)
-	locT = glGetUniformLocation(myShaderProgram, "T");
-	locT2 = glGetUniformLocation(myShaderProgramNoTexture, "T2");
-}
-
-#pragma region ground object
-void setupSkyVAO(void) {
-	// Vertex Buffer Object IDs for the ground texture object
-	GLuint quadPosVBO, quadColourVBO, quadTexCoordVBO, quadIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat quadVertices[] = {
-		-1.0, -1.0f,
-		-1.0f, 1.0f,
-		1.0f, -1.0f,
-		1.0f, 1.0f
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte quadColors[] = {
-		255, 0, 0, 255,
-		255, 255, 0, 255,
-		0, 255, 0, 255,
-		0, 255, 255, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float quadTextureCoords[] = {
-		0.0f, 1.0f,
-		0.0f, 0.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f
-	};
-
-	// 4) Index Array - Store indices to quad vertices - this determines the order the vertices are to be processed
-	static GLubyte quadVertexIndices[] = { 0, 1, 2, 3 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &skyVAO);
-	glBindVertexArray(skyVAO);
-
-	// setup VBO for the quad object position data
-	glGenBuffers(1, &quadPosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadPosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the quad object colour data
-	glGenBuffers(1, &quadColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadColors), quadColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the quad object texture coord data
-	glGenBuffers(1, &quadTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadTextureCoords), quadTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup quad vertex index array
-	glGenBuffers(1, &quadIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadVertexIndices), quadVertexIndices, GL_STATIC_DRAW);
+	//submit every program up front - nothing here waits on the driver, so compilation overlaps the rest of startup
+	for (auto& variant : shaderVariants) {
+		*variant.program = submitShaderVariant(variant.features);
+	}
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+	watchShaderVariantSources();
+
+	addAssetHandler(".glsl", NULL, applyShaderReload);
 }
 
-void drawSkyVAO(void) {
-	//Pass shader program into GPU pipeline
-	glUseProgram(myShaderProgram);
-
-	// Move our ground shape to the top half of the screen
-	GUMatrix4 T = GUMatrix4::translationMatrix(0.0f, 0.0f, 0.0f);
-	glUniformMatrix4fv(locT, 1, GL_FALSE, (GLfloat*)&T);
-
-	//bind the texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, skyTexture);
-	glUniform1i(glGetUniformLocation(myShaderProgram, "texture"), 0);
-	glEnable(GL_TEXTURE_2D);
-
-	//Enables blending to support alpha
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_ONE, GL_ONE);
-
-	//bind ground VAO and draw it
-	glBindVertexArray(skyVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, (GLvoid*)0);
-
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
-	glUseProgram(0);
-}
-#pragma endregion sky object
-
-#pragma region ground object
-void setupGroundVAO(void) {
-	// Vertex Buffer Object IDs for the ground texture object
-	GLuint quadPosVBO, quadColourVBO, quadTexCoordVBO, quadIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat quadVertices[] = {
-		-1.0, -0.5f,
-		-1.0f, 0.3f,
-		1.0f, -0.5f,
-		1.0f, 0.3f
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte quadColors[] = {
-		255, 0, 0, 255,
-		255, 255, 0, 255,
-		0, 255, 0, 255,
-		0, 255, 255, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float quadTextureCoords[] = {
-		0.0f, 1.0f,
-		0.0f, 0.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f
-	};
-
-	// 4) Index Array - Store indices to quad vertices - this determines the order the vertices are to be processed
-	static GLubyte quadVertexIndices[] = { 0, 1, 2, 3 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &groundVAO);
-	glBindVertexArray(groundVAO);
-
-	// setup VBO for the quad object position data
-	glGenBuffers(1, &quadPosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadPosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the quad object colour data
-	glGenBuffers(1, &quadColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadColors), quadColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the quad object texture coord data
-	glGenBuffers(1, &quadTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadTextureCoords), quadTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup quad vertex index array
-	glGenBuffers(1, &quadIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadVertexIndices), quadVertexIndices, GL_STATIC_DRAW);
+void finishShaders(void) {
+	//poll until the driver has finished every program submitted by setupShaders, so collecting them below never blocks.  Programs that couldn't be submitted have nothing to wait for
+	const int programCount = sizeof(shaderVariants) / sizeof(shaderVariants[0]);
+	int submitted = 0, alreadyCompleted = -1;
+	auto waitStart = std::chrono::high_resolution_clock::now(), lastPoll = waitStart;
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+	for (auto& variant : shaderVariants) {
+		submitted += (*variant.program != 0) ? 1 : 0;
+	}
+
+	std::vector<GLuint> building;
+
+	for (;;) {
+		//the time since the last poll was spent waiting on the programs that were still building then.  Shared between them, it goes into the build cost the program cache records - what a warm start saves
+		auto now = std::chrono::high_resolution_clock::now();
+		double pollMs = std::chrono::duration<double, std::milli>(now - lastPoll).count();
+
+		lastPoll = now;
+
+		for (GLuint program : building) {
+			addShaderBuildWait(program, pollMs / building.size());
+		}
+
+		int completed = 0;
+		building.clear();
+
+		for (auto& variant : shaderVariants) {
+			if (*variant.program && shadersCompleted(*variant.program)) {
+				completed++;
+			} else if (*variant.program) {
+				building.push_back(*variant.program);
+			}
+		}
+
+		if (alreadyCompleted < 0) {
+			alreadyCompleted = completed;
+		}
+
+		if (completed == submitted) {
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	double waitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+	//then collect them, reporting any compile or link errors
+	collectShaderVariants();
+
+	for (auto& variant : shaderVariants) {
+		*variant.program = shaderVariant(variant.features);
+	}
+
+	std::cout << "Shaders: " << alreadyCompleted << " of " << programCount << " programs finished compiling before they were needed, waited " << waitMs << " ms for the rest\n";
+
+	reportProgramCacheStats();
+
+	getUniformLocations();
 }
 
-void drawGroundVAO(void) {
-	//Pass shader program into GPU pipeline
-	glUseProgram(myShaderProgram);
-
-	// Move our ground shape to the bottom half of the screen
-	GUMatrix4 T = GUMatrix4::translationMatrix(0.0f, -0.5f, 0.0f);
-	glUniformMatrix4fv(locT, 1, GL_FALSE, (GLfloat*)&T);
-
-	//bind the texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, groundTexture);
-	glUniform1i(glGetUniformLocation(myShaderProgram, "texture"), 0);
-	glEnable(GL_TEXTURE_2D);
-
-	//Enables blending to support alpha
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_MAX);
-	glBlendFunc(GL_ONE_MINUS_DST_COLOR, GL_ONE_MINUS_SRC_COLOR);
-
-	//bind ground VAO and draw it
-	glBindVertexArray(groundVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, (GLvoid*)0);
-
-	glDisable(GL_BLEND);
-	glUseProgram(0);
-}
-#pragma endregion ground object
-
-#pragma region grass object
-void setupGrassVAO(void) {
-	// Vertex Buffer Object IDs for the grass texture object
-	GLuint grassPosVBO, grassColourVBO, grassTexCoordVBO, grassIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat grassVertices[] = {
-		-1.0, -0.2f,
-		-1.0f, 0.2f,
-		1.0f, -0.2f,
-		1.0f, 0.2f
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte grassColors[] = {
-		255, 0, 0, 255,
-		255, 255, 0, 255,
-		0, 255, 0, 255,
-		0, 255, 255, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float grassTextureCoords[] = {
-		0.0f, 1.0f,
-		0.0f, 0.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f
-	};
-
-	// 4) Index Array - Store indices to quad vertices - this determines the order the vertices are to be processed
-	static GLubyte grassVertexIndices[] = { 0, 1, 2, 3 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &GrassVAO);
-	glBindVertexArray(GrassVAO);
-
-	// setup VBO for the quad object position data
-	glGenBuffers(1, &grassPosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, grassPosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(grassVertices), grassVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the quad object colour data
-	glGenBuffers(1, &grassColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, grassColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(grassColors), grassColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the quad object texture coord data
-	glGenBuffers(1, &grassTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, grassTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(grassTextureCoords), grassTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup quad vertex index array
-	glGenBuffers(1, &grassIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grassIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(grassVertexIndices), grassVertexIndices, GL_STATIC_DRAW);
+#pragma region culling
+//world space box around a node's mesh
+static spatialBounds nodeBounds(SceneNode node) {
+	const spatialBounds& b = meshBounds[scene->nodes[node].mesh];
+	float corners[8] = { b.minX, b.minY, b.maxX, b.minY, b.minX, b.maxY, b.maxX, b.maxY };
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+	sceneNodeWorld(sceneNodes, node).transformPoints(corners, corners, 4);
+
+	spatialBounds result = { corners[0], corners[1], corners[0], corners[1] };
+
+	for (int i = 2; i < 8; i += 2) {
+		result.minX = (corners[i] < result.minX) ? corners[i] : result.minX;
+		result.maxX = (corners[i] > result.maxX) ? corners[i] : result.maxX;
+		result.minY = (corners[i + 1] < result.minY) ? corners[i + 1] : result.minY;
+		result.maxY = (corners[i + 1] > result.maxY) ? corners[i + 1] : result.maxY;
+	}
+
+	return result;
+}
+
+//file every node with a mesh in the spatial hash (the scene graph must be up to date)
+static void setupCulling(void) {
+	//cells about the size of the smaller scene objects
+	initSpatialHash(cullGrid, 0.25f);
+
+	nodeCullIds.assign(scene->nodes.count, -1);
+	cullIdNodes.clear();
+
+	for (unsigned i = 0; i < scene->nodes.count; i++) {
+		if (scene->nodes[i].mesh >= 0) {
+			nodeCullIds[i] = addSpatialObject(cullGrid, nodeBounds(SceneNode(i)));
+			cullIdNodes.push_back(SceneNode(i));
+		}
+	}
 }
 
-void drawGrassVAO(void) {
-	//Pass shader program into GPU pipeline
-	glUseProgram(myShaderProgram);
+//move the bounds of the nodes the last scene graph update moved, then find what overlaps the visible area
+static void updateVisibleNodes(const spatialBounds& visibleArea) {
+	for (size_t i = 0; i < sceneNodes.moved.size(); i++) {
+		SceneNode node = sceneNodes.moved[i];
+
+		if (nodeCullIds[node] >= 0) {
+			//both where it was and where it is now need redrawing
+			movedBounds.push_back(cullGrid.bounds[nodeCullIds[node]]);
+			updateSpatialObject(cullGrid, nodeCullIds[node], nodeBounds(node));
+			movedBounds.push_back(cullGrid.bounds[nodeCullIds[node]]);
+		}
+	}
 
-	// Move the grass shape to the bottom half of the screen
-	GUMatrix4 T = GUMatrix4::translationMatrix(0.0f, -0.8f, 0.0f);
-	glUniformMatrix4fv(locT, 1, GL_FALSE, (GLfloat*)&T);
+	static std::vector<int> visibleIds;
 
-	//bind the texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, grassTexture);
-	glUniform1i(glGetUniformLocation(myShaderProgram, "texture"), 0);
-	glEnable(GL_TEXTURE_2D);
+	visibleIds.clear();
+	querySpatialHash(cullGrid, visibleArea, visibleIds);
 
-	//Enables blending to support alpha
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
-	//glBlendFunc(GL_SRC_ALPHA_SATURATE, GL_ONE_MINUS_SRC_ALPHA);
+	//back to scene order, which the render queue keeps for draws with the same state
+	visibleNodes.clear();
 
+	for (size_t i = 0; i < visibleIds.size(); i++) {
+		visibleNodes.push_back(cullIdNodes[visibleIds[i]]);
+	}
 
-	//bind grass VAO and draw it
-	glBindVertexArray(GrassVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, (GLvoid*)0);
+	std::sort(visibleNodes.begin(), visibleNodes.end());
+}
 
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
-	glUseProgram(0);
+void reportCullingStats(void) {
+	std::cout << "Culling: " << visibleNodes.size() << " of " << cullIdNodes.size() << " objects visible, " << cullGrid.lastCandidates << " tested\n";
 }
-#pragma endregion grass object
+#pragma endregion culling
 
-#pragma region missile object
-//Setup a global struct for the missile object
-struct missileAttrib {
-	bool atTop;
-	bool exploded;
-	float x = 0.0f;
-	float y = -0.5f;
-	float theta = 0.0f;
-	float scale = 1.0f;
-	float smokeScaleY = 1.4f;
-	float smokeOffsetY = -0.24f;
-	bool smokeScaleUp = true;
-} missile;
+#pragma region collisions
+collisionWorld sceneCollisions;
+int missileBody = -1, groundBody = -1, cloudBody = -1;
 
-void setupMissileVAO(void) {
-	//Draws the main missile object, the body
-	setupMissileBodyVAO();
-
-	setupMissileThrusterVAO();
-	setupMissileSmokeVAO();
-}
-
-void setupMissileBodyVAO(void) {
-	// Vertex Buffer Object IDs for the missile 
-	GLuint missilePosVBO, missileColourVBO, missileTexCoordVBO, missileIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat missileVertices[] = {
-		0.0f, 0.5f,
-		-0.2f, 0.2f,
-		0.2f, 0.2f,
-		-0.2f, -0.4f,
-		0.2f, -0.4f,
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte missileColors[] = {
-		50, 50, 50, 255,
-		200, 200, 200, 255,
-		200, 200, 200, 255,
-		200, 200, 200, 255,
-		200, 200, 200, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float missileTextureCoords[] = {
-		0.0f, 0.5f,
-		-0.2f, 0.2f,
-		0.2f, 0.2f,
-		-0.2f, -0.4f,
-		0.2f, -0.4f,
-	};
-
-	// 4) Index Array - Store indices to missile vertices - this determines the order the vertices are to be processed
-	static GLubyte missileVertexIndices[] = { 0, 1, 2, 3, 4 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &missileBodyVAO);
-	glBindVertexArray(missileBodyVAO);
-
-	// setup VBO for the missile object position data
-	glGenBuffers(1, &missilePosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missilePosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileVertices), missileVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the missile object colour data
-	glGenBuffers(1, &missileColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileColors), missileColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the missile object texture coord data
-	glGenBuffers(1, &missileTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileTextureCoords), missileTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup missile vertex index array
-	glGenBuffers(1, &missileIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, missileIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(missileVertexIndices), missileVertexIndices, GL_STATIC_DRAW);
+//the missile collides with the ground, the cloud and any other missile.  The ground is everything below the returning missile's nose at missile.bottom
+static void setupCollisions(void) {
+	initCollisionWorld(sceneCollisions, 0.25f);
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+	missileBody = groundBody = cloudBody = -1;
+
+	if (missileBodyNode >= 0) {
+		missileBody = addCollisionBox(sceneCollisions, nodeBounds(missileBodyNode), COLLISION_MISSILE, COLLISION_MISSILE | COLLISION_GROUND | COLLISION_CLOUD);
+	}
+
+	//the ground's top is where the returning missile's nose is (turned round and shrunk to missile.returnScale) as its centre reaches missile.bottom, so the box touches it on the frame the old position check fired
+	float groundTop = sceneParameter(scene, "missile.bottom", -0.3f);
+
+	if (missileBodyNode >= 0) {
+		groundTop -= meshBounds[scene->nodes[missileBodyNode].mesh].maxY * sceneParameter(scene, "missile.returnScale", 0.5f);
+	}
+
+	spatialBounds ground = { -1000.0f, -1000.0f, 1000.0f, groundTop };
+
+	groundBody = addCollisionBox(sceneCollisions, ground, COLLISION_GROUND, 0);
+
+	if (cloudNode >= 0) {
+		cloudBody = addCollisionBox(sceneCollisions, nodeBounds(cloudNode), COLLISION_CLOUD, 0);
+	}
 }
 
-void setupMissileThrusterVAO(void) {
-	// Vertex Buffer Object IDs for the missile 
-	GLuint missileThrusterPosVBO, missileThrusterColourVBO, missileThrusterTexCoordVBO, missileThrusterIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat missileThrusterVertices[] = {
-		-0.05f, 0.1f,
-		0.05f, 0.1f,
-		-0.1f, -0.1f,
-		0.1f, -0.1f,
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte missileThrusterColors[] = {
-		170, 170, 170, 255,
-		170, 170, 170, 255,
-		90, 90, 90, 255,
-		90, 90, 90, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float missileThrusterTextureCoords[] = {
-		-0.05f, 0.1f,
-		0.05f, 0.1f,
-		-0.1f, -0.1f,
-		0.1f, -0.1f,
-	};
-
-	// 4) Index Array - Store indices to missile vertices - this determines the order the vertices are to be processed
-	static GLubyte missileThrusterVertexIndices[] = { 0, 1, 2, 3 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &missileThrusterVAO);
-	glBindVertexArray(missileThrusterVAO);
-
-	// setup VBO for the missile object position data
-	glGenBuffers(1, &missileThrusterPosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileThrusterPosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileThrusterVertices), missileThrusterVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the missile object colour data
-	glGenBuffers(1, &missileThrusterColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileThrusterColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileThrusterColors), missileThrusterColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the missile object texture coord data
-	glGenBuffers(1, &missileThrusterTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileThrusterTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileThrusterTextureCoords), missileThrusterTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup missile vertex index array
-	glGenBuffers(1, &missileThrusterIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, missileThrusterIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(missileThrusterVertexIndices), missileThrusterVertexIndices, GL_STATIC_DRAW);
+//move the bodies to where the last scene graph update put their nodes, then find what started and stopped touching
+static void collideScene(void) {
+	if (missileBody >= 0) {
+		setCollisionBox(sceneCollisions, missileBody, nodeBounds(missileBodyNode));
+	}
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+	if (cloudBody >= 0) {
+		setCollisionBox(sceneCollisions, cloudBody, nodeBounds(cloudNode));
+	}
+
+	updateCollisionWorld(sceneCollisions);
+}
+
+void reportSceneCollisionStats(void) {
+	reportCollisionStats(sceneCollisions);
+}
+#pragma endregion collisions
+
+#pragma region layer cache
+//finds the lowest layer with an animated node (or a child of one) in it - everything below can be cached
+static void findFirstDynamicLayer(void) {
+	std::vector<bool> animated(scene->nodes.count, false);
+	SceneNode animatedNodes[] = { explosionNode, cloudNode, missileBodyNode, missileSmokeNodes[0], missileSmokeNodes[1] };
+
+	for (auto node : animatedNodes) {
+		if (node >= 0) {
+			animated[node] = true;
+		}
+	}
+
+	firstDynamicLayer = 256;
+
+	//parents come before their children, so one pass passes animation down the hierarchy
+	for (unsigned i = 0; i < scene->nodes.count; i++) {
+		const sceneNodeRecord& node = scene->nodes[i];
+
+		if (node.parent >= 0 && animated[node.parent]) {
+			animated[i] = true;
+		}
+
+		if (animated[i] && node.mesh >= 0 && node.layer < firstDynamicLayer) {
+			firstDynamicLayer = node.layer;
+		}
+	}
+
+	//the particles move every frame too, and the flipbooks change while they play
+	if (useParticles && particleLayer < firstDynamicLayer) {
+		firstDynamicLayer = particleLayer;
+	}
+
+	if (useFlipbooks && flipbookLayer < firstDynamicLayer) {
+		firstDynamicLayer = flipbookLayer;
+	}
+}
+
+//true if anything drawn into the cached layers has changed since they were last drawn
+static bool backgroundCacheStale(void) {
+	if (memcmp(&cachedCamera, &camera, sizeof(camera)) != 0 || cachedTileUploads != getTileWorldStats().uploaded || cachedAssetChanges != appliedAssetChanges()) {
+		return true;
+	}
+
+	//nothing in the cached layers is animated, but a node moved some other way still has to show up
+	if (scene) {
+		for (size_t i = 0; i < sceneNodes.moved.size(); i++) {
+			const sceneNodeRecord& node = scene->nodes[sceneNodes.moved[i]];
+
+			if (node.mesh >= 0 && node.layer < firstDynamicLayer) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+//records what the cached layers were drawn with, so backgroundCacheStale can tell when they change
+static void rememberBackground(void) {
+	cachedCamera = camera;
+	cachedTileUploads = getTileWorldStats().uploaded;
+	cachedAssetChanges = appliedAssetChanges();
+}
+
+void resizeScene(int width, int height) {
+	if (height > 0) {
+		camera.aspect = float(width) / float(height);
+		windowHeight = height;
+	}
+
+	resizeLayerCache(backgroundCache, width, height);
+	resizeLayerCache(frameTarget, width, height);
+}
+
+void setLayerCaching(bool enable) {
+	useLayerCache = enable;
+	invalidateLayerCache(backgroundCache);
 }
 
-void setupMissileSmokeVAO(void) {
-	// Vertex Buffer Object IDs for the smoke 
-	GLuint missileSmokePosVBO, missileSmokeColourVBO, missileSmokeTexCoordVBO, missileSmokeIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat missileSmokeVertices[] = {
-		0.05f, 0.1f,
-		-0.05f, 0.1f,
-		0.15f, -0.05f,
-		-0.15f, -0.05f,
-		0.0f, -0.15f
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte missileSmokeColors[] = {
-		138, 39, 9, 255,
-		138, 39, 9, 255,
-		198, 105, 14, 255,
-		198, 105, 14, 255,
-		158, 0, 0, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float missileSmokeTextureCoords[] = {
-		0.05f, 0.1f,
-		-0.05f, 0.1f,
-		0.15f, -0.05f,
-		-0.15f, -0.05f,
-		0.0f, -0.15f
-	};
-
-	// 4) Index Array - Store indices to missile vertices - this determines the order the vertices are to be processed
-	static GLubyte missileSmokeVertexIndices[] = { 0, 1, 2, 3, 4 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &missileSmokeVAO);
-	glBindVertexArray(missileSmokeVAO);
-
-	// setup VBO for the missile object position data
-	glGenBuffers(1, &missileSmokePosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileSmokePosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileSmokeVertices), missileSmokeVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the missile object colour data
-	glGenBuffers(1, &missileSmokeColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileSmokeColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileSmokeColors), missileSmokeColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the missile object texture coord data
-	glGenBuffers(1, &missileSmokeTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, missileSmokeTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(missileSmokeTextureCoords), missileSmokeTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup missile vertex index array
-	glGenBuffers(1, &missileSmokeIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, missileSmokeIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(missileSmokeVertexIndices), missileSmokeVertexIndices, GL_STATIC_DRAW);
+bool layerCaching(void) {
+	return useLayerCache;
+}
+
+void setDamageTracking(bool enable) {
+	useDamageTracking = enable;
+	invalidateLayerCache(frameTarget);
+}
+
+bool damageTracking(void) {
+	return useDamageTracking;
+}
+
+void reportDamageStats(void) {
+	if (!useDamageTracking || frameTarget.width == 0) {
+		std::cout << "Damage tracking: off, the whole window is redrawn each frame\n";
+	} else {
+		int windowPixels = frameTarget.width * frameTarget.height;
+
+		std::cout << "Damage tracking: " << damageStats.partialFrames << " partial and " << damageStats.fullFrames << " full redraws, last frame redrew " << damageStats.lastPixels << " of " << windowPixels << " pixels (" << 100.0 * damageStats.lastPixels / windowPixels << "%) in " << damageStats.lastRects << " rectangles\n";
+	}
+}
+
+void reportLayerCacheStats(void) {
+	if (!useLayerCache || backgroundCache.width == 0 || firstDynamicLayer == 0) {
+		std::cout << "Layer cache: off, every layer is drawn each frame\n";
+	} else {
+		std::cout << "Layer cache: layers 0-" << firstDynamicLayer - 1 << " cached at " << backgroundCache.width << "x" << backgroundCache.height << ", drawn " << backgroundCache.renders << " times and composited " << backgroundCache.composites << " times\n";
+	}
+}
+#pragma endregion layer cache
+
+#pragma region scene objects
+void setupSceneVAOs(void) {
+	if (!scene) {
+		return;
+	}
+
+	//one interleaved vertex buffer and one index buffer per mesh, straight from the scene file
+	for (unsigned i = 0; i < scene->meshes.count; i++) {
+		const sceneMeshRecord& mesh = scene->meshes[i];
+		GLuint meshVAO, vertexVBO, indexVBO;
+
+		//create and bind the VAO
+		glGenVertexArrays(1, &meshVAO);
+		glBindVertexArray(meshVAO);
+
+		// setup VBO for the position, colour and texture coord data
+		glGenBuffers(1, &vertexVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertices.count * sizeof(sceneVertex), mesh.vertices.data(), GL_STATIC_DRAW);
+
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(sceneVertex), (const GLvoid*)offsetof(sceneVertex, x));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(sceneVertex), (const GLvoid*)offsetof(sceneVertex, colour));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(sceneVertex), (const GLvoid*)offsetof(sceneVertex, u));
+		glEnableVertexAttribArray(2);
+
+		// setup vertex index array
+		glGenBuffers(1, &indexVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.count * sizeof(unsigned short), mesh.indices.data(), GL_STATIC_DRAW);
+
+		sceneMeshVAOs.push_back(meshVAO);
+	}
 
 	//Unbind the VAO once created
 	glBindVertexArray(0);
-}
 
-void drawMissileVAO(void) {
-	//Pass shader program into GPU pipeline
-	glUseProgram(myShaderProgramNoTexture);
+	//build the scene graph - the file stores parents before their children, so the nodes go in in file order
+	for (unsigned i = 0; i < scene->nodes.count; i++) {
+		const sceneNodeRecord& node = scene->nodes[i];
 
-	//setup matrix as an identity matrix
-	GUMatrix4 M = GUMatrix4::identity();
+		addSceneNode(sceneNodes, node.parent, GUAffine2D::TRS(node.x, node.y, node.rotation, node.scaleX, node.scaleY));
+	}
 
-	matrixStack.push(M);
+	//bounds of each mesh in its own space, then each node's in world space
+	for (unsigned i = 0; i < scene->meshes.count; i++) {
+		const sceneMeshRecord& mesh = scene->meshes[i];
+		spatialBounds b = { mesh.vertices[0].x, mesh.vertices[0].y, mesh.vertices[0].x, mesh.vertices[0].y };
 
-	//Transform the base object, the missile body
-	GUMatrix4 T = GUMatrix4::translationMatrix(missile.x, missile.y, 0.0f);
-	GUMatrix4 R = GUMatrix4::rotationMatrix(0.0f, 0.0f, missile.theta*(PI / 180));
-	GUMatrix4 S = GUMatrix4::scaleMatrix(missile.scale, missile.scale, 0.0f);
-	M = T * R * S;
-	glUniformMatrix4fv(locT2, 1, GL_FALSE, (GLfloat*)&M);
+		for (unsigned v = 1; v < mesh.vertices.count; v++) {
+			b.minX = (mesh.vertices[v].x < b.minX) ? mesh.vertices[v].x : b.minX;
+			b.maxX = (mesh.vertices[v].x > b.maxX) ? mesh.vertices[v].x : b.maxX;
+			b.minY = (mesh.vertices[v].y < b.minY) ? mesh.vertices[v].y : b.minY;
+			b.maxY = (mesh.vertices[v].y > b.maxY) ? mesh.vertices[v].y : b.maxY;
+		}
 
-	drawMissileBodyVAO();
+		meshBounds.push_back(b);
+	}
 
-	matrixStack.push(M);
+	updateSceneGraph(sceneNodes);
+	setupCulling();
+	setupCollisions();
 
-	//transform the left missile thruster
-	M = M * GUMatrix4::translationMatrix(-0.13f, -0.5f, 0.0f);
-	glUniformMatrix4fv(locT2, 1, GL_FALSE, (GLfloat*)&M);
+	//the particle buffers and programs - on the GPU if it can, otherwise on the CPU (the smoke meshes stay if neither can be set up)
+	unsigned maxParticles = unsigned(sceneParameter(scene, "particles.max", 16384.0f));
 
-	drawMissileThrusterVAO();
+	particlesOnCpu = sceneParameter(scene, "particles.cpu", 0.0f) != 0.0f;
 
-	matrixStack.push(M);
+	if (!particlesOnCpu) {
+		useParticles = setupParticleSystem(particles, maxParticles);
+		particlesOnCpu = !useParticles;
+	}
 
-	//transform the left missile smoke
-	M = M * GUMatrix4::translationMatrix(0.0f, missile.smokeOffsetY, 0.0f) * GUMatrix4::scaleMatrix(1.0f, missile.smokeScaleY, 0.0f);
-	glUniformMatrix4fv(locT2, 1, GL_FALSE, (GLfloat*)&M);
+	if (particlesOnCpu) {
+		useParticles = setupCpuParticleSystem(cpuParticles, maxParticles);
+	}
 
-	drawMissileSmokeVAO();
+	if (useParticles) {
+		watchParticleShaders();
+	}
 
-	M = matrixStack.top();
-	matrixStack.pop();
+	//the explosion's frames come from the scene's sheet if explosion.columns says how it is laid out, otherwise they are baked from the still explosion texture
+	int explosionTexture = findSceneTexture(scene, "explosion");
 
-	M = matrixStack.top();
-	matrixStack.pop();
+	if (explosionNode >= 0 && explosionTexture >= 0 && setupFlipbookRenderer()) {
+		const sceneTextureRecord& texture = scene->textures[explosionTexture];
+		unsigned frames = unsigned(sceneParameter(scene, "explosion.frames", 16.0f));
+		unsigned columns = unsigned(sceneParameter(scene, "explosion.columns", 0.0f));
+		std::vector<flipbookFrame> table;
 
-	//transform the right missile thruster
-	M = M * GUMatrix4::translationMatrix(0.13f, -0.5f, 0.0f);
-	glUniformMatrix4fv(locT2, 1, GL_FALSE, (GLfloat*)&M);
+		GLuint atlas = (columns > 0) ? loadFlipbookSheet(texture.path.get(), texture.loadFlags, columns, frames, table)
+			: bakeFlipbookSheet(texture.path.get(), texture.loadFlags, frames, unsigned(sceneParameter(scene, "explosion.frameWidth", 256.0f)), table);
 
-	drawMissileThrusterVAO();
+		useFlipbooks = setupFlipbook(explosionFlipbook, atlas, table, sceneParameter(scene, "explosion.fps", 8.0f), FLIPBOOK_HOLD);
+		flipbookLayer = scene->nodes[explosionNode].layer + 1;
 
-	matrixStack.push(M);
+		if (useFlipbooks) {
+			watchFlipbookShaders();
+		} else if (atlas) {
+			glDeleteTextures(1, &atlas);
+		}
+	}
 
-	//transform the right missile smoke
-	M = M * GUMatrix4::translationMatrix(0.0f, missile.smokeOffsetY, 0.0f) * GUMatrix4::scaleMatrix(1.0f, missile.smokeScaleY, 0.0f);
-	glUniformMatrix4fv(locT2, 1, GL_FALSE, (GLfloat*)&M);
+	findFirstDynamicLayer();
 
-	drawMissileSmokeVAO();
+	for (unsigned i = 0; i < scene->materials.count; i++) {
+		const sceneMaterialRecord& material = scene->materials[i];
 
-	M = matrixStack.top();
-	matrixStack.pop();
+		sceneMaterialBlends.push_back(renderBlendState(material.blendEquation, material.blendSource, material.blendDestination));
+	}
+}
 
-	M = matrixStack.top();
-	matrixStack.pop();
+//fills in the program, texture and blend state for a scene material (-1 = untextured vertex colour) - either a layer of the texture array or an individual texture
+static void setSceneMaterial(int material, renderCommand& command) {
+	const sceneMaterialRecord *m = (material >= 0) ? &scene->materials[material] : NULL;
+
+	command.texture = 0;
+	command.textureLayer = -1;
+	command.blend = m ? sceneMaterialBlends[material] : 0;
+
+	if (m && m->texture >= 0) {
+		if (useSceneTextureArray) {
+			command.program = myShaderProgramArray;
+			command.textureLayer = m->texture;
+		} else {
+			command.program = myShaderProgram;
+			command.texture = sceneMaterialTextures[material];
+		}
+	} else {
+		command.program = myShaderProgramNoTexture;
+	}
+}
 
-	glUseProgram(0);
+//true if an effect is drawn just under layer
+static bool effectsUnder(unsigned layer) {
+	return (useParticles && particleLayer == layer) || (useFlipbooks && flipbookLayer == layer);
 }
 
-void drawMissileBodyVAO(void) {
-	//bind missile body VAO and draw it
-	glBindVertexArray(missileBodyVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 5, GL_UNSIGNED_BYTE, (GLvoid*)0);
+static void drawEffectsUnder(unsigned layer) {
+	if (useParticles && particleLayer == layer) {
+		//the view is 2 / zoom units high
+		float pointScale = camera.zoom * float(windowHeight) * 0.5f;
+
+		if (particlesOnCpu) {
+			drawCpuParticleSystem(cpuParticles, pointScale);
+		} else {
+			drawParticleSystem(particles, pointScale);
+		}
+	}
+
+	if (useFlipbooks && flipbookLayer == layer) {
+		drawFlipbook(explosionFlipbook, sceneTime);
+	}
 }
 
-void drawMissileThrusterVAO(void) {
-	//bind missile thruster VAO and draw it
-	glBindVertexArray(missileThrusterVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, (GLvoid*)0);
+//draws the queued layers firstLayer - lastLayer, with the particles and flipbooks each between the layer below theirs and their own
+static void executeSceneLayers(unsigned firstLayer, unsigned lastLayer) {
+	unsigned next = firstLayer;
+
+	for (unsigned layer = firstLayer; layer <= lastLayer; layer++) {
+		if (!effectsUnder(layer)) {
+			continue;
+		}
+
+		if (layer > next) {
+			executeRenderQueueLayers(next, layer - 1);
+		}
+
+		drawEffectsUnder(layer);
+		next = layer;
+	}
+
+	executeRenderQueueLayers(next, lastLayer);
 }
 
-void drawMissileSmokeVAO(void) {
-	//bind missile thruster VAO and draw it
-	glBindVertexArray(missileSmokeVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 5, GL_UNSIGNED_BYTE, (GLvoid*)0);
+void drawScene(void) {
+	//the cached layers are only drawn when the cache is stale (or off)
+	bool cacheLayers = useLayerCache && backgroundCache.width > 0 && firstDynamicLayer > 0;
+	bool trackDamage = useDamageTracking && frameTarget.width > 0;
+	bool stale = (cacheLayers || trackDamage) && backgroundCacheStale();
+
+	if (cacheLayers && stale) {
+		invalidateLayerCache(backgroundCache);
+	}
+
+	bool drawCachedLayers = !cacheLayers || !backgroundCache.valid;
+
+	//queue every visible node - the queue sorts them by layer and then state, so draws that share a program, texture or blend mode run together
+	beginRenderQueue();
+
+	//the tile chunks in view - one draw per tile type in each chunk.  The tile world is always below the first dynamic layer, so it is only drawn when the cached layers are
+	for (size_t c = 0; c < visibleChunks.size() && drawCachedLayers; c++) {
+		const tileChunkDraw& chunk = visibleChunks[c];
+
+		for (int type = 0; type < TILE_TYPE_COUNT; type++) {
+			if (chunk.count[type] == 0) {
+				continue;
+			}
+
+			renderCommand command;
+
+			setSceneMaterial(tileMaterials[type], command);
+
+			command.vao = chunk.vao;
+			command.primitive = GL_TRIANGLES;
+			command.first = chunk.first[type];
+			command.count = chunk.count[type];
+			command.indexType = GL_UNSIGNED_SHORT;
+			command.transform = chunkTransforms[c];
+
+			submitRenderCommand(command, TILE_WORLD_LAYER);
+		}
+	}
+
+	//the scene nodes recorded by updateSceneTransforms, in order, leaving out any already in the cache
+	if (usedNodeLists > 0) {
+		submitCommandLists(&nodeCommandLists[0], usedNodeLists, drawCachedLayers ? 0 : firstDynamicLayer);
+	}
+
+	//with damage tracking only the rectangles around what moved are redrawn - unless the background changed, the frame target has nothing in it yet or so much moved that a full redraw is as cheap
+	int damagedPixels = 0;
+
+	if (trackDamage) {
+		clearDamage(damage, frameTarget.width, frameTarget.height);
+
+		for (size_t i = 0; i < movedBounds.size(); i++) {
+			float x0, y0, x1, y1;
+
+			worldToScreen(camera, movedBounds[i].minX, movedBounds[i].minY, &x0, &y0);
+			worldToScreen(camera, movedBounds[i].maxX, movedBounds[i].maxY, &x1, &y1);
+			addDamage(damage, x0, y0, x1, y1);
+		}
+
+		damagedPixels = finishDamage(damage);
+	}
+
+	bool partial = trackDamage && frameTarget.valid && !stale && damagedPixels * 2 < frameTarget.width * frameTarget.height;
+	GLuint target = trackDamage ? frameTarget.framebuffer : 0;
+
+	//bring the background cache up to date if it has to be
+	if (cacheLayers && !backgroundCache.valid) {
+		beginLayerCache(backgroundCache);
+		executeRenderQueueLayers(0, firstDynamicLayer - 1);
+		endLayerCache(backgroundCache, target);
+	}
+
+	if (trackDamage) {
+		beginLayerCache(frameTarget, !partial);
+	}
+
+	//copy the cached layers to the screen and draw the rest over them - everything within each damaged rectangle for a partial redraw
+	unsigned firstLayer = cacheLayers ? firstDynamicLayer : 0;
+
+	if (partial) {
+		glEnable(GL_SCISSOR_TEST);
+
+		for (size_t i = 0; i < damage.rects.size(); i++) {
+			const damageRect& r = damage.rects[i];
+
+			glScissor(r.x, r.y, r.width, r.height);
+
+			if (cacheLayers) {
+				compositeLayerCache(backgroundCache, target);
+			} else {
+				glClear(GL_COLOR_BUFFER_BIT);
+			}
+
+			executeSceneLayers(firstLayer, 255);
+		}
+
+		glDisable(GL_SCISSOR_TEST);
+	} else {
+		if (cacheLayers) {
+			compositeLayerCache(backgroundCache, target);
+		}
+
+		executeSceneLayers(firstLayer, 255);
+	}
+
+	if (stale) {
+		rememberBackground();
+	}
+
+	//the finished frame goes to the window in one copy
+	if (trackDamage) {
+		endLayerCache(frameTarget);
+		compositeLayerCache(frameTarget);
+
+		if (partial) {
+			damageStats.partialFrames++;
+			damageStats.lastPixels = damagedPixels;
+			damageStats.lastRects = damage.rects.size();
+		} else {
+			damageStats.fullFrames++;
+			damageStats.lastPixels = frameTarget.width * frameTarget.height;
+			damageStats.lastRects = 1;
+		}
+	}
 }
+#pragma endregion scene objects
+
+#pragma region missile object
+//Animation settings - the defaults are replaced by the scene file's param values when it is loaded
+struct animationAttrib {
+	float missileSpeed = 0.004f;
+	float missileTop = 1.9f;
+	float missileBottom = -0.3f;
+	float missileReturnScale = 0.5f;
+	float smokeMin = 1.0f;
+	float smokeMax = 1.4f;
+	float smokeRate = 0.005f;
+	float explosionGrowth = 0.008f;
+	float explosionMaxScale = 1.0f;
+	float explosionRise = 0.004f;
+	float cloudSpeed = 0.003f;
+	float cloudRange = 1.4f;
+} animation;
+
+//Setup a global struct for the missile object
+struct missileAttrib {
+	bool atTop;
+	bool exploded;
+	float x = 0.0f;
+	float y = -0.5f;
+	float theta = 0.0f;
+	float scale = 1.0f;
+	float smokeOffsetY = -0.24f; //at the smoke's longest
+} missile;
 
 void moveUpMissileVAO(void) {
-	if (missile.y < 1.9f) {
-		missile.y += 0.004f;
+	if (missile.y < animation.missileTop) {
+		missile.y += animation.missileSpeed;
 	} else {
 		missile.atTop = true;
-		missile.scale = 0.5f;
+		missile.scale = animation.missileReturnScale;
 		missile.theta = 180.0f;
 		std::cout << "Missile has reached the top... It's coming down!\n";
 	}
 }
 
-void moveDownMissileVAO(void) {
-	if (missile.y > -0.3) {
-		missile.y -= 0.004f;
-	} else {
-		missile.exploded = true;
-		std::cout << "Missile has reached the bottom... It's going to blow up!\n";
+static void explodeMissile(void) {
+	missile.exploded = true;
+	std::cout << "Missile has hit the ground... It's going to blow up!\n";
+
+	//Reduces the size of the missile to 0 so it appears invisible, and it no longer collides with anything
+	missile.scale = 0.0f;
 
-		//Reduces the size of the missile to 0 so it appears invisible
-		missile.scale = 0.0f;
+	if (missileBody >= 0) {
+		removeCollisionBody(sceneCollisions, missileBody);
+		missileBody = -1;
 	}
-}
 
-void setMissileX(float deltaX) {
-	missile.x += deltaX;
+	//starts the explosion growing
+	for (int i = 0; i < 2; i++) {
+		if (explosionTracks[i] >= 0) {
+			setCurveSpeed(sceneCurves, explosionTracks[i], 1.0f);
+		}
+	}
 }
 
-void setSmokeScaleY(float deltaScale) {
-	static float offsetY;
-	//reverses the direction of the smoke scale onces it reaches the edges
-	if (missile.smokeScaleY > 1.4f && missile.smokeScaleUp == true) {
-		missile.smokeScaleUp = false;
-		offsetY = 0.0005f;
-	}
-	else if (missile.smokeScaleY < 1.0f && missile.smokeScaleUp == false) {
-		missile.smokeScaleUp = true;
-		offsetY = -0.0005f;
+//the ground contact explodes the missile as its centre reaches missile.bottom - this only catches it when there is no scene to collide with
+void moveDownMissileVAO(void) {
+	if (missile.y > animation.missileBottom) {
+		missile.y -= animation.missileSpeed;
+	} else {
+		explodeMissile();
 	}
+}
+
+//act on the contacts the last collision update started
+static void missileContacts(void) {
+	for (size_t i = 0; i < sceneCollisions.events.size(); i++) {
+		const collisionEvent& event = sceneCollisions.events[i];
 
-	missile.smokeOffsetY += offsetY;
-	missile.smokeScaleY += deltaScale;
+		if (event.type != COLLISION_BEGIN || (event.contact.a != missileBody && event.contact.b != missileBody)) {
+			continue;
+		}
+
+		int other = (event.contact.a == missileBody) ? event.contact.b : event.contact.a;
+
+		if (other == groundBody && missile.atTop && !missile.exploded) {
+			explodeMissile();
+			return;
+		} else if (other == cloudBody) {
+			std::cout << "Missile has flown through the cloud\n";
+		}
+	}
 }
 
-bool getSmokeScaleDir(void) {
-	return missile.smokeScaleUp;
+void setMissileX(float deltaX) {
+	missile.x += deltaX;
 }
 
 bool getMissileAtTop(void) {
@@ -692,231 +920,411 @@ bool getMissileExploded(void) {
 #pragma endregion missile object
 
 #pragma region missile explosion object
+//where the explosion starts - its curves grow and lift it from here
 struct missileExpAttrib {
 	float scale = 0.0f;
 	float x = 0.0f;
 	float y = -0.3f;
 } missileExp;
 
-void setupMissileExplosionVAO(void) {
-	// Vertex Buffer Object IDs for the ground texture object
-	GLuint quadPosVBO, quadColourVBO, quadTexCoordVBO, quadIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat quadVertices[] = {
-		-1.0, -0.7f,
-		-1.0f, 0.7f,
-		1.0f, -0.7f,
-		1.0f, 0.7f
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte quadColors[] = {
-		255, 0, 0, 255,
-		255, 255, 0, 255,
-		0, 255, 0, 255,
-		0, 255, 255, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float quadTextureCoords[] = {
-		0.0f, 1.0f,
-		0.0f, 0.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f
-	};
-
-	// 4) Index Array - Store indices to quad vertices - this determines the order the vertices are to be processed
-	static GLubyte quadVertexIndices[] = { 0, 1, 2, 3 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &missileExplosionVAO);
-	glBindVertexArray(missileExplosionVAO);
-
-	// setup VBO for the quad object position data
-	glGenBuffers(1, &quadPosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadPosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the quad object colour data
-	glGenBuffers(1, &quadColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadColors), quadColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the quad object texture coord data
-	glGenBuffers(1, &quadTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadTextureCoords), quadTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup quad vertex index array
-	glGenBuffers(1, &quadIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadVertexIndices), quadVertexIndices, GL_STATIC_DRAW);
+//starts the explosion flipbook where the explosion mesh would have started to grow.  The shader grows it to explosion.maxScale and lifts it by explosion.rise a frame while its frames play, so nothing is updated after this
+static void playExplosionFlipbook(void) {
+	int mesh = scene->nodes[explosionNode].mesh;
+	float maxScale = animation.explosionMaxScale;
+	flipbookInstance explosion;
+
+	explosion.x = missile.x;
+	explosion.y = missileExp.y;
+	explosion.velocityX = 0.0f;
+	explosion.velocityY = animation.explosionRise / FRAME_TIME_STEP;
+	explosion.halfWidth = (mesh >= 0) ? (meshBounds[mesh].maxX - meshBounds[mesh].minX) * 0.5f * maxScale : maxScale;
+	explosion.halfHeight = (mesh >= 0) ? (meshBounds[mesh].maxY - meshBounds[mesh].minY) * 0.5f * maxScale : maxScale;
+	explosion.startScale = 0.0f;
+	explosion.startTime = sceneTime;
+
+	playFlipbook(explosionFlipbook, explosion);
+}
+#pragma endregion missile explosion object
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+#pragma region cloud object
+//where the cloud starts - its curve moves it from here
+struct cloudAttrib {
+	float x;
+} cloud;
+
+void setCloudSpeed(float deltaX) {
+	if (cloudTrack >= 0) {
+		setCurveSpeed(sceneCurves, cloudTrack, deltaX / animation.cloudSpeed);
+	}
 }
+#pragma endregion cloud object
+
+#pragma region scene animation
+//builds the curves from the scene's animation settings.  The settings are per frame, so they become key times at FRAME_TIME_STEP a frame
+static void setupSceneAnimation(void) {
+	clearAnimationCurves(sceneCurves);
+
+	//the smoke pulses between its longest and shortest, easing at each end, and lifts as it shortens so it stays on the thrusters
+	float smokeRange = animation.smokeMax - animation.smokeMin;
+	float smokeTime = smokeRange / animation.smokeRate * FRAME_TIME_STEP;
+	curveKey smokeScale[2] = { { 0.0f, animation.smokeMax, CURVE_SMOOTH }, { smokeTime, animation.smokeMin, CURVE_SMOOTH } };
+	curveKey smokeOffset[2] = { { 0.0f, missile.smokeOffsetY, CURVE_SMOOTH }, { smokeTime, missile.smokeOffsetY + smokeRange * 0.1f, CURVE_SMOOTH } };
 
-void drawMissileExplosionVAO(void) {
-	//Pass shader program into GPU pipeline
-	glUseProgram(myShaderProgram);
+	addCurveTrack(sceneCurves, smokeScale, 2, CURVE_PINGPONG, SMOKE_SCALE_Y);
+	addCurveTrack(sceneCurves, smokeOffset, 2, CURVE_PINGPONG, SMOKE_OFFSET_Y);
 
-	// Move our ground shape to the top half of the screen
-	GUMatrix4 T = GUMatrix4::translationMatrix(missile.x, missileExp.y, 0.0f);
-	GUMatrix4 S = GUMatrix4::scaleMatrix(missileExp.scale, missileExp.scale, 0.0f);
-	GUMatrix4 M = T * S;
-	glUniformMatrix4fv(locT, 1, GL_FALSE, (GLfloat*)&M);
+	//the cloud drifts from side to side, setting off right from where the scene puts it
+	float cloudTime = 2.0f * animation.cloudRange / animation.cloudSpeed * FRAME_TIME_STEP;
+	curveKey cloudX[2] = { { 0.0f, -animation.cloudRange, CURVE_LINEAR }, { cloudTime, animation.cloudRange, CURVE_LINEAR } };
 
-	//bind the texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, explosionTexture);
-	glUniform1i(glGetUniformLocation(myShaderProgram, "texture"), 0);
-	glEnable(GL_TEXTURE_2D);
+	cloudTrack = addCurveTrack(sceneCurves, cloudX, 2, CURVE_PINGPONG, CLOUD_X);
+	setCurveTime(sceneCurves, cloudTrack, clamp((cloud.x + animation.cloudRange) / (2.0f * animation.cloudRange), 0.0f, 1.0f) * cloudTime);
 
-	//Enables blending to support alpha
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_ONE, GL_ONE);
+	//the explosion grows to its full size, rising as it does, and waits for the missile to explode before it starts
+	float explosionFrames = (animation.explosionMaxScale - missileExp.scale) / animation.explosionGrowth;
+	float explosionTime = explosionFrames * FRAME_TIME_STEP;
+	curveKey explosionScale[2] = { { 0.0f, missileExp.scale, CURVE_LINEAR }, { explosionTime, animation.explosionMaxScale, CURVE_LINEAR } };
+	curveKey explosionY[2] = { { 0.0f, missileExp.y, CURVE_LINEAR }, { explosionTime, missileExp.y + explosionFrames * animation.explosionRise, CURVE_LINEAR } };
 
-	//bind ground VAO and draw it
-	glBindVertexArray(missileExplosionVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, (GLvoid*)0);
+	explosionTracks[0] = addCurveTrack(sceneCurves, explosionScale, 2, CURVE_CLAMP, EXPLOSION_SCALE);
+	explosionTracks[1] = addCurveTrack(sceneCurves, explosionY, 2, CURVE_CLAMP, EXPLOSION_Y);
+
+	for (int i = 0; i < 2; i++) {
+		setCurveSpeed(sceneCurves, explosionTracks[i], missile.exploded ? 1.0f : 0.0f);
+	}
 
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
-	glUseProgram(0);
+	updateAnimationCurves(sceneCurves, 0.0f, animatedValues);
 }
 
-void setMissileExpScale(float deltaScale) {
-	missileExp.scale += deltaScale;
+void animateScene(void) {
+	updateAnimationCurves(sceneCurves, FRAME_TIME_STEP, animatedValues);
+}
 
-	//modify the y position of the explosion to grow from a certain point as it scales
-	missileExp.y += 0.004f;
+void reportAnimationStats(void) {
+	reportAnimationCurveStats(sceneCurves);
+}
+#pragma endregion scene animation
+
+#pragma region particle effects
+//Particle effect settings - replaced by the scene file's param values when it is loaded.  Colours are RGBA with red in the low byte
+struct particleEffect {
+	unsigned count; //per thruster per frame for the exhaust, all at once for the debris
+	float speed; //along the thruster for the exhaust
+	float spread; //extra speed in a random direction
+	float lifeMin, lifeMax;
+	float sizeStart, sizeEnd;
+	float accelerationY;
+	float drag;
+	unsigned colourStart, colourEnd;
+};
+
+particleEffect exhaust = { 24, 0.8f, 0.25f, 0.6f, 1.5f, 0.03f, 0.12f, 0.4f, 2.0f, 0xDC28AAFF, 0x00505050 };
+particleEffect debris = { 3000, 0.2f, 1.6f, 1.0f, 2.5f, 0.02f, 0.008f, -1.2f, 0.8f, 0xFF96E6FF, 0x00001E8C };
+
+//a batch of an effect's particles from a square around x, y, moving at velocityX, velocityY plus the effect's spread
+static particleEmission effectEmission(const particleEffect& effect, unsigned count, float x, float y, float halfSize, float velocityX, float velocityY) {
+	particleEmission e;
+
+	e.x = x;
+	e.y = y;
+	e.halfWidth = halfSize;
+	e.halfHeight = halfSize;
+	e.velocityX = velocityX;
+	e.velocityY = velocityY;
+	e.speedMin = 0.0f;
+	e.speedMax = effect.spread;
+	e.lifeMin = effect.lifeMin;
+	e.lifeMax = effect.lifeMax;
+	e.sizeStart = effect.sizeStart;
+	e.sizeEnd = effect.sizeEnd;
+	e.accelerationX = 0.0f;
+	e.accelerationY = effect.accelerationY;
+	e.drag = effect.drag;
+	e.unused = 0.0f;
+	e.colourStart = effect.colourStart;
+	e.colourEnd = effect.colourEnd;
+	e.first = 0;
+	e.count = count;
+
+	return e;
 }
 
-float getCurMissileExpSize(void) {
-	return missileExp.scale;
+//queues a batch with whichever particle system is running
+static void queueParticles(const particleEmission& emission) {
+	if (particlesOnCpu) {
+		emitCpuParticles(cpuParticles, emission);
+	} else {
+		emitParticles(particles, emission);
+	}
 }
-#pragma endregion missile explosion object
 
-#pragma region cloud object
-struct cloudAttrib {
-	float x;
-	bool moveRight = true;
-} cloud;
+//queues this frame's particles - exhaust from each thruster while the missile flies, and one burst of debris when it blows up
+static void emitSceneParticles(void) {
+	if (!missile.exploded && missile.scale > 0.0f) {
+		for (int i = 0; i < 2; i++) {
+			SceneNode thruster = (missileSmokeNodes[i] >= 0) ? scene->nodes[missileSmokeNodes[i]].parent : -1;
 
-void setupCloudVAO(void) {
-	// Vertex Buffer Object IDs for the grass texture object
-	GLuint cloudPosVBO, cloudColourVBO, cloudTexCoordVBO, cloudIndicesVBO;
-
-	// 1) Position Array - Store vertices as (x,y) pairs
-	static GLfloat cloudVertices[] = {
-		-0.3f, -0.3f,
-		-0.3f, 0.0f,
-		0.3f, -0.3f,
-		0.3f, 0.0f
-	};
-
-	// 2) Colour Array - Store RGB values as unsigned bytes
-	static GLubyte cloudColors[] = {
-		255, 0, 0, 255,
-		255, 255, 0, 255,
-		0, 255, 0, 255,
-		0, 255, 255, 255
-	};
-
-	// 3) Texture coordinate array (store uv coordinates as floating point values)
-	static float cloudTextureCoords[] = {
-		0.0f, 1.0f,
-		0.0f, 0.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f
-	};
-
-	// 4) Index Array - Store indices to quad vertices - this determines the order the vertices are to be processed
-	static GLubyte cloudVertexIndices[] = { 0, 1, 2, 3 };
-
-	//create and bind the VAO
-	glGenVertexArrays(1, &cloudVAO);
-	glBindVertexArray(cloudVAO);
-
-	// setup VBO for the quad object position data
-	glGenBuffers(1, &cloudPosVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, cloudPosVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cloudVertices), cloudVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// setup VBO for the quad object colour data
-	glGenBuffers(1, &cloudColourVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, cloudColourVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cloudColors), cloudColors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// setup VBO for the quad object texture coord data
-	glGenBuffers(1, &cloudTexCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, cloudTexCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cloudTextureCoords), cloudTextureCoords, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	// setup quad vertex index array
-	glGenBuffers(1, &cloudIndicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cloudIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cloudVertexIndices), cloudVertexIndices, GL_STATIC_DRAW);
+			if (thruster < 0) {
+				continue;
+			}
 
-	//Unbind the VAO once created
-	glBindVertexArray(0);
+			//the nozzle is the bottom of the thruster mesh and the exhaust leaves along the thruster's -y axis, whichever way up the missile is
+			float points[4] = { 0.0f, -0.1f, 0.0f, -1.1f };
+
+			sceneNodeWorld(sceneNodes, thruster).transformPoints(points, points, 2);
+
+			float dx = points[2] - points[0];
+			float dy = points[3] - points[1];
+			float length = sqrtf(dx * dx + dy * dy);
+
+			if (length > 0.0f) {
+				queueParticles(effectEmission(exhaust, exhaust.count, points[0], points[1], 0.02f * length, dx / length * exhaust.speed, dy / length * exhaust.speed));
+			}
+		}
+	}
+
+	if (missile.exploded && !debrisEmitted) {
+		queueParticles(effectEmission(debris, debris.count, missile.x, missile.y, 0.05f, 0.0f, 0.0f));
+		debrisEmitted = true;
+	}
 }
 
-void drawCloudVAO(void) {
-	//Pass shader program into GPU pipeline
-	glUseProgram(myShaderProgram);
+void reportParticleStats(void) {
+	if (particlesOnCpu) {
+		reportCpuParticleSystemStats(cpuParticles);
+	} else {
+		reportParticleSystemStats(particles);
+	}
 
-	// Move the grass shape to the bottom half of the screen
-	GUMatrix4 T = GUMatrix4::translationMatrix(cloud.x, 0.3f, 0.0f);
-	glUniformMatrix4fv(locT, 1, GL_FALSE, (GLfloat*)&T);
+	reportFlipbookStats(explosionFlipbook);
+}
+#pragma endregion particle effects
 
-	//bind the texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, cloudTexture);
-	glUniform1i(glGetUniformLocation(myShaderProgram, "texture"), 0);
-	glEnable(GL_TEXTURE_2D);
+#pragma region scene loading
+bool loadScene(const char *path) {
+	scene = loadSceneFile(path);
 
-	//Enables blending to support alpha
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_ONE, GL_ONE);
+	if (!scene) {
+		std::cout << "Scene: nothing will be drawn\n";
+		return false;
+	}
 
+	//find the nodes the animation moves
+	explosionNode = findSceneNode(scene, "explosion");
+	cloudNode = findSceneNode(scene, "cloud");
+	missileBodyNode = findSceneNode(scene, "missile");
+	missileSmokeNodes[0] = findSceneNode(scene, "smoke0");
+	missileSmokeNodes[1] = findSceneNode(scene, "smoke1");
+
+	//the materials the tile world is drawn with
+	tileMaterials[TILE_SKY] = findSceneMaterial(scene, "tileSky");
+	tileMaterials[TILE_GRASS] = findSceneMaterial(scene, "tileGrass");
+	tileMaterials[TILE_GROUND] = findSceneMaterial(scene, "tileGround");
+
+	//the animation starts from where the scene places the nodes
+	if (missileBodyNode >= 0) {
+		missile.x = scene->nodes[missileBodyNode].x;
+		missile.y = scene->nodes[missileBodyNode].y;
+	}
 
-	//bind grass VAO and draw it
-	glBindVertexArray(cloudVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, (GLvoid*)0);
+	if (explosionNode >= 0) {
+		missileExp.x = scene->nodes[explosionNode].x;
+		missileExp.y = scene->nodes[explosionNode].y;
+		missileExp.scale = scene->nodes[explosionNode].scaleX;
+	}
 
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
-	glUseProgram(0);
+	if (cloudNode >= 0) {
+		cloud.x = scene->nodes[cloudNode].x;
+	}
+
+	animation.missileSpeed = sceneParameter(scene, "missile.speed", animation.missileSpeed);
+	animation.missileTop = sceneParameter(scene, "missile.top", animation.missileTop);
+	animation.missileBottom = sceneParameter(scene, "missile.bottom", animation.missileBottom);
+	animation.missileReturnScale = sceneParameter(scene, "missile.returnScale", animation.missileReturnScale);
+	animation.smokeMin = sceneParameter(scene, "smoke.min", animation.smokeMin);
+	animation.smokeMax = sceneParameter(scene, "smoke.max", animation.smokeMax);
+	animation.smokeRate = sceneParameter(scene, "smoke.rate", animation.smokeRate);
+	animation.explosionGrowth = sceneParameter(scene, "explosion.growth", animation.explosionGrowth);
+	animation.explosionMaxScale = sceneParameter(scene, "explosion.maxScale", animation.explosionMaxScale);
+	animation.explosionRise = sceneParameter(scene, "explosion.rise", animation.explosionRise);
+	animation.cloudSpeed = sceneParameter(scene, "cloud.speed", animation.cloudSpeed);
+	animation.cloudRange = sceneParameter(scene, "cloud.range", animation.cloudRange);
+
+	particleLayer = unsigned(sceneParameter(scene, "particles.layer", float(particleLayer)));
+	exhaust.count = unsigned(sceneParameter(scene, "exhaust.rate", float(exhaust.count)));
+	exhaust.speed = sceneParameter(scene, "exhaust.speed", exhaust.speed);
+	exhaust.lifeMax = sceneParameter(scene, "exhaust.life", exhaust.lifeMax);
+	debris.count = unsigned(sceneParameter(scene, "debris.count", float(debris.count)));
+	debris.spread = sceneParameter(scene, "debris.speed", debris.spread);
+	debris.lifeMax = sceneParameter(scene, "debris.life", debris.lifeMax);
+	debris.accelerationY = sceneParameter(scene, "debris.gravity", debris.accelerationY);
+
+	setupSceneAnimation();
+
+	return true;
+}
+
+float getSceneParameter(const char *name, float defaultValue) {
+	return scene ? sceneParameter(scene, name, defaultValue) : defaultValue;
+}
+
+camera2D& getSceneCamera(void) {
+	return camera;
 }
+#pragma endregion scene loading
 
-void setCloudX(float deltaX) {
-	//reverses the direction of the cloud onces it reaches the edges
-	if (cloud.x > 1.4f && cloud.moveRight == true) {
-		cloud.moveRight = false;
-	} else if (cloud.x < -1.4f && cloud.moveRight == false) {
-		cloud.moveRight = true;
+#pragma region frame transforms
+//sets the local transform of a node the animation moves, if the scene has it
+static void setAnimatedNode(SceneNode node, const GUAffine2D& local) {
+	if (node >= 0) {
+		setSceneNodeLocal(sceneNodes, node, local);
 	}
+}
+
+//records the transforms and draws for visibleNodes[begin, end) - runs on the thread pool, so it only reads the scene and writes its own transform slots and list
+static void recordSceneNodes(int begin, int end, int firstTransform, commandList& list) {
+	resetCommandList(list);
+
+	for (int v = begin; v < end; v++) {
+		SceneNode i = visibleNodes[v];
+		const sceneNodeRecord& node = scene->nodes[i];
+		const GUAffine2D& world = sceneNodeWorld(sceneNodes, i);
+
+		int transform = reservedFrameTransform(firstTransform, v);
 
-	cloud.x += deltaX;
+		setFrameTransform(transform, world);
+
+		//nodes scaled down to nothing (the explosion before the missile blows up, the missile after) are skipped
+		if (world.det() == 0.0f) {
+			continue;
+		}
+
+		const sceneMeshRecord& mesh = scene->meshes[node.mesh];
+		renderCommand command;
+
+		setSceneMaterial(node.material, command);
+
+		command.vao = sceneMeshVAOs[node.mesh];
+		command.primitive = mesh.primitive;
+		command.first = 0;
+		command.count = GLsizei(mesh.indices.count);
+		command.indexType = GL_UNSIGNED_SHORT;
+		command.transform = transform;
+
+		recordCommand(list, command, node.layer);
+	}
 }
 
-bool getCloudDir(void) {
-	return cloud.moveRight;
+void updateSceneTransforms(void) {
+	//everything is positioned in world coordinates and the camera projects the part in view to the screen
+	beginTransformFrame(cameraMatrix(camera));
+
+	spatialBounds view = cameraBounds(camera);
+
+	movedBounds.clear();
+	usedNodeLists = 0;
+
+	//the texture manager isn't thread safe, so the textures are looked up here rather than while recording
+	if (scene && !useSceneTextureArray) {
+		sceneMaterialTextures.resize(scene->materials.count, 0);
+
+		for (unsigned i = 0; i < scene->materials.count; i++) {
+			int texture = scene->materials[i].texture;
+
+			sceneMaterialTextures[i] = (texture >= 0) ? useTexture(sceneTextureHandles[texture]) : 0;
+		}
+	}
+
+	//stream tile chunks in and out around the view, then give each chunk in view a slot
+	updateTileWorld(view);
+	visibleTileChunks(view, visibleChunks);
+
+	chunkTransforms.clear();
+
+	for (size_t i = 0; i < visibleChunks.size(); i++) {
+		chunkTransforms.push_back(addFrameTransform(GUAffine2D::translation(visibleChunks[i].originX, visibleChunks[i].originY)));
+	}
+
+	if (scene) {
+		//update the local transforms of everything that can move - only nodes that actually changed (and their children) are recomputed
+		if (cloudNode >= 0) {
+			setAnimatedNode(cloudNode, GUAffine2D::translation(animatedValues[CLOUD_X], scene->nodes[cloudNode].y));
+		}
+
+		//the flipbook replaces the explosion mesh when there is one
+		float explosionScale = useFlipbooks ? 0.0f : animatedValues[EXPLOSION_SCALE];
+
+		setAnimatedNode(explosionNode, GUAffine2D::TRS(missile.x, animatedValues[EXPLOSION_Y], 0.0f, explosionScale, explosionScale));
+		setAnimatedNode(missileBodyNode, GUAffine2D::TRS(missile.x, missile.y, missile.theta*(PI / 180), missile.scale, missile.scale));
+
+		//the particles replace the smoke meshes when there are any
+		GUAffine2D smoke = useParticles ? GUAffine2D::scale(0.0f, 0.0f) : GUAffine2D::translation(0.0f, animatedValues[SMOKE_OFFSET_Y]) * GUAffine2D::scale(1.0f, animatedValues[SMOKE_SCALE_Y]);
+
+		for (int i = 0; i < 2; i++) {
+			setAnimatedNode(missileSmokeNodes[i], smoke);
+		}
+
+		updateSceneGraph(sceneNodes);
+
+		//the missile explodes on the frame after it touches the ground
+		collideScene();
+		missileContacts();
+
+		//cull before anything is transformed or drawn - only visible nodes need a slot
+		updateVisibleNodes(view);
+
+		//record the visible nodes in ranges, each into its own list and its own block of transform slots
+		int count = int(visibleNodes.size());
+		int firstTransform = reserveFrameTransforms(count);
+
+		usedNodeLists = size_t(parallelChunks(count, NODES_PER_JOB));
+
+		if (nodeCommandLists.size() < usedNodeLists) {
+			nodeCommandLists.resize(usedNodeLists);
+		}
+
+		parallelFor(count, NODES_PER_JOB, [firstTransform](int begin, int end, int chunk) {
+			recordSceneNodes(begin, end, firstTransform, nodeCommandLists[chunk]);
+		});
+
+		//start this frame's particles from where the missile is now and step them.  GPU particles are never read back, so damage tracking redraws everywhere they could have reached - CPU particles report where they are and were
+		if (useParticles) {
+			emitSceneParticles();
+
+			spatialBounds reach;
+			bool moved;
+
+			if (particlesOnCpu) {
+				updateCpuParticleSystem(cpuParticles, FRAME_TIME_STEP);
+				moved = cpuParticleSystemBounds(cpuParticles, &reach);
+			} else {
+				updateParticleSystem(particles, FRAME_TIME_STEP);
+				moved = particleSystemBounds(particles, &reach);
+			}
+
+			if (moved) {
+				movedBounds.push_back(reach);
+			}
+		}
+
+		//the explosion flipbook only needs starting - after that the shader plays it from sceneTime
+		sceneTime += FRAME_TIME_STEP;
+
+		if (useFlipbooks) {
+			if (missile.exploded && !explosionPlayed) {
+				playExplosionFlipbook();
+				explosionPlayed = true;
+			}
+
+			spatialBounds playing;
+
+			if (flipbookBounds(explosionFlipbook, sceneTime, FRAME_TIME_STEP, &playing)) {
+				movedBounds.push_back(playing);
+			}
+		}
+	}
+
+	//one buffer update for the whole frame
+	uploadFrameTransforms();
 }
-#pragma endregion cloud object
\ No newline at end of file
+#pragma endregion
\ No newline at end of file
@@ -1,42 +1,50 @@
 #pragma once
 
+#include "camera.h"
+
 void setupTextures(void);
 void setupShaders(void);
+void finishShaders(void);
+void updateSceneTransforms(void);
+
+//Load the scene description (call before setupTextures and setupSceneVAOs)
+bool loadScene(const char *path);
+float getSceneParameter(const char *name, float defaultValue);
+
+//the camera the scene and tile world are drawn through
+camera2D& getSceneCamera(void);
 
-void setupSkyVAO(void);
-void drawSkyVAO(void);
+void setupSceneVAOs(void);
+void drawScene(void);
+void reportCullingStats(void);
 
-void setupGroundVAO(void);
-void drawGroundVAO(void);
+//Static layer caching - resizeScene must be called with the window size
+void resizeScene(int width, int height);
+void setLayerCaching(bool enable);
+bool layerCaching(void);
+void reportLayerCacheStats(void);
 
-void setupGrassVAO(void);
-void drawGrassVAO(void);
+//particles for the missile exhaust and explosion debris, and the explosion flipbook
+void reportParticleStats(void);
+
+//Damage tracking (partial redraw) mode
+void setDamageTracking(bool enable);
+bool damageTracking(void);
+void reportDamageStats(void);
 
 //Function prototypes for the missile
-void setupMissileVAO(void);
-void setupMissileBodyVAO(void);
-void setupMissileThrusterVAO(void);
-void setupMissileSmokeVAO(void);
-void drawMissileVAO(void);
-void drawMissileBodyVAO(void);
-void drawMissileThrusterVAO(void);
-void drawMissileSmokeVAO(void);
 void moveUpMissileVAO(void);
 void moveDownMissileVAO(void);
 void setMissileX(float);
-void setSmokeScaleY(float);
-bool getSmokeScaleDir(void);
 bool getMissileAtTop(void);
 bool getMissileExploded(void);
 
-//Function prototypes for the missile explosion
-void setupMissileExplosionVAO(void);
-void drawMissileExplosionVAO(void);
-void setMissileExpScale(float);
-float getCurMissileExpSize(void);
-
-//function prototypes for the clouds
-void setupCloudVAO(void);
-void drawCloudVAO(void);
-void setCloudX(float);
-bool getCloudDir();
\ No newline at end of file
+//collisions between the missile, the ground and the cloud
+void reportSceneCollisionStats(void);
+
+//function prototypes for the clouds - the speed is the distance moved per frame
+void setCloudSpeed(float);
+
+//Keyframed animation of the smoke, cloud and explosion - animateScene moves them on by a frame
+void animateScene(void);
+void reportAnimationStats(void);
\ No newline at end of file
@@ -0,0 +1,467 @@
+#include "stdafx.h"
+#include "flipbook.h"
+#include "shader_setup.h"
+#include "shader_source.h"
+#include "asset_watcher.h"
+#include "texture_loader.h"
+#include "transform_buffer.h"
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+static const char *FLIPBOOK_VS_PATH = "Shaders\\flipbook_vert.glsl";
+static const char *FLIPBOOK_FS_PATH = "Shaders\\flipbook_frag.glsl";
+
+// the texture unit the atlas is bound to while drawing
+static const GLuint FLIPBOOK_ATLAS_UNIT = 0;
+
+static GLuint flipbookProgram = 0;
+static GLint timeUniform = -1, framesPerSecondUniform = -1, frameCountUniform = -1, endModeUniform = -1;
+
+// sizes the shaders share with the C++ side
+static string flipbookDefines(void) {
+	return "#define MAX_FLIPBOOK_FRAMES " + to_string(MAX_FLIPBOOK_FRAMES) + "\n";
+}
+
+static void getFlipbookUniforms(void) {
+	timeUniform = glGetUniformLocation(flipbookProgram, "time");
+	framesPerSecondUniform = glGetUniformLocation(flipbookProgram, "framesPerSecond");
+	frameCountUniform = glGetUniformLocation(flipbookProgram, "frameCount");
+	endModeUniform = glGetUniformLocation(flipbookProgram, "endMode");
+
+	bindTransformBlock(flipbookProgram);
+
+	GLuint frameBlock = glGetUniformBlockIndex(flipbookProgram, "flipbookFrames");
+
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(flipbookProgram, frameBlock, FLIPBOOK_FRAME_BINDING);
+
+	glUseProgram(flipbookProgram);
+	glUniform1i(glGetUniformLocation(flipbookProgram, "atlas"), FLIPBOOK_ATLAS_UNIT);
+	glUseProgram(0);
+}
+
+bool setupFlipbookRenderer(void) {
+	if (flipbookProgram)
+		return true;
+
+	flipbookProgram = setupShaders(FLIPBOOK_VS_PATH, FLIPBOOK_FS_PATH, NULL, false, flipbookDefines());
+
+	releaseShaderSourceMappings();
+
+	if (!flipbookProgram) {
+
+		cout << "Flipbooks: the flipbook shaders could not be built\n";
+		return false;
+	}
+
+	getFlipbookUniforms();
+
+	return true;
+}
+
+#pragma region sheets
+
+void flipbookGrid(unsigned width, unsigned height, unsigned columns, unsigned frames, vector<flipbookFrame>& table) {
+	table.clear();
+
+	if (width == 0 || height == 0 || columns == 0)
+		return;
+
+	unsigned rows = (frames + columns - 1) / columns;
+	float frameWidth = float(width) / float(columns);
+	float frameHeight = float(height) / float(rows);
+
+	for (unsigned i = 0; i < frames; ++i) {
+
+		// rows count down from the top of the image, which is the end of the texture
+		float left = float(i % columns) * frameWidth;
+		float bottom = float(rows - 1 - i / columns) * frameHeight;
+
+		flipbookFrame f = { (left + 0.5f) / float(width), (bottom + 0.5f) / float(height), (left + frameWidth - 0.5f) / float(width), (bottom + frameHeight - 0.5f) / float(height) };
+
+		table.push_back(f);
+	}
+}
+
+// filtering and wrapping for an atlas - frames sit side by side, so nothing wraps
+static void setAtlasSampling(GLuint atlas) {
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLuint loadFlipbookSheet(const char *path, unsigned loadFlags, unsigned columns, unsigned frames, vector<flipbookFrame>& table) {
+	GLuint atlas = fiLoadTexture(path, loadFlags);
+
+	if (!atlas)
+		return 0;
+
+	GLint width = 0, height = 0;
+
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+	setAtlasSampling(atlas);
+	flipbookGrid(unsigned(width), unsigned(height), columns, frames, table);
+
+	return atlas;
+}
+
+// Bilinear sample of a prepared image at (x, y) texels, as premultiplied RGBA 0 - 255.  Outside the image is transparent
+static void sampleImage(const fiUploadSource& image, float x, float y, float rgba[4]) {
+	int channels = (image.format == GL_RGBA || image.format == GL_BGRA) ? 4 : ((image.format == GL_RED) ? 1 : 3);
+	bool swapRB = (image.format == GL_BGR || image.format == GL_BGRA);
+
+	rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0.0f;
+
+	x -= 0.5f;
+	y -= 0.5f;
+
+	int x0 = int(floorf(x));
+	int y0 = int(floorf(y));
+	float fx = x - float(x0);
+	float fy = y - float(y0);
+
+	for (int j = 0; j < 2; ++j) {
+
+		for (int i = 0; i < 2; ++i) {
+
+			int px = x0 + i;
+			int py = y0 + j;
+
+			if (px < 0 || py < 0 || px >= int(image.width) || py >= int(image.height))
+				continue;
+
+			float weight = (i ? fx : 1.0f - fx) * (j ? fy : 1.0f - fy);
+			const BYTE *p = image.pixels + size_t(py) * image.pitch + size_t(px) * channels;
+
+			float r = p[0], g = p[0], b = p[0], a = 255.0f;
+
+			if (channels >= 3) {
+
+				r = p[swapRB ? 2 : 0];
+				g = p[1];
+				b = p[swapRB ? 0 : 2];
+			}
+
+			if (channels == 4)
+				a = p[3];
+
+			rgba[0] += r * weight;
+			rgba[1] += g * weight;
+			rgba[2] += b * weight;
+			rgba[3] += a * weight;
+		}
+	}
+}
+
+GLuint bakeFlipbookSheet(const char *path, unsigned loadFlags, unsigned frames, unsigned frameWidth, vector<flipbookFrame>& table) {
+	table.clear();
+
+	fipImage *image = fiDecodeImage(path);
+
+	if (!image)
+		return 0;
+
+	vector<unsigned char> scratch;
+	fiUploadSource source;
+
+	if (frames == 0 || frameWidth == 0 || !fiPrepareUpload(*image, loadFlags, scratch, &source)) {
+
+		delete image;
+		return 0;
+	}
+
+	// frames keep the image's shape, laid out as near square as they go
+	unsigned frameHeight = unsigned(float(frameWidth) * float(source.height) / float(source.width) + 0.5f);
+	unsigned columns = unsigned(ceilf(sqrtf(float(frames))));
+	unsigned rows = (frames + columns - 1) / columns;
+	unsigned width = columns * frameWidth, height = rows * frameHeight;
+
+	vector<unsigned char> sheet(size_t(width) * height * 4, 0);
+
+	flipbookGrid(width, height, columns, frames, table);
+
+	float toImageX = float(source.width) / float(frameWidth);
+	float toImageY = float(source.height) / float(frameHeight);
+
+	for (unsigned f = 0; f < frames; ++f) {
+
+		float t = (frames > 1) ? float(f) / float(frames - 1) : 0.0f;
+
+		// a quarter turn over the whole flipbook, white hot at first, then cooling to red and thinning out
+		float angle = 0.6f * t;
+		float heat = 1.0f + 0.6f * (1.0f - t) * (1.0f - t);
+		float fade = 1.0f - 0.3f * t;
+		float tint[3] = { heat * fade, heat * fade * (1.0f - 0.25f * t), heat * fade * (1.0f - 0.5f * t) };
+
+		float c = cosf(angle), s = sinf(angle);
+		unsigned left = (f % columns) * frameWidth;
+		unsigned bottom = (rows - 1 - f / columns) * frameHeight;
+
+		for (unsigned y = 0; y < frameHeight; ++y) {
+
+			for (unsigned x = 0; x < frameWidth; ++x) {
+
+				// turn the frame's texel back into the image around the centre
+				float dx = (float(x) + 0.5f) - float(frameWidth) * 0.5f;
+				float dy = (float(y) + 0.5f) - float(frameHeight) * 0.5f;
+				float rgba[4];
+
+				sampleImage(source, (c * dx + s * dy) * toImageX + float(source.width) * 0.5f, (c * dy - s * dx) * toImageY + float(source.height) * 0.5f, rgba);
+
+				unsigned char *out = &sheet[(size_t(bottom + y) * width + left + x) * 4];
+
+				for (int k = 0; k < 3; ++k)
+					out[k] = (unsigned char)((rgba[k] * tint[k] < 255.0f) ? rgba[k] * tint[k] + 0.5f : 255.0f);
+
+				out[3] = (unsigned char)(rgba[3] * fade + 0.5f);
+			}
+		}
+	}
+
+	delete image;
+
+	GLuint atlas;
+
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &sheet[0]);
+
+	setAtlasSampling(atlas);
+
+	cout << "Flipbooks: baked " << frames << " frames of " << path << " into a " << width << "x" << height << " sheet\n";
+
+	return atlas;
+}
+
+#pragma endregion
+
+bool setupFlipbook(flipbook& book, GLuint atlas, const vector<flipbookFrame>& table, float framesPerSecond, flipbookEnd end) {
+	book = flipbook();
+
+	if (!flipbookProgram || !atlas || table.empty() || table.size() > MAX_FLIPBOOK_FRAMES || framesPerSecond <= 0.0f) {
+
+		cout << "Flipbooks: a flipbook needs the renderer set up, an atlas and 1 - " << MAX_FLIPBOOK_FRAMES << " frames\n";
+		return false;
+	}
+
+	book.atlas = atlas;
+	book.frames = unsigned(table.size());
+	book.framesPerSecond = framesPerSecond;
+	book.end = end;
+
+	// std140 arrays of vec4 are tightly packed, so the table goes in as it is
+	glGenBuffers(1, &book.frameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, book.frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_FLIPBOOK_FRAMES * sizeof(flipbookFrame), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, table.size() * sizeof(flipbookFrame), &table[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// the instance buffer is made when the first copy is drawn
+	glGenBuffers(1, &book.instanceBuffer);
+	glGenVertexArrays(1, &book.drawVAO);
+
+	return true;
+}
+
+void playFlipbook(flipbook& book, const flipbookInstance& instance) {
+	if (book.frames == 0)
+		return;
+
+	float duration = float(book.frames) / book.framesPerSecond;
+	float finished = instance.startTime + duration;
+
+	if (book.instances.empty() || finished < book.nextExpiry)
+		book.nextExpiry = finished;
+
+	book.instances.push_back(instance);
+	book.played++;
+
+	// everywhere it can be from the first frame to where it comes to rest
+	float startHalfWidth = instance.halfWidth * ((instance.startScale > 1.0f) ? instance.startScale : 1.0f);
+	float startHalfHeight = instance.halfHeight * ((instance.startScale > 1.0f) ? instance.startScale : 1.0f);
+	float endX = instance.x + instance.velocityX * duration, endY = instance.y + instance.velocityY * duration;
+
+	spatialBounds b;
+
+	b.minX = ((instance.x < endX) ? instance.x : endX) - startHalfWidth;
+	b.minY = ((instance.y < endY) ? instance.y : endY) - startHalfHeight;
+	b.maxX = ((instance.x > endX) ? instance.x : endX) + startHalfWidth;
+	b.maxY = ((instance.y > endY) ? instance.y : endY) + startHalfHeight;
+
+	if (book.animatingUntil < instance.startTime) {
+
+		book.reach = b;
+
+	} else {
+
+		book.reach.minX = (b.minX < book.reach.minX) ? b.minX : book.reach.minX;
+		book.reach.minY = (b.minY < book.reach.minY) ? b.minY : book.reach.minY;
+		book.reach.maxX = (b.maxX > book.reach.maxX) ? b.maxX : book.reach.maxX;
+		book.reach.maxY = (b.maxY > book.reach.maxY) ? b.maxY : book.reach.maxY;
+	}
+
+	// looping copies keep changing for good
+	float until = (book.end == FLIPBOOK_LOOP) ? FLT_MAX : finished;
+
+	book.animatingUntil = (until > book.animatingUntil) ? until : book.animatingUntil;
+}
+
+// Drop the hidden copies that have finished by time and work out when the next one will
+static void dropFinishedCopies(flipbook& book, float time) {
+	float duration = float(book.frames) / book.framesPerSecond;
+	size_t kept = 0;
+
+	book.nextExpiry = FLT_MAX;
+
+	for (size_t i = 0; i < book.instances.size(); ++i) {
+
+		float finished = book.instances[i].startTime + duration;
+
+		if (finished <= time)
+			continue;
+
+		book.nextExpiry = (finished < book.nextExpiry) ? finished : book.nextExpiry;
+		book.instances[kept++] = book.instances[i];
+	}
+
+	book.instances.resize(kept);
+
+	// everything left has to go up again
+	book.uploaded = 0;
+}
+
+// Bring the instance buffer up to date - only copies added since the last draw are sent, unless the buffer has to grow
+static void uploadCopies(flipbook& book) {
+	size_t count = book.instances.size();
+
+	if (book.uploaded == count)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, book.instanceBuffer);
+
+	if (count > book.bufferCapacity) {
+
+		book.bufferCapacity = (count > book.bufferCapacity * 2) ? count : book.bufferCapacity * 2;
+		book.uploaded = 0;
+
+		glBufferData(GL_ARRAY_BUFFER, book.bufferCapacity * sizeof(flipbookInstance), NULL, GL_DYNAMIC_DRAW);
+
+		// (re)point the attributes at the new storage
+		glBindVertexArray(book.drawVAO);
+
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(flipbookInstance), (const GLvoid*)offsetof(flipbookInstance, x));
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(flipbookInstance), (const GLvoid*)offsetof(flipbookInstance, halfWidth));
+
+		for (GLuint a = 0; a < 2; ++a) {
+
+			glEnableVertexAttribArray(a);
+			glVertexAttribDivisor(a, 1);
+		}
+
+		glBindVertexArray(0);
+	}
+
+	glBufferSubData(GL_ARRAY_BUFFER, book.uploaded * sizeof(flipbookInstance), (count - book.uploaded) * sizeof(flipbookInstance), &book.instances[book.uploaded]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	book.uploaded = count;
+}
+
+void drawFlipbook(flipbook& book, float time) {
+	if (book.frames == 0)
+		return;
+
+	if (book.end == FLIPBOOK_HIDE && !book.instances.empty() && time >= book.nextExpiry)
+		dropFinishedCopies(book, time);
+
+	uploadCopies(book);
+
+	book.lastDrawn = unsigned(book.instances.size());
+
+	if (book.instances.empty())
+		return;
+
+	glUseProgram(flipbookProgram);
+	glUniform1f(timeUniform, time);
+	glUniform1f(framesPerSecondUniform, book.framesPerSecond);
+	glUniform1i(frameCountUniform, GLint(book.frames));
+	glUniform1i(endModeUniform, GLint(book.end));
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FLIPBOOK_FRAME_BINDING, book.frameBuffer);
+
+	glActiveTexture(GL_TEXTURE0 + FLIPBOOK_ATLAS_UNIT);
+	glBindTexture(GL_TEXTURE_2D, book.atlas);
+
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	glBindVertexArray(book.drawVAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(book.instances.size()));
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
+
+bool flipbookBounds(const flipbook& book, float time, float timeStep, spatialBounds *bounds) {
+	// a copy that finished during the last frame step still has to be erased this frame
+	if (book.instances.empty() || time - timeStep > book.animatingUntil)
+		return false;
+
+	*bounds = book.reach;
+
+	return true;
+}
+
+void watchFlipbookShaders(void) {
+	const char *paths[] = { FLIPBOOK_VS_PATH, FLIPBOOK_FS_PATH };
+	vector<string> files;
+
+	for (int i = 0; i < 2; ++i) {
+
+		files.push_back(paths[i]);
+
+		getShaderSource(paths[i]);
+		shaderSourceDependencies(paths[i], files);
+	}
+
+	releaseShaderSourceMappings();
+
+	for (size_t i = 0; i < files.size(); ++i)
+		watchAssetFile(files[i]);
+}
+
+bool reloadFlipbookShaders(const string& path) {
+	if (!flipbookProgram || (!shaderSourceDependsOn(FLIPBOOK_VS_PATH, path) && !shaderSourceDependsOn(FLIPBOOK_FS_PATH, path)))
+		return false;
+
+	// rebuilt in place, so a broken edit leaves the working program running - it may still have been relinked, so look the uniforms up again either way
+	reloadShaders(&flipbookProgram, FLIPBOOK_VS_PATH, FLIPBOOK_FS_PATH, flipbookDefines());
+	getFlipbookUniforms();
+
+	releaseShaderSourceMappings();
+
+	return true;
+}
+
+void reportFlipbookStats(const flipbook& book) {
+	if (book.frames == 0) {
+
+		cout << "Flipbooks: off\n";
+		return;
+	}
+
+	cout << "Flipbooks: " << book.frames << " frames at " << book.framesPerSecond << " per second, " << book.lastDrawn << " copies drawn in one call, " << book.played << " played\n";
+}
@@ -0,0 +1,88 @@
+//
+// Flipbook animation.  A flipbook's frames are packed into one atlas texture, with a table of each frame's rectangle in it kept in a uniform buffer.  Every playing copy of a flipbook is an instance holding where it is and when it started, and the vertex shader works out each copy's frame, the cross-fade into the next frame, its growth and its drift from a time uniform.  So once a copy has started it costs no CPU time, and all the copies of a flipbook are one instanced draw however many are playing
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <string>
+#include <vector>
+#include "spatial_hash.h"
+
+// Frames a flipbook can have.  Shaders see this as MAX_FLIPBOOK_FRAMES
+#define MAX_FLIPBOOK_FRAMES			64
+
+// Uniform buffer binding point for the frame table (FRAME_TRANSFORM_BINDING is 0)
+#define FLIPBOOK_FRAME_BINDING		1
+
+// What a copy does after its last frame
+enum flipbookEnd {
+	FLIPBOOK_HIDE = 0,
+	FLIPBOOK_HOLD = 1, // stays on the last frame
+	FLIPBOOK_LOOP = 2 // starts again from the first frame (it only grows and drifts the first time through)
+};
+
+// Where a frame is in the atlas.  (u0, v0) is the bottom left corner of the frame and (u1, v1) the top right
+struct flipbookFrame {
+	float		u0, v0, u1, v1;
+};
+
+// A playing copy of a flipbook.  Per-instance attributes 0 - 1 of the flipbook program
+struct flipbookInstance {
+	float		x, y; // centre when it starts
+	float		velocityX, velocityY; // drift per second while it plays its frames
+	float		halfWidth, halfHeight; // at full size
+	float		startScale; // size on the first frame, growing to full size by the last
+	float		startTime; // seconds, on the clock passed to drawFlipbook
+};
+
+struct flipbook {
+	GLuint							atlas = 0;
+	GLuint							frameBuffer = 0; // the frame table (std140 vec4s)
+	unsigned						frames = 0; // 0 if the flipbook couldn't be set up
+	float							framesPerSecond = 0.0f;
+	flipbookEnd						end = FLIPBOOK_HIDE;
+
+	std::vector<flipbookInstance>	instances;
+	GLuint							instanceBuffer = 0, drawVAO = 0;
+	size_t							bufferCapacity = 0, uploaded = 0; // instances the buffer holds / has been given
+	float							nextExpiry = 0.0f; // the earliest a hidden copy can be dropped (FLIPBOOK_HIDE)
+
+	spatialBounds					reach; // everywhere the copies still animating can cover
+	float							animatingUntil = -1.0f; // when the last of them reaches its final frame (or forever, looping)
+
+	unsigned						played = 0;
+	unsigned						lastDrawn = 0;
+};
+
+// Build the program every flipbook draws with (Shaders\flipbook_vert.glsl and flipbook_frag.glsl).  Returns false if it doesn't build
+bool setupFlipbookRenderer(void);
+
+// Frame rectangles for a sheet of width x height texels cut into columns across and as many rows as it takes, with frame 0 at the top left and the frames running left to right.  Each rectangle is inset by half a texel so filtering never reaches into the next frame.  The image is taken to be bottom row first, as fiLoadTexture uploads it
+void flipbookGrid(unsigned width, unsigned height, unsigned columns, unsigned frames, std::vector<flipbookFrame>& table);
+
+// Load an image that is already a sheet of frames (see flipbookGrid).  Returns the atlas texture, or 0 if the image doesn't load
+GLuint loadFlipbookSheet(const char *path, unsigned loadFlags, unsigned columns, unsigned frames, std::vector<flipbookFrame>& table);
+
+// Make a sheet of frames from one still image: a slow turn, cooling from white hot and thinning out over the frames.  Each frame is frameWidth texels wide, with the image's aspect.  Returns the atlas texture, or 0 if the image doesn't load
+GLuint bakeFlipbookSheet(const char *path, unsigned loadFlags, unsigned frames, unsigned frameWidth, std::vector<flipbookFrame>& table);
+
+// Make a flipbook from an atlas and its frame table (the flipbook takes the atlas).  Returns false if the table is empty or longer than MAX_FLIPBOOK_FRAMES, or the renderer isn't set up
+bool setupFlipbook(flipbook& book, GLuint atlas, const std::vector<flipbookFrame>& table, float framesPerSecond, flipbookEnd end);
+
+// Start a copy.  Nothing more is needed per frame
+void playFlipbook(flipbook& book, const flipbookInstance& instance);
+
+// Draw every copy as it is at time (seconds), with premultiplied alpha blending, leaving no program, VAO or blending active.  The only CPU work is uploading copies started since the last draw and, with FLIPBOOK_HIDE, dropping copies that have finished
+void drawFlipbook(flipbook& book, float time);
+
+// A box around the copies that are animating at time or were at the frame before it, timeStep earlier - so the frame a hidden copy disappears on is covered too.  Returns false if none are
+bool flipbookBounds(const flipbook& book, float time, float timeStep, spatialBounds *bounds);
+
+// Watch the flipbook shaders and everything they include with the asset watcher
+void watchFlipbookShaders(void);
+
+// Rebuild the program in place if path is one of its shaders or a file they include.  Returns true if it was rebuilt
+bool reloadFlipbookShaders(const std::string& path);
+
+void reportFlipbookStats(const flipbook& book);
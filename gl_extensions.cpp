@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "gl_extensions.h"
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+#ifdef GLEXT_LOAD_ARB_bindless_texture
+PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB = NULL;
+PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB = NULL;
+PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB = NULL;
+PFNGLUNIFORMHANDLEUI64ARBPROC glUniformHandleui64ARB = NULL;
+#endif
+
+#ifdef GLEXT_LOAD_KHR_parallel_shader_compile
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR = NULL;
+#endif
+
+#ifdef GLEXT_LOAD_ARB_compute_shader
+PFNGLDISPATCHCOMPUTEPROC glDispatchCompute = NULL;
+PFNGLDISPATCHCOMPUTEINDIRECTPROC glDispatchComputeIndirect = NULL;
+#endif
+
+#ifdef GLEXT_LOAD_ARB_buffer_storage
+PFNGLBUFFERSTORAGEPROC glBufferStorage = NULL;
+#endif
+
+bool glextBindlessTexture = false;
+bool glextParallelShaderCompile = false;
+bool glextComputeShader = false;
+bool glextBufferStorage = false;
+
+// freeglut already knows how to find entry points on each platform (wglGetProcAddress / glXGetProcAddress)
+template <class T>
+static bool loadProc(T *proc, const char *name) {
+	*proc = (T)glutGetProcAddress(name);
+	return *proc != NULL;
+}
+
+bool hasGLExtension(const char *name) {
+	GLint noofExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &noofExtensions);
+
+	for (GLint i = 0; i < noofExtensions; ++i) {
+
+		const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void loadGLExtensions(void) {
+	glextBindlessTexture = hasGLExtension("GL_ARB_bindless_texture");
+
+#ifdef GLEXT_LOAD_ARB_bindless_texture
+	if (glextBindlessTexture) {
+
+		glextBindlessTexture = loadProc(&glGetTextureHandleARB, "glGetTextureHandleARB")
+			&& loadProc(&glMakeTextureHandleResidentARB, "glMakeTextureHandleResidentARB")
+			&& loadProc(&glMakeTextureHandleNonResidentARB, "glMakeTextureHandleNonResidentARB")
+			&& loadProc(&glUniformHandleui64ARB, "glUniformHandleui64ARB");
+	}
+#endif
+
+	cout << "GL_ARB_bindless_texture " << (glextBindlessTexture ? "supported" : "not supported") << "\n";
+
+	glextParallelShaderCompile = hasGLExtension("GL_KHR_parallel_shader_compile");
+
+#ifdef GLEXT_LOAD_KHR_parallel_shader_compile
+	if (glextParallelShaderCompile)
+		glextParallelShaderCompile = loadProc(&glMaxShaderCompilerThreadsKHR, "glMaxShaderCompilerThreadsKHR");
+#endif
+
+	// let the driver pick the number of compiler threads (0xFFFFFFFF = implementation maximum)
+	if (glextParallelShaderCompile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	cout << "GL_KHR_parallel_shader_compile " << (glextParallelShaderCompile ? "supported" : "not supported") << "\n";
+
+	// core versions of the groups below, where drivers needn't list them as extensions
+	GLint majorVersion = 0, minorVersion = 0;
+
+	glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+	glextComputeShader = (majorVersion > 4 || (majorVersion == 4 && minorVersion >= 3))
+		|| (hasGLExtension("GL_ARB_compute_shader") && hasGLExtension("GL_ARB_shader_storage_buffer_object"));
+
+#ifdef GLEXT_LOAD_ARB_compute_shader
+	if (glextComputeShader) {
+
+		glextComputeShader = loadProc(&glDispatchCompute, "glDispatchCompute")
+			&& loadProc(&glDispatchComputeIndirect, "glDispatchComputeIndirect");
+	}
+#endif
+
+	cout << "GL_ARB_compute_shader " << (glextComputeShader ? "supported" : "not supported") << "\n";
+
+	glextBufferStorage = (majorVersion > 4 || (majorVersion == 4 && minorVersion >= 4)) || hasGLExtension("GL_ARB_buffer_storage");
+
+#ifdef GLEXT_LOAD_ARB_buffer_storage
+	if (glextBufferStorage)
+		glextBufferStorage = loadProc(&glBufferStorage, "glBufferStorage");
+#endif
+
+	cout << "GL_ARB_buffer_storage " << (glextBufferStorage ? "supported" : "not supported") << "\n";
+}
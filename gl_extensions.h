@@ -0,0 +1,102 @@
+//
+// OpenGL entry points and tokens that are newer than the bundled GLEW headers.  They are loaded through freeglut after glewInit, and each group has a flag reporting whether the driver supports it
+//
+
+#pragma once
+
+#include <glew\glew.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#pragma region GL_ARB_bindless_texture
+
+#ifndef GL_ARB_bindless_texture
+#define GL_ARB_bindless_texture		1
+#define GLEXT_LOAD_ARB_bindless_texture
+
+typedef GLuint64 (APIENTRY *PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRY *PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRY *PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRY *PFNGLUNIFORMHANDLEUI64ARBPROC)(GLint location, GLuint64 value);
+
+extern PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB;
+extern PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB;
+extern PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB;
+extern PFNGLUNIFORMHANDLEUI64ARBPROC glUniformHandleui64ARB;
+#endif
+
+#pragma endregion
+
+#pragma region GL_KHR_parallel_shader_compile
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile		1
+#define GLEXT_LOAD_KHR_parallel_shader_compile
+
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR		0x91B0
+#define GL_COMPLETION_STATUS_KHR				0x91B1
+
+typedef void (APIENTRY *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+#endif
+
+#pragma endregion
+
+#pragma region GL_ARB_compute_shader / GL_ARB_shader_storage_buffer_object
+
+#ifndef GL_ARB_compute_shader
+#define GL_ARB_compute_shader		1
+#define GLEXT_LOAD_ARB_compute_shader
+
+#define GL_COMPUTE_SHADER						0x91B9
+#define GL_DISPATCH_INDIRECT_BUFFER				0x90EE
+
+typedef void (APIENTRY *PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRY *PFNGLDISPATCHCOMPUTEINDIRECTPROC)(GLintptr indirect);
+
+extern PFNGLDISPATCHCOMPUTEPROC glDispatchCompute;
+extern PFNGLDISPATCHCOMPUTEINDIRECTPROC glDispatchComputeIndirect;
+#endif
+
+#ifndef GL_ARB_shader_storage_buffer_object
+#define GL_ARB_shader_storage_buffer_object		1
+
+#define GL_SHADER_STORAGE_BUFFER				0x90D2
+#define GL_SHADER_STORAGE_BARRIER_BIT			0x00002000
+#define GL_MAX_SHADER_STORAGE_BLOCK_SIZE		0x90DE
+#endif
+
+#pragma endregion
+
+#pragma region GL_ARB_buffer_storage
+
+#ifndef GL_ARB_buffer_storage
+#define GL_ARB_buffer_storage		1
+#define GLEXT_LOAD_ARB_buffer_storage
+
+#define GL_MAP_PERSISTENT_BIT					0x0040
+#define GL_MAP_COHERENT_BIT						0x0080
+#define GL_DYNAMIC_STORAGE_BIT					0x0100
+#define GL_CLIENT_STORAGE_BIT					0x0200
+
+typedef void (APIENTRY *PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+extern PFNGLBUFFERSTORAGEPROC glBufferStorage;
+#endif
+
+#pragma endregion
+
+// Driver support for the extension groups above (valid after loadGLExtensions)
+extern bool glextBindlessTexture;
+extern bool glextParallelShaderCompile;
+extern bool glextComputeShader; // compute shaders and shader storage buffers (core in GL 4.3)
+extern bool glextBufferStorage; // immutable buffers that can stay mapped while the GPU reads them (core in GL 4.4)
+
+// Load the entry points above and fill in the support flags.  Call once after glewInit
+void loadGLExtensions(void);
+
+// Return true if the current context advertises the named extension
+bool hasGLExtension(const char *name);
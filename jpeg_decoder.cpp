@@ -0,0 +1,215 @@
+#include "stdafx.h"
+#include "jpeg_decoder.h"
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+
+#ifdef __CG_USE_LIBJPEG_TURBO___
+#include <libjpeg-turbo\turbojpeg.h>
+#pragma comment(lib, "libjpeg-turbo\\turbojpeg-static.lib")
+#endif
+
+using namespace std;
+
+static bool isJPEG(const char *filename) {
+	string name(filename);
+	size_t dot = name.find_last_of('.');
+
+	if (dot == string::npos)
+		return false;
+
+	string ext = name.substr(dot + 1);
+
+	for (size_t i = 0; i < ext.size(); ++i)
+		ext[i] = (char)tolower(ext[i]);
+
+	return ext == "jpg" || ext == "jpeg";
+}
+
+// Smallest power of two denominator (up to 8) whose scaled size still covers the target
+static unsigned scaleDenominator(unsigned width, unsigned height, unsigned targetWidth, unsigned targetHeight) {
+	unsigned denom = 1;
+
+	while (denom < 8) {
+
+		unsigned next = denom * 2;
+		unsigned w = (width + next - 1) / next;
+		unsigned h = (height + next - 1) / next;
+
+		if ((targetWidth && w < targetWidth) || (targetHeight && h < targetHeight) || (!targetWidth && !targetHeight))
+			break;
+
+		denom = next;
+	}
+
+	return denom;
+}
+
+#ifdef __CG_USE_LIBJPEG_TURBO___
+
+fipImage *tjDecodeImage(const char *filename, unsigned targetWidth, unsigned targetHeight) {
+	FILE *file = fopen(filename, "rb");
+
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	vector<unsigned char> jpeg(fileSize > 0 ? fileSize : 0);
+	size_t bytesRead = jpeg.empty() ? 0 : fread(jpeg.data(), 1, jpeg.size(), file);
+
+	fclose(file);
+
+	if (bytesRead != jpeg.size() || jpeg.empty())
+		return NULL;
+
+	tjhandle decoder = tjInitDecompress();
+
+	if (!decoder)
+		return NULL;
+
+	int width = 0, height = 0, subsampling = 0, colourspace = 0;
+	fipImage *I = NULL;
+
+	if (tjDecompressHeader3(decoder, jpeg.data(), (unsigned long)jpeg.size(), &width, &height, &subsampling, &colourspace) == 0) {
+
+		unsigned denom = scaleDenominator(width, height, targetWidth, targetHeight);
+		unsigned w = (width + denom - 1) / denom;
+		unsigned h = (height + denom - 1) / denom;
+
+		// decode straight into a FreeImage bitmap so the rest of the loader (format selection, colour keying, upload) is shared.  TJFLAG_BOTTOMUP matches FreeImage's row order
+		I = new fipImage();
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		const int pixelFormat = TJPF_BGR;
+#else
+		const int pixelFormat = TJPF_RGB;
+#endif
+
+		if (!I->setSize(FIT_BITMAP, w, h, 24) || tjDecompress2(decoder, jpeg.data(), (unsigned long)jpeg.size(), I->accessPixels(), w, I->getScanWidth(), h, pixelFormat, TJFLAG_BOTTOMUP | TJFLAG_FASTDCT) != 0) {
+
+			cout << "libjpeg-turbo: " << tjGetErrorStr() << "\n";
+
+			delete I;
+			I = NULL;
+		}
+	}
+
+	tjDestroy(decoder);
+
+	return I;
+}
+
+#endif
+
+fipImage *decodeImageScaled(const char *filename, unsigned targetWidth, unsigned targetHeight, bool *converted) {
+	if (!isJPEG(filename) || (targetWidth == 0 && targetHeight == 0))
+		return fiDecodeImage(filename, converted);
+
+#ifdef __CG_USE_LIBJPEG_TURBO___
+	fipImage *I = tjDecodeImage(filename, targetWidth, targetHeight);
+
+	if (!I)
+		return NULL;
+#else
+	// FreeImage's JPEG plugin takes a size hint in the upper 16 bits of the load flags and picks the smallest DCT scale whose larger side is at least that size.  That ignores the shorter side, so work the scale out from the header (as tjDecodeImage does) and hint the larger side at that scale
+	fipImage header;
+	unsigned sizeHint = 0;
+
+	if (header.load(filename, FIF_LOAD_NOPIXELS)) {
+
+		unsigned width = header.getWidth(), height = header.getHeight();
+		unsigned denom = scaleDenominator(width, height, targetWidth, targetHeight);
+
+		sizeHint = ((width > height ? width : height) + denom - 1) / denom;
+	}
+
+	fipImage *I = new fipImage();
+
+	if (!I->load(filename, JPEG_DEFAULT | int(sizeHint << 16))) {
+
+		cout << "FreeImagePlus: Cannot open image file.\n";
+
+		delete I;
+		return NULL;
+	}
+#endif
+
+	// greyscale JPEGs come out palettised, which GL can't take directly
+	if (!fiMakeUploadable(*I, converted)) {
+
+		delete I;
+		return NULL;
+	}
+
+	return I;
+}
+
+#pragma region benchmark
+
+static void timeDecoder(const char *label, const char *filename, unsigned target, fipImage *(*decode)(const char*, unsigned, unsigned)) {
+	const int iterations = 20;
+
+	size_t decodedBytes = 0;
+	unsigned w = 0, h = 0;
+
+	auto start = chrono::high_resolution_clock::now();
+
+	for (int n = 0; n < iterations; ++n) {
+
+		fipImage *I = decode(filename, target, target);
+
+		if (!I)
+			return;
+
+		w = I->getWidth();
+		h = I->getHeight();
+		decodedBytes += size_t(I->getScanWidth()) * h;
+
+		delete I;
+	}
+
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	cout << "  " << label << " " << filename << " -> " << w << "x" << h << ": " << (decodedBytes / 1e6) / seconds << " MB/s, " << seconds * 1000.0 / iterations << " ms per image\n";
+}
+
+static fipImage *decodeFreeImageFull(const char *filename, unsigned, unsigned) {
+	return fiDecodeImage(filename);
+}
+
+static fipImage *decodeScaled(const char *filename, unsigned targetWidth, unsigned targetHeight) {
+	return decodeImageScaled(filename, targetWidth, targetHeight);
+}
+
+void jpegDecodeBenchmark(void) {
+	const char *files[] = { "Assets\\sky.jpg", "Assets\\ground.jpg", "Assets\\grass.jpg", "Assets\\explosion.jpg", "Assets\\cloud.jpg" };
+
+#ifdef __CG_USE_LIBJPEG_TURBO___
+	cout << "JPEG decode benchmark (scaled decoder: libjpeg-turbo)\n";
+#else
+	cout << "JPEG decode benchmark (scaled decoder: FreeImage size hint)\n";
+#endif
+
+	for (const char *file : files) {
+
+		timeDecoder("FreeImage full size", file, 0, decodeFreeImageFull);
+
+		// target sizes roughly 1/2, 1/4 and 1/8 of an 800 pixel window
+		unsigned targets[] = { 400, 200, 100 };
+
+		for (unsigned target : targets) {
+
+			string label = "scaled (target " + to_string(target) + ")";
+			timeDecoder(label.c_str(), file, target, decodeScaled);
+		}
+	}
+
+	cout << "\n";
+}
+
+#pragma endregion
@@ -0,0 +1,21 @@
+//
+// Scaled JPEG decoding.  Small on-screen images don't need a full resolution decode - JPEG can be decoded at 1/2, 1/4 or 1/8 scale directly in the DCT domain, which skips most of the IDCT and colour conversion work.  When libjpeg-turbo is available its SIMD decoder is used, otherwise FreeImage's own (libjpeg) scaled decode
+//
+
+#pragma once
+
+// Note: Uncomment this to decode JPEGs with libjpeg-turbo.  Requires Libs\libjpeg-turbo\turbojpeg.h and turbojpeg-static.lib
+//#define __CG_USE_LIBJPEG_TURBO___		1
+
+class fipImage;
+
+// Decode an image, downscaling JPEGs in the DCT domain to the smallest 1/1, 1/2, 1/4 or 1/8 scale that still covers targetWidth x targetHeight pixels (0 = no limit in that direction).  Non-JPEG files are decoded at full size.  The result goes through the same format check as fiDecodeImage so it can go straight to fiUploadImage.  Returns NULL on failure.  converted is set if a full-image format conversion was needed
+fipImage *decodeImageScaled(const char *filename, unsigned targetWidth, unsigned targetHeight, bool *converted = NULL);
+
+#ifdef __CG_USE_LIBJPEG_TURBO___
+// libjpeg-turbo decoder used by decodeImageScaled for JPEG files
+fipImage *tjDecodeImage(const char *filename, unsigned targetWidth, unsigned targetHeight);
+#endif
+
+// Time each decoder over the scene's JPEG assets at every scale and print the decode rate in MB/s of decoded pixels
+void jpegDecodeBenchmark(void);
@@ -0,0 +1,76 @@
+#include "stdafx.h"
+#include "layer_cache.h"
+#include <iostream>
+
+using namespace std;
+
+bool resizeLayerCache(layerCache& cache, int width, int height) {
+	if (!cache.framebuffer) {
+
+		glGenFramebuffers(1, &cache.framebuffer);
+		glGenTextures(1, &cache.colourTexture);
+	}
+
+	cache.valid = false;
+	cache.width = 0;
+	cache.height = 0;
+
+	if (width <= 0 || height <= 0)
+		return false;
+
+	// same format as the window, so blending into the cache gives the same result as blending into the window
+	glBindTexture(GL_TEXTURE_2D, cache.colourTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, cache.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cache.colourTexture, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+
+		cout << "Layer cache: framebuffer incomplete (0x" << hex << status << dec << "), layers will be drawn every frame\n";
+		return false;
+	}
+
+	cache.width = width;
+	cache.height = height;
+
+	return true;
+}
+
+void invalidateLayerCache(layerCache& cache) {
+	cache.valid = false;
+}
+
+void beginLayerCache(layerCache& cache, bool clear) {
+	glBindFramebuffer(GL_FRAMEBUFFER, cache.framebuffer);
+	glViewport(0, 0, cache.width, cache.height);
+
+	if (clear)
+		glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void endLayerCache(layerCache& cache, GLuint nextFramebuffer) {
+	glBindFramebuffer(GL_FRAMEBUFFER, nextFramebuffer);
+
+	cache.valid = true;
+	cache.renders++;
+}
+
+void compositeLayerCache(layerCache& cache, GLuint targetFramebuffer) {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, cache.framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+
+	// blits are clipped by the scissor test like draws, so a partial redraw only copies the rectangle being repaired
+	glBlitFramebuffer(0, 0, cache.width, cache.height, 0, 0, cache.width, cache.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+	cache.composites++;
+}
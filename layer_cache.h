@@ -0,0 +1,28 @@
+//
+// Offscreen layer cache.  Layers that look the same from frame to frame are drawn once into a texture attached to a framebuffer object, and each frame after that they reach the screen with a single framebuffer blit instead of being redrawn and re-blended.  The owner decides when the cached image is stale and invalidates it
+//
+
+#pragma once
+
+#include <glew\glew.h>
+
+struct layerCache {
+	GLuint			framebuffer, colourTexture;
+	int				width, height; // 0 until the first resizeLayerCache
+	bool			valid; // the texture holds the current image
+
+	unsigned		renders, composites; // times the layers were drawn into the cache / copied out of it
+};
+
+// (Re)create the cache at the window size.  The cache is invalid afterwards.  Returns false (leaving width at 0) if the framebuffer can't be created
+bool resizeLayerCache(layerCache& cache, int width, int height);
+
+// Mark the cached image as stale so the layers are drawn again on the next frame
+void invalidateLayerCache(layerCache& cache);
+
+// Redirect drawing into the cache, clearing it to the clear colour unless only part of it is being redrawn.  endLayerCache goes back to nextFramebuffer (0 = the window) and marks the cache valid
+void beginLayerCache(layerCache& cache, bool clear = true);
+void endLayerCache(layerCache& cache, GLuint nextFramebuffer = 0);
+
+// Copy the cached image over the whole of targetFramebuffer (0 = the window), or just the scissor rectangle if the scissor test is on.  targetFramebuffer is left bound
+void compositeLayerCache(layerCache& cache, GLuint targetFramebuffer = 0);
@@ -1,11 +1,32 @@
 #include "stdafx.h"
 #include "main.h";
 #include "draw_scene.h";
-
-//GLOBAL: used to store the deltaX position of the cloud
+#include "pixel_convert.h"
+#include "asset_watcher.h"
+#include "gl_extensions.h"
+#include "jpeg_decoder.h"
+#include "shader_variants.h"
+#include "transform_buffer.h"
+#include "scene_graph.h"
+#include "render_queue.h"
+#include "spatial_hash.h"
+#include "tile_world.h"
+#include "command_list.h"
+#include "thread_pool.h"
+#include "cpu_particles.h"
+#include "animation_curves.h"
+#include "collision_world.h"
+#include "self_tests.h"
+
+//GLOBAL: the cloud's speed when the mouse isn't held down (replaced by the scene file's value)
 float cloudDeltaX = 0.003f;
 
 int _tmain(int argc, char* argv[]) {
+	//"--test" runs the self tests without opening a window, failing if any check does
+	if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+		return (runSelfTests() == 0) ? 0 : 1;
+	}
+
 	init(argc, argv);
 	glutMainLoop();
 
@@ -30,8 +51,11 @@ void init(int argc, char* argv[]) {
 	// Display callback
 	glutDisplayFunc(display);
 	glutIdleFunc(update);
+	glutReshapeFunc(reshape);
 	glutKeyboardFunc(keyDown);
+	glutSpecialFunc(specialKeyDown);
 	glutMouseFunc(mouseButtonDown);
+	glutMouseWheelFunc(mouseWheel);
 
 	// 2. Initialise GLEW library
 	GLenum err = glewInit();
@@ -47,6 +71,9 @@ void init(int argc, char* argv[]) {
 	// Example query OpenGL state (get version number)
 	reportVersion();
 
+	// Load the entry points newer than the bundled GLEW
+	loadGLExtensions();
+
 	// Report maximum number of vertex attributes
 	GLint numAttributeSlots;
 	glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &numAttributeSlots);
@@ -59,19 +86,35 @@ void init(int argc, char* argv[]) {
 	//sets background colour of window to black
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-	//Setup the textures to be used
-	setupTextures();
+	//Create the buffer every object transform is uploaded through each frame
+	setupTransformBuffer();
+
+	//worker threads for preparing frames (one per core)
+	startThreadPool();
 
-	//Setup the shaders to be used
+	//Start compiling the shaders to be used - the driver builds them while the textures and objects below are set up
 	setupShaders();
 
+	//Load the scene description and the animation rates it sets
+	loadScene("Assets\\missile.scene");
+
+	cloudDeltaX = getSceneParameter("cloud.speed", cloudDeltaX);
+
+	//Setup the textures to be used
+	setupTextures();
+
 	//Setup the objects to be rendered
-	setupSkyVAO();
-	setupGroundVAO();
-	setupMissileVAO();
-	setupGrassVAO();
-	setupMissileExplosionVAO();
-	setupCloudVAO();
+	setupSceneVAOs();
+
+	//start streaming the tile world in around the camera, if the scene asks for it
+	if (getSceneParameter("world.tiles", 0.0f) != 0.0f)
+		startTileWorld(unsigned(getSceneParameter("world.seed", 1.0f)));
+
+	//Collect the compiled shaders
+	finishShaders();
+
+	//watch the asset and shader files so edits are picked up without a restart
+	startAssetWatcher();
 }
 
 void reportVersion(void) {
@@ -84,24 +127,31 @@ void reportVersion(void) {
 }
 
 void display(void) {
+	//upload any assets that changed on disk since the last frame
+	applyChangedAssets();
+
+	//lets the texture manager evict anything that has gone cold
+	textureManagerBeginFrame();
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//draw and transform the objects to screen
-	drawSkyVAO();
-	drawGroundVAO();
-	drawMissileVAO();
-	drawGrassVAO();
-	drawCloudVAO();
+	//gather every object transform for this frame and upload them in one go
+	updateSceneTransforms();
 
-	//If the missile has exploded draw the explosion image
-	if (getMissileExploded()) {
-		drawMissileExplosionVAO();
-	}
+	//draw and transform the objects to screen - the explosion only shows once it has started to grow
+	drawScene();
 
 	//encapsulates these commands and performs double buffering
 	glutSwapBuffers();
 }
 
+//keeps the camera's view the same shape as the window so nothing is stretched, and the layer cache the same size
+void reshape(int width, int height) {
+	glViewport(0, 0, width, height);
+
+	resizeScene(width, height);
+}
+
 // update is called every frame
 void update(void) {
 	if (!getMissileAtTop()) {
@@ -110,29 +160,97 @@ void update(void) {
 		moveDownMissileVAO();
 	}
 
-	//Increase the size of the explosion cloud over time
-	if (getMissileExploded() && getCurMissileExpSize() < 1.0f) {
-		setMissileExpScale(0.008f);
-	}
-
-	//changes the scale of the missile smoke over time
-	switch (getSmokeScaleDir()) {
-		case true: setSmokeScaleY(0.005f); break;
-		case false: setSmokeScaleY(-0.005f); break;
-	}
-
-	//moves the cloud over time
-	switch (getCloudDir()) {
-		case true: setCloudX(cloudDeltaX); break;
-		case false: setCloudX(cloudDeltaX * -1); break;
-	}
+	//pulses the missile smoke, moves the cloud and grows the explosion once the missile has exploded
+	animateScene();
 
 	// Redraw the screen
 	glutPostRedisplay();
 }
 
+//runs the self-checking CPU benchmarks for the engine subsystems and prints the results to the console
+void runBenchmarks(void) {
+	pixelConvertBenchmark();
+	jpegDecodeBenchmark();
+	textureLoadBenchmark();
+	transformComposeBenchmark();
+	sceneGraphBenchmark();
+	spatialHashBenchmark();
+	commandListBenchmark();
+	cpuParticleBenchmark();
+	animationCurveBenchmark();
+	collisionBenchmark();
+}
+
 #pragma region event handling
 void keyDown(unsigned char key, int x, int y) {
+	//'b' runs the CPU benchmarks at any point in the scene
+	if (tolower(key) == 'b') {
+		runBenchmarks();
+		return;
+	}
+
+	//'t' reports texture residency and loading statistics
+	if (tolower(key) == 't') {
+		reportTextureStats();
+		return;
+	}
+
+	//'v' builds every shader variant and reports any that fail to compile
+	if (tolower(key) == 'v') {
+		validateShaderVariants();
+		return;
+	}
+
+	//'r' reports the render queue's state changes for the last frame, sorted and in submission order, how many objects were culled and the state of each subsystem
+	if (tolower(key) == 'r') {
+		reportRenderQueueStats();
+		reportCullingStats();
+		reportTileWorldStats();
+		reportLayerCacheStats();
+		reportDamageStats();
+		reportParticleStats();
+		reportAnimationStats();
+		reportSceneCollisionStats();
+		return;
+	}
+
+	//'p' switches partial redraws of just the damaged parts of the window on and off
+	if (tolower(key) == 'p') {
+		setDamageTracking(!damageTracking());
+		std::cout << "Damage tracking " << (damageTracking() ? "on" : "off") << "\n";
+		return;
+	}
+
+	//'l' switches caching of the static background layers on and off
+	if (tolower(key) == 'l') {
+		setLayerCaching(!layerCaching());
+		std::cout << "Layer cache " << (layerCaching() ? "on" : "off") << "\n";
+		return;
+	}
+
+	//'+' and '-' zoom the camera in and out, 'c' puts it back on the scene
+	if (key == '+' || key == '=') {
+		zoomCamera(getSceneCamera(), 1.25f);
+		return;
+	}
+
+	if (key == '-') {
+		zoomCamera(getSceneCamera(), 0.8f);
+		return;
+	}
+
+	if (tolower(key) == 'c') {
+		resetCamera(getSceneCamera(), getSceneCamera().aspect);
+		return;
+	}
+
+	//'q' switches render queue sorting on and off
+	if (tolower(key) == 'q') {
+		setRenderQueueSorting(!renderQueueSorting());
+		std::cout << "Render queue sorting " << (renderQueueSorting() ? "on" : "off") << "\n";
+		return;
+	}
+
 	//check if the missile has already exploded
 	if (!getMissileExploded()) {
 		std::cout << key << " pressed\n";
@@ -146,14 +264,32 @@ void keyDown(unsigned char key, int x, int y) {
 	}
 }
 
+//the arrow keys pan the camera a tenth of the view at a time
+void specialKeyDown(int key, int x, int y) {
+	switch (key) {
+		case GLUT_KEY_LEFT: panCamera(getSceneCamera(), -0.1f, 0.0f); break;
+		case GLUT_KEY_RIGHT: panCamera(getSceneCamera(), 0.1f, 0.0f); break;
+		case GLUT_KEY_UP: panCamera(getSceneCamera(), 0.0f, 0.1f); break;
+		case GLUT_KEY_DOWN: panCamera(getSceneCamera(), 0.0f, -0.1f); break;
+	}
+}
+
+//the mouse wheel zooms the camera in and out around the point under the cursor
+void mouseWheel(int wheel, int direction, int x, int y) {
+	float screenX = 2.0f * float(x) / float(glutGet(GLUT_WINDOW_WIDTH)) - 1.0f;
+	float screenY = 1.0f - 2.0f * float(y) / float(glutGet(GLUT_WINDOW_HEIGHT));
+
+	zoomCamera(getSceneCamera(), (direction > 0) ? 1.25f : 0.8f, screenX, screenY);
+}
+
 void mouseButtonDown(int button_id, int state, int x, int y) {
 	//If the mouse button is down then increase the x speed of the cloud
 	if (button_id == GLUT_LEFT_BUTTON) {
 		if (state == GLUT_DOWN) {
-			cloudDeltaX = 0.05f;
+			setCloudSpeed(0.05f);
 
 		} else if (state == GLUT_UP) {
-			cloudDeltaX = 0.003f;
+			setCloudSpeed(cloudDeltaX);
 		}
 	}
 }
@@ -4,6 +4,10 @@
 void init(int, char*[]);
 void reportVersion(void);
 void display(void);
+void reshape(int, int);
 void update(void);
+void runBenchmarks(void);
 void keyDown(unsigned char, int, int);
-void mouseButtonDown(int, int, int, int);
\ No newline at end of file
+void specialKeyDown(int, int, int);
+void mouseButtonDown(int, int, int, int);
+void mouseWheel(int, int, int, int);
\ No newline at end of file
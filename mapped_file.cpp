@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool mapFileView(const string& path, mappedFile *view) {
+	view->data = NULL;
+	view->size = 0;
+
+#if defined(_WIN32)
+
+	// share read, write and delete so other handles can still open the file - but Windows refuses to truncate or resize it while a view exists (ERROR_USER_MAPPED_FILE), so callers release their views after each batch of builds
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize)) {
+
+		CloseHandle(file);
+		return false;
+	}
+
+	view->size = size_t(fileSize.QuadPart);
+
+	// empty files cannot be mapped
+	if (view->size > 0) {
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (mapping) {
+
+			view->data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+			// the view keeps the mapping alive
+			CloseHandle(mapping);
+		}
+	}
+
+	CloseHandle(file);
+
+#else
+
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat fileStatus;
+
+	if (fstat(fd, &fileStatus) != 0) {
+
+		close(fd);
+		return false;
+	}
+
+	view->size = size_t(fileStatus.st_size);
+
+	if (view->size > 0) {
+
+		void *data = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		view->data = (data != MAP_FAILED) ? (const char*)data : NULL;
+	}
+
+	close(fd);
+
+#endif
+
+	if (view->size > 0 && !view->data) {
+
+		view->size = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void unmapFileView(mappedFile *view) {
+	if (view->data) {
+
+#if defined(_WIN32)
+		UnmapViewOfFile(view->data);
+#else
+		munmap((void*)view->data, view->size);
+#endif
+	}
+
+	view->data = NULL;
+	view->size = 0;
+}
@@ -0,0 +1,18 @@
+//
+// Read-only memory mapped views of whole files (MapViewOfFile on Windows, mmap elsewhere).  On Windows a mapped file cannot be truncated or rewritten in place, so views should be released as soon as they are consumed (see releaseShaderSourceMappings)
+//
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+struct mappedFile {
+	const char		*data; // NULL for an empty file
+	size_t			size;
+};
+
+// Map the whole of path.  Returns false if the file cannot be opened or mapped.  Empty files succeed with data = NULL
+bool mapFileView(const std::string& path, mappedFile *view);
+
+void unmapFileView(mappedFile *view);
@@ -0,0 +1,398 @@
+#include "stdafx.h"
+#include "particle_system.h"
+#include "gl_extensions.h"
+#include "shader_setup.h"
+#include "shader_source.h"
+#include "asset_watcher.h"
+#include "transform_buffer.h"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+static const char *PARTICLE_UPDATE_PATH = "Shaders\\particle_update.glsl";
+static const char *PARTICLE_EMIT_PATH = "Shaders\\particle_emit.glsl";
+static const char *PARTICLE_FINISH_PATH = "Shaders\\particle_finish.glsl";
+static const char *PARTICLE_VS_PATH = "Shaders\\particle_vert.glsl";
+static const char *PARTICLE_FS_PATH = "Shaders\\particle_frag.glsl";
+
+// buffer binding points and layouts, as declared in Shaders\particle.glsl
+static const GLuint PARTICLE_SOURCE_BINDING = 0;
+static const GLuint PARTICLE_TARGET_BINDING = 1;
+static const GLuint PARTICLE_COUNTER_BINDING = 2;
+static const GLuint PARTICLE_EMISSION_BINDING = 3;
+
+static const GLsizeiptr PARTICLE_STRIDE = 40;
+
+struct particleCounters {
+	GLuint		alive, written;
+	GLuint		updateGroups[3];
+	GLuint		drawArgs[4];
+};
+
+static const GLintptr UPDATE_GROUPS_OFFSET = offsetof(particleCounters, updateGroups);
+static const GLintptr DRAW_ARGS_OFFSET = offsetof(particleCounters, drawArgs);
+
+// sizes the shaders share with the C++ side
+static string particleDefines(void) {
+	return "#define PARTICLE_GROUP_SIZE " + to_string(PARTICLE_GROUP_SIZE) + "\n";
+}
+
+static void getParticleUniforms(particleSystem& system) {
+	system.timeStepUniform = glGetUniformLocation(system.updateProgram, "timeStep");
+	system.emissionCountUniform = glGetUniformLocation(system.emitProgram, "emissionCount");
+	system.newParticlesUniform = glGetUniformLocation(system.emitProgram, "newParticles");
+	system.emitCapacityUniform = glGetUniformLocation(system.emitProgram, "capacity");
+	system.seedUniform = glGetUniformLocation(system.emitProgram, "seed");
+	system.finishCapacityUniform = glGetUniformLocation(system.finishProgram, "capacity");
+}
+
+// delete whichever programs were built
+static void deleteParticlePrograms(particleSystem& system) {
+	GLuint programs[] = { system.updateProgram, system.emitProgram, system.finishProgram, system.drawProgram };
+
+	for (int i = 0; i < 4; ++i) {
+
+		if (programs[i])
+			glDeleteProgram(programs[i]);
+	}
+
+	system.updateProgram = system.emitProgram = system.finishProgram = system.drawProgram = 0;
+}
+
+bool setupParticleSystem(particleSystem& system, unsigned capacity) {
+	system = particleSystem();
+
+	if (!glextComputeShader) {
+
+		cout << "Particles: compute shaders are not supported\n";
+		return false;
+	}
+
+	// the whole buffer is one storage block, so it can't be bigger than the driver allows (16MB is the minimum)
+	GLint maxBlockSize = 0;
+	glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+
+	if (maxBlockSize > 0 && capacity > unsigned(maxBlockSize / PARTICLE_STRIDE))
+		capacity = unsigned(maxBlockSize / PARTICLE_STRIDE);
+
+	string defines = particleDefines();
+
+	system.updateProgram = setupComputeShader(PARTICLE_UPDATE_PATH, NULL, defines);
+	system.emitProgram = setupComputeShader(PARTICLE_EMIT_PATH, NULL, defines);
+	system.finishProgram = setupComputeShader(PARTICLE_FINISH_PATH, NULL, defines);
+	system.drawProgram = setupParticleSpriteProgram();
+
+	releaseShaderSourceMappings();
+
+	if (!system.updateProgram || !system.emitProgram || !system.finishProgram || !system.drawProgram || capacity == 0) {
+
+		cout << "Particles: the particle shaders could not be built\n";
+		deleteParticlePrograms(system);
+		return false;
+	}
+
+	getParticleUniforms(system);
+
+	// the particles, ping-ponged between two buffers.  Nothing needs initialising - only the first alive entries are ever read
+	glGenBuffers(2, system.particleBuffers);
+	glGenVertexArrays(2, system.drawVAOs);
+
+	for (int i = 0; i < 2; ++i) {
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, system.particleBuffers[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * PARTICLE_STRIDE, NULL, GL_DYNAMIC_COPY);
+
+		// position, (age, lifetime), (start size, end size), start colour and end colour, one set per instance
+		glBindVertexArray(system.drawVAOs[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, system.particleBuffers[i]);
+
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, GLsizei(PARTICLE_STRIDE), (const GLvoid*)0);
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, GLsizei(PARTICLE_STRIDE), (const GLvoid*)16);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, GLsizei(PARTICLE_STRIDE), (const GLvoid*)20);
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, GLsizei(PARTICLE_STRIDE), (const GLvoid*)24);
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, GLsizei(PARTICLE_STRIDE), (const GLvoid*)28);
+
+		for (GLuint a = 0; a < 5; ++a) {
+
+			glEnableVertexAttribArray(a);
+			glVertexAttribDivisor(a, 1);
+		}
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// no particles yet, so the first update is an empty dispatch and the first draw has no instances
+	particleCounters counters = { 0, 0, { 0, 1, 1 }, { 1, 0, 0, 0 } };
+
+	glGenBuffers(1, &system.counterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, system.counterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counters), &counters, GL_DYNAMIC_COPY);
+
+	glGenBuffers(1, &system.emissionBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, system.emissionBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_PARTICLE_EMISSIONS * sizeof(particleEmission), NULL, GL_STREAM_DRAW);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	system.capacity = capacity;
+
+	cout << "Particles: room for " << capacity << " on the GPU\n";
+
+	return true;
+}
+
+bool emitParticles(particleSystem& system, const particleEmission& emission) {
+	if (system.capacity == 0 || system.emissions.size() >= MAX_PARTICLE_EMISSIONS)
+		return false;
+
+	// more than the buffer holds would only be dropped
+	unsigned count = (emission.count < system.capacity - system.queued) ? emission.count : system.capacity - system.queued;
+
+	system.totalEmitted += emission.count;
+
+	if (count == 0)
+		return true;
+
+	particleEmission e = emission;
+
+	e.first = system.queued;
+	e.count = count;
+
+	system.emissions.push_back(e);
+	system.queued += count;
+
+	// the furthest the batch can get: flying straight out at top speed while accelerating (drag only slows particles down), plus the largest sprite
+	float speed = sqrtf(e.velocityX * e.velocityX + e.velocityY * e.velocityY) + e.speedMax;
+	float acceleration = sqrtf(e.accelerationX * e.accelerationX + e.accelerationY * e.accelerationY);
+	float size = (e.sizeStart > e.sizeEnd) ? e.sizeStart : e.sizeEnd;
+	float distance = speed * e.lifeMax + 0.5f * acceleration * e.lifeMax * e.lifeMax + size * 0.5f;
+
+	particleReach r;
+
+	r.bounds.minX = e.x - e.halfWidth - distance;
+	r.bounds.minY = e.y - e.halfHeight - distance;
+	r.bounds.maxX = e.x + e.halfWidth + distance;
+	r.bounds.maxY = e.y + e.halfHeight + distance;
+	r.expires = system.time + e.lifeMax;
+
+	system.reach.push_back(r);
+
+	return true;
+}
+
+void updateParticleSystem(particleSystem& system, float timeStep) {
+	if (system.capacity == 0)
+		return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_SOURCE_BINDING, system.particleBuffers[system.current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_TARGET_BINDING, system.particleBuffers[1 - system.current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_COUNTER_BINDING, system.counterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_EMISSION_BINDING, system.emissionBuffer);
+
+	// integrate and compact - as many groups as the last step's finish pass worked out
+	glUseProgram(system.updateProgram);
+	glUniform1f(system.timeStepUniform, timeStep);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, system.counterBuffer);
+	glDispatchComputeIndirect(UPDATE_GROUPS_OFFSET);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// new particles go in after the survivors
+	if (system.queued > 0) {
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, system.emissionBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, system.emissions.size() * sizeof(particleEmission), &system.emissions[0]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		glUseProgram(system.emitProgram);
+		glUniform1ui(system.emissionCountUniform, GLuint(system.emissions.size()));
+		glUniform1ui(system.newParticlesUniform, system.queued);
+		glUniform1ui(system.emitCapacityUniform, system.capacity);
+		glUniform1ui(system.seedUniform, system.steps + 1);
+
+		glDispatchCompute((system.queued + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// the target buffer becomes the source, with the next update and the draw sized to it
+	glUseProgram(system.finishProgram);
+	glUniform1ui(system.finishCapacityUniform, system.capacity);
+
+	glDispatchCompute(1, 1, 1);
+
+	// the draw reads the counters as indirect arguments and the particles as vertex attributes
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	glUseProgram(0);
+
+	system.current = 1 - system.current;
+	system.time += timeStep;
+	system.steps++;
+	system.lastEmitted = system.queued;
+
+	system.emissions.clear();
+	system.queued = 0;
+
+	// particles emitted more than a step before their lifetime was up are all gone from what was last drawn
+	size_t kept = 0;
+
+	for (size_t i = 0; i < system.reach.size(); ++i) {
+
+		if (system.reach[i].expires + timeStep >= system.time)
+			system.reach[kept++] = system.reach[i];
+	}
+
+	system.reach.resize(kept);
+}
+
+void drawParticleSystem(const particleSystem& system, float pointScale) {
+	if (system.capacity == 0)
+		return;
+
+	beginParticleSprites(system.drawProgram, pointScale);
+
+	glBindVertexArray(system.drawVAOs[system.current]);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, system.counterBuffer);
+
+	glDrawArraysIndirect(GL_POINTS, (const GLvoid*)DRAW_ARGS_OFFSET);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	endParticleSprites();
+}
+
+GLuint setupParticleSpriteProgram(void) {
+	GLuint program = setupShaders(PARTICLE_VS_PATH, PARTICLE_FS_PATH);
+
+	if (program)
+		bindTransformBlock(program);
+
+	return program;
+}
+
+bool reloadParticleSpriteProgram(GLuint *program, const string& path) {
+	if (!shaderSourceDependsOn(PARTICLE_VS_PATH, path) && !shaderSourceDependsOn(PARTICLE_FS_PATH, path))
+		return false;
+
+	// a failed relink still relinks the old shaders, which resets the block binding - so bind it again either way
+	reloadShaders(program, PARTICLE_VS_PATH, PARTICLE_FS_PATH);
+
+	if (*program)
+		bindTransformBlock(*program);
+
+	return true;
+}
+
+void beginParticleSprites(GLuint program, float pointScale) {
+	glUseProgram(program);
+	glUniform1f(glGetUniformLocation(program, "pointScale"), pointScale);
+
+	// the compatibility profile only gives point sprites gl_PointCoord with GL_POINT_SPRITE on
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glEnable(GL_POINT_SPRITE);
+
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void endParticleSprites(void) {
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+	glDisable(GL_POINT_SPRITE);
+	glDisable(GL_PROGRAM_POINT_SIZE);
+
+	glUseProgram(0);
+}
+
+bool particleSystemBounds(const particleSystem& system, spatialBounds *bounds) {
+	if (system.reach.empty())
+		return false;
+
+	*bounds = system.reach[0].bounds;
+
+	for (size_t i = 1; i < system.reach.size(); ++i) {
+
+		const spatialBounds& b = system.reach[i].bounds;
+
+		bounds->minX = (b.minX < bounds->minX) ? b.minX : bounds->minX;
+		bounds->minY = (b.minY < bounds->minY) ? b.minY : bounds->minY;
+		bounds->maxX = (b.maxX > bounds->maxX) ? b.maxX : bounds->maxX;
+		bounds->maxY = (b.maxY > bounds->maxY) ? b.maxY : bounds->maxY;
+	}
+
+	return true;
+}
+
+void watchParticleShaders(void) {
+	const char *paths[] = { PARTICLE_UPDATE_PATH, PARTICLE_EMIT_PATH, PARTICLE_FINISH_PATH, PARTICLE_VS_PATH, PARTICLE_FS_PATH };
+	vector<string> files;
+
+	for (int i = 0; i < 5; ++i) {
+
+		files.push_back(paths[i]);
+
+		getShaderSource(paths[i]);
+		shaderSourceDependencies(paths[i], files);
+	}
+
+	releaseShaderSourceMappings();
+
+	for (size_t i = 0; i < files.size(); ++i)
+		watchAssetFile(files[i]);
+}
+
+bool reloadParticleShaders(particleSystem& system, const string& path) {
+	if (system.capacity == 0)
+		return false;
+
+	string defines = particleDefines();
+	bool reloaded = false;
+
+	// programs are rebuilt in place, so a broken edit leaves the working program running
+	if (shaderSourceDependsOn(PARTICLE_UPDATE_PATH, path)) {
+
+		reloadComputeShader(&system.updateProgram, PARTICLE_UPDATE_PATH, defines);
+		reloaded = true;
+	}
+
+	if (shaderSourceDependsOn(PARTICLE_EMIT_PATH, path)) {
+
+		reloadComputeShader(&system.emitProgram, PARTICLE_EMIT_PATH, defines);
+		reloaded = true;
+	}
+
+	if (shaderSourceDependsOn(PARTICLE_FINISH_PATH, path)) {
+
+		reloadComputeShader(&system.finishProgram, PARTICLE_FINISH_PATH, defines);
+		reloaded = true;
+	}
+
+	if (reloadParticleSpriteProgram(&system.drawProgram, path))
+		reloaded = true;
+
+	if (reloaded) {
+
+		releaseShaderSourceMappings();
+		getParticleUniforms(system);
+	}
+
+	return reloaded;
+}
+
+void reportParticleSystemStats(const particleSystem& system) {
+	if (system.capacity == 0) {
+
+		cout << "Particles: off\n";
+		return;
+	}
+
+	// the live count stays on the GPU - reading it back would stall the pipeline
+	cout << "Particles: " << system.lastEmitted << " emitted last step, " << system.totalEmitted << " in " << system.steps << " steps, room for " << system.capacity << "\n";
+}
@@ -0,0 +1,86 @@
+//
+// GPU particle system.  Compute passes integrate and compact the particles between a pair of storage buffers, append new ones and size the next dispatch and draw, which is one indirect instanced draw.  Needs compute shaders
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <string>
+#include <vector>
+#include "spatial_hash.h"
+
+// Invocations per compute work group.  Shaders see this as PARTICLE_GROUP_SIZE
+#define PARTICLE_GROUP_SIZE			256
+
+// Emissions that can be queued for one step
+#define MAX_PARTICLE_EMISSIONS		16
+
+// A batch of particles to start on the next step, each picked at random within the ranges.  Mirrors the emission struct in Shaders\particle_emit.glsl (std430)
+struct particleEmission {
+	float		x, y, halfWidth, halfHeight; // spawn area
+	float		velocityX, velocityY, speedMin, speedMax; // base velocity, plus speedMin - speedMax in a random direction
+	float		lifeMin, lifeMax, sizeStart, sizeEnd; // seconds, world units
+	float		accelerationX, accelerationY, drag, unused; // drag is the fraction of the velocity lost per second
+	unsigned	colourStart, colourEnd; // RGBA with red in the low byte, faded from one to the other over the particle's life
+	unsigned	first, count; // first is filled in by emitParticles
+};
+
+// World bounds that particles emitted together can reach before they die
+struct particleReach {
+	spatialBounds	bounds;
+	float			expires;
+};
+
+struct particleSystem {
+	unsigned					capacity = 0; // 0 if the system couldn't be set up
+	GLuint						particleBuffers[2]; // the live particles are in particleBuffers[current] after each step
+	GLuint						drawVAOs[2]; // per-instance attributes over each particle buffer
+	int							current = 0;
+	GLuint						counterBuffer = 0; // live count and the indirect dispatch / draw arguments
+	GLuint						emissionBuffer = 0;
+	GLuint						updateProgram = 0, emitProgram = 0, finishProgram = 0, drawProgram = 0;
+	GLint						timeStepUniform = -1, emissionCountUniform = -1, newParticlesUniform = -1, emitCapacityUniform = -1, seedUniform = -1, finishCapacityUniform = -1;
+
+	std::vector<particleEmission>	emissions; // queued for the next step
+	unsigned					queued = 0; // particles in emissions
+
+	std::vector<particleReach>	reach; // recent emissions, for particleSystemBounds
+	float						time = 0.0f; // seconds simulated
+
+	unsigned					steps = 0;
+	unsigned					lastEmitted = 0;
+	unsigned long long			totalEmitted = 0; // particles asked for, including any dropped when the buffer was full
+};
+
+// Create the buffers and build the programs for up to capacity particles (less if the driver's storage blocks are smaller).  Returns false, leaving capacity at 0, if compute shaders aren't supported or a program doesn't build
+bool setupParticleSystem(particleSystem& system, unsigned capacity);
+
+// Queue a batch of particles for the next step.  Returns false if MAX_PARTICLE_EMISSIONS are already queued
+bool emitParticles(particleSystem& system, const particleEmission& emission);
+
+// Advance the particles by timeStep seconds and start the queued emissions.  Only issues GPU work - nothing is read back
+void updateParticleSystem(particleSystem& system, float timeStep);
+
+// Draw the particles with premultiplied alpha blending, leaving no program, VAO or blending active.  pointScale is the number of pixels per world unit.  Programs must have the frame transform block bound (done by setup and reload)
+void drawParticleSystem(const particleSystem& system, float pointScale);
+
+// The point sprite program both particle systems draw with (Shaders\particle_vert.glsl and particle_frag.glsl), with the frame transform block bound.  Each particle is one instance, with per-instance attributes 0 - 4: position, (age, lifetime), (size at birth, size at death), start colour and end colour.  Returns 0 if it doesn't build
+GLuint setupParticleSpriteProgram(void);
+
+// Rebuild a sprite program in place if path is one of its shaders or a file they include.  Returns true if path was one of them
+bool reloadParticleSpriteProgram(GLuint *program, const std::string& path);
+
+// Draw state for particle sprites.  beginParticleSprites makes program current with program point sizes and premultiplied alpha blending, endParticleSprites leaves no program, VAO or blending active
+void beginParticleSprites(GLuint program, float pointScale);
+void endParticleSprites(void);
+
+// A box that holds every particle that can still be alive (and any that died on the last step).  Returns false if there can't be any
+bool particleSystemBounds(const particleSystem& system, spatialBounds *bounds);
+
+// Watch the particle shaders and everything they include with the asset watcher
+void watchParticleShaders(void);
+
+// Rebuild the programs in place if path is one of the particle shaders or a file they include.  Returns true if anything was rebuilt
+bool reloadParticleShaders(particleSystem& system, const std::string& path);
+
+void reportParticleSystemStats(const particleSystem& system);
@@ -0,0 +1,412 @@
+#include "stdafx.h"
+#include "pixel_convert.h"
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PIXEL_HAVE_X86		1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM) || defined(_M_ARM64)
+#define PIXEL_HAVE_NEON		1
+#include <arm_neon.h>
+#endif
+
+// GCC / Clang need per-function target attributes to emit SSSE3 / AVX2 code without raising the baseline for the whole project.  MSVC always accepts the intrinsics
+#if defined(__GNUC__)
+#define PIXEL_TARGET(isa)	__attribute__((target(isa)))
+#else
+#define PIXEL_TARGET(isa)
+#endif
+
+using namespace std;
+
+#pragma region CPU detection
+
+static PIXEL_ISA detectISA(void) {
+#if defined(PIXEL_HAVE_NEON)
+	return PIXEL_ISA_NEON;
+#elif defined(PIXEL_HAVE_X86) && defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 1);
+
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	// AVX2 also needs the OS to save ymm state on context switches
+	if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+
+		__cpuidex(info, 7, 0);
+
+		if (info[1] & (1 << 5))
+			return PIXEL_ISA_AVX2;
+	}
+
+	return ssse3 ? PIXEL_ISA_SSSE3 : PIXEL_ISA_SCALAR;
+#elif defined(PIXEL_HAVE_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return PIXEL_ISA_AVX2;
+
+	return __builtin_cpu_supports("ssse3") ? PIXEL_ISA_SSSE3 : PIXEL_ISA_SCALAR;
+#else
+	return PIXEL_ISA_SCALAR;
+#endif
+}
+
+PIXEL_ISA pixelBestISA(void) {
+	static const PIXEL_ISA best = detectISA();
+	return best;
+}
+
+const char *pixelISAName(PIXEL_ISA isa) {
+	switch (isa) {
+
+	case PIXEL_ISA_SSSE3: return "SSSE3";
+	case PIXEL_ISA_AVX2: return "AVX2";
+	case PIXEL_ISA_NEON: return "NEON";
+	default: return "scalar";
+	}
+}
+
+#pragma endregion
+
+#pragma region scalar reference kernels
+
+static void convertRGBToRGBAScalar(unsigned char *dst, const unsigned char *src, size_t count, unsigned flags) {
+	const int r = (flags & PIXEL_CONVERT_SWAP_RB) ? 2 : 0;
+	const int b = 2 - r;
+
+	for (size_t i = 0; i < count; ++i, src += 3, dst += 4) {
+
+		unsigned char R = src[r], G = src[1], B = src[b];
+
+		dst[0] = R;
+		dst[1] = G;
+		dst[2] = B;
+
+		if (flags & PIXEL_CONVERT_COLOUR_KEY_BLACK) {
+
+			unsigned char m = (R > G) ? R : G;
+			dst[3] = (m > B) ? m : B;
+
+		} else {
+
+			dst[3] = 255;
+		}
+	}
+}
+
+// round(c * a / 255) without a divide - exact for all 8 bit c and a
+static inline unsigned char mulDiv255(unsigned c, unsigned a) {
+	unsigned t = c * a + 128;
+	return (unsigned char)((t + (t >> 8)) >> 8);
+}
+
+static void premultiplyAlphaScalar(unsigned char *rgba, size_t count) {
+	for (size_t i = 0; i < count; ++i, rgba += 4) {
+
+		unsigned a = rgba[3];
+
+		rgba[0] = mulDiv255(rgba[0], a);
+		rgba[1] = mulDiv255(rgba[1], a);
+		rgba[2] = mulDiv255(rgba[2], a);
+	}
+}
+
+#pragma endregion
+
+#if defined(PIXEL_HAVE_X86)
+
+#pragma region SSSE3 / AVX2 kernels
+
+// pshufb masks expanding 4 packed 3-byte pixels into 4-byte pixels with a zero alpha byte
+#define RGB_TO_RGBA_MASK		 0,  1,  2, -1,  3,  4,  5, -1,  6,  7,  8, -1,  9, 10, 11, -1
+#define BGR_TO_RGBA_MASK		 2,  1,  0, -1,  5,  4,  3, -1,  8,  7,  6, -1, 11, 10,  9, -1
+
+// pshufb masks spreading the alpha of the 2 pixels held in each unpacked 16-bit half across rgb
+#define ALPHA_LO_MASK			 3, -1,  3, -1,  3, -1,  3, -1,  7, -1,  7, -1,  7, -1,  7, -1
+#define ALPHA_HI_MASK			11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1
+
+PIXEL_TARGET("ssse3")
+static void convertRGBToRGBASSSE3(unsigned char *dst, const unsigned char *src, size_t count, unsigned flags) {
+	const __m128i shuffle = (flags & PIXEL_CONVERT_SWAP_RB) ? _mm_setr_epi8(BGR_TO_RGBA_MASK) : _mm_setr_epi8(RGB_TO_RGBA_MASK);
+	const __m128i opaque = _mm_set1_epi32(0xFF000000);
+	const bool key = (flags & PIXEL_CONVERT_COLOUR_KEY_BLACK) != 0;
+
+	size_t i = 0;
+
+	// Each 16 byte load covers 4 pixels plus 4 bytes of the next pixels, so stop while 6 pixels remain to stay inside the source
+	for (; i + 6 <= count; i += 4) {
+
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 3)), shuffle);
+
+		if (key) {
+
+			__m128i m = _mm_max_epu8(v, _mm_srli_epi32(v, 8));
+			m = _mm_max_epu8(m, _mm_srli_epi32(v, 16));
+			v = _mm_or_si128(v, _mm_slli_epi32(m, 24));
+
+		} else {
+
+			v = _mm_or_si128(v, opaque);
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + i * 4), v);
+	}
+
+	convertRGBToRGBAScalar(dst + i * 4, src + i * 3, count - i, flags);
+}
+
+PIXEL_TARGET("avx2")
+static void convertRGBToRGBAAVX2(unsigned char *dst, const unsigned char *src, size_t count, unsigned flags) {
+	const __m256i shuffle = (flags & PIXEL_CONVERT_SWAP_RB) ? _mm256_setr_epi8(BGR_TO_RGBA_MASK, BGR_TO_RGBA_MASK) : _mm256_setr_epi8(RGB_TO_RGBA_MASK, RGB_TO_RGBA_MASK);
+	const __m256i opaque = _mm256_set1_epi32(0xFF000000);
+	const bool key = (flags & PIXEL_CONVERT_COLOUR_KEY_BLACK) != 0;
+
+	size_t i = 0;
+
+	// pshufb works within 128-bit lanes, so load pixels 0-3 into the low lane and 4-7 into the high lane
+	for (; i + 10 <= count; i += 8) {
+
+		const unsigned char *s = src + i * 3;
+
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)s)), _mm_loadu_si128((const __m128i*)(s + 12)), 1);
+		v = _mm256_shuffle_epi8(v, shuffle);
+
+		if (key) {
+
+			__m256i m = _mm256_max_epu8(v, _mm256_srli_epi32(v, 8));
+			m = _mm256_max_epu8(m, _mm256_srli_epi32(v, 16));
+			v = _mm256_or_si256(v, _mm256_slli_epi32(m, 24));
+
+		} else {
+
+			v = _mm256_or_si256(v, opaque);
+		}
+
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), v);
+	}
+
+	convertRGBToRGBAScalar(dst + i * 4, src + i * 3, count - i, flags);
+}
+
+PIXEL_TARGET("ssse3")
+static void premultiplyAlphaSSSE3(unsigned char *rgba, size_t count) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(128);
+	const __m128i alphaLo = _mm_setr_epi8(ALPHA_LO_MASK);
+	const __m128i alphaHi = _mm_setr_epi8(ALPHA_HI_MASK);
+	const __m128i alphaBits = _mm_set1_epi32(0xFF000000);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+
+		__m128i v = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), _mm_shuffle_epi8(v, alphaLo)), round);
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), _mm_shuffle_epi8(v, alphaHi)), round);
+
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+		// keep the original alpha byte
+		__m128i p = _mm_packus_epi16(lo, hi);
+		p = _mm_or_si128(_mm_andnot_si128(alphaBits, p), _mm_and_si128(alphaBits, v));
+
+		_mm_storeu_si128((__m128i*)(rgba + i * 4), p);
+	}
+
+	premultiplyAlphaScalar(rgba + i * 4, count - i);
+}
+
+PIXEL_TARGET("avx2")
+static void premultiplyAlphaAVX2(unsigned char *rgba, size_t count) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi16(128);
+	const __m256i alphaLo = _mm256_setr_epi8(ALPHA_LO_MASK, ALPHA_LO_MASK);
+	const __m256i alphaHi = _mm256_setr_epi8(ALPHA_HI_MASK, ALPHA_HI_MASK);
+	const __m256i alphaBits = _mm256_set1_epi32(0xFF000000);
+
+	size_t i = 0;
+
+	// unpack / pack both work per 128-bit lane so the pixel order survives the round trip
+	for (; i + 8 <= count; i += 8) {
+
+		__m256i v = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), _mm256_shuffle_epi8(v, alphaLo)), round);
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), _mm256_shuffle_epi8(v, alphaHi)), round);
+
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+		__m256i p = _mm256_packus_epi16(lo, hi);
+		p = _mm256_or_si256(_mm256_andnot_si256(alphaBits, p), _mm256_and_si256(alphaBits, v));
+
+		_mm256_storeu_si256((__m256i*)(rgba + i * 4), p);
+	}
+
+	premultiplyAlphaScalar(rgba + i * 4, count - i);
+}
+
+#pragma endregion
+
+#endif
+
+#if defined(PIXEL_HAVE_NEON)
+
+#pragma region NEON kernels
+
+static void convertRGBToRGBANEON(unsigned char *dst, const unsigned char *src, size_t count, unsigned flags) {
+	const bool swap = (flags & PIXEL_CONVERT_SWAP_RB) != 0;
+	const bool key = (flags & PIXEL_CONVERT_COLOUR_KEY_BLACK) != 0;
+
+	size_t i = 0;
+
+	// vld3 / vst4 de-interleave and re-interleave 16 pixels at a time
+	for (; i + 16 <= count; i += 16) {
+
+		uint8x16x3_t s = vld3q_u8(src + i * 3);
+		uint8x16x4_t d;
+
+		d.val[0] = swap ? s.val[2] : s.val[0];
+		d.val[1] = s.val[1];
+		d.val[2] = swap ? s.val[0] : s.val[2];
+		d.val[3] = key ? vmaxq_u8(vmaxq_u8(s.val[0], s.val[1]), s.val[2]) : vdupq_n_u8(255);
+
+		vst4q_u8(dst + i * 4, d);
+	}
+
+	convertRGBToRGBAScalar(dst + i * 4, src + i * 3, count - i, flags);
+}
+
+static inline uint8x8_t mulDiv255NEON(uint8x8_t c, uint8x8_t a) {
+	uint16x8_t t = vaddq_u16(vmull_u8(c, a), vdupq_n_u16(128));
+	return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+static void premultiplyAlphaNEON(unsigned char *rgba, size_t count) {
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+
+		uint8x8x4_t p = vld4_u8(rgba + i * 4);
+
+		p.val[0] = mulDiv255NEON(p.val[0], p.val[3]);
+		p.val[1] = mulDiv255NEON(p.val[1], p.val[3]);
+		p.val[2] = mulDiv255NEON(p.val[2], p.val[3]);
+
+		vst4_u8(rgba + i * 4, p);
+	}
+
+	premultiplyAlphaScalar(rgba + i * 4, count - i);
+}
+
+#pragma endregion
+
+#endif
+
+#pragma region kernel dispatch
+
+void convertRGBToRGBA(unsigned char *dst, const unsigned char *src, size_t count, unsigned flags, PIXEL_ISA isa) {
+	switch (isa) {
+#if defined(PIXEL_HAVE_X86)
+	case PIXEL_ISA_AVX2: convertRGBToRGBAAVX2(dst, src, count, flags); break;
+	case PIXEL_ISA_SSSE3: convertRGBToRGBASSSE3(dst, src, count, flags); break;
+#endif
+#if defined(PIXEL_HAVE_NEON)
+	case PIXEL_ISA_NEON: convertRGBToRGBANEON(dst, src, count, flags); break;
+#endif
+	default: convertRGBToRGBAScalar(dst, src, count, flags); break;
+	}
+}
+
+void premultiplyAlpha(unsigned char *rgba, size_t count, PIXEL_ISA isa) {
+	switch (isa) {
+#if defined(PIXEL_HAVE_X86)
+	case PIXEL_ISA_AVX2: premultiplyAlphaAVX2(rgba, count); break;
+	case PIXEL_ISA_SSSE3: premultiplyAlphaSSSE3(rgba, count); break;
+#endif
+#if defined(PIXEL_HAVE_NEON)
+	case PIXEL_ISA_NEON: premultiplyAlphaNEON(rgba, count); break;
+#endif
+	default: premultiplyAlphaScalar(rgba, count); break;
+	}
+}
+
+#pragma endregion
+
+#pragma region benchmark
+
+// x86 levels are cumulative, NEON stands alone
+bool pixelISASupported(PIXEL_ISA isa) {
+	PIXEL_ISA best = pixelBestISA();
+
+	if (isa == PIXEL_ISA_SCALAR)
+		return true;
+	else if (isa == PIXEL_ISA_NEON || best == PIXEL_ISA_NEON)
+		return isa == best;
+	else
+		return isa <= best;
+}
+
+void pixelConvertBenchmark(void) {
+	// 1024x1024 synthetic image with a black border so the colour key path sees both keyed and opaque pixels
+	const size_t count = 1024 * 1024 + 7;
+	const int iterations = 50;
+
+	vector<unsigned char> src(count * 3);
+	vector<unsigned char> result(count * 4);
+
+	for (size_t i = 0; i < src.size(); ++i)
+		src[i] = (i % 3072 < 256) ? 0 : (unsigned char)((i * 2654435761u) >> 24);
+
+	PIXEL_ISA isaList[] = { PIXEL_ISA_SCALAR, PIXEL_ISA_SSSE3, PIXEL_ISA_AVX2, PIXEL_ISA_NEON };
+	unsigned flagList[] = { PIXEL_CONVERT_SWAP_RB, PIXEL_CONVERT_SWAP_RB | PIXEL_CONVERT_COLOUR_KEY_BLACK };
+
+	cout << "Pixel conversion benchmark (" << count << " pixels, best ISA " << pixelISAName(pixelBestISA()) << ")\n";
+
+	for (PIXEL_ISA isa : isaList) {
+
+		if (!pixelISASupported(isa))
+			continue;
+
+		for (unsigned flags : flagList) {
+
+			auto start = chrono::high_resolution_clock::now();
+
+			for (int n = 0; n < iterations; ++n)
+				convertRGBToRGBA(result.data(), src.data(), count, flags, isa);
+
+			double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+			cout << "  " << pixelISAName(isa) << " convertRGBToRGBA(flags " << flags << "): " << (double(count) * 7.0 * iterations) / seconds / 1e9 << " GB/s\n";
+		}
+
+		convertRGBToRGBA(result.data(), src.data(), count, PIXEL_CONVERT_COLOUR_KEY_BLACK, isa);
+
+		auto start = chrono::high_resolution_clock::now();
+
+		for (int n = 0; n < iterations; ++n)
+			premultiplyAlpha(result.data(), count, isa);
+
+		double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+		cout << "  " << pixelISAName(isa) << " premultiplyAlpha: " << (double(count) * 8.0 * iterations) / seconds / 1e9 << " GB/s\n";
+	}
+
+	cout << "\n";
+}
+
+#pragma endregion
@@ -0,0 +1,41 @@
+//
+// Pixel format conversion kernels used by the texture loader.  Each kernel has a scalar reference implementation and SSSE3 / AVX2 / NEON versions that produce bit-identical output
+//
+
+#pragma once
+
+#include <cstddef>
+
+// Instruction set used by the conversion kernels
+typedef enum PIXEL_ISA {
+
+	PIXEL_ISA_SCALAR = 0,
+	PIXEL_ISA_SSSE3,
+	PIXEL_ISA_AVX2,
+	PIXEL_ISA_NEON
+
+} PIXEL_ISA;
+
+// Conversion options for convertRGBToRGBA
+enum {
+
+	PIXEL_CONVERT_DEFAULT = 0,
+	PIXEL_CONVERT_SWAP_RB = 0x01, // source is BGR (FreeImage little-endian order) rather than RGB
+	PIXEL_CONVERT_COLOUR_KEY_BLACK = 0x02 // alpha = max(r, g, b) so black backgrounds become transparent and the colour is already premultiplied
+};
+
+// Return the best instruction set supported by the CPU (detected once)
+PIXEL_ISA pixelBestISA(void);
+const char *pixelISAName(PIXEL_ISA isa);
+
+// Expand count 3-byte pixels in src to 4-byte RGBA pixels in dst.  src and dst must not overlap
+void convertRGBToRGBA(unsigned char *dst, const unsigned char *src, size_t count, unsigned flags, PIXEL_ISA isa = pixelBestISA());
+
+// Premultiply count RGBA pixels in place by their alpha.  Rounding is exact: c' = round(c * a / 255)
+void premultiplyAlpha(unsigned char *rgba, size_t count, PIXEL_ISA isa = pixelBestISA());
+
+// Whether the CPU can run the kernels for isa
+bool pixelISASupported(PIXEL_ISA isa);
+
+// Print the throughput of each kernel in GB/s on a synthetic image.  The SIMD paths are checked against the scalar reference by the self tests
+void pixelConvertBenchmark(void);
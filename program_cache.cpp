@@ -0,0 +1,280 @@
+#include "stdafx.h"
+#include "program_cache.h"
+#include "asset_watcher.h"
+#include "shader_source.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define makeDirectory(path)		_mkdir(path)
+#else
+#define makeDirectory(path)		mkdir(path, 0755)
+#endif
+
+using namespace std;
+
+static const char		*PROGRAM_CACHE_DIRECTORY = "ShaderCache";
+static const unsigned	PROGRAM_CACHE_MAGIC = 0x31425047; // 'GPB1'
+
+// Cache file header, followed by binaryLength bytes of program binary
+struct programCacheHeader {
+	unsigned		magic;
+	unsigned		binaryFormat;
+	unsigned		binaryLength;
+	unsigned		reserved;
+	GLuint64		key;
+	double			buildMs; // time the source build took when the entry was written
+};
+
+static programCacheStats	stats = { 0, 0, 0.0, 0.0 };
+
+#pragma region hashing
+
+// 64 bit FNV-1a
+static GLuint64 hashBytes(const void *data, size_t length, GLuint64 h = 14695981039346656037ULL) {
+	const unsigned char *p = (const unsigned char*)data;
+
+	for (size_t i = 0; i < length; ++i) {
+
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+static GLuint64 hashString(const char *s, GLuint64 h) {
+	// hash the terminator too so ("ab", "c") and ("a", "bc") differ
+	return s ? hashBytes(s, strlen(s) + 1, h) : hashBytes("", 1, h);
+}
+
+static GLuint64 hashSource(const shaderSource& source, GLuint64 h) {
+	for (size_t i = 0; i < source.strings.size(); ++i)
+		h = hashBytes(source.strings[i], source.lengths[i], h);
+
+	return hashBytes("", 1, h);
+}
+
+// Key covering everything that can invalidate a binary - the expanded sources (so an edit to an included file counts) and the driver that compiled them
+static bool programKey(const string& vsPath, const string& fsPath, const string& defines, GLuint64 *key) {
+	const shaderSource *vsSource = getShaderSource(vsPath);
+	const shaderSource *fsSource = getShaderSource(fsPath);
+
+	if (!vsSource || !fsSource)
+		return false;
+
+	GLuint64 h = hashSource(*vsSource, 14695981039346656037ULL);
+
+	h = hashSource(*fsSource, h);
+	h = hashString(defines.c_str(), h);
+	h = hashString((const char*)glGetString(GL_VENDOR), h);
+	h = hashString((const char*)glGetString(GL_RENDERER), h);
+	h = hashString((const char*)glGetString(GL_VERSION), h);
+
+	*key = h;
+
+	return true;
+}
+
+// One file per vertex / fragment shader pair and set of defines, so a stale entry is overwritten rather than left behind
+static string cacheFilePath(const string& vsPath, const string& fsPath, const string& defines) {
+	GLuint64 h = hashString(normaliseAssetPath(vsPath).c_str(), 14695981039346656037ULL);
+	h = hashString(normaliseAssetPath(fsPath).c_str(), h);
+	h = hashString(defines.c_str(), h);
+
+	stringstream path;
+	path << PROGRAM_CACHE_DIRECTORY << "/" << hex << setw(16) << setfill('0') << h << ".bin";
+
+	return path.str();
+}
+
+#pragma endregion
+
+static bool programBinarySupported(void) {
+	if (!glProgramBinary || !glGetProgramBinary)
+		return false;
+
+	GLint noofFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &noofFormats);
+
+	return noofFormats > 0;
+}
+
+// Restore a program from its cache file.  Returns 0 if there is no matching entry or the driver rejects the binary
+static GLuint loadCachedProgram(const string& cachePath, GLuint64 key, double *buildMs) {
+	ifstream file(cachePath.c_str(), ios::binary);
+
+	if (!file.is_open())
+		return 0;
+
+	programCacheHeader header;
+
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_CACHE_MAGIC || header.key != key)
+		return 0;
+
+	vector<char> binary(header.binaryLength);
+
+	if (!file.read(binary.data(), header.binaryLength))
+		return 0;
+
+	GLuint program = glCreateProgram();
+
+	glProgramBinary(program, header.binaryFormat, binary.data(), header.binaryLength);
+
+	GLint linkStatus = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+
+	if (linkStatus == 0) {
+
+		// drivers are free to reject binaries, e.g. after an update that kept the version string
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	*buildMs = header.buildMs;
+
+	return program;
+}
+
+static void saveCachedProgram(const string& cachePath, GLuint program, GLuint64 key, double buildMs) {
+	GLint binaryLength = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+
+	if (binaryLength <= 0)
+		return;
+
+	vector<char> binary(binaryLength);
+
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(program, binaryLength, &binaryLength, &binaryFormat, binary.data());
+
+	makeDirectory(PROGRAM_CACHE_DIRECTORY);
+
+	ofstream file(cachePath.c_str(), ios::binary | ios::trunc);
+
+	if (!file.is_open()) {
+
+		cout << "Program cache: could not write " << cachePath << "\n";
+		return;
+	}
+
+	programCacheHeader header = { PROGRAM_CACHE_MAGIC, binaryFormat, unsigned(binaryLength), 0, key, buildMs };
+
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), binaryLength);
+}
+
+// Source builds still in flight, so the binary can be saved once the driver has finished linking
+struct pendingCacheEntry {
+	string			cachePath;
+	GLuint64		key;
+	double			buildMs; // main thread time spent on the build so far - submitting it and any waits added with addShaderBuildWait
+};
+
+static map<GLuint, pendingCacheEntry>	pendingEntries;
+
+GLuint submitShadersCached(const string& vsPath, const string& fsPath, GLSL_ERROR *error_result, const string& defines) {
+	GLuint64 key = 0;
+
+	bool cacheable = programBinarySupported() && programKey(vsPath, fsPath, defines, &key);
+	string cachePath = cacheable ? cacheFilePath(vsPath, fsPath, defines) : string();
+
+	if (cacheable) {
+
+		auto loadStart = chrono::high_resolution_clock::now();
+
+		double buildMs = 0.0;
+		GLuint program = loadCachedProgram(cachePath, key, &buildMs);
+
+		if (program) {
+
+			double loadMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - loadStart).count();
+
+			stats.hits++;
+			stats.loadMs += loadMs;
+			stats.savedMs += buildMs - loadMs;
+
+			if (error_result)
+				*error_result = GLSL_OK;
+
+			return program;
+		}
+	}
+
+	stats.misses++;
+
+	auto submitStart = chrono::high_resolution_clock::now();
+
+	GLuint program = submitShaders(vsPath, fsPath, error_result, cacheable, defines);
+
+	if (program && cacheable) {
+
+		pendingCacheEntry entry = { cachePath, key, chrono::duration<double, milli>(chrono::high_resolution_clock::now() - submitStart).count() };
+		pendingEntries[program] = entry;
+	}
+
+	return program;
+}
+
+GLSL_ERROR collectShadersCached(GLuint program) {
+	auto collectStart = chrono::high_resolution_clock::now();
+
+	GLSL_ERROR err = collectShaders(program);
+
+	map<GLuint, pendingCacheEntry>::iterator pending = pendingEntries.find(program);
+
+	if (pending != pendingEntries.end()) {
+
+		// the build cost recorded is the main thread time it took - submitting, waiting for it before collecting (if the caller polled and said so with addShaderBuildWait) and collecting - which is what a cache hit saves at startup
+		double buildMs = pending->second.buildMs + chrono::duration<double, milli>(chrono::high_resolution_clock::now() - collectStart).count();
+
+		if (err == GLSL_OK)
+			saveCachedProgram(pending->second.cachePath, program, pending->second.key, buildMs);
+
+		pendingEntries.erase(pending);
+	}
+
+	return err;
+}
+
+void addShaderBuildWait(GLuint program, double ms) {
+	map<GLuint, pendingCacheEntry>::iterator pending = pendingEntries.find(program);
+
+	if (pending != pendingEntries.end())
+		pending->second.buildMs += ms;
+}
+
+GLuint setupShadersCached(const string& vsPath, const string& fsPath, GLSL_ERROR *error_result, const string& defines) {
+	GLuint program = submitShadersCached(vsPath, fsPath, error_result, defines);
+
+	if (!program)
+		return 0;
+
+	GLSL_ERROR err = collectShadersCached(program);
+
+	if (error_result)
+		*error_result = err;
+
+	return (err == GLSL_OK) ? program : 0;
+}
+
+const programCacheStats& getProgramCacheStats(void) {
+	return stats;
+}
+
+void reportProgramCacheStats(void) {
+	cout << "Program cache: " << stats.hits << " hits, " << stats.misses << " misses";
+
+	if (stats.hits)
+		cout << ", " << fixed << setprecision(2) << stats.loadMs << " ms loading binaries, " << stats.savedMs << " ms startup time saved";
+
+	cout << "\n";
+}
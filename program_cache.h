@@ -0,0 +1,29 @@
+//
+// GLSL program binary cache.  Linked programs are saved to disk with glGetProgramBinary and restored with glProgramBinary on later runs, skipping compilation and linking.  Each entry is keyed by a hash of the shader sources and the GL vendor, renderer and version strings, so editing a shader or changing driver falls back to compiling from source
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <string>
+#include "shader_setup.h"
+
+struct programCacheStats {
+	unsigned		hits;
+	unsigned		misses; // programs compiled from source (no entry, stale entry or driver rejected the binary)
+	double			loadMs; // time spent restoring programs from the cache
+	double			savedMs; // compile and link time recorded for the cached programs, less loadMs
+};
+
+// Drop-in replacement for setupShaders(vsPath, fsPath, error_result, false, defines) that tries the binary cache first.  On a miss the program is built from source and written to the cache
+GLuint setupShadersCached(const std::string& vsPath, const std::string& fsPath, GLSL_ERROR *error_result = NULL, const std::string& defines = std::string());
+
+// Non-blocking form, mirroring submitShaders / collectShaders.  Cache hits are restored during submit; misses are compiled from source and written to the cache when collected
+GLuint submitShadersCached(const std::string& vsPath, const std::string& fsPath, GLSL_ERROR *error_result = NULL, const std::string& defines = std::string());
+GLSL_ERROR collectShadersCached(GLuint program);
+
+// Add main thread time spent waiting for a submitted program to finish building (polling shadersCompleted before collecting it) to the build cost recorded for it in the cache
+void addShaderBuildWait(GLuint program, double ms);
+
+const programCacheStats& getProgramCacheStats(void);
+void reportProgramCacheStats(void);
@@ -0,0 +1,360 @@
+#include "stdafx.h"
+#include "render_queue.h"
+#include "transform_buffer.h"
+#include <vector>
+#include <map>
+#include <iostream>
+
+using namespace std;
+
+static const int		MAX_BLEND_KEY = 15; // 4 bits
+static const unsigned	MAX_PROGRAM_IDS = 256; // 8 bits
+static const unsigned	MAX_TEXTURE_IDS = 65536; // 16 bits
+static const unsigned	MAX_DEPTH = (1 << 28) - 1;
+
+struct blendState {
+	GLenum			equation, source, destination;
+};
+
+// Sort entry - the key and the position of its command in commands
+struct queuedCommand {
+	GLuint64		key;
+	unsigned		index;
+};
+
+struct programLocations {
+	GLint			transform, layer;
+};
+
+static vector<renderCommand>		commands;
+static vector<queuedCommand>		submitted, sorted, sortScratch;
+static vector<queuedCommand>		unsortedLayerRange; // the commands in the layers being executed in submission order, when sorting is off
+static bool							sortedValid = false; // sorted matches submitted
+static bool							comparisonValid = false; // stats.unsortedChanges and sortedChanges are counted for this frame's commands
+static vector<blendState>			blendStates;
+
+// small ids for the key, given out in the order programs and textures are first seen each frame
+static map<GLuint, unsigned>		programIds, textureIds;
+static map<GLuint, programLocations>	locations;
+
+static bool							sortingEnabled = true;
+static renderQueueStats				stats = { 0, 0, 0, 0, 0, 0, 0 };
+
+int renderBlendState(GLenum equation, GLenum source, GLenum destination) {
+	if (equation == 0)
+		return 0;
+
+	// id 0 is reserved for blending disabled
+	if (blendStates.empty()) {
+
+		blendState disabled = { 0, 0, 0 };
+		blendStates.push_back(disabled);
+	}
+
+	for (size_t i = 1; i < blendStates.size(); ++i) {
+
+		if (blendStates[i].equation == equation && blendStates[i].source == source && blendStates[i].destination == destination)
+			return int(i);
+	}
+
+	blendState b = { equation, source, destination };
+	blendStates.push_back(b);
+
+	return int(blendStates.size() - 1);
+}
+
+static unsigned smallId(map<GLuint, unsigned>& ids, GLuint name, unsigned limit) {
+	map<GLuint, unsigned>::iterator i = ids.find(name);
+
+	if (i != ids.end())
+		return i->second;
+
+	unsigned id = (ids.size() < limit) ? unsigned(ids.size()) : limit - 1;
+	ids[name] = id;
+
+	return id;
+}
+
+void beginRenderQueue(void) {
+	commands.clear();
+	submitted.clear();
+	sortedValid = false;
+	comparisonValid = false;
+
+	// ids only order one frame's keys, so they start again each frame rather than collecting every program and texture name ever drawn.  Locations are kept across frames but dropped if deleted programs have piled up
+	programIds.clear();
+	textureIds.clear();
+
+	if (locations.size() > MAX_PROGRAM_IDS)
+		locations.clear();
+
+	renderQueueStats cleared = { 0, 0, 0, 0, 0, 0, 0 };
+	stats = cleared;
+}
+
+void submitRenderCommand(const renderCommand& command, unsigned layer) {
+	GLuint64 program = smallId(programIds, command.program, MAX_PROGRAM_IDS);
+	GLuint64 texture = (command.textureLayer >= 0) ? GLuint64(command.textureLayer) : smallId(textureIds, command.texture, MAX_TEXTURE_IDS);
+	GLuint64 blend = (command.blend < MAX_BLEND_KEY) ? GLuint64(command.blend) : MAX_BLEND_KEY;
+	GLuint64 depth = (commands.size() < MAX_DEPTH) ? GLuint64(commands.size()) : MAX_DEPTH;
+
+	queuedCommand q;
+
+	q.key = (GLuint64(layer & 0xFF) << 56) | (blend << 52) | ((program & 0xFF) << 44) | ((texture & 0xFFFF) << 28) | depth;
+	q.index = unsigned(commands.size());
+
+	commands.push_back(command);
+	submitted.push_back(q);
+
+	sortedValid = false;
+	comparisonValid = false;
+}
+
+#pragma region sorting
+
+// LSD radix sort on the 64 bit key, one byte per pass.  Stable, so equal keys keep their submission order.  Passes where every key has the same byte (usually most of them - few layers, few programs) are skipped
+static void radixSort(vector<queuedCommand>& entries, vector<queuedCommand>& scratch) {
+	size_t n = entries.size();
+
+	if (n < 2)
+		return;
+
+	scratch.resize(n);
+
+	for (int shift = 0; shift < 64; shift += 8) {
+
+		size_t counts[256] = { 0 };
+
+		for (size_t i = 0; i < n; ++i)
+			counts[(entries[i].key >> shift) & 0xFF]++;
+
+		if (counts[(entries[0].key >> shift) & 0xFF] == n)
+			continue;
+
+		size_t offset = 0;
+
+		for (int d = 0; d < 256; ++d) {
+
+			size_t c = counts[d];
+			counts[d] = offset;
+			offset += c;
+		}
+
+		for (size_t i = 0; i < n; ++i)
+			scratch[counts[(entries[i].key >> shift) & 0xFF]++] = entries[i];
+
+		entries.swap(scratch);
+	}
+}
+
+#pragma endregion
+
+#pragma region replay
+
+static size_t indexSize(GLenum indexType) {
+	return (indexType == GL_UNSIGNED_INT) ? 4 : ((indexType == GL_UNSIGNED_SHORT) ? 2 : 1);
+}
+
+static const programLocations& locationsFor(GLuint program) {
+	map<GLuint, programLocations>::iterator i = locations.find(program);
+
+	if (i != locations.end())
+		return i->second;
+
+	programLocations l;
+	l.transform = glGetUniformLocation(program, "transformIndex");
+	l.layer = glGetUniformLocation(program, "layer");
+
+	// individual textures are always bound to unit 0 (the program is current when this is first called)
+	GLint sampler = glGetUniformLocation(program, "textureImage");
+
+	if (sampler >= 0)
+		glUniform1i(sampler, 0);
+
+	return locations[program] = l;
+}
+
+// Walk the commands from begin to end, counting the state changes between neighbours (and making them and drawing if draw is set).  Returns the total number of changes
+static unsigned replay(const queuedCommand *begin, const queuedCommand *end, bool draw, renderQueueStats *changes) {
+	GLuint program = 0, texture = 0, vao = 0;
+	int blend = -1;
+	bool first = true;
+
+	unsigned programChanges = 0, textureChanges = 0, blendChanges = 0, vaoChanges = 0;
+
+	for (const queuedCommand *q = begin; q != end; ++q) {
+
+		const renderCommand& c = commands[q->index];
+
+		if (first || c.program != program) {
+
+			program = c.program;
+			programChanges++;
+
+			if (draw)
+				glUseProgram(program);
+		}
+
+		if (c.texture && c.texture != texture) {
+
+			texture = c.texture;
+			textureChanges++;
+
+			if (draw) {
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, texture);
+			}
+		}
+
+		if (c.blend != blend) {
+
+			blendChanges++;
+
+			if (draw) {
+
+				if (c.blend == 0) {
+
+					glDisable(GL_BLEND);
+
+				} else {
+
+					if (blend <= 0)
+						glEnable(GL_BLEND);
+
+					const blendState& b = blendStates[c.blend];
+					glBlendEquation(b.equation);
+					glBlendFunc(b.source, b.destination);
+				}
+			}
+
+			blend = c.blend;
+		}
+
+		if (first || c.vao != vao) {
+
+			vao = c.vao;
+			vaoChanges++;
+
+			if (draw)
+				glBindVertexArray(vao);
+		}
+
+		first = false;
+
+		if (!draw)
+			continue;
+
+		// per draw values rather than state - always set
+		const programLocations& l = locationsFor(program);
+
+		glUniform1i(l.transform, bindFrameTransform(c.transform));
+
+		if (c.textureLayer >= 0)
+			glUniform1i(l.layer, c.textureLayer);
+
+		glDrawElements(c.primitive, c.count, c.indexType, (const GLvoid*)(size_t(c.first) * indexSize(c.indexType)));
+	}
+
+	if (changes) {
+
+		changes->programChanges += programChanges;
+		changes->textureChanges += textureChanges;
+		changes->blendChanges += blendChanges;
+		changes->vaoChanges += vaoChanges;
+	}
+
+	return programChanges + textureChanges + blendChanges + vaoChanges;
+}
+
+#pragma endregion
+
+static unsigned keyLayer(const queuedCommand& q) {
+	return unsigned(q.key >> 56);
+}
+
+static void sortQueue(void) {
+	if (!sortedValid) {
+
+		sorted = submitted;
+		radixSort(sorted, sortScratch);
+
+		sortedValid = true;
+	}
+}
+
+void executeRenderQueue(void) {
+	executeRenderQueueLayers(0, 255);
+}
+
+void executeRenderQueueLayers(unsigned firstLayer, unsigned lastLayer) {
+	sortQueue();
+
+	// the layer is the top of the key, so in sorted order the range is contiguous and is replayed where it lies
+	const queuedCommand *first = sorted.data(), *end = sorted.data() + sorted.size();
+
+	while (first != end && keyLayer(*first) < firstLayer)
+		++first;
+
+	const queuedCommand *last = first;
+
+	while (last != end && keyLayer(*last) <= lastLayer)
+		++last;
+
+	stats.draws += unsigned(last - first);
+
+	if (sortingEnabled) {
+
+		replay(first, last, true, &stats);
+
+	} else {
+
+		unsortedLayerRange.clear();
+
+		for (size_t i = 0; i < submitted.size(); ++i) {
+
+			if (keyLayer(submitted[i]) >= firstLayer && keyLayer(submitted[i]) <= lastLayer)
+				unsortedLayerRange.push_back(submitted[i]);
+		}
+
+		replay(unsortedLayerRange.data(), unsortedLayerRange.data() + unsortedLayerRange.size(), true, &stats);
+	}
+
+	glBindVertexArray(0);
+	glDisable(GL_BLEND);
+	glUseProgram(0);
+}
+
+void renderQueueProgramsChanged(void) {
+	locations.clear();
+}
+
+void setRenderQueueSorting(bool sort) {
+	sortingEnabled = sort;
+}
+
+bool renderQueueSorting(void) {
+	return sortingEnabled;
+}
+
+const renderQueueStats& getRenderQueueStats(void) {
+	// the comparison takes two more passes over the queue, so it is only counted when asked for, once per frame
+	if (!comparisonValid) {
+
+		sortQueue();
+
+		stats.unsortedChanges = replay(submitted.data(), submitted.data() + submitted.size(), false, NULL);
+		stats.sortedChanges = replay(sorted.data(), sorted.data() + sorted.size(), false, NULL);
+
+		comparisonValid = true;
+	}
+
+	return stats;
+}
+
+void reportRenderQueueStats(void) {
+	getRenderQueueStats();
+
+	cout << "Render queue: " << stats.draws << " draws, " << (sortingEnabled ? "sorted" : "unsorted") << " - " << stats.programChanges << " program, " << stats.textureChanges << " texture, " << stats.blendChanges << " blend and " << stats.vaoChanges << " VAO changes\n";
+	cout << "Render queue: " << stats.unsortedChanges << " state changes per frame in submission order, " << stats.sortedChanges << " sorted\n";
+	cout << "Render queue: " << frameTransformCount() << " transforms on " << frameTransformPages() << " pages of " << FRAME_TRANSFORM_CAPACITY << "\n";
+}
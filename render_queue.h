@@ -0,0 +1,59 @@
+//
+// Sort-key render queue.  Draws are queued with a 64 bit key, radix sorted and replayed setting only the GL state that changes.  Key layout:
+//
+//	bits 56-63	layer
+//	bits 52-55	blend state (0 = blending disabled)
+//	bits 44-51	program
+//	bits 28-43	texture
+//	bits 0-27	depth (submission order within the layer)
+//
+
+#pragma once
+
+#include <glew\glew.h>
+
+struct renderCommand {
+	GLuint			program;
+	GLuint			texture; // GL_TEXTURE_2D bound to unit 0, or 0 for none
+	int				textureLayer; // value for the program's "layer" uniform (texture arrays), -1 for none
+	int				blend; // from renderBlendState, 0 = blending disabled
+	GLuint			vao;
+	GLenum			primitive;
+	GLsizei			first; // first index of the element buffer to draw from
+	GLsizei			count;
+	GLenum			indexType;
+	int				transform; // frame transform index (see addFrameTransform), bound with bindFrameTransform
+};
+
+// GL state changes made replaying a frame's commands (totals over every execute since beginRenderQueue), and the changes the whole frame needs in submission and sorted order
+struct renderQueueStats {
+	unsigned		draws;
+	unsigned		programChanges, textureChanges, blendChanges, vaoChanges;
+	unsigned		unsortedChanges; // counted by getRenderQueueStats, not while drawing
+	unsigned		sortedChanges;
+};
+
+// Return the id of a blend state (registering it the first time it is seen).  An equation of 0 means blending disabled, which is always id 0.  The key holds ids up to 15 - states past that sort together but are still set correctly
+int renderBlendState(GLenum equation, GLenum source, GLenum destination);
+
+// Start a frame's commands
+void beginRenderQueue(void);
+
+// Queue a draw in layer (0-255).  Within a layer commands are reordered freely to group state, except that commands with identical state keep their submission order
+void submitRenderCommand(const renderCommand& command, unsigned layer);
+
+// Sort and draw the commands queued since beginRenderQueue, leaving no program, VAO or blending active
+void executeRenderQueue(void);
+
+// Draw only the queued commands in layers firstLayer - lastLayer.  Can be called several times a frame with different ranges (e.g. to draw some layers into an offscreen target) - the queue is only sorted once
+void executeRenderQueueLayers(unsigned firstLayer, unsigned lastLayer);
+
+// Forget cached uniform locations - call after programs are relinked
+void renderQueueProgramsChanged(void);
+
+// Replay in submission order instead of sorted order (for comparing the two)
+void setRenderQueueSorting(bool sort);
+bool renderQueueSorting(void);
+
+const renderQueueStats& getRenderQueueStats(void);
+void reportRenderQueueStats(void);
@@ -0,0 +1,727 @@
+#include "stdafx.h"
+#include "scene_file.h"
+#include "mapped_file.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+using namespace std;
+
+static const unsigned	SCENE_FILE_MAGIC = 0x31424353; // 'SCB1'
+static const unsigned	SCENE_FILE_VERSION = 2;
+
+// Images handed out by loadSceneFile
+static vector<mappedFile>	sceneMappings;
+
+#pragma region text form
+
+struct parsedMesh {
+	string						name;
+	GLenum						primitive;
+	vector<sceneVertex>			vertices;
+	vector<unsigned short>		indices;
+};
+
+// A scene as read from text.  Records refer to each other by index, strings are held here until the image is written
+struct parsedScene {
+	vector<sceneTextureRecord>		textures;
+	vector<sceneMaterialRecord>		materials;
+	vector<parsedMesh>				meshes;
+	vector<sceneNodeRecord>			nodes;
+	vector<sceneParameterRecord>	parameters;
+
+	// names and paths in record order - textures hold two strings each (name, path)
+	vector<string>					textureStrings, materialNames, nodeNames, parameterNames;
+
+	map<string, int>				textureIndex, materialIndex, meshIndex, nodeIndex, parameterIndex;
+};
+
+struct sceneToken {
+	const char		*name;
+	GLenum			value;
+};
+
+static const sceneToken blendEquations[] = {
+	{ "add", GL_FUNC_ADD }, { "subtract", GL_FUNC_SUBTRACT }, { "reverse_subtract", GL_FUNC_REVERSE_SUBTRACT }, { "min", GL_MIN }, { "max", GL_MAX }
+};
+
+static const sceneToken blendFactors[] = {
+	{ "zero", GL_ZERO }, { "one", GL_ONE },
+	{ "src_colour", GL_SRC_COLOR }, { "one_minus_src_colour", GL_ONE_MINUS_SRC_COLOR },
+	{ "dst_colour", GL_DST_COLOR }, { "one_minus_dst_colour", GL_ONE_MINUS_DST_COLOR },
+	{ "src_alpha", GL_SRC_ALPHA }, { "one_minus_src_alpha", GL_ONE_MINUS_SRC_ALPHA },
+	{ "dst_alpha", GL_DST_ALPHA }, { "one_minus_dst_alpha", GL_ONE_MINUS_DST_ALPHA },
+	{ "src_alpha_saturate", GL_SRC_ALPHA_SATURATE }
+};
+
+static const sceneToken primitives[] = {
+	{ "strip", GL_TRIANGLE_STRIP }, { "triangles", GL_TRIANGLES }, { "fan", GL_TRIANGLE_FAN }
+};
+
+static bool lookupToken(const sceneToken *tokens, size_t count, const string& name, GLenum *value) {
+	for (size_t i = 0; i < count; ++i) {
+
+		if (name == tokens[i].name) {
+
+			*value = tokens[i].value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool sceneError(const char *path, int line, const string& message) {
+	cout << "Scene: " << path << "(" << line << "): " << message << "\n";
+	return false;
+}
+
+static int findIndex(const map<string, int>& index, const string& name) {
+	map<string, int>::const_iterator i = index.find(name);
+	return (i != index.end()) ? i->second : -1;
+}
+
+// texture <name> <path> [colour_key_black] [premultiply_alpha] [size <width> <height>]
+static bool parseTexture(parsedScene& scene, istringstream& line, string *error) {
+	string name, path, option;
+
+	if (!(line >> name >> path)) {
+
+		*error = "texture needs a name and a path";
+		return false;
+	}
+
+	sceneTextureRecord t = {};
+
+	while (line >> option) {
+
+		if (option == "colour_key_black") {
+			t.loadFlags |= TEXTURE_LOAD_COLOUR_KEY_BLACK;
+		} else if (option == "premultiply_alpha") {
+			t.loadFlags |= TEXTURE_LOAD_PREMULTIPLY_ALPHA;
+		} else if (option == "size") {
+			if (!(line >> t.targetWidth >> t.targetHeight)) {
+				*error = "size needs a width and a height";
+				return false;
+			}
+		} else {
+			*error = "unknown texture option '" + option + "'";
+			return false;
+		}
+	}
+
+	scene.textureIndex[name] = int(scene.textures.size());
+	scene.textures.push_back(t);
+	scene.textureStrings.push_back(name);
+	scene.textureStrings.push_back(path);
+
+	return true;
+}
+
+// material <name> [texture <texture>] [blend <equation> <source> <destination>]
+static bool parseMaterial(parsedScene& scene, istringstream& line, string *error) {
+	string name, option;
+
+	if (!(line >> name)) {
+
+		*error = "material needs a name";
+		return false;
+	}
+
+	sceneMaterialRecord m = {};
+	m.texture = -1;
+
+	while (line >> option) {
+
+		if (option == "texture") {
+			string texture;
+			line >> texture;
+
+			if ((m.texture = findIndex(scene.textureIndex, texture)) < 0) {
+				*error = "unknown texture '" + texture + "'";
+				return false;
+			}
+		} else if (option == "blend") {
+			string equation, source, destination;
+			line >> equation >> source >> destination;
+
+			if (!lookupToken(blendEquations, sizeof(blendEquations) / sizeof(blendEquations[0]), equation, &m.blendEquation) ||
+				!lookupToken(blendFactors, sizeof(blendFactors) / sizeof(blendFactors[0]), source, &m.blendSource) ||
+				!lookupToken(blendFactors, sizeof(blendFactors) / sizeof(blendFactors[0]), destination, &m.blendDestination)) {
+				*error = "blend needs an equation and two factors";
+				return false;
+			}
+		} else {
+			*error = "unknown material option '" + option + "'";
+			return false;
+		}
+	}
+
+	scene.materialIndex[name] = int(scene.materials.size());
+	scene.materials.push_back(m);
+	scene.materialNames.push_back(name);
+
+	return true;
+}
+
+// node <name> [parent <node>] [mesh <mesh>] [material <material>] [layer <layer>] [at <x> <y>] [rotate <degrees>] [scale <x> <y>]
+static bool parseNode(parsedScene& scene, istringstream& line, string *error) {
+	string name, option;
+
+	if (!(line >> name)) {
+
+		*error = "node needs a name";
+		return false;
+	}
+
+	sceneNodeRecord n = {};
+	n.parent = n.mesh = n.material = -1;
+	n.scaleX = n.scaleY = 1.0f;
+
+	bool layerSet = false;
+
+	while (line >> option) {
+
+		string reference;
+		bool ok = true;
+
+		if (option == "parent") {
+			// parents must be declared first, which keeps the nodes in parent before child order
+			line >> reference;
+			ok = (n.parent = findIndex(scene.nodeIndex, reference)) >= 0;
+		} else if (option == "mesh") {
+			line >> reference;
+			ok = (n.mesh = findIndex(scene.meshIndex, reference)) >= 0;
+		} else if (option == "material") {
+			line >> reference;
+			ok = (n.material = findIndex(scene.materialIndex, reference)) >= 0;
+		} else if (option == "layer") {
+			ok = !!(line >> n.layer) && n.layer < 256;
+			layerSet = true;
+		} else if (option == "at") {
+			ok = !!(line >> n.x >> n.y);
+		} else if (option == "rotate") {
+			ok = !!(line >> n.rotation);
+			n.rotation *= 3.14159265f / 180.0f;
+		} else if (option == "scale") {
+			ok = !!(line >> n.scaleX >> n.scaleY);
+		} else {
+			*error = "unknown node option '" + option + "'";
+			return false;
+		}
+
+		if (!ok) {
+			*error = reference.empty() ? "'" + option + "' is missing its values" : "'" + reference + "' is not defined above this node";
+			return false;
+		}
+	}
+
+	// children are drawn in their parent's layer unless they say otherwise
+	if (!layerSet && n.parent >= 0)
+		n.layer = scene.nodes[n.parent].layer;
+
+	scene.nodeIndex[name] = int(scene.nodes.size());
+	scene.nodes.push_back(n);
+	scene.nodeNames.push_back(name);
+
+	return true;
+}
+
+// v <x> <y> [<r> <g> <b> <a> [<u> <v>]]
+static bool parseVertex(parsedMesh& mesh, istringstream& line, string *error) {
+	sceneVertex v = {};
+	unsigned colour[4];
+
+	if (!(line >> v.x >> v.y)) {
+
+		*error = "vertex needs a position";
+		return false;
+	}
+
+	// colour defaults to white - a failed read zeroes its target, so only copy a complete one
+	if (line >> colour[0] >> colour[1] >> colour[2] >> colour[3]) {
+
+		for (int i = 0; i < 4; ++i)
+			v.colour[i] = (unsigned char)(colour[i] > 255 ? 255 : colour[i]);
+
+		line >> v.u >> v.v;
+
+	} else {
+
+		memset(v.colour, 255, sizeof(v.colour));
+	}
+
+	mesh.vertices.push_back(v);
+
+	return true;
+}
+
+static bool parseSceneText(const char *path, parsedScene& scene) {
+	ifstream file(path);
+
+	if (!file.is_open())
+		return sceneError(path, 0, "cannot be opened");
+
+	parsedMesh *mesh = NULL; // mesh whose vertices are being read
+	string text, error;
+	int lineNumber = 0;
+
+	while (getline(file, text)) {
+
+		lineNumber++;
+
+		size_t comment = text.find('#');
+
+		if (comment != string::npos)
+			text.erase(comment);
+
+		istringstream line(text);
+		string keyword;
+
+		if (!(line >> keyword))
+			continue;
+
+		bool ok = true;
+
+		if (mesh) {
+
+			if (keyword == "v") {
+				ok = parseVertex(*mesh, line, &error);
+			} else if (keyword == "i") {
+				unsigned index;
+				while (line >> index)
+					mesh->indices.push_back((unsigned short)index);
+			} else if (keyword == "end") {
+				if (mesh->vertices.empty() || mesh->vertices.size() > 65535)
+					return sceneError(path, lineNumber, "mesh '" + mesh->name + "' needs between 1 and 65535 vertices");
+
+				// without an index list the vertices are drawn in order
+				if (mesh->indices.empty()) {
+					for (size_t i = 0; i < mesh->vertices.size(); ++i)
+						mesh->indices.push_back((unsigned short)i);
+				}
+
+				for (size_t i = 0; i < mesh->indices.size(); ++i) {
+					if (mesh->indices[i] >= mesh->vertices.size())
+						return sceneError(path, lineNumber, "mesh '" + mesh->name + "' has an index past its last vertex");
+				}
+
+				mesh = NULL;
+			} else {
+				error = "expected v, i or end inside mesh '" + mesh->name + "'";
+				ok = false;
+			}
+
+		} else if (keyword == "texture" || keyword == "material" || keyword == "mesh" || keyword == "node" || keyword == "param") {
+
+			string name;
+			streampos start = line.tellg();
+
+			// peek at the name to catch duplicates
+			line >> name;
+			line.clear();
+			line.seekg(start);
+
+			const map<string, int>& index = (keyword == "texture") ? scene.textureIndex : (keyword == "material") ? scene.materialIndex : (keyword == "mesh") ? scene.meshIndex : (keyword == "node") ? scene.nodeIndex : scene.parameterIndex;
+
+			if (!name.empty() && findIndex(index, name) >= 0)
+				return sceneError(path, lineNumber, keyword + " '" + name + "' is defined twice");
+
+			if (keyword == "texture") {
+				ok = parseTexture(scene, line, &error);
+			} else if (keyword == "material") {
+				ok = parseMaterial(scene, line, &error);
+			} else if (keyword == "node") {
+				ok = parseNode(scene, line, &error);
+			} else if (keyword == "mesh") {
+				// mesh <name> <strip | triangles | fan>, then its vertices up to "end"
+				string primitive;
+				parsedMesh m;
+
+				if (!(line >> m.name >> primitive) || !lookupToken(primitives, sizeof(primitives) / sizeof(primitives[0]), primitive, &m.primitive)) {
+					error = "mesh needs a name and one of strip, triangles or fan";
+					ok = false;
+				} else {
+					scene.meshIndex[m.name] = int(scene.meshes.size());
+					scene.meshes.push_back(m);
+					mesh = &scene.meshes.back();
+				}
+			} else {
+				// param <name> <value>
+				sceneParameterRecord p = {};
+
+				if (!(line >> name >> p.value)) {
+					error = "param needs a name and a value";
+					ok = false;
+				} else {
+					scene.parameterIndex[name] = int(scene.parameters.size());
+					scene.parameters.push_back(p);
+					scene.parameterNames.push_back(name);
+				}
+			}
+
+		} else {
+
+			error = "unknown keyword '" + keyword + "'";
+			ok = false;
+		}
+
+		if (!ok)
+			return sceneError(path, lineNumber, error);
+	}
+
+	if (mesh)
+		return sceneError(path, lineNumber, "mesh '" + mesh->name + "' has no end");
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region binary form
+
+static size_t alignUp(size_t n, size_t alignment) {
+	return (n + alignment - 1) & ~(alignment - 1);
+}
+
+// Point field (which lives in image) at the byte offset target of image
+template <typename T> static void link(char *image, T& field, size_t target) {
+	field.offset = int(ptrdiff_t(target) - ((char*)&field - image));
+}
+
+// Append a string to the string block, returning its offset in the image
+static size_t addString(string& strings, size_t stringsStart, const string& s) {
+	size_t offset = stringsStart + strings.size();
+
+	strings += s;
+	strings += '\0';
+
+	return offset;
+}
+
+static bool writeSceneImage(const parsedScene& scene, const char *binaryPath) {
+	size_t vertexCount = 0, indexCount = 0;
+
+	for (size_t i = 0; i < scene.meshes.size(); ++i) {
+
+		vertexCount += scene.meshes[i].vertices.size();
+		indexCount += scene.meshes[i].indices.size();
+	}
+
+	// layout: header, record tables, vertex data, index data, strings
+	size_t texturesStart = sizeof(sceneFileHeader);
+	size_t materialsStart = texturesStart + scene.textures.size() * sizeof(sceneTextureRecord);
+	size_t meshesStart = materialsStart + scene.materials.size() * sizeof(sceneMaterialRecord);
+	size_t nodesStart = meshesStart + scene.meshes.size() * sizeof(sceneMeshRecord);
+	size_t parametersStart = nodesStart + scene.nodes.size() * sizeof(sceneNodeRecord);
+	size_t verticesStart = parametersStart + scene.parameters.size() * sizeof(sceneParameterRecord);
+	size_t indicesStart = verticesStart + vertexCount * sizeof(sceneVertex);
+	size_t stringsStart = alignUp(indicesStart + indexCount * sizeof(unsigned short), 4);
+
+	string strings;
+	vector<size_t> textureStrings, materialNames, meshNames, nodeNames, parameterNames;
+
+	for (size_t i = 0; i < scene.textureStrings.size(); ++i)
+		textureStrings.push_back(addString(strings, stringsStart, scene.textureStrings[i]));
+
+	for (size_t i = 0; i < scene.materialNames.size(); ++i)
+		materialNames.push_back(addString(strings, stringsStart, scene.materialNames[i]));
+
+	for (size_t i = 0; i < scene.meshes.size(); ++i)
+		meshNames.push_back(addString(strings, stringsStart, scene.meshes[i].name));
+
+	for (size_t i = 0; i < scene.nodeNames.size(); ++i)
+		nodeNames.push_back(addString(strings, stringsStart, scene.nodeNames[i]));
+
+	for (size_t i = 0; i < scene.parameterNames.size(); ++i)
+		parameterNames.push_back(addString(strings, stringsStart, scene.parameterNames[i]));
+
+	// sized once up front, so pointers into the image stay valid while it is filled in
+	vector<char> bytes(alignUp(stringsStart + strings.size(), 4), 0);
+	char *image = &bytes[0];
+
+	sceneFileHeader *header = (sceneFileHeader*)image;
+
+	header->magic = SCENE_FILE_MAGIC;
+	header->version = SCENE_FILE_VERSION;
+	header->size = unsigned(bytes.size());
+
+	link(image, header->textures, texturesStart);
+	link(image, header->materials, materialsStart);
+	link(image, header->meshes, meshesStart);
+	link(image, header->nodes, nodesStart);
+	link(image, header->parameters, parametersStart);
+
+	header->textures.count = unsigned(scene.textures.size());
+	header->materials.count = unsigned(scene.materials.size());
+	header->meshes.count = unsigned(scene.meshes.size());
+	header->nodes.count = unsigned(scene.nodes.size());
+	header->parameters.count = unsigned(scene.parameters.size());
+
+	for (size_t i = 0; i < scene.textures.size(); ++i) {
+
+		sceneTextureRecord *t = (sceneTextureRecord*)(image + texturesStart) + i;
+
+		*t = scene.textures[i];
+		link(image, t->name, textureStrings[i * 2]);
+		link(image, t->path, textureStrings[i * 2 + 1]);
+	}
+
+	for (size_t i = 0; i < scene.materials.size(); ++i) {
+
+		sceneMaterialRecord *m = (sceneMaterialRecord*)(image + materialsStart) + i;
+
+		*m = scene.materials[i];
+		link(image, m->name, materialNames[i]);
+	}
+
+	size_t vertexOffset = verticesStart, indexOffset = indicesStart;
+
+	for (size_t i = 0; i < scene.meshes.size(); ++i) {
+
+		const parsedMesh& source = scene.meshes[i];
+		sceneMeshRecord *m = (sceneMeshRecord*)(image + meshesStart) + i;
+
+		m->primitive = source.primitive;
+		link(image, m->name, meshNames[i]);
+
+		memcpy(image + vertexOffset, &source.vertices[0], source.vertices.size() * sizeof(sceneVertex));
+		link(image, m->vertices, vertexOffset);
+		m->vertices.count = unsigned(source.vertices.size());
+		vertexOffset += source.vertices.size() * sizeof(sceneVertex);
+
+		memcpy(image + indexOffset, &source.indices[0], source.indices.size() * sizeof(unsigned short));
+		link(image, m->indices, indexOffset);
+		m->indices.count = unsigned(source.indices.size());
+		indexOffset += source.indices.size() * sizeof(unsigned short);
+	}
+
+	for (size_t i = 0; i < scene.nodes.size(); ++i) {
+
+		sceneNodeRecord *n = (sceneNodeRecord*)(image + nodesStart) + i;
+
+		*n = scene.nodes[i];
+		link(image, n->name, nodeNames[i]);
+	}
+
+	for (size_t i = 0; i < scene.parameters.size(); ++i) {
+
+		sceneParameterRecord *p = (sceneParameterRecord*)(image + parametersStart) + i;
+
+		*p = scene.parameters[i];
+		link(image, p->name, parameterNames[i]);
+	}
+
+	if (!strings.empty())
+		memcpy(image + stringsStart, strings.data(), strings.size());
+
+	ofstream file(binaryPath, ios::binary | ios::trunc);
+
+	if (!file.write(image, bytes.size())) {
+
+		cout << "Scene: could not write " << binaryPath << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region validation
+
+// Every array must lie inside the image after the header, aligned for its element type (records and vertices are made of 4 byte fields, indices are 2 bytes)
+template <typename T> static bool arrayInImage(const sceneFileHeader *scene, const sceneArray<T>& a) {
+	if (a.count == 0)
+		return true;
+
+	ptrdiff_t start = ((const char*)&a - (const char*)scene) + a.offset;
+	ptrdiff_t alignment = (sizeof(T) < 4) ? ptrdiff_t(sizeof(T)) : 4;
+
+	return start >= ptrdiff_t(sizeof(sceneFileHeader)) && start % alignment == 0 && size_t(start) + size_t(a.count) * sizeof(T) <= scene->size;
+}
+
+// Strings must start inside the image - the image ends with a terminator, so they cannot run off the end
+static bool stringInImage(const sceneFileHeader *scene, const sceneOffset<char>& s) {
+	ptrdiff_t start = ((const char*)&s - (const char*)scene) + s.offset;
+
+	return s.offset != 0 && start >= ptrdiff_t(sizeof(sceneFileHeader)) && size_t(start) < scene->size;
+}
+
+static bool validateSceneImage(const sceneFileHeader *scene, size_t fileSize) {
+	if (fileSize < sizeof(sceneFileHeader) || scene->magic != SCENE_FILE_MAGIC || scene->version != SCENE_FILE_VERSION || scene->size != fileSize || ((const char*)scene)[fileSize - 1] != '\0')
+		return false;
+
+	if (!arrayInImage(scene, scene->textures) || !arrayInImage(scene, scene->materials) || !arrayInImage(scene, scene->meshes) || !arrayInImage(scene, scene->nodes) || !arrayInImage(scene, scene->parameters))
+		return false;
+
+	for (unsigned i = 0; i < scene->textures.count; ++i) {
+
+		if (!stringInImage(scene, scene->textures[i].name) || !stringInImage(scene, scene->textures[i].path))
+			return false;
+	}
+
+	for (unsigned i = 0; i < scene->materials.count; ++i) {
+
+		const sceneMaterialRecord& m = scene->materials[i];
+
+		if (!stringInImage(scene, m.name) || m.texture < -1 || m.texture >= int(scene->textures.count))
+			return false;
+	}
+
+	for (unsigned i = 0; i < scene->meshes.count; ++i) {
+
+		const sceneMeshRecord& m = scene->meshes[i];
+
+		if (!stringInImage(scene, m.name) || !arrayInImage(scene, m.vertices) || !arrayInImage(scene, m.indices))
+			return false;
+
+		for (unsigned j = 0; j < m.indices.count; ++j) {
+
+			if (m.indices[j] >= m.vertices.count)
+				return false;
+		}
+	}
+
+	for (unsigned i = 0; i < scene->nodes.count; ++i) {
+
+		const sceneNodeRecord& n = scene->nodes[i];
+
+		if (!stringInImage(scene, n.name) || n.parent < -1 || n.parent >= int(i) || n.mesh < -1 || n.mesh >= int(scene->meshes.count) || n.material < -1 || n.material >= int(scene->materials.count) || n.layer > 255)
+			return false;
+	}
+
+	for (unsigned i = 0; i < scene->parameters.count; ++i) {
+
+		if (!stringInImage(scene, scene->parameters[i].name))
+			return false;
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+static time_t modificationTime(const string& path) {
+	struct stat fileStatus;
+	return (stat(path.c_str(), &fileStatus) == 0) ? fileStatus.st_mtime : 0;
+}
+
+bool compileSceneFile(const char *textPath, const char *binaryPath) {
+	parsedScene scene;
+
+	if (!parseSceneText(textPath, scene))
+		return false;
+
+	return writeSceneImage(scene, binaryPath);
+}
+
+// Map and validate a compiled scene.  Returns NULL without reporting if it is missing or invalid
+static const sceneFileHeader *mapSceneImage(const string& binaryPath) {
+	mappedFile view;
+
+	if (!mapFileView(binaryPath, &view))
+		return NULL;
+
+	if (!view.data || !validateSceneImage((const sceneFileHeader*)view.data, view.size)) {
+
+		unmapFileView(&view);
+		return NULL;
+	}
+
+	sceneMappings.push_back(view);
+
+	return (const sceneFileHeader*)view.data;
+}
+
+const sceneFileHeader *loadSceneFile(const char *textPath) {
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	string binaryPath = string(textPath) + "b";
+
+	time_t textTime = modificationTime(textPath);
+	bool compiled = false;
+
+	// rebuild when the text has been edited since the binary was written.  A binary shipped without its text is used as is
+	if (textTime != 0 && modificationTime(binaryPath) < textTime) {
+
+		if (!compileSceneFile(textPath, binaryPath.c_str()))
+			return NULL;
+
+		compiled = true;
+	}
+
+	const sceneFileHeader *scene = mapSceneImage(binaryPath);
+
+	// an image from an older version of the format is rebuilt once
+	if (!scene && !compiled && textTime != 0 && compileSceneFile(textPath, binaryPath.c_str())) {
+
+		compiled = true;
+		scene = mapSceneImage(binaryPath);
+	}
+
+	if (!scene) {
+
+		cout << "Scene: " << binaryPath << " is missing or invalid\n";
+		return NULL;
+	}
+
+	double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	cout << "Scene: " << (compiled ? "compiled and loaded " : "loaded ") << binaryPath << " (" << scene->nodes.count << " nodes, " << scene->meshes.count << " meshes, " << scene->size << " bytes) in " << ms << " ms\n";
+
+	return scene;
+}
+
+void releaseSceneFile(const sceneFileHeader *scene) {
+	for (size_t i = 0; i < sceneMappings.size(); ++i) {
+
+		if (sceneMappings[i].data == (const char*)scene) {
+
+			unmapFileView(&sceneMappings[i]);
+			sceneMappings.erase(sceneMappings.begin() + i);
+			return;
+		}
+	}
+}
+
+#pragma region lookup
+
+template <typename T> static int findByName(const sceneArray<T>& records, const char *name) {
+	for (unsigned i = 0; i < records.count; ++i) {
+
+		if (strcmp(records[i].name.get(), name) == 0)
+			return int(i);
+	}
+
+	return -1;
+}
+
+int findSceneTexture(const sceneFileHeader *scene, const char *name) {
+	return findByName(scene->textures, name);
+}
+
+int findSceneMaterial(const sceneFileHeader *scene, const char *name) {
+	return findByName(scene->materials, name);
+}
+
+int findSceneMesh(const sceneFileHeader *scene, const char *name) {
+	return findByName(scene->meshes, name);
+}
+
+int findSceneNode(const sceneFileHeader *scene, const char *name) {
+	return findByName(scene->nodes, name);
+}
+
+float sceneParameter(const sceneFileHeader *scene, const char *name, float defaultValue) {
+	int i = findByName(scene->parameters, name);
+	return (i >= 0) ? scene->parameters[i].value : defaultValue;
+}
+
+#pragma endregion
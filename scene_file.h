@@ -0,0 +1,100 @@
+//
+// Scene description files.  A scene (textures, materials, meshes, the node hierarchy and named animation parameters) is written as text and compiled into a binary image that is memory mapped and used in place.  Every record in the image is fixed size and refers to its arrays and strings by an offset relative to the field holding it, so loading is a map and a bounds check - no parsing, no allocation and no pointer fixing.  The binary is rebuilt from the text whenever the text is newer
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <cstddef>
+
+// Offset from this field to a T (0 = none)
+template <typename T> struct sceneOffset {
+	int				offset;
+
+	const T *get(void) const { return offset ? (const T*)((const char*)this + offset) : NULL; }
+};
+
+// Offset from this field to the first of count Ts
+template <typename T> struct sceneArray {
+	int				offset;
+	unsigned		count;
+
+	const T *data(void) const { return (const T*)((const char*)this + offset); }
+	const T& operator[](unsigned i) const { return data()[i]; }
+};
+
+struct sceneTextureRecord {
+	sceneOffset<char>	name;
+	sceneOffset<char>	path;
+	unsigned			loadFlags; // TEXTURE_LOAD_* flags
+	unsigned			targetWidth, targetHeight; // largest on-screen size, 0 = full size
+};
+
+struct sceneMaterialRecord {
+	sceneOffset<char>	name;
+	int					texture; // index into textures, -1 for vertex colour only
+	GLenum				blendEquation; // 0 = blending disabled
+	GLenum				blendSource, blendDestination;
+};
+
+// Interleaved vertex - position, RGBA colour and texture coordinate
+struct sceneVertex {
+	float				x, y;
+	unsigned char		colour[4];
+	float				u, v;
+};
+
+struct sceneMeshRecord {
+	sceneOffset<char>				name;
+	GLenum							primitive; // GL_TRIANGLE_STRIP, GL_TRIANGLES or GL_TRIANGLE_FAN
+	sceneArray<sceneVertex>			vertices;
+	sceneArray<unsigned short>		indices;
+};
+
+// Nodes are stored parents first, so they can be added to a sceneGraph in file order
+struct sceneNodeRecord {
+	sceneOffset<char>	name;
+	int					parent; // -1 for a root
+	int					mesh; // -1 for a node that only positions its children
+	int					material; // -1 for untextured vertex colour
+	unsigned			layer; // draw layer (0-255) - lower layers are drawn first
+	float				x, y;
+	float				rotation; // radians
+	float				scaleX, scaleY;
+};
+
+// Named value read by the animation code (speeds, limits and so on)
+struct sceneParameterRecord {
+	sceneOffset<char>	name;
+	float				value;
+};
+
+struct sceneFileHeader {
+	unsigned							magic;
+	unsigned							version;
+	unsigned							size; // bytes in the whole image
+	unsigned							reserved;
+
+	sceneArray<sceneTextureRecord>		textures;
+	sceneArray<sceneMaterialRecord>		materials;
+	sceneArray<sceneMeshRecord>			meshes;
+	sceneArray<sceneNodeRecord>			nodes;
+	sceneArray<sceneParameterRecord>	parameters;
+};
+
+// Compile a text scene into a binary image.  Errors are reported with their line number
+bool compileSceneFile(const char *textPath, const char *binaryPath);
+
+// Map the compiled form of a text scene (textPath + "b"), compiling it first if it is missing or older than the text.  Returns NULL if the scene cannot be compiled or the image fails validation.  The image stays mapped until releaseSceneFile
+const sceneFileHeader *loadSceneFile(const char *textPath);
+
+void releaseSceneFile(const sceneFileHeader *scene);
+
+// Find a record by name (-1 if there is none).  These are linear searches, meant for setup rather than per frame use
+int findSceneTexture(const sceneFileHeader *scene, const char *name);
+int findSceneMaterial(const sceneFileHeader *scene, const char *name);
+int findSceneMesh(const sceneFileHeader *scene, const char *name);
+int findSceneNode(const sceneFileHeader *scene, const char *name);
+
+// The value of a named parameter, or defaultValue if the scene does not set it
+float sceneParameter(const sceneFileHeader *scene, const char *name, float defaultValue);
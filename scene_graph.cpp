@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "scene_graph.h"
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace CoreStructures;
+
+// dirty values - a node is marked by setSceneNodeLocal / addSceneNode and recomputed by updateSceneGraph, which also uses the flag to tell children their parent moved
+static const unsigned char NODE_CLEAN = 0;
+static const unsigned char NODE_DIRTY = 1;
+
+SceneNode addSceneNode(sceneGraph& graph, SceneNode parent, const GUAffine2D& local) {
+	SceneNode node = SceneNode(graph.parent.size());
+
+	graph.parent.push_back(parent < node ? parent : -1);
+	graph.local.push_back(local);
+	graph.world.push_back(local);
+	graph.dirty.push_back(NODE_DIRTY);
+
+	if (graph.firstDirty > node)
+		graph.firstDirty = node;
+
+	return node;
+}
+
+void setSceneNodeLocal(sceneGraph& graph, SceneNode node, const GUAffine2D& local) {
+	if (memcmp(graph.local[node].M, local.M, sizeof(local.M)) == 0)
+		return;
+
+	graph.local[node] = local;
+	graph.dirty[node] = NODE_DIRTY;
+
+	if (graph.firstDirty > node)
+		graph.firstDirty = node;
+}
+
+unsigned updateSceneGraph(sceneGraph& graph) {
+	SceneNode count = SceneNode(graph.parent.size());
+	SceneNode first = graph.firstDirty;
+
+	unsigned updated = 0;
+
+	graph.moved.clear();
+
+	// parents come first, so by the time a node is reached its parent's world transform is final and its dirty flag says whether it changed this pass
+	const SceneNode		*parent = graph.parent.data();
+	const GUAffine2D	*local = graph.local.data();
+	GUAffine2D			*world = graph.world.data();
+	unsigned char		*dirty = graph.dirty.data();
+
+	for (SceneNode i = first; i < count; ++i) {
+
+		SceneNode p = parent[i];
+
+		if (p >= 0 && dirty[p])
+			dirty[i] = NODE_DIRTY;
+
+		if (!dirty[i])
+			continue;
+
+		world[i] = (p >= 0) ? world[p] * local[i] : local[i];
+		graph.moved.push_back(i);
+		updated++;
+	}
+
+	if (first < count)
+		memset(dirty + first, NODE_CLEAN, count - first);
+
+	graph.firstDirty = count;
+	graph.lastUpdated = updated;
+
+	return updated;
+}
+
+void clearSceneGraph(sceneGraph& graph) {
+	graph.parent.clear();
+	graph.local.clear();
+	graph.world.clear();
+	graph.dirty.clear();
+	graph.moved.clear();
+
+	graph.firstDirty = 0;
+	graph.lastUpdated = 0;
+}
+
+void sceneGraphBenchmark(void) {
+	const int noofNodes = 100000;
+	const int noofRoots = 1000;
+
+	sceneGraph graph;
+
+	graph.parent.reserve(noofNodes);
+	graph.local.reserve(noofNodes);
+	graph.world.reserve(noofNodes);
+	graph.dirty.reserve(noofNodes);
+	graph.moved.reserve(noofNodes);
+
+	// 1000 objects of 100 nodes each, every node hanging off an earlier node of the same object
+	unsigned seed = 12345;
+
+	for (int r = 0; r < noofRoots; ++r) {
+
+		SceneNode root = addSceneNode(graph, -1, GUAffine2D::translation(float(r % 40) * 0.05f, float(r / 40) * 0.05f));
+
+		for (int i = 1; i < noofNodes / noofRoots; ++i) {
+
+			seed = seed * 1664525u + 1013904223u;
+
+			SceneNode parent = root + SceneNode((seed >> 8) % unsigned(i));
+			addSceneNode(graph, parent, GUAffine2D::TRS(0.01f, 0.0f, 0.1f, 0.99f, 0.99f));
+		}
+	}
+
+	auto start = chrono::high_resolution_clock::now();
+	unsigned fullUpdated = updateSceneGraph(graph);
+	double fullMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	// move 1% of the objects
+	for (int r = 0; r < noofRoots; r += 100)
+		setSceneNodeLocal(graph, r * (noofNodes / noofRoots), GUAffine2D::translation(float(r), 1.0f));
+
+	start = chrono::high_resolution_clock::now();
+	unsigned partialUpdated = updateSceneGraph(graph);
+	double partialMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	start = chrono::high_resolution_clock::now();
+	unsigned cleanUpdated = updateSceneGraph(graph);
+	double cleanMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	cout << "Scene graph benchmark (" << noofNodes << " nodes)\n";
+	cout << "  full update:    " << fullUpdated << " nodes in " << fullMs << " ms\n";
+	cout << "  1% moved:       " << partialUpdated << " nodes in " << partialMs << " ms\n";
+	cout << "  nothing moved:  " << cleanUpdated << " nodes in " << cleanMs << " ms\n\n";
+}
@@ -0,0 +1,43 @@
+//
+// Flat scene graph.  Nodes live in parallel arrays in parent-before-child order (a node can only be added under an existing node), so world transforms are brought up to date in one linear pass: a node is recomputed if its local transform changed or its parent was recomputed earlier in the same pass.  Nothing before the first changed node is touched, and nothing is recomputed when nothing moved
+//
+
+#pragma once
+
+#include <CoreStructures\CoreStructures.h>
+#include <vector>
+
+// Index of a node in its scene graph.  -1 means no node (e.g. the parent of a root)
+typedef int SceneNode;
+
+struct sceneGraph {
+	std::vector<SceneNode>						parent;
+	std::vector<CoreStructures::GUAffine2D>		local;
+	std::vector<CoreStructures::GUAffine2D>		world;
+	std::vector<unsigned char>					dirty;
+	std::vector<SceneNode>						moved; // nodes whose world transform the last updateSceneGraph recomputed, in order
+
+	SceneNode		firstDirty; // lowest dirty index, or size() if nothing is dirty
+	unsigned		lastUpdated; // world transforms recomputed by the last updateSceneGraph
+
+	sceneGraph() : firstDirty(0), lastUpdated(0) {}
+};
+
+// Add a node under parent (-1 for a root) and return it.  The new node starts dirty
+SceneNode addSceneNode(sceneGraph& graph, SceneNode parent, const CoreStructures::GUAffine2D& local = CoreStructures::GUAffine2D::identity());
+
+// Set a node's transform relative to its parent.  Setting the transform it already has does not mark the node dirty
+void setSceneNodeLocal(sceneGraph& graph, SceneNode node, const CoreStructures::GUAffine2D& local);
+
+// Bring every world transform up to date and return how many were recomputed
+unsigned updateSceneGraph(sceneGraph& graph);
+
+// World transform of node as of the last updateSceneGraph
+inline const CoreStructures::GUAffine2D& sceneNodeWorld(const sceneGraph& graph, SceneNode node) {
+	return graph.world[node];
+}
+
+void clearSceneGraph(sceneGraph& graph);
+
+// Time full and incremental updates of a 100k node graph
+void sceneGraphBenchmark(void);
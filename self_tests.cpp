@@ -0,0 +1,785 @@
+#include "stdafx.h"
+#include "self_tests.h"
+#include "pixel_convert.h"
+#include "jpeg_decoder.h"
+#include "transform_buffer.h"
+#include "render_queue.h"
+#include "spatial_hash.h"
+#include "command_list.h"
+#include "thread_pool.h"
+#include "cpu_particles.h"
+#include "animation_curves.h"
+#include "collision_world.h"
+#include "tile_world.h"
+#include <FreeImage\FreeImagePlus.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static unsigned checksRun = 0, checksFailed = 0;
+
+// Count a check and print it if it failed
+static bool check(bool passed, const string& what) {
+	checksRun++;
+
+	if (!passed) {
+
+		checksFailed++;
+		cout << "  FAILED: " << what << "\n";
+	}
+
+	return passed;
+}
+
+#pragma region pixel conversion
+
+// The scalar kernels against the formulas they implement, then every SIMD kernel the CPU supports against the scalar kernels.  The odd pixel count leaves a tail after every vector width
+static void testPixelConvert(void) {
+	const size_t count = 64 * 1024 + 7;
+
+	vector<unsigned char> src(count * 3);
+	vector<unsigned char> reference(count * 4), result(count * 4);
+
+	for (size_t i = 0; i < src.size(); ++i)
+		src[i] = (i % 3072 < 256) ? 0 : (unsigned char)((i * 2654435761u) >> 24);
+
+	// BGR in, colour keyed: alpha is the brightest channel
+	convertRGBToRGBA(reference.data(), src.data(), count, PIXEL_CONVERT_SWAP_RB | PIXEL_CONVERT_COLOUR_KEY_BLACK, PIXEL_ISA_SCALAR);
+
+	bool converted = true;
+
+	for (size_t i = 0; i < count; ++i) {
+
+		const unsigned char *s = &src[i * 3], *d = &reference[i * 4];
+		unsigned char m = max(s[0], max(s[1], s[2]));
+
+		converted = converted && d[0] == s[2] && d[1] == s[1] && d[2] == s[0] && d[3] == m;
+	}
+
+	check(converted, "scalar convertRGBToRGBA swaps red and blue and keys alpha on brightness");
+
+	// every colour and alpha pair against round(c * a / 255)
+	vector<unsigned char> pairs(256 * 256 * 4);
+
+	for (unsigned c = 0; c < 256; ++c) {
+
+		for (unsigned a = 0; a < 256; ++a) {
+
+			unsigned char *p = &pairs[(c * 256 + a) * 4];
+
+			p[0] = p[1] = p[2] = (unsigned char)c;
+			p[3] = (unsigned char)a;
+		}
+	}
+
+	vector<unsigned char> premultiplied = pairs;
+
+	premultiplyAlpha(premultiplied.data(), 256 * 256, PIXEL_ISA_SCALAR);
+
+	bool exact = true;
+
+	for (unsigned c = 0; c < 256; ++c)
+		for (unsigned a = 0; a < 256; ++a)
+			exact = exact && premultiplied[(c * 256 + a) * 4] == (c * a * 2 + 255) / 510;
+
+	check(exact, "scalar premultiplyAlpha rounds c * a / 255 exactly");
+
+	PIXEL_ISA isaList[] = { PIXEL_ISA_SSSE3, PIXEL_ISA_AVX2, PIXEL_ISA_NEON };
+	unsigned flagList[] = { PIXEL_CONVERT_DEFAULT, PIXEL_CONVERT_SWAP_RB, PIXEL_CONVERT_COLOUR_KEY_BLACK, PIXEL_CONVERT_SWAP_RB | PIXEL_CONVERT_COLOUR_KEY_BLACK };
+
+	for (PIXEL_ISA isa : isaList) {
+
+		if (!pixelISASupported(isa))
+			continue;
+
+		string name = pixelISAName(isa);
+
+		for (unsigned flags : flagList) {
+
+			convertRGBToRGBA(reference.data(), src.data(), count, flags, PIXEL_ISA_SCALAR);
+			convertRGBToRGBA(result.data(), src.data(), count, flags, isa);
+
+			check(reference == result, name + " convertRGBToRGBA(flags " + to_string(flags) + ") matches the scalar kernel");
+		}
+
+		vector<unsigned char> simd = pairs;
+
+		premultiplyAlpha(simd.data(), 256 * 256, isa);
+
+		check(simd == premultiplied, name + " premultiplyAlpha matches the scalar kernel");
+	}
+}
+
+#pragma endregion
+
+#pragma region scaled JPEG decoding
+
+// Shipped JPEGs decoded for small targets come out at the smallest DCT scale that still covers the target both ways - a square target keeps the wide grass image at full size
+static void testScaledDecode(void) {
+	struct scaledDecodeCase {
+		const char	*filename;
+		unsigned	targetWidth, targetHeight;
+		unsigned	width, height; // expected size
+	} cases[] = {
+		{ "Assets\\sky.jpg", 100, 100, 100, 100 }, // 800x800 at 1/8
+		{ "Assets\\cloud.jpg", 60, 32, 60, 32 }, // 239x128 at 1/4
+		{ "Assets\\grass.jpg", 200, 30, 200, 38 }, // 800x151 at 1/4
+		{ "Assets\\grass.jpg", 100, 100, 800, 151 } // 1/2 would be 76 high
+	};
+
+	for (const scaledDecodeCase& c : cases) {
+
+		fipImage *I = decodeImageScaled(c.filename, c.targetWidth, c.targetHeight);
+		string name = string(c.filename) + " decoded for " + to_string(c.targetWidth) + "x" + to_string(c.targetHeight);
+
+		if (!check(I != NULL, name + " loads"))
+			continue;
+
+		check(I->getWidth() == c.width && I->getHeight() == c.height, name + " is " + to_string(c.width) + "x" + to_string(c.height) + " (got " + to_string(I->getWidth()) + "x" + to_string(I->getHeight()) + ")");
+
+		delete I;
+	}
+}
+
+#pragma endregion
+
+#pragma region frame transforms
+
+// Frames with more transforms than one page holds must give every transform its own slot, whether added one at a time or reserved in blocks that straddle pages
+static void testFrameTransforms(void) {
+	const int blocks = 7, blockSize = 300; // 2100 transforms, past four pages
+
+	beginTransformFrame(CoreStructures::GUMatrix4::identity());
+
+	vector<int> indices;
+
+	for (int b = 0; b < blocks; ++b) {
+
+		int first = reserveFrameTransforms(blockSize);
+
+		for (int i = 0; i < blockSize; ++i) {
+
+			int index = reservedFrameTransform(first, i);
+
+			setFrameTransform(index, CoreStructures::GUAffine2D::translation(float(index), float(b)));
+			indices.push_back(index);
+		}
+
+		indices.push_back(addFrameTransform(CoreStructures::GUAffine2D::translation(-1.0f, float(b))));
+	}
+
+	vector<int> sortedIndices = indices;
+	sort(sortedIndices.begin(), sortedIndices.end());
+
+	check(unique(sortedIndices.begin(), sortedIndices.end()) == sortedIndices.end(), "frame transforms past FRAME_TRANSFORM_CAPACITY get distinct indices");
+
+	// each slot still holds what was written to it (the translation is the last column of each row)
+	bool kept = true;
+
+	for (size_t i = 0; i < indices.size(); ++i) {
+
+		const float *rows = frameTransformRows(indices[i]);
+		bool added = (i % (blockSize + 1)) == blockSize;
+
+		kept = kept && rows[2] == (added ? -1.0f : float(indices[i])) && rows[6] == float(i / (blockSize + 1));
+	}
+
+	check(kept, "every frame transform keeps its own value when the frame overflows a page");
+}
+
+#pragma endregion
+
+#pragma region render queue
+
+// Queue one frame of a known scene: four commands in layer 1 submitted first, then 64 in layer 0 alternating between two programs (program and program + 1) and (every other command) two textures
+static void queueTestFrame(GLuint program) {
+	beginRenderQueue();
+
+	renderCommand c = { program, 10, -1, 0, 1, GL_TRIANGLES, 0, 6, GL_UNSIGNED_SHORT, 0 };
+
+	for (int i = 0; i < 4; ++i)
+		submitRenderCommand(c, 1);
+
+	for (int i = 0; i < 64; ++i) {
+
+		c.program = program + GLuint(i % 2);
+		c.texture = GLuint(10 + (i / 2) % 2);
+		submitRenderCommand(c, 0);
+	}
+}
+
+// State change counts for the scene above.  Sorted, layer 0 needs 4 changes for its first command then 4 more between its four program/texture groups, and layer 1 after it needs a program and a texture change - 8 if layer 1 were wrongly merged into layer 0's first group.  Unsorted it is 4 to start, a program change on every command after that and a texture change every other one
+static void testRenderQueue(void) {
+	queueTestFrame(1);
+
+	check(getRenderQueueStats().unsortedChanges == 98, "render queue counts submission order state changes");
+	check(getRenderQueueStats().sortedChanges == 10, "render queue sorts by state within layers and keeps layers in order");
+
+	// a new program every frame for longer than the key has program ids for - the ids must start again each frame, or two programs first seen after that would end up sharing the last one
+	for (int frame = 0; frame < 300; ++frame) {
+
+		beginRenderQueue();
+
+		renderCommand c = { GLuint(1000 + frame), 10, -1, 0, 1, GL_TRIANGLES, 0, 6, GL_UNSIGNED_SHORT, 0 };
+		submitRenderCommand(c, 0);
+		getRenderQueueStats();
+	}
+
+	queueTestFrame(2000);
+
+	check(getRenderQueueStats().sortedChanges == 10, "render queue still groups by program after many programs have come and gone");
+}
+
+#pragma endregion
+
+#pragma region spatial hash
+
+static float testRandom(unsigned& seed) {
+	seed = seed * 1664525u + 1013904223u;
+
+	return float(seed >> 8) / float(1 << 24);
+}
+
+static bool boundsOverlap(const spatialBounds& a, const spatialBounds& b) {
+	return a.minX <= b.maxX && a.maxX >= b.minX && a.minY <= b.maxY && a.maxY >= b.minY;
+}
+
+// Queries against testing every object, after objects have been added (some too big to file by cell, some straddling the origin), moved across cells and removed
+static void testSpatialHash(void) {
+	const int noofObjects = 5000;
+	const float worldSize = 20.0f;
+
+	spatialHash hash;
+	initSpatialHash(hash, 0.25f, 1024);
+
+	vector<spatialBounds> objects(noofObjects);
+	vector<bool> removed(noofObjects, false);
+	unsigned seed = 12345;
+	bool inOrder = true;
+
+	for (int i = 0; i < noofObjects; ++i) {
+
+		float x = (testRandom(seed) - 0.5f) * worldSize, y = (testRandom(seed) - 0.5f) * worldSize;
+		float size = (i % 100 == 0) ? 2.0f + testRandom(seed) * 8.0f : 0.02f + testRandom(seed) * 0.3f;
+		spatialBounds b = { x, y, x + size, y + size };
+
+		objects[i] = b;
+		inOrder = inOrder && addSpatialObject(hash, b) == i;
+	}
+
+	check(inOrder, "spatial hash ids are handed out in order");
+
+	// move a tenth of them far enough to change cells (and some small ones big enough to become oversized), and remove another tenth
+	for (int i = 0; i < noofObjects; i += 10) {
+
+		spatialBounds& b = objects[i];
+		float dx = (testRandom(seed) - 0.5f) * 4.0f, grow = (i % 200 == 0) ? 5.0f : 0.0f;
+
+		b.minX += dx; b.maxX += dx + grow; b.maxY += grow;
+		updateSpatialObject(hash, i, b);
+
+		removeSpatialObject(hash, i + 5);
+		removed[i + 5] = true;
+	}
+
+	bool same = true;
+
+	for (int q = 0; q < 200; ++q) {
+
+		float x = (testRandom(seed) - 0.5f) * worldSize, y = (testRandom(seed) - 0.5f) * worldSize, size = testRandom(seed) * 6.0f;
+		spatialBounds rect = { x, y, x + size, y + size * 0.5f };
+
+		vector<int> found, expected;
+		querySpatialHash(hash, rect, found);
+
+		for (int i = 0; i < noofObjects; ++i) {
+
+			if (!removed[i] && boundsOverlap(objects[i], rect))
+				expected.push_back(i);
+		}
+
+		sort(found.begin(), found.end());
+		same = same && found == expected;
+	}
+
+	check(same, "spatial hash queries find each overlapping object exactly once, as testing every object does");
+}
+
+#pragma endregion
+
+#pragma region command lists
+
+// Record a draw for each object in [begin, end) that isn't culled (every third one is), as the scene does for its nodes
+static void recordTestObjects(int begin, int end, commandList& list) {
+	for (int i = begin; i < end; ++i) {
+
+		if (i % 3 == 0)
+			continue;
+
+		renderCommand command = { 1 + GLuint(i % 3), GLuint(i % 11), i % 5 - 1, i % 2, 1 + GLuint(i % 7), GL_TRIANGLE_STRIP, i, 4, GL_UNSIGNED_SHORT, i };
+
+		recordCommand(list, command, unsigned(i % 4));
+	}
+}
+
+// Recording across the thread pool into a list per chunk must give, in chunk order, exactly the list one thread records - including when the lists are reused for a second frame
+static void testCommandLists(void) {
+	const int noofObjects = 20000, grain = 256;
+
+	commandList serialList;
+	recordTestObjects(0, noofObjects, serialList);
+
+	vector<commandList> lists(parallelChunks(noofObjects, grain));
+	bool same = true;
+
+	for (int frame = 0; frame < 2; ++frame) {
+
+		parallelFor(noofObjects, grain, [&](int begin, int end, int chunk) {
+			resetCommandList(lists[chunk]);
+			recordTestObjects(begin, end, lists[chunk]);
+		});
+
+		vector<recordedCommand> merged;
+
+		for (size_t i = 0; i < lists.size(); ++i)
+			merged.insert(merged.end(), lists[i].commands.begin(), lists[i].commands.end());
+
+		same = same && merged.size() == serialList.commands.size() && memcmp(merged.data(), serialList.commands.data(), merged.size() * sizeof(recordedCommand)) == 0;
+	}
+
+	check(lists.size() > 1, "command list test splits its objects into several chunks");
+	check(same, "command lists recorded across the thread pool match the list recorded on one thread");
+}
+
+#pragma endregion
+
+#pragma region CPU particles
+
+static bool samePools(const cpuParticlePool& a, const cpuParticlePool& b) {
+	if (a.count != b.count)
+		return false;
+
+	if (a.count == 0)
+		return true;
+
+	const vector<float> *fieldsA[] = { &a.x, &a.y, &a.velocityX, &a.velocityY, &a.accelerationX, &a.accelerationY, &a.drag, &a.age, &a.life, &a.sizeStart, &a.sizeEnd };
+	const vector<float> *fieldsB[] = { &b.x, &b.y, &b.velocityX, &b.velocityY, &b.accelerationX, &b.accelerationY, &b.drag, &b.age, &b.life, &b.sizeStart, &b.sizeEnd };
+
+	for (int i = 0; i < 11; ++i) {
+
+		if (memcmp(fieldsA[i]->data(), fieldsB[i]->data(), a.count * sizeof(float)) != 0)
+			return false;
+	}
+
+	return memcmp(a.colourStart.data(), b.colourStart.data(), a.count * sizeof(unsigned)) == 0 && memcmp(a.colourEnd.data(), b.colourEnd.data(), a.count * sizeof(unsigned)) == 0;
+}
+
+// Steps across the thread pool against steps on one thread, with particles dying, being compacted and being emitted every step.  Each chunk does the same operations in the same order, so the pools and sprites must be bit for bit the same
+static void testCpuParticles(void) {
+	const unsigned capacity = 50000;
+	const float timeStep = 1.0f / 60.0f;
+
+	// lives from 0.05 - 0.5 seconds, so plenty die over the steps below.  Everything emitted fits, so none are dropped
+	particleEmission fill = { 0.0f, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.05f, 0.5f, 0.02f, 0.01f, 0.0f, -1.0f, 0.5f, 0.0f, 0xFFFFFFFF, 0x00000000, 0, capacity / 2 };
+	particleEmission topUp = fill;
+
+	topUp.count = capacity / 40;
+
+	cpuParticleSystem serial, parallel;
+	vector<cpuParticleVertex> serialSprites(capacity), parallelSprites(capacity);
+
+	allocateCpuParticles(serial, capacity);
+	allocateCpuParticles(parallel, capacity);
+
+	bool same = true, died = false;
+
+	for (int step = 0; step < 20; ++step) {
+
+		emitCpuParticles(serial, (step == 0) ? fill : topUp);
+		emitCpuParticles(parallel, (step == 0) ? fill : topUp);
+
+		stepCpuParticles(serial, timeStep, serialSprites.data(), false);
+		stepCpuParticles(parallel, timeStep, parallelSprites.data(), true);
+
+		unsigned live = serial.pools[serial.current].count;
+
+		same = same && samePools(serial.pools[serial.current], parallel.pools[parallel.current]) && memcmp(serialSprites.data(), parallelSprites.data(), live * sizeof(cpuParticleVertex)) == 0;
+		died = died || live < serial.totalEmitted;
+	}
+
+	check(died, "CPU particle test has particles dying");
+	check(same, "CPU particle steps across the thread pool match steps on one thread");
+}
+
+#pragma endregion
+
+#pragma region animation curves
+
+static const unsigned	TEST_CURVE_KEYS = 8;
+static const float		TEST_KEY_SPACING = 0.25f;
+
+// The value gu_math gives for a test track at time (within its first and last keys) - cspline through the keys (with the end knots doubled up) for a spline track, smoothstep or lerp between the keys either side for the others
+static float referenceCurveValue(const float *keyValues, curveEase ease, float trackGain, float time) {
+	float knots[TEST_CURVE_KEYS + 2];
+
+	for (unsigned k = 0; k < TEST_CURVE_KEYS; ++k)
+		knots[k + 1] = keyValues[k];
+
+	knots[0] = knots[1];
+	knots[TEST_CURVE_KEYS + 1] = knots[TEST_CURVE_KEYS];
+
+	float duration = float(TEST_CURVE_KEYS - 1) * TEST_KEY_SPACING;
+
+	if (ease == CURVE_SPLINE)
+		return cspline(time / duration, int(TEST_CURVE_KEYS + 2), knots);
+
+	unsigned span = min(unsigned(time / TEST_KEY_SPACING), TEST_CURVE_KEYS - 2);
+	float u = clamp((time - float(span) * TEST_KEY_SPACING) / TEST_KEY_SPACING, 0.0f, 1.0f);
+
+	if (ease == CURVE_SMOOTH)
+		return lerp(keyValues[span], keyValues[span + 1], smoothstep(gain(u, trackGain), 0.0f, 1.0f));
+
+	return lerp(keyValues[span], keyValues[span + 1], u);
+}
+
+// Batched updates across the thread pool against curveValue and against gu_math, for splines, smoothstepped and straight tracks with every wrap, some running backwards.  The clocks must stay within one period however long the set runs
+static void testAnimationCurves(void) {
+	const unsigned noofTracks = 20000;
+	const float duration = float(TEST_CURVE_KEYS - 1) * TEST_KEY_SPACING;
+
+	animationCurves curves;
+	vector<float> keyValues(noofTracks * TEST_CURVE_KEYS), values(noofTracks);
+	vector<curveEase> eases(noofTracks);
+	unsigned seed = 12345;
+
+	for (unsigned i = 0; i < noofTracks; ++i) {
+
+		curveEase ease = eases[i] = (i % 3 == 0) ? CURVE_SPLINE : ((i % 3 == 1) ? CURVE_SMOOTH : CURVE_LINEAR);
+		curveKey keys[TEST_CURVE_KEYS];
+
+		for (unsigned k = 0; k < TEST_CURVE_KEYS; ++k) {
+
+			keys[k].time = float(k) * TEST_KEY_SPACING;
+			keys[k].value = keyValues[i * TEST_CURVE_KEYS + k] = testRandom(seed) * 2.0f - 1.0f;
+			keys[k].ease = ease;
+		}
+
+		float trackGain = (ease == CURVE_SMOOTH) ? 0.2f + testRandom(seed) * 0.6f : 0.5f;
+		int track = addCurveTrack(curves, keys, TEST_CURVE_KEYS, curveWrap((i / 3) % 3), i, 0.0f, trackGain);
+
+		setCurveTime(curves, track, testRandom(seed) * 2.0f);
+		setCurveSpeed(curves, track, (testRandom(seed) - 0.3f) * 4.0f);
+	}
+
+	float batchDifference = 0.0f, referenceDifference = 0.0f;
+	bool bounded = true;
+
+	// long steps as well as frame sized ones, so the clocks go round many times
+	for (int step = 0; step < 200; ++step) {
+
+		updateAnimationCurves(curves, (step % 10 == 0) ? 7.3f : 1.0f / 60.0f, values.data());
+
+		for (unsigned i = 0; i < noofTracks; ++i) {
+
+			float time = curves.time[i];
+			float value = values[curves.output[i]];
+
+			batchDifference = max(batchDifference, fabsf(value - curveValue(curves, int(i), time)));
+
+			// where the clock is on the keys, as the wrap takes it
+			float t = time;
+
+			if (curves.wrap[i] == CURVE_LOOP) {
+
+				bounded = bounded && t >= 0.0f && t <= duration;
+
+			} else if (curves.wrap[i] == CURVE_PINGPONG) {
+
+				bounded = bounded && t >= 0.0f && t <= 2.0f * duration;
+				t = (t > duration) ? 2.0f * duration - t : t;
+
+			} else {
+
+				bounded = bounded && t >= 0.0f && t <= duration;
+			}
+
+			referenceDifference = max(referenceDifference, fabsf(value - referenceCurveValue(&keyValues[i * TEST_CURVE_KEYS], eases[i], curves.gain[i], t)));
+		}
+	}
+
+	check(batchDifference <= 1e-6f, "batched animation curve updates give what curveValue does (largest difference " + to_string(batchDifference) + ")");
+	check(referenceDifference <= 1e-4f, "animation curves follow cspline, smoothstep and lerp (largest difference " + to_string(referenceDifference) + ")");
+	check(bounded, "animation curve clocks stay within one period of their wrap");
+}
+
+#pragma endregion
+
+#pragma region collisions
+
+// count missiles - circles and boxes 0.01 - 0.04 across - moving about a square worldSize across, above a ground box and among a few clouds.  Bodies are added in the same order every time, so two worlds built with the same seed have the same ids
+static void buildTestWorld(collisionWorld& world, vector<float>& velocities, int count, float worldSize) {
+	initCollisionWorld(world, 0.05f, 1 << 16);
+	velocities.resize(count * 2);
+
+	unsigned seed = 12345;
+	unsigned missileMask = COLLISION_MISSILE | COLLISION_GROUND | COLLISION_CLOUD;
+
+	for (int i = 0; i < count; ++i) {
+
+		float x = (testRandom(seed) - 0.5f) * worldSize, y = (testRandom(seed) - 0.5f) * worldSize;
+		float size = 0.005f + testRandom(seed) * 0.015f;
+
+		if (i % 2 == 0) {
+
+			addCollisionCircle(world, x, y, size, COLLISION_MISSILE, missileMask);
+
+		} else {
+
+			spatialBounds b = { x - size, y - size * 0.5f, x + size, y + size * 0.5f };
+			addCollisionBox(world, b, COLLISION_MISSILE, missileMask);
+		}
+
+		float angle = testRandom(seed) * 6.2831853f, speed = 0.2f + testRandom(seed) * 0.8f;
+
+		velocities[i * 2] = cosf(angle) * speed;
+		velocities[i * 2 + 1] = sinf(angle) * speed;
+	}
+
+	spatialBounds ground = { -worldSize, -worldSize, worldSize, -worldSize * 0.4f };
+	addCollisionBox(world, ground, COLLISION_GROUND, 0);
+
+	for (int c = 0; c < 8; ++c) {
+
+		float x = (testRandom(seed) - 0.5f) * worldSize, y = (testRandom(seed) - 0.5f) * worldSize;
+		spatialBounds cloud = { x - 0.5f, y - 0.2f, x + 0.5f, y + 0.2f };
+
+		addCollisionBox(world, cloud, COLLISION_CLOUD, 0);
+	}
+}
+
+// move the missiles on a frame, bouncing them off the edges of the world
+static void moveTestBodies(collisionWorld& world, vector<float>& velocities, int count, float worldSize) {
+	const float timeStep = 1.0f / 60.0f;
+	float edge = worldSize * 0.5f;
+
+	for (int i = 0; i < count; ++i) {
+
+		float *v = &velocities[i * 2];
+
+		v[0] = (fabsf(world.bodies[i].x + v[0] * timeStep) > edge) ? -v[0] : v[0];
+		v[1] = (fabsf(world.bodies[i].y + v[1] * timeStep) > edge) ? -v[1] : v[1];
+
+		moveCollisionBody(world, i, world.bodies[i].x + v[0] * timeStep, world.bodies[i].y + v[1] * timeStep);
+	}
+}
+
+static bool sameContacts(const vector<collisionContact>& a, const vector<collisionContact>& b) {
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(collisionContact)) == 0);
+}
+
+static bool sameEvents(const vector<collisionEvent>& a, const vector<collisionEvent>& b) {
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); ++i) {
+
+		if (a[i].type != b[i].type || a[i].contact.a != b[i].contact.a || a[i].contact.b != b[i].contact.b)
+			return false;
+	}
+
+	return true;
+}
+
+// The grid's contacts against testing every pair on a world small enough for that, with some bodies removed part way, then 100,000 bodies updated on one thread against across the thread pool
+static void testCollisions(void) {
+	const int smallCount = 3000;
+	const float smallSize = 5.0f;
+
+	collisionWorld small;
+	vector<float> velocities;
+	vector<bool> removed;
+
+	buildTestWorld(small, velocities, smallCount, smallSize);
+	removed.assign(small.bodies.size(), false);
+
+	bool same = true, touched = false;
+
+	for (int update = 0; update < 10; ++update) {
+
+		moveTestBodies(small, velocities, smallCount, smallSize);
+
+		if (update == 5) {
+
+			for (int i = 0; i < smallCount; i += 7) {
+
+				removeCollisionBody(small, i);
+				removed[i] = true;
+			}
+		}
+
+		updateCollisionWorld(small);
+
+		// every pair whose groups collide, in id order as the world keeps its contacts
+		vector<collisionContact> expected;
+		int count = int(small.bodies.size());
+
+		for (int a = 0; a < count; ++a) {
+			for (int b = a + 1; b < count; ++b) {
+
+				const collisionBody& bodyA = small.bodies[a];
+				const collisionBody& bodyB = small.bodies[b];
+				collisionContact contact;
+
+				if (removed[a] || removed[b] || ((bodyA.mask & bodyB.group) | (bodyB.mask & bodyA.group)) == 0 || !collisionBodiesTouch(bodyA, bodyB, &contact))
+					continue;
+
+				contact.a = a;
+				contact.b = b;
+				expected.push_back(contact);
+			}
+		}
+
+		same = same && sameContacts(small.contacts, expected);
+		touched = touched || !expected.empty();
+	}
+
+	check(touched, "collision test has bodies touching");
+	check(same, "the collision grid finds the same contacts as testing every pair");
+
+	// the same moves on one thread and across the pool must give the same contacts and events, update after update
+	const int largeCount = 100000;
+	const float largeSize = 30.0f;
+
+	collisionWorld serial, parallel;
+	vector<float> serialVelocities, parallelVelocities;
+
+	buildTestWorld(serial, serialVelocities, largeCount, largeSize);
+	buildTestWorld(parallel, parallelVelocities, largeCount, largeSize);
+
+	same = true;
+
+	for (int update = 0; update < 5; ++update) {
+
+		moveTestBodies(serial, serialVelocities, largeCount, largeSize);
+		moveTestBodies(parallel, parallelVelocities, largeCount, largeSize);
+
+		updateCollisionWorld(serial, false);
+		updateCollisionWorld(parallel, true);
+
+		same = same && sameContacts(serial.contacts, parallel.contacts) && sameEvents(serial.events, parallel.events);
+	}
+
+	check(same, "collision updates of 100,000 bodies across the thread pool match updates on one thread");
+}
+
+#pragma endregion
+
+#pragma region tile world
+
+// Chunks in the rectangle of chunks within margin chunks of view, as the tile world counts them
+static unsigned chunksAround(const spatialBounds& view, int margin) {
+	int minX = int(floorf(view.minX / TILE_CHUNK_SIZE)) - margin, maxX = int(floorf(view.maxX / TILE_CHUNK_SIZE)) + margin;
+	int minY = int(floorf(view.minY / TILE_CHUNK_SIZE)) - margin, maxY = int(floorf(view.maxY / TILE_CHUNK_SIZE)) + margin;
+
+	return unsigned(maxX - minX + 1) * unsigned(maxY - minY + 1);
+}
+
+// Update the world each "frame" at view until nothing is pending, as the draw loop would.  Returns false if a frame ever had more chunks resident than the keep range holds, or it never settled
+static bool settleTileWorld(const spatialBounds& view) {
+	unsigned keep = chunksAround(view, TILE_KEEP_MARGIN);
+	bool bounded = true;
+
+	for (int frame = 0; frame < 5000; ++frame) {
+
+		updateTileWorld(view);
+
+		const tileWorldStats& stats = getTileWorldStats();
+
+		bounded = bounded && stats.resident <= keep && stats.resident + stats.pending <= max(keep, unsigned(INITIAL_TILE_CHUNKS));
+
+		if (stats.pending == 0)
+			return bounded;
+
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+
+	return false;
+}
+
+// Stream the world without GL buffers while the camera settles, steps one chunk across and back, jumps away and zooms out past the initial pool.  Each time exactly the load range ends up resident, chunks between the load and keep margins stay, and nothing already resident is generated again
+static void testTileWorld(void) {
+	startTileWorld(1, false);
+
+	spatialBounds view = { -1.0f, -1.0f, 1.0f, 1.0f };
+	vector<tileChunkDraw> chunks;
+
+	check(settleTileWorld(view) && getTileWorldStats().resident == chunksAround(view, TILE_LOAD_MARGIN), "tile world streams in every chunk of the load range and stays within the keep range");
+
+	visibleTileChunks(view, chunks);
+	check(chunks.size() == chunksAround(view, 0), "every tile chunk in view is resident once the world settles");
+
+	// one chunk to the right - the column left behind is inside the keep margin, so it stays
+	unsigned evicted = getTileWorldStats().evicted;
+	spatialBounds step = { view.minX + TILE_CHUNK_SIZE, view.minY, view.maxX + TILE_CHUNK_SIZE, view.maxY };
+
+	bool settled = settleTileWorld(step);
+
+	spatialBounds both = { view.minX, view.minY, step.maxX, step.maxY };
+
+	check(settled && getTileWorldStats().evicted == evicted && getTileWorldStats().resident == chunksAround(both, TILE_LOAD_MARGIN), "tile chunks between the load and keep margins stay resident when the camera steps one chunk");
+
+	unsigned generated = getTileWorldStats().generated;
+
+	updateTileWorld(view);
+	check(getTileWorldStats().pending == 0 && getTileWorldStats().generated == generated, "stepping the camera back needs no chunks generated again");
+
+	// far away - everything resident is dropped and the new load range streamed in
+	spatialBounds away = { view.minX + 100.0f, view.minY - 50.0f, view.maxX + 100.0f, view.maxY - 50.0f };
+
+	unsigned resident = getTileWorldStats().resident;
+	evicted = getTileWorldStats().evicted;
+
+	settled = settleTileWorld(away);
+
+	check(settled && getTileWorldStats().evicted == evicted + resident && getTileWorldStats().resident == chunksAround(away, TILE_LOAD_MARGIN), "tile world drops every chunk out of range and streams in the new view after a jump");
+
+	// zoomed out far enough that the keep range is bigger than the initial pool
+	spatialBounds wide = { -20.0f, -20.0f, 20.0f, 20.0f };
+
+	check(chunksAround(wide, TILE_KEEP_MARGIN) > INITIAL_TILE_CHUNKS, "the zoomed out tile view needs more chunks than the initial pool");
+	check(settleTileWorld(wide) && getTileWorldStats().resident == chunksAround(wide, TILE_LOAD_MARGIN), "tile world grows its pool to stream in a view wider than the initial pool");
+
+	stopTileWorld();
+}
+
+#pragma endregion
+
+unsigned runSelfTests(void) {
+	checksRun = checksFailed = 0;
+
+	cout << "Running self tests\n";
+
+	// a few workers even on a single core machine, so the threaded checks really run threaded
+	startThreadPool(4);
+
+	testPixelConvert();
+	testScaledDecode();
+	testFrameTransforms();
+	testRenderQueue();
+	testSpatialHash();
+	testCommandLists();
+	testCpuParticles();
+	testAnimationCurves();
+	testCollisions();
+	testTileWorld();
+
+	cout << checksRun - checksFailed << " of " << checksRun << " checks passed\n";
+
+	return checksFailed;
+}
@@ -0,0 +1,8 @@
+//
+// Correctness checks for the CPU side of the engine.  "CS2S565 --test" runs them without opening a window and exits non-zero if any fail
+//
+
+#pragma once
+
+// Run every check and print the ones that fail.  Returns how many failed
+unsigned runSelfTests(void);
@@ -1,337 +1,415 @@
 #include "stdafx.h"
 #include "shader_setup.h"
-#include <sys/types.h>
-#include <sys/stat.h>
+#include "gl_extensions.h"
+#include "shader_source.h"
+#include <map>
+#include <vector>
 #include <iostream>
-#include <fstream>
 
 using namespace std;
 
 // private function declarations
 
-static GLSL_ERROR createShaderFromFile(GLenum shaderType, const string& shaderFilePath, GLuint *shaderObject, const string **shaderSource);
-static const string *shaderSourceStringFromFile(const string& filePath);
+static GLSL_ERROR createShaderFromFile(GLenum shaderType, const string& shaderFilePath, const string& defines, GLuint *shaderObject);
 static void printSourceListing(const string& sourceString, bool showLineNumbers = true);
 static void reportProgramInfoLog(GLuint program);
 static void reportShaderInfoLog(GLuint shader);
+static GLSL_ERROR replaceProgramShaders(GLuint *program, GLuint scratchProgram);
+
+// programs submitted but not yet collected, with the paths needed to list the sources if compilation failed.  Compute programs keep their shader's path in vsPath
+struct pendingProgram {
+	string			vsPath, fsPath, defines;
+};
+
+static map<GLuint, pendingProgram>		pendingPrograms;
 
 // main shader loader function
 
-GLuint setupShaders(const string& vsPath, const string& fsPath, GLSL_ERROR *error_result) {
+GLuint setupShaders(const string& vsPath, const string& fsPath, GLSL_ERROR *error_result, bool retrievableBinary, const string& defines) {
 
-	GLuint					vertexShader = 0, fragmentShader = 0, glslProgram = 0;
-	const string			*vertexShaderSource = NULL, *fragmentShaderSource = NULL;
+	GLuint glslProgram = submitShaders(vsPath, fsPath, error_result, retrievableBinary, defines);
 
-	// create vertex shader object
-	GLSL_ERROR err = createShaderFromFile(GL_VERTEX_SHADER, vsPath, &vertexShader, &vertexShaderSource);
+	if (!glslProgram)
+		return 0;
 
-	if (err != GLSL_OK) {
+	GLSL_ERROR err = collectShaders(glslProgram);
 
-		switch (err) {
+	if (error_result)
+		*error_result = err;
 
-		case GLSL_SHADER_SOURCE_NOT_FOUND:
+	return (err == GLSL_OK) ? glslProgram : 0;
+}
 
-			printf("Vertex shader source not found.  Ensure the GUShaderSource object for the vertex shader has been created successfully.\n");
+// non-blocking build - compile and link without querying any status so the driver can work on several programs at once
 
-			if (error_result)
-				*error_result = GLSL_VERTEX_SHADER_SOURCE_NOT_FOUND;
+GLuint submitShaders(const string& vsPath, const string& fsPath, GLSL_ERROR *error_result, bool retrievableBinary, const string& defines) {
 
-			return 0;
+	GLuint					vertexShader = 0, fragmentShader = 0, glslProgram = 0;
 
+	// create vertex shader object
+	GLSL_ERROR err = createShaderFromFile(GL_VERTEX_SHADER, vsPath, defines, &vertexShader);
 
-		case GLSL_SHADER_OBJECT_CREATION_ERROR:
+	if (err != GLSL_OK) {
 
-			printf("OpenGL could not create the vertex shader program object.  Try using fewer resources before creating the program object.\n");
+		if (err == GLSL_SHADER_SOURCE_NOT_FOUND) {
 
-			if (error_result)
-				*error_result = GLSL_VERTEX_SHADER_OBJECT_CREATION_ERROR;
+			printf("Vertex shader source not found.  Ensure the GUShaderSource object for the vertex shader has been created successfully.\n");
+			err = GLSL_VERTEX_SHADER_SOURCE_NOT_FOUND;
 
-			return 0;
+		} else {
 
+			printf("OpenGL could not create the vertex shader program object.  Try using fewer resources before creating the program object.\n");
+			err = GLSL_VERTEX_SHADER_OBJECT_CREATION_ERROR;
+		}
 
-		case GLSL_SHADER_COMPILE_ERROR:
+		if (error_result)
+			*error_result = err;
 
-			printf("The vertex shader could not be compiled successfully...\n");
-			printf("Vertex shader source code...\n\n");
+		return 0;
+	}
 
-			printSourceListing(*vertexShaderSource);
 
-			// report compilation error log
+	// create fragment shader object
+	err = createShaderFromFile(GL_FRAGMENT_SHADER, fsPath, defines, &fragmentShader);
 
-			printf("\n<vertex shader compiler errors--------------------->\n\n");
-			reportShaderInfoLog(vertexShader);
-			printf("<-----------------end vertex shader compiler errors>\n\n\n");
+	if (err != GLSL_OK) {
 
-			// dispose of existing shader objects
+		if (err == GLSL_SHADER_SOURCE_NOT_FOUND) {
 
-			glDeleteShader(vertexShader);
+			printf("Fragment shader source not found.  Ensure the GUShaderSource object for the fragment shader has been created successfully.");
+			err = GLSL_FRAGMENT_SHADER_SOURCE_NOT_FOUND;
 
-			if (vertexShaderSource)
-				delete vertexShaderSource;
+		} else {
 
-			if (error_result)
-				*error_result = GLSL_VERTEX_SHADER_COMPILE_ERROR;
+			printf("OpenGL could not create the fragment shader program object.  Try using fewer resources before creating the program object.\n");
+			err = GLSL_FRAGMENT_SHADER_OBJECT_CREATION_ERROR;
+		}
 
-			return 0;
+		// dispose of existing shader objects
+		glDeleteShader(vertexShader);
 
+		if (error_result)
+			*error_result = err;
 
-		default:
+		return 0;
+	}
 
-			printf("The vertex shader object could not be created successfully.\n");
+	//
+	// Setup the main shader program object.  Linking is issued straight away - if either shader failed to compile the link fails too and collectShaders reports why
+	//
+	glslProgram = glCreateProgram();
 
-			// dispose of existing shader objects
+	if (!glslProgram) {
 
-			glDeleteShader(vertexShader);
+		printf("The shader program object could not be created.\n");
 
-			if (vertexShaderSource)
-				delete vertexShaderSource;
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
 
-			if (error_result)
-				*error_result = err;
+		if (error_result)
+			*error_result = GLSL_PROGRAM_OBJECT_CREATION_ERROR;
 
-			return 0;
-		}
+		return 0;
 	}
 
 
-	// create fragment shader object
-	err = createShaderFromFile(GL_FRAGMENT_SHADER, fsPath, &fragmentShader, &fragmentShaderSource);
+	// Attach shader objects
+	glAttachShader(glslProgram, vertexShader);
+	glAttachShader(glslProgram, fragmentShader);
 
-	if (err != GLSL_OK) {
+	// ask the driver to keep the binary around for glGetProgramBinary
+	if (retrievableBinary)
+		glProgramParameteri(glslProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-		switch (err) {
+	// link the shader program
+	glLinkProgram(glslProgram);
 
-		case GLSL_SHADER_SOURCE_NOT_FOUND:
+	// flag the shader objects for deletion - they stay alive while attached to the program
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
 
-			printf("Fragment shader source not found.  Ensure the GUShaderSource object for the fragment shader has been created successfully.");
+	pendingProgram pending = { vsPath, fsPath, defines };
+	pendingPrograms[glslProgram] = pending;
 
-			// dispose of existing shader objects
+	if (error_result)
+		*error_result = GLSL_OK;
 
-			glDeleteShader(vertexShader);
+	return glslProgram;
+}
 
-			if (vertexShaderSource)
-				delete vertexShaderSource;
+bool shadersCompleted(GLuint program) {
 
-			if (error_result)
-				*error_result = GLSL_FRAGMENT_SHADER_SOURCE_NOT_FOUND;
+	if (!glextParallelShaderCompile)
+		return true;
 
-			return 0;
+	GLint completed = GL_TRUE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
 
+	return completed == GL_TRUE;
+}
 
-		case GLSL_SHADER_OBJECT_CREATION_ERROR:
+GLSL_ERROR collectShaders(GLuint program) {
 
-			printf("OpenGL could not create the fragment shader program object.  Try using fewer resources before creating the program object.\n");
+	map<GLuint, pendingProgram>::iterator pending = pendingPrograms.find(program);
 
-			// dispose of existing shader objects
+	if (pending == pendingPrograms.end())
+		return GLSL_OK; // not submitted through submitShaders (e.g. restored from a program binary)
 
-			glDeleteShader(vertexShader);
+	pendingProgram paths = pending->second;
+	pendingPrograms.erase(pending);
 
-			if (vertexShaderSource)
-				delete vertexShaderSource;
+	// validate link status - blocks until the driver has finished with this program
+	GLint linkStatus;
 
-			if (error_result)
-				*error_result = GLSL_FRAGMENT_SHADER_OBJECT_CREATION_ERROR;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
 
-			return 0;
+	if (linkStatus != 0)
+		return GLSL_OK;
 
+	// find out whether a shader failed to compile or the program failed to link
+	GLSL_ERROR err = GLSL_PROGRAM_OBJECT_LINK_ERROR;
 
-		case GLSL_SHADER_COMPILE_ERROR:
+	GLuint		shaders[2];
+	GLsizei		noofShaders = 0;
 
-			printf("The fragment shader could not be compiled successfully...\n");
-			printf("Fragment shader source code...\n\n");
+	glGetAttachedShaders(program, 2, &noofShaders, shaders);
 
-			printSourceListing(*fragmentShaderSource);
+	for (GLsizei i = 0; i < noofShaders && err == GLSL_PROGRAM_OBJECT_LINK_ERROR; ++i) {
 
-			// report compilation error log
+		GLint compileStatus, shaderType;
 
-			printf("\n<fragment shader compiler errors--------------------->\n\n");
-			reportShaderInfoLog(fragmentShader);
-			printf("<-----------------end fragment shader compiler errors>\n\n");
+		glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compileStatus);
+		glGetShaderiv(shaders[i], GL_SHADER_TYPE, &shaderType);
 
-			// dispose of existing shader objects
-			glDeleteShader(vertexShader);
-			glDeleteShader(fragmentShader);
+		if (compileStatus != 0)
+			continue;
 
-			if (vertexShaderSource)
-				delete vertexShaderSource;
+		bool vertex = (shaderType == GL_VERTEX_SHADER);
+		bool compute = (shaderType == GL_COMPUTE_SHADER);
+		const char *name = vertex ? "vertex" : (compute ? "compute" : "fragment");
 
-			if (fragmentShaderSource)
-				delete fragmentShaderSource;
+		printf("The %s shader could not be compiled successfully...\n", name);
+		printf("%s shader source code...\n\n", vertex ? "Vertex" : (compute ? "Compute" : "Fragment"));
 
-			if (error_result)
-				*error_result = GLSL_FRAGMENT_SHADER_COMPILE_ERROR;
+		const string& path = (vertex || compute) ? paths.vsPath : paths.fsPath;
+		const shaderSource *source = getShaderSource(path);
 
-			return 0;
+		if (source) {
 
+			if (!paths.defines.empty())
+				printf("compiled with...\n%s\n", paths.defines.c_str());
 
-		default:
+			printSourceListing(shaderSourceText(*source));
 
-			printf("The fragment shader object could not be created successfully.\n");
+			// log entries are "<source string>:<line>" - list which file each number refers to
+			vector<string> files(1, path);
+			shaderSourceDependencies(path, files);
 
-			// dispose of existing shader objects
-			glDeleteShader(vertexShader);
-			glDeleteShader(fragmentShader);
+			printf("\n");
 
-			if (vertexShaderSource)
-				delete vertexShaderSource;
+			for (size_t j = 0; j < files.size(); ++j)
+				printf("source string %d = %s\n", shaderSourceStringNumber(files[j]), files[j].c_str());
+		}
 
-			if (fragmentShaderSource)
-				delete fragmentShaderSource;
+		// report compilation error log
 
-			if (error_result)
-				*error_result = err;
+		printf("\n<%s shader compiler errors--------------------->\n\n", name);
+		reportShaderInfoLog(shaders[i]);
+		printf("<-----------------end %s shader compiler errors>\n\n", name);
 
-			return 0;
-		}
+		err = vertex ? GLSL_VERTEX_SHADER_COMPILE_ERROR : (compute ? GLSL_COMPUTE_SHADER_COMPILE_ERROR : GLSL_FRAGMENT_SHADER_COMPILE_ERROR);
 	}
 
-	// source code objects not longer needed
-	if (vertexShaderSource)
-		delete vertexShaderSource;
+	if (err == GLSL_PROGRAM_OBJECT_LINK_ERROR) {
 
-	if (fragmentShaderSource)
-		delete fragmentShaderSource;
+		// failed to link - report linker error log
 
-	//
-	// Once vertex and fragment shader objects have been validated, setup the main
-	// shader program object
-	//
-	glslProgram = glCreateProgram();
+		printf("The shader program object could not be linked successfully...\n");
 
-	if (!glslProgram) {
+		printf("\n<GLSL shader program object linker errors--------------------->\n\n");
+		reportProgramInfoLog(program);
+		printf("<-----------------end shader program object linker errors>\n\n");
+	}
 
-		printf("The shader program object could not be created.\n");
+	// delete program - the shaders were already flagged for deletion so they go with it
+	glDeleteProgram(program);
 
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+	return err;
+}
 
-		if (error_result)
-			*error_result = GLSL_PROGRAM_OBJECT_CREATION_ERROR;
+// hot-reload an existing program object
 
-		return 0;
-	}
+GLSL_ERROR reloadShaders(GLuint *program, const string& vsPath, const string& fsPath, const string& defines) {
 
+	GLSL_ERROR err = GLSL_OK;
 
-	// Attach shader objects
-	glAttachShader(glslProgram, vertexShader);
-	glAttachShader(glslProgram, fragmentShader);
+	// build the new program separately so a broken edit never replaces a working program
+	GLuint scratchProgram = setupShaders(vsPath, fsPath, &err, false, defines);
 
+	if (!scratchProgram)
+		return err;
 
-	// link the shader program
-	glLinkProgram(glslProgram);
+	return replaceProgramShaders(program, scratchProgram);
+}
 
+// compute programs
 
-	// validate link status
-	GLint linkStatus;
+GLuint setupComputeShader(const string& csPath, GLSL_ERROR *error_result, const string& defines) {
 
-	glGetProgramiv(glslProgram, GL_LINK_STATUS, &linkStatus);
+	GLuint computeShader = 0;
 
-	if (linkStatus == 0) {
+	GLSL_ERROR err = createShaderFromFile(GL_COMPUTE_SHADER, csPath, defines, &computeShader);
 
-		// failed to link - report linker error log and dispose of local resources
+	if (err != GLSL_OK) {
 
-		printf("The shader program object could not be linked successfully...\n");
+		if (err == GLSL_SHADER_SOURCE_NOT_FOUND) {
 
-		// report linker error log
+			printf("Compute shader source not found.  Ensure the GUShaderSource object for the compute shader has been created successfully.\n");
+			err = GLSL_COMPUTE_SHADER_SOURCE_NOT_FOUND;
 
-		printf("\n<GLSL shader program object linker errors--------------------->\n\n");
-		reportProgramInfoLog(glslProgram);
-		printf("<-----------------end shader program object linker errors>\n\n");
+		} else {
 
-		// delete program and detach shaders
-		glDeleteProgram(glslProgram);
+			printf("OpenGL could not create the compute shader program object.  Try using fewer resources before creating the program object.\n");
+			err = GLSL_COMPUTE_SHADER_OBJECT_CREATION_ERROR;
+		}
 
-		// delete shaders
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+		if (error_result)
+			*error_result = err;
+
+		return 0;
+	}
+
+	GLuint glslProgram = glCreateProgram();
+
+	if (!glslProgram) {
+
+		printf("The shader program object could not be created.\n");
+
+		glDeleteShader(computeShader);
 
 		if (error_result)
-			*error_result = GLSL_PROGRAM_OBJECT_LINK_ERROR;
+			*error_result = GLSL_PROGRAM_OBJECT_CREATION_ERROR;
 
 		return 0;
 	}
 
-	// cleanup - delete individual shader objects since they're now included as part of the overall shader program object
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	glAttachShader(glslProgram, computeShader);
+	glLinkProgram(glslProgram);
+	glDeleteShader(computeShader);
+
+	// collectShaders does the checking and error reporting
+	pendingProgram pending = { csPath, string(), defines };
+	pendingPrograms[glslProgram] = pending;
+
+	err = collectShaders(glslProgram);
 
 	if (error_result)
-		*error_result = GLSL_OK;
+		*error_result = err;
 
-	return glslProgram;
+	return (err == GLSL_OK) ? glslProgram : 0;
+}
+
+GLSL_ERROR reloadComputeShader(GLuint *program, const string& csPath, const string& defines) {
+
+	GLSL_ERROR err = GLSL_OK;
+
+	GLuint scratchProgram = setupComputeShader(csPath, &err, defines);
+
+	if (!scratchProgram)
+		return err;
+
+	return replaceProgramShaders(program, scratchProgram);
 }
 
 //
 // private function implementation
 //
 
-GLSL_ERROR createShaderFromFile(GLenum shaderType, const string& shaderFilePath, GLuint *shaderObject, const string **shaderSource) {
-	const string *sourceString = shaderSourceStringFromFile(shaderFilePath);
+// move the shaders of a freshly built scratch program into *program, relink it and delete the scratch program.  If the relink fails the old shaders are put back and linked again.  With no program to replace the scratch program is kept as it is
+GLSL_ERROR replaceProgramShaders(GLuint *programObject, GLuint scratchProgram) {
 
-	if (!sourceString)
-		return GLSL_SHADER_SOURCE_NOT_FOUND;
+	if (*programObject == 0) {
 
-	const char *src = sourceString->c_str();
+		*programObject = scratchProgram;
+		return GLSL_OK;
+	}
 
-	if (!src) {
+	GLuint program = *programObject;
 
-		delete sourceString;
-		return GLSL_SHADER_OBJECT_CREATION_ERROR;
-	}
+	// shaders are flagged for deletion when they are built, so they stay alive only while attached to a program - park the old ones on the scratch program until the relink has worked
+	GLuint		oldShaders[8], newShaders[8];
+	GLsizei		noofOldShaders = 0, noofNewShaders = 0;
 
-	GLuint shader = glCreateShader(shaderType);
+	glGetAttachedShaders(program, 8, &noofOldShaders, oldShaders);
+	glGetAttachedShaders(scratchProgram, 8, &noofNewShaders, newShaders);
 
-	if (shader == 0) {
+	for (GLsizei i = 0; i < noofOldShaders; ++i) {
 
-		delete sourceString;
-		return GLSL_SHADER_OBJECT_CREATION_ERROR;
+		glAttachShader(scratchProgram, oldShaders[i]);
+		glDetachShader(program, oldShaders[i]);
 	}
 
-	glShaderSource(shader, 1, static_cast<const GLchar**>(&src), 0);
-	glCompileShader(shader);
+	for (GLsizei i = 0; i < noofNewShaders; ++i)
+		glAttachShader(program, newShaders[i]);
 
-	*shaderObject = shader;
-	*shaderSource = sourceString;
+	glLinkProgram(program);
 
-	GLint compileStatus;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+	GLint linkStatus;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
 
-	return (compileStatus == 0) ? GLSL_SHADER_COMPILE_ERROR : GLSL_OK;
-}
+	if (linkStatus == 0) {
 
-const string *shaderSourceStringFromFile(const string& filePath) {
-	string *sourceString = NULL;
+		printf("The shader program object could not be relinked - keeping the old shaders...\n");
+		reportProgramInfoLog(program);
 
-	const char *file_str = filePath.c_str();
+		for (GLsizei i = 0; i < noofNewShaders; ++i)
+			glDetachShader(program, newShaders[i]);
 
-	struct stat fileStatus;
-	int file_error = stat(file_str, &fileStatus);
+		for (GLsizei i = 0; i < noofOldShaders; ++i)
+			glAttachShader(program, oldShaders[i]);
 
-	if (file_error == 0) {
+		glLinkProgram(program);
+	}
 
-		_off_t fileSize = fileStatus.st_size;
+	// deleting the scratch program frees whichever set of shaders is no longer attached to program
+	glDeleteProgram(scratchProgram);
 
-		char *src = (char *)calloc(fileSize + 1, 1); // add null-terminator character at end of string
+	return (linkStatus == 0) ? GLSL_PROGRAM_OBJECT_LINK_ERROR : GLSL_OK;
+}
 
-		if (src) {
+GLSL_ERROR createShaderFromFile(GLenum shaderType, const string& shaderFilePath, const string& defines, GLuint *shaderObject) {
+	// views of the mapped file and its includes - glShaderSource copies them, so nothing is duplicated on our side
+	const shaderSource *source = getShaderSource(shaderFilePath);
 
-			ifstream shaderFile(file_str);
+	if (!source)
+		return GLSL_SHADER_SOURCE_NOT_FOUND;
 
-			if (shaderFile.is_open()) {
+	GLuint shader = glCreateShader(shaderType);
 
-				shaderFile.read(src, fileSize);
-				sourceString = new string(src);
+	if (shader == 0)
+		return GLSL_SHADER_OBJECT_CREATION_ERROR;
 
-				shaderFile.close();
-			}
+	// the compile status is not queried here - collectShaders checks it once the program has been linked
+	if (defines.empty()) {
 
-			// dispose of local resources
-			free(src);
-		}
+		glShaderSource(shader, source->count(), const_cast<const GLchar**>(source->strings.data()), source->lengths.data());
+
+	} else {
+
+		// slot the defines in after the #version line, which has to come first
+		vector<const GLchar*>	strings(source->strings.begin(), source->strings.end());
+		vector<GLint>			lengths(source->lengths.begin(), source->lengths.end());
+
+		strings.insert(strings.begin() + source->preambleStrings, defines.c_str());
+		lengths.insert(lengths.begin() + source->preambleStrings, GLint(defines.size()));
+
+		glShaderSource(shader, GLsizei(strings.size()), strings.data(), lengths.data());
 	}
+	glCompileShader(shader);
+
+	*shaderObject = shader;
 
-	// return pointer to new source string
-	return sourceString;
+	return GLSL_OK;
 }
 
 void printSourceListing(const string& sourceString, bool showLineNumbers) {
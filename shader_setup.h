@@ -21,14 +21,17 @@ typedef enum GLSL_ERROR_CODES {
 	GLSL_VERTEX_SHADER_SOURCE_NOT_FOUND,
 	GLSL_GEOMETRY_SHADER_SOURCE_NOT_FOUND,
 	GLSL_FRAGMENT_SHADER_SOURCE_NOT_FOUND,
+	GLSL_COMPUTE_SHADER_SOURCE_NOT_FOUND,
 
 	GLSL_VERTEX_SHADER_OBJECT_CREATION_ERROR,
 	GLSL_GEOMETRY_SHADER_OBJECT_CREATION_ERROR,
 	GLSL_FRAGMENT_SHADER_OBJECT_CREATION_ERROR,
+	GLSL_COMPUTE_SHADER_OBJECT_CREATION_ERROR,
 
 	GLSL_VERTEX_SHADER_COMPILE_ERROR,
 	GLSL_GEOMETRY_SHADER_COMPILE_ERROR,
 	GLSL_FRAGMENT_SHADER_COMPILE_ERROR,
+	GLSL_COMPUTE_SHADER_COMPILE_ERROR,
 
 	GLSL_PROGRAM_OBJECT_CREATION_ERROR,
 	GLSL_PROGRAM_OBJECT_LINK_ERROR
@@ -36,5 +39,21 @@ typedef enum GLSL_ERROR_CODES {
 } GLSL_ERROR;
 
 
-// Basic shader object creation function takes a path to a vertex shader file and fragment shader file and returns a bound and linked shader program object
-GLuint setupShaders(const std::string& vsPath, const std::string& fsPath, GLSL_ERROR *error_result = NULL);
+// Basic shader object creation function takes a path to a vertex shader file and fragment shader file and returns a bound and linked shader program object.  Set retrievableBinary if the linked program will be read back with glGetProgramBinary.  defines (e.g. "#define TEXTURED\n") is inserted into both shaders straight after their #version line
+GLuint setupShaders(const std::string& vsPath, const std::string& fsPath, GLSL_ERROR *error_result = NULL, bool retrievableBinary = false, const std::string& defines = std::string());
+
+// Non-blocking build.  submitShaders issues the compile and link for a program without waiting on the driver and returns the program object (0 only if a source file is missing or GL objects cannot be created).  Submit every program first, then call collectShaders on each to check the result - with GL_KHR_parallel_shader_compile the driver compiles the submitted programs concurrently.  collectShaders reports any compile / link errors and deletes the program on failure
+GLuint submitShaders(const std::string& vsPath, const std::string& fsPath, GLSL_ERROR *error_result = NULL, bool retrievableBinary = false, const std::string& defines = std::string());
+GLSL_ERROR collectShaders(GLuint program);
+
+// Return true if collectShaders would not block on program.  Always true without GL_KHR_parallel_shader_compile
+bool shadersCompleted(GLuint program);
+
+// Rebuild an existing program object from the given shader files in place, so the program name held by callers stays valid.  The new sources are compiled and linked in a scratch program first; if that fails the existing program is left untouched.  If relinking the existing program with the new shaders fails, its old shaders are put back and relinked, so it keeps working but - as after any relink - its uniform locations and block bindings must be set up again.  If *program is 0 (it failed to build before) the new program is stored there instead
+GLSL_ERROR reloadShaders(GLuint *program, const std::string& vsPath, const std::string& fsPath, const std::string& defines = std::string());
+
+// Compute programs (GL 4.3 / GL_ARB_compute_shader - check glextComputeShader first).  Built and reported the same way as setupShaders, from a single compute shader file
+GLuint setupComputeShader(const std::string& csPath, GLSL_ERROR *error_result = NULL, const std::string& defines = std::string());
+
+// Rebuild an existing compute program in place, as reloadShaders does
+GLSL_ERROR reloadComputeShader(GLuint *program, const std::string& csPath, const std::string& defines = std::string());
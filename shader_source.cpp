@@ -0,0 +1,382 @@
+#include "stdafx.h"
+#include "shader_source.h"
+#include "asset_watcher.h"
+#include "mapped_file.h"
+#include <map>
+#include <set>
+#include <deque>
+#include <sstream>
+#include <iostream>
+
+using namespace std;
+
+struct sourceFile {
+	string				path; // normalised
+	int					id; // source string number used in #line directives
+
+	const char			*data; // mapped contents, NULL if not mapped
+	size_t				size;
+	bool				mapped;
+
+	vector<string>		includes; // direct includes - the edges of the include graph
+
+	// expanded source for when this file is compiled as a shader, plus the #line directives it points into
+	bool				expanded;
+	shaderSource		source;
+	deque<string>		directives; // deque so views into earlier entries survive push_back
+};
+
+static map<string, sourceFile*>		sourceFiles;
+static vector<sourceFile*>			sourceFilesById;
+
+#pragma region file mapping
+
+static bool mapFile(sourceFile *f) {
+	if (f->mapped)
+		return true;
+
+	mappedFile view;
+
+	if (!mapFileView(f->path, &view)) {
+
+		f->data = NULL;
+		f->size = 0;
+		return false;
+	}
+
+	f->data = view.data;
+	f->size = view.size;
+	f->mapped = true;
+
+	return true;
+}
+
+static void unmapFile(sourceFile *f) {
+	if (!f->mapped)
+		return;
+
+	mappedFile view = { f->data, f->size };
+	unmapFileView(&view);
+
+	f->data = NULL;
+	f->size = 0;
+	f->mapped = false;
+}
+
+#pragma endregion
+
+#pragma region include expansion
+
+static sourceFile *findSourceFile(const string& path, bool create) {
+	string p = normaliseAssetPath(path);
+
+	map<string, sourceFile*>::iterator i = sourceFiles.find(p);
+
+	if (i != sourceFiles.end())
+		return i->second;
+
+	if (!create)
+		return NULL;
+
+	sourceFile *f = new sourceFile();
+
+	f->path = p;
+	f->id = int(sourceFilesById.size());
+	f->data = NULL;
+	f->size = 0;
+	f->mapped = false;
+	f->expanded = false;
+	f->source.preambleStrings = 0;
+
+	sourceFiles[p] = f;
+	sourceFilesById.push_back(f);
+
+	return f;
+}
+
+// Match a preprocessor directive at the start of a line, returning the text after its name
+static const char *matchDirective(const char *p, const char *end, const char *name) {
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+
+	if (p >= end || *p != '#')
+		return NULL;
+
+	++p;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+
+	size_t length = strlen(name);
+
+	if (size_t(end - p) < length || strncmp(p, name, length) != 0)
+		return NULL;
+
+	return p + length;
+}
+
+// Parse the "file" or <file> operand of an #include
+static bool includeName(const char *p, const char *end, string *name) {
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+
+	if (p >= end || (*p != '"' && *p != '<'))
+		return false;
+
+	char close = (*p == '"') ? '"' : '>';
+	const char *start = ++p;
+
+	while (p < end && *p != close)
+		++p;
+
+	if (p >= end)
+		return false;
+
+	*name = string(start, p);
+
+	return true;
+}
+
+static void addView(shaderSource& source, const char *data, size_t length) {
+	if (length == 0)
+		return;
+
+	source.strings.push_back(data);
+	source.lengths.push_back(GLint(length));
+}
+
+static void addDirective(sourceFile *root, const string& text) {
+	root->directives.push_back(text);
+	addView(root->source, root->directives.back().c_str(), root->directives.back().size());
+}
+
+// Append f to root's expanded source, replacing each #include line with the included file.  included holds the files already spliced into this shader, stack the files currently being expanded (to catch cycles)
+static bool expandFile(sourceFile *root, sourceFile *f, set<sourceFile*>& included, vector<sourceFile*>& stack) {
+	if (!mapFile(f)) {
+
+		cout << "Shader source: could not read " << f->path << "\n";
+		return false;
+	}
+
+	stack.push_back(f);
+	f->includes.clear();
+
+	const char *p = f->data;
+	const char *end = f->data + f->size;
+	const char *segmentStart = p;
+
+	int line = 1;
+
+	while (p < end) {
+
+		const char *lineEnd = (const char*)memchr(p, '\n', end - p);
+		const char *next = lineEnd ? lineEnd + 1 : end;
+
+		if (!lineEnd)
+			lineEnd = end;
+
+		const char *operand = matchDirective(p, lineEnd, "include");
+		string name;
+
+		if (operand && includeName(operand, lineEnd, &name)) {
+
+			addView(root->source, segmentStart, p - segmentStart);
+			segmentStart = next;
+
+			// includes are relative to the including file
+			size_t slash = f->path.find_last_of('/');
+			sourceFile *inc = findSourceFile((slash == string::npos) ? name : f->path.substr(0, slash + 1) + name, true);
+
+			f->includes.push_back(inc->path);
+
+			for (size_t i = 0; i < stack.size(); ++i) {
+
+				if (stack[i] == inc) {
+
+					cout << "Shader source: " << f->path << " includes " << inc->path << " which includes it back\n";
+					return false;
+				}
+			}
+
+			if (included.insert(inc).second) {
+
+				stringstream directive;
+
+				directive << "#line 1 " << inc->id << "\n";
+				addDirective(root, directive.str());
+
+				if (!expandFile(root, inc, included, stack))
+					return false;
+
+				// the leading newline ends the included file's last line if it has no newline of its own
+				directive.str("");
+				directive << "\n#line " << line + 1 << " " << f->id << "\n";
+				addDirective(root, directive.str());
+
+			} else {
+
+				// already spliced in - leave a blank line so the line numbers that follow stay right
+				addDirective(root, "\n");
+			}
+
+		} else if (f == root && root->source.preambleStrings == 0 && matchDirective(p, lineEnd, "version")) {
+
+			// end a string on the #version line so defines can be slotted in after it
+			addView(root->source, segmentStart, next - segmentStart);
+			segmentStart = next;
+
+			stringstream directive;
+
+			directive << "#line " << line + 1 << " " << f->id << "\n";
+			addDirective(root, directive.str());
+
+			root->source.preambleStrings = root->source.strings.size() - 1;
+		}
+
+		p = next;
+		line++;
+	}
+
+	addView(root->source, segmentStart, end - segmentStart);
+
+	stack.pop_back();
+
+	return true;
+}
+
+static void clearExpansion(sourceFile *f) {
+	f->expanded = false;
+	f->source.strings.clear();
+	f->source.lengths.clear();
+	f->source.preambleStrings = 0;
+	f->directives.clear();
+}
+
+#pragma endregion
+
+const shaderSource *getShaderSource(const string& path) {
+	sourceFile *f = findSourceFile(path, true);
+
+	if (f->expanded)
+		return &f->source;
+
+	clearExpansion(f);
+
+	set<sourceFile*>		included;
+	vector<sourceFile*>		stack;
+
+	included.insert(f);
+
+	if (!expandFile(f, f, included, stack)) {
+
+		clearExpansion(f);
+		return NULL;
+	}
+
+	f->expanded = true;
+
+	return &f->source;
+}
+
+string shaderSourceText(const shaderSource& source) {
+	string text;
+
+	for (size_t i = 0; i < source.strings.size(); ++i)
+		text.append(source.strings[i], source.lengths[i]);
+
+	return text;
+}
+
+bool shaderSourceDependsOn(const string& path, const string& dependency) {
+	sourceFile *f = findSourceFile(path, false);
+	string target = normaliseAssetPath(dependency);
+
+	if (!f)
+		return normaliseAssetPath(path) == target;
+
+	// depth first over the include graph
+	set<sourceFile*>		visited;
+	vector<sourceFile*>		pending(1, f);
+
+	while (!pending.empty()) {
+
+		sourceFile *current = pending.back();
+		pending.pop_back();
+
+		if (current->path == target)
+			return true;
+
+		if (!visited.insert(current).second)
+			continue;
+
+		for (size_t i = 0; i < current->includes.size(); ++i) {
+
+			sourceFile *inc = findSourceFile(current->includes[i], false);
+
+			if (inc)
+				pending.push_back(inc);
+		}
+	}
+
+	return false;
+}
+
+void shaderSourceDependencies(const string& path, vector<string>& dependencies) {
+	sourceFile *f = findSourceFile(path, false);
+
+	if (!f)
+		return;
+
+	set<sourceFile*>		visited;
+	vector<sourceFile*>		pending(1, f);
+
+	visited.insert(f);
+
+	while (!pending.empty()) {
+
+		sourceFile *current = pending.back();
+		pending.pop_back();
+
+		for (size_t i = 0; i < current->includes.size(); ++i) {
+
+			sourceFile *inc = findSourceFile(current->includes[i], false);
+
+			if (inc && visited.insert(inc).second) {
+
+				dependencies.push_back(inc->path);
+				pending.push_back(inc);
+			}
+		}
+	}
+}
+
+int shaderSourceStringNumber(const string& path) {
+	sourceFile *f = findSourceFile(path, false);
+	return f ? f->id : -1;
+}
+
+void invalidateShaderSource(const string& path) {
+	sourceFile *changed = findSourceFile(path, false);
+
+	if (!changed)
+		return;
+
+	// drop the expansions that point into the file before unmapping it
+	for (size_t i = 0; i < sourceFilesById.size(); ++i) {
+
+		sourceFile *f = sourceFilesById[i];
+
+		if (f->expanded && shaderSourceDependsOn(f->path, changed->path))
+			clearExpansion(f);
+	}
+
+	unmapFile(changed);
+}
+
+void releaseShaderSourceMappings(void) {
+	for (size_t i = 0; i < sourceFilesById.size(); ++i) {
+
+		clearExpansion(sourceFilesById[i]);
+		unmapFile(sourceFilesById[i]);
+	}
+}
@@ -0,0 +1,39 @@
+//
+// Shader source provider.  Shader files are memory mapped rather than copied, and #include "file" directives are expanded by splicing views of the included files in place of the directive, so an expanded source is a list of (pointer, length) pairs that go straight to glShaderSource.  Each file is mapped once however many shaders include it, the expanded list for each shader is cached, and the include graph is kept so a change to a shared header can be traced to every shader that uses it
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <string>
+#include <vector>
+
+// An expanded shader source, ready for glShaderSource(shader, count(), strings.data(), lengths.data())
+struct shaderSource {
+	std::vector<const GLchar*>	strings;
+	std::vector<GLint>			lengths;
+	size_t						preambleStrings; // number of leading strings up to and including the #version line (0 if there is none) - defines must be inserted after these
+
+	GLsizei count(void) const { return GLsizei(strings.size()); }
+};
+
+// Return the expanded source of a shader file, mapping and expanding it on first use.  Returns NULL if the file or one of its includes cannot be read, or the includes are circular.  Each file is included at most once per shader, so shared headers need no include guards.  The views stay valid until the file is invalidated or releaseShaderSourceMappings is called
+const shaderSource *getShaderSource(const std::string& path);
+
+// Copy an expanded source into one string (for error listings)
+std::string shaderSourceText(const shaderSource& source);
+
+// Forget the contents of a file that changed on disk, along with the expanded source of every shader that includes it
+void invalidateShaderSource(const std::string& path);
+
+// True if path is dependency, or includes it directly or indirectly
+bool shaderSourceDependsOn(const std::string& path, const std::string& dependency);
+
+// Every file path includes, directly or indirectly (as found the last time it was expanded)
+void shaderSourceDependencies(const std::string& path, std::vector<std::string>& dependencies);
+
+// The source string number #line directives use for a file (-1 if it has never been loaded), for reading compiler logs
+int shaderSourceStringNumber(const std::string& path);
+
+// Unmap every file.  glShaderSource copies the strings, so this can be called once a batch of shaders has been submitted - mappings are not held between batches, which also keeps the files free for editors to overwrite while the program runs.  The include graph is kept
+void releaseShaderSourceMappings(void);
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "shader_variants.h"
+#include "program_cache.h"
+#include "shader_source.h"
+#include "asset_watcher.h"
+#include "transform_buffer.h"
+#include "texture_array.h"
+#include <map>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+static const char *VARIANT_VS_PATH = "Shaders\\scene_vert.glsl";
+static const char *VARIANT_FS_PATH = "Shaders\\scene_frag.glsl";
+
+// define names, in SHADER_FEATURE bit order
+static const char *featureNames[] = { "TEXTURED", "VERTEX_COLOUR", "INSTANCED", "ALPHA_KEY", "TEXTURE_ARRAY" };
+
+struct shaderVariantEntry {
+	GLuint		program;
+	bool		pending; // submitted but not yet collected
+	bool		failed;
+};
+
+static map<unsigned, shaderVariantEntry>	variants; // keyed by normalised feature mask
+
+unsigned normaliseShaderFeatures(unsigned features) {
+	features &= SHADER_ALL_FEATURES;
+
+	if (features & SHADER_TEXTURE_ARRAY)
+		features |= SHADER_TEXTURED;
+
+	return features;
+}
+
+// "TEXTURED | VERTEX_COLOUR" style description for reports
+static string featureList(unsigned features) {
+	string list;
+
+	for (unsigned i = 0; i < sizeof(featureNames) / sizeof(featureNames[0]); ++i) {
+
+		if (features & (1u << i))
+			list += (list.empty() ? "" : " | ") + string(featureNames[i]);
+	}
+
+	return list.empty() ? string("no features") : list;
+}
+
+string shaderFeatureDefines(unsigned features) {
+	// sizes the shaders share with the C++ side
+	string defines = "#define MAX_FRAME_TRANSFORMS " + to_string(FRAME_TRANSFORM_CAPACITY) + "\n"
+		+ "#define MAX_TEXTURE_ARRAY_LAYERS " + to_string(MAX_TEXTURE_ARRAY_LAYERS) + "\n";
+
+	features = normaliseShaderFeatures(features);
+
+	for (unsigned i = 0; i < sizeof(featureNames) / sizeof(featureNames[0]); ++i) {
+
+		if (features & (1u << i))
+			defines += string("#define ") + featureNames[i] + "\n";
+	}
+
+	return defines;
+}
+
+GLuint submitShaderVariant(unsigned features) {
+	features = normaliseShaderFeatures(features);
+
+	map<unsigned, shaderVariantEntry>::iterator v = variants.find(features);
+
+	if (v != variants.end())
+		return v->second.program;
+
+	shaderVariantEntry entry = { 0, true, false };
+
+	entry.program = submitShadersCached(VARIANT_VS_PATH, VARIANT_FS_PATH, NULL, shaderFeatureDefines(features));
+
+	if (!entry.program) {
+
+		entry.pending = false;
+		entry.failed = true;
+	}
+
+	variants[features] = entry;
+
+	return entry.program;
+}
+
+void collectShaderVariants(void) {
+	for (map<unsigned, shaderVariantEntry>::iterator v = variants.begin(); v != variants.end(); ++v) {
+
+		shaderVariantEntry& entry = v->second;
+
+		if (!entry.pending)
+			continue;
+
+		entry.pending = false;
+
+		if (collectShadersCached(entry.program) != GLSL_OK) {
+
+			cout << "Shader variant " << featureList(v->first) << " failed to build\n";
+
+			entry.program = 0;
+			entry.failed = true;
+		}
+	}
+
+	// the driver has its own copy of the sources now
+	releaseShaderSourceMappings();
+}
+
+GLuint shaderVariant(unsigned features) {
+	features = normaliseShaderFeatures(features);
+
+	map<unsigned, shaderVariantEntry>::iterator v = variants.find(features);
+
+	if (v == variants.end()) {
+
+		submitShaderVariant(features);
+		collectShaderVariants();
+
+		v = variants.find(features);
+	}
+
+	return v->second.failed ? 0 : v->second.program;
+}
+
+bool reloadShaderVariants(const string& path) {
+	if (!shaderSourceDependsOn(VARIANT_VS_PATH, path) && !shaderSourceDependsOn(VARIANT_FS_PATH, path))
+		return false;
+
+	for (map<unsigned, shaderVariantEntry>::iterator v = variants.begin(); v != variants.end(); ++v) {
+
+		shaderVariantEntry& entry = v->second;
+		string defines = shaderFeatureDefines(v->first);
+
+		if (entry.failed) {
+
+			// give variants that failed before another chance with the edited source
+			entry.program = setupShadersCached(VARIANT_VS_PATH, VARIANT_FS_PATH, NULL, defines);
+			entry.failed = (entry.program == 0);
+
+		} else {
+
+			// rebuilt in place so program names held by callers stay valid
+			reloadShaders(&entry.program, VARIANT_VS_PATH, VARIANT_FS_PATH, defines);
+		}
+	}
+
+	releaseShaderSourceMappings();
+
+	return true;
+}
+
+void watchShaderVariantSources(void) {
+	vector<string> files;
+
+	files.push_back(VARIANT_VS_PATH);
+	files.push_back(VARIANT_FS_PATH);
+
+	// the include graph is only known once the sources have been expanded
+	getShaderSource(VARIANT_VS_PATH);
+	getShaderSource(VARIANT_FS_PATH);
+
+	shaderSourceDependencies(VARIANT_VS_PATH, files);
+	shaderSourceDependencies(VARIANT_FS_PATH, files);
+
+	releaseShaderSourceMappings();
+
+	for (size_t i = 0; i < files.size(); ++i)
+		watchAssetFile(files[i]);
+}
+
+bool validateShaderVariants(void) {
+	// enumerate every mask and keep the distinct feature sets
+	vector<unsigned> featureSets;
+
+	for (unsigned features = 0; features <= SHADER_ALL_FEATURES; ++features) {
+
+		if (normaliseShaderFeatures(features) == features)
+			featureSets.push_back(features);
+	}
+
+	for (size_t i = 0; i < featureSets.size(); ++i)
+		submitShaderVariant(featureSets[i]);
+
+	collectShaderVariants();
+
+	unsigned failures = 0;
+
+	for (size_t i = 0; i < featureSets.size(); ++i) {
+
+		if (variants[featureSets[i]].failed)
+			failures++;
+	}
+
+	cout << "Shader variants: " << SHADER_ALL_FEATURES + 1 << " feature masks, " << featureSets.size() << " distinct programs, " << failures << " failed to build\n";
+
+	return failures == 0;
+}
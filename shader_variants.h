@@ -0,0 +1,42 @@
+//
+// Scene shader variants.  Every scene shape is drawn with one vertex / fragment source pair (Shaders\scene_vert.glsl and scene_frag.glsl) compiled with a #define per feature.  Programs are requested by feature bitmask, built on first use and cached, so asking for the same feature set twice - or for two masks that normalise to the same set - returns the same program
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <string>
+
+enum SHADER_FEATURE {
+	SHADER_TEXTURED			= 0x01, // sample textureImage
+	SHADER_VERTEX_COLOUR	= 0x02, // multiply by the vertex colour
+	SHADER_INSTANCED		= 0x04, // per-instance mat3x2 transform attribute at locations 3 - 5 instead of the frame transform block
+	SHADER_ALPHA_KEY		= 0x08, // discard fragments with no alpha
+	SHADER_TEXTURE_ARRAY	= 0x10, // sample a layer of textureArray instead of textureImage (implies SHADER_TEXTURED)
+
+	SHADER_ALL_FEATURES		= 0x1F
+};
+
+// Resolve implied features so equivalent masks share one program
+unsigned normaliseShaderFeatures(unsigned features);
+
+// The #define block a feature set is compiled with
+std::string shaderFeatureDefines(unsigned features);
+
+// Start building the program for a feature set without waiting for the driver (see submitShaders) and return its program object, which is not usable until collectShaderVariants.  Does nothing if the variant is already built or pending
+GLuint submitShaderVariant(unsigned features);
+
+// Wait for every submitted variant and report any errors.  Variants that fail are remembered and not rebuilt until their sources change
+void collectShaderVariants(void);
+
+// Return the program for a feature set, building it now if it has not been submitted.  Returns 0 if the variant does not compile
+GLuint shaderVariant(unsigned features);
+
+// Rebuild every built variant in place if path is one of the variant sources or a file they include.  Returns true if anything was rebuilt (uniform locations must then be queried again)
+bool reloadShaderVariants(const std::string& path);
+
+// Watch the variant sources and everything they include with the asset watcher
+void watchShaderVariantSources(void);
+
+// Build every distinct feature combination and report which compile.  Returns true if all of them do
+bool validateShaderVariants(void);
@@ -0,0 +1,303 @@
+#include "stdafx.h"
+#include "spatial_hash.h"
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+// Objects covering more cells than this go on the oversized list instead (e.g. full screen backgrounds)
+static const int		MAX_OBJECT_CELLS = 64;
+
+// Cell coordinates are clamped to this so huge or infinite bounds can't overflow
+static const float		MAX_CELL = 1048576.0f;
+
+static const unsigned char	OBJECT_REMOVED = 0;
+static const unsigned char	OBJECT_FILED = 1; // in the buckets of its cells
+static const unsigned char	OBJECT_OVERSIZED = 2; // on the oversized list
+
+static int cellCoordinate(const spatialHash& hash, float x) {
+	float c = floorf(x * hash.inverseCellSize);
+
+	// NaN fails the first comparison and ends up in the -MAX_CELL column, like a coordinate far off to the left
+	return int((c > -MAX_CELL) ? ((c < MAX_CELL) ? c : MAX_CELL) : -MAX_CELL);
+}
+
+static unsigned bucketIndex(const spatialHash& hash, int cx, int cy) {
+	return ((unsigned(cx) * 73856093u) ^ (unsigned(cy) * 19349663u)) & hash.bucketMask;
+}
+
+static bool overlaps(const spatialBounds& a, const spatialBounds& b) {
+	return a.minX <= b.maxX && a.maxX >= b.minX && a.minY <= b.maxY && a.maxY >= b.minY;
+}
+
+static void removeFromBucket(vector<int>& bucket, int id) {
+	for (size_t i = 0; i < bucket.size(); ++i) {
+
+		if (bucket[i] == id) {
+
+			bucket[i] = bucket.back();
+			bucket.pop_back();
+			return;
+		}
+	}
+}
+
+// File an object under its cells (or on the oversized list) - the cell range must already be in hash.cells
+static void fileObject(spatialHash& hash, int id) {
+	const int *c = &hash.cells[id * 4];
+
+	if ((long long)(c[2] - c[0] + 1) * (long long)(c[3] - c[1] + 1) > MAX_OBJECT_CELLS) {
+
+		hash.oversized.push_back(id);
+		hash.live[id] = OBJECT_OVERSIZED;
+		return;
+	}
+
+	for (int cy = c[1]; cy <= c[3]; ++cy)
+		for (int cx = c[0]; cx <= c[2]; ++cx)
+			hash.buckets[bucketIndex(hash, cx, cy)].push_back(id);
+
+	hash.live[id] = OBJECT_FILED;
+}
+
+static void unfileObject(spatialHash& hash, int id) {
+	const int *c = &hash.cells[id * 4];
+
+	if (hash.live[id] == OBJECT_OVERSIZED) {
+
+		hash.oversized.erase(find(hash.oversized.begin(), hash.oversized.end(), id));
+
+	} else if (hash.live[id] == OBJECT_FILED) {
+
+		for (int cy = c[1]; cy <= c[3]; ++cy)
+			for (int cx = c[0]; cx <= c[2]; ++cx)
+				removeFromBucket(hash.buckets[bucketIndex(hash, cx, cy)], id);
+	}
+
+	hash.live[id] = OBJECT_REMOVED;
+}
+
+static void setCells(spatialHash& hash, int id, const spatialBounds& b) {
+	int *c = &hash.cells[id * 4];
+
+	c[0] = cellCoordinate(hash, b.minX);
+	c[1] = cellCoordinate(hash, b.minY);
+	c[2] = cellCoordinate(hash, b.maxX);
+	c[3] = cellCoordinate(hash, b.maxY);
+}
+
+void initSpatialHash(spatialHash& hash, float cellSize, unsigned bucketCount) {
+	unsigned n = 1;
+
+	while (n < bucketCount)
+		n <<= 1;
+
+	hash.cellSize = cellSize;
+	hash.inverseCellSize = 1.0f / cellSize;
+	hash.bucketMask = n - 1;
+
+	hash.buckets.assign(n, vector<int>());
+	hash.oversized.clear();
+
+	hash.bounds.clear();
+	hash.cells.clear();
+	hash.live.clear();
+	hash.queryStamp.clear();
+
+	hash.currentQuery = 0;
+	hash.lastCandidates = 0;
+}
+
+int addSpatialObject(spatialHash& hash, const spatialBounds& bounds) {
+	int id = int(hash.bounds.size());
+
+	hash.bounds.push_back(bounds);
+	hash.cells.resize(hash.cells.size() + 4);
+	hash.live.push_back(OBJECT_REMOVED);
+	hash.queryStamp.push_back(hash.currentQuery);
+
+	setCells(hash, id, bounds);
+	fileObject(hash, id);
+
+	return id;
+}
+
+void updateSpatialObject(spatialHash& hash, int id, const spatialBounds& bounds) {
+	if (hash.live[id] == OBJECT_REMOVED)
+		return;
+
+	hash.bounds[id] = bounds;
+
+	int *c = &hash.cells[id * 4];
+	int previous[4] = { c[0], c[1], c[2], c[3] };
+
+	setCells(hash, id, bounds);
+
+	// still in the same cells - the new bounds are all that changes
+	if (memcmp(previous, c, sizeof(previous)) == 0)
+		return;
+
+	int moved[4] = { c[0], c[1], c[2], c[3] };
+
+	memcpy(c, previous, sizeof(previous));
+	unfileObject(hash, id);
+
+	memcpy(c, moved, sizeof(moved));
+	fileObject(hash, id);
+}
+
+void removeSpatialObject(spatialHash& hash, int id) {
+	unfileObject(hash, id);
+}
+
+unsigned querySpatialHash(spatialHash& hash, const spatialBounds& rect, vector<int>& results) {
+	size_t first = results.size();
+	unsigned candidates = 0;
+
+	// new stamp for this query.  On wrap around the old stamps could match, so clear them
+	if (++hash.currentQuery == 0) {
+
+		fill(hash.queryStamp.begin(), hash.queryStamp.end(), 0u);
+		hash.currentQuery = 1;
+	}
+
+	unsigned stamp = hash.currentQuery;
+
+	int minX = cellCoordinate(hash, rect.minX), minY = cellCoordinate(hash, rect.minY);
+	int maxX = cellCoordinate(hash, rect.maxX), maxY = cellCoordinate(hash, rect.maxY);
+
+	// a rectangle covering more cells than there are buckets visits each bucket once instead
+	bool everyBucket = (long long)(maxX - minX + 1) * (long long)(maxY - minY + 1) > (long long)hash.buckets.size();
+
+	if (everyBucket) {
+
+		minX = minY = 0;
+		maxX = int(hash.bucketMask);
+		maxY = 0;
+	}
+
+	for (int cy = minY; cy <= maxY; ++cy) {
+
+		for (int cx = minX; cx <= maxX; ++cx) {
+
+			const vector<int>& bucket = hash.buckets[everyBucket ? unsigned(cx) : bucketIndex(hash, cx, cy)];
+
+			for (size_t i = 0; i < bucket.size(); ++i) {
+
+				int id = bucket[i];
+
+				if (hash.queryStamp[id] == stamp)
+					continue;
+
+				hash.queryStamp[id] = stamp;
+				candidates++;
+
+				if (overlaps(hash.bounds[id], rect))
+					results.push_back(id);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < hash.oversized.size(); ++i) {
+
+		int id = hash.oversized[i];
+		candidates++;
+
+		if (overlaps(hash.bounds[id], rect))
+			results.push_back(id);
+	}
+
+	hash.lastCandidates = candidates;
+
+	return unsigned(results.size() - first);
+}
+
+void spatialHashBenchmark(void) {
+	const int noofObjects = 100000;
+	const float worldSize = 100.0f;
+
+	// sprites between 0.02 and 0.1 across, scattered over a 100 x 100 world - the [-1, 1] viewport sees about 0.04% of it
+	vector<spatialBounds> objects(noofObjects);
+	unsigned seed = 12345;
+
+	for (int i = 0; i < noofObjects; ++i) {
+
+		float r[3];
+
+		for (int j = 0; j < 3; ++j) {
+			seed = seed * 1664525u + 1013904223u;
+			r[j] = float(seed >> 8) / float(1 << 24);
+		}
+
+		float x = (r[0] - 0.5f) * worldSize, y = (r[1] - 0.5f) * worldSize, size = 0.02f + r[2] * 0.08f;
+		spatialBounds b = { x, y, x + size, y + size };
+		objects[i] = b;
+	}
+
+	spatialHash hash;
+	initSpatialHash(hash, 0.25f, 1 << 16);
+
+	auto start = chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < noofObjects; ++i)
+		addSpatialObject(hash, objects[i]);
+
+	double buildMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	// move 1% of the objects a little
+	start = chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < noofObjects; i += 100) {
+
+		spatialBounds& b = objects[i];
+		b.minX += 0.1f; b.maxX += 0.1f;
+		updateSpatialObject(hash, i, b);
+	}
+
+	double updateMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	spatialBounds viewport = { -1.0f, -1.0f, 1.0f, 1.0f };
+	vector<int> visible, expected;
+
+	const int noofQueries = 100;
+
+	start = chrono::high_resolution_clock::now();
+
+	for (int q = 0; q < noofQueries; ++q) {
+		visible.clear();
+		querySpatialHash(hash, viewport, visible);
+	}
+
+	double queryMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / noofQueries;
+
+	start = chrono::high_resolution_clock::now();
+
+	for (int q = 0; q < noofQueries; ++q) {
+
+		expected.clear();
+
+		for (int i = 0; i < noofObjects; ++i) {
+
+			if (overlaps(objects[i], viewport))
+				expected.push_back(i);
+		}
+	}
+
+	double bruteMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / noofQueries;
+
+	sort(visible.begin(), visible.end());
+	sort(expected.begin(), expected.end());
+
+	cout << "Spatial hash benchmark (" << noofObjects << " objects, " << visible.size() << " in the viewport)\n";
+	cout << "  build:         " << buildMs << " ms\n";
+	cout << "  move 1%:       " << updateMs << " ms\n";
+	cout << "  query:         " << queryMs << " ms (" << hash.lastCandidates << " objects tested)\n";
+	cout << "  test all:      " << bruteMs << " ms\n";
+
+	if (visible != expected)
+		cout << "  results DO NOT match: the hash found " << visible.size() << " objects, testing all found " << expected.size() << "\n";
+
+	cout << "\n";
+}
@@ -0,0 +1,46 @@
+//
+// 2D spatial hash for culling.  Axis aligned boxes are filed under the grid cells they overlap, hashed into a fixed number of buckets, so a query only visits the cells it covers
+//
+
+#pragma once
+
+#include <vector>
+
+struct spatialBounds {
+	float		minX, minY, maxX, maxY;
+};
+
+struct spatialHash {
+	float								cellSize, inverseCellSize;
+	unsigned							bucketMask; // bucket count - 1 (the count is a power of two)
+
+	std::vector<std::vector<int> >		buckets; // object ids
+	std::vector<int>					oversized; // objects covering too many cells to file individually - tested by every query
+
+	// per object
+	std::vector<spatialBounds>			bounds;
+	std::vector<int>					cells; // cell range as minX, minY, maxX, maxY (4 per object)
+	std::vector<unsigned char>			live;
+	std::vector<unsigned>				queryStamp; // last query that reported the object, so objects spanning several cells are reported once
+
+	unsigned							currentQuery;
+	unsigned							lastCandidates; // objects the last query tested
+};
+
+// Set up an empty hash.  cellSize should be around the size of a typical object.  bucketCount is rounded up to a power of two
+void initSpatialHash(spatialHash& hash, float cellSize, unsigned bucketCount = 4096);
+
+// Add an object and return its id
+int addSpatialObject(spatialHash& hash, const spatialBounds& bounds);
+
+// Move an object.  Cheap when it stays within the same cells
+void updateSpatialObject(spatialHash& hash, int id, const spatialBounds& bounds);
+
+// Remove an object.  Its id is not reused
+void removeSpatialObject(spatialHash& hash, int id);
+
+// Append the id of every object overlapping rect to results (in no particular order), returning how many were added
+unsigned querySpatialHash(spatialHash& hash, const spatialBounds& rect, std::vector<int>& results);
+
+// Time building, updating and querying a 100k object hash against testing every object, and report it if the two find different objects
+void spatialHashBenchmark(void);
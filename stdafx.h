@@ -21,4 +21,5 @@
 #include <CoreStructures\CoreStructures.h>
 
 #include "texture_loader.h"
+#include "texture_manager.h"
 #include "shader_setup.h"
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "stdafx.h"
+#include "texture_array.h"
+#include "gl_extensions.h"
+#include "jpeg_decoder.h"
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// Upload an image to one layer of the bound array
+static bool uploadLayer(const textureArray& array, int layer, fipImage& I, unsigned flags, vector<unsigned char>& scratch) {
+	// layers can't have their own swizzle, so greyscale images are expanded rather than stored as a single channel
+	if (I.getBitsPerPixel() == 8 && !I.convertTo24Bits())
+		return false;
+
+	// a changed file is resampled to the size its layer was loaded at, which the shaders' uv scale for the layer is based on
+	if ((I.getWidth() != array.layerWidth[layer] || I.getHeight() != array.layerHeight[layer]) && !I.rescale(array.layerWidth[layer], array.layerHeight[layer], FILTER_BILINEAR))
+		return false;
+
+	fiUploadSource source;
+
+	if (!fiPrepareUpload(I, flags, scratch, &source))
+		return false;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, source.rowLength);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, source.width, source.height, 1, source.format, GL_UNSIGNED_BYTE, source.pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	return true;
+}
+
+bool fiLoadTextureArray(const char **filenames, const unsigned *flags, const unsigned *targetWidths, const unsigned *targetHeights, int count, textureArray *result) {
+	result->texture = 0;
+	result->bindlessHandle = 0;
+	result->layers = 0;
+	result->width = result->height = 0;
+
+	if (count <= 0 || count > MAX_TEXTURE_ARRAY_LAYERS)
+		return false;
+
+	// decode everything first so the array size is known before any storage is allocated
+	vector<fipImage*> images(count, (fipImage*)NULL);
+	bool okay = true;
+
+	for (int i = 0; i < count && okay; ++i) {
+
+		images[i] = decodeImageScaled(filenames[i], targetWidths ? targetWidths[i] : 0, targetHeights ? targetHeights[i] : 0);
+		okay = (images[i] != NULL);
+
+		if (okay) {
+
+			result->layerWidth[i] = images[i]->getWidth();
+			result->layerHeight[i] = images[i]->getHeight();
+
+			if (images[i]->getWidth() > result->width)
+				result->width = images[i]->getWidth();
+
+			if (images[i]->getHeight() > result->height)
+				result->height = images[i]->getHeight();
+		}
+	}
+
+	if (okay) {
+
+		glGenTextures(1, &result->texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, result->texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, result->width, result->height, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		vector<unsigned char> scratch;
+
+		for (int i = 0; i < count && okay; ++i) {
+
+			if (!uploadLayer(*result, i, *images[i], flags ? flags[i] : unsigned(TEXTURE_LOAD_DEFAULT), scratch)) {
+
+				cout << "Texture array: could not add " << filenames[i] << " as layer " << i << "\n";
+				okay = false;
+			}
+		}
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// the shaders clamp to each image's corner of its layer, so wrapping never comes into it
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	for (int i = 0; i < count; ++i)
+		delete images[i];
+
+	if (!okay) {
+
+		deleteTextureArray(result);
+		return false;
+	}
+
+	result->layers = count;
+
+	// sampler state is frozen once a bindless handle is created, so this has to come last
+	if (glextBindlessTexture) {
+
+		result->bindlessHandle = glGetTextureHandleARB(result->texture);
+		glMakeTextureHandleResidentARB(result->bindlessHandle);
+	}
+
+	cout << "Texture array: " << count << " layers up to " << result->width << "x" << result->height << (result->bindlessHandle ? " (bindless)\n" : "\n");
+
+	return true;
+}
+
+bool replaceTextureArrayLayer(const textureArray& array, int layer, fipImage& image, unsigned flags) {
+	if (!array.texture || layer < 0 || layer >= array.layers)
+		return false;
+
+	vector<unsigned char> scratch;
+
+	// only the texels change, so a bindless handle stays valid
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+
+	bool okay = uploadLayer(array, layer, image, flags, scratch);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return okay;
+}
+
+size_t textureArrayBytes(const textureArray& array) {
+	return size_t(array.width) * array.height * array.layers * 4;
+}
+
+void attachTextureArray(const textureArray& array, GLuint program, const char *samplerName, GLuint textureUnit) {
+	GLint location = glGetUniformLocation(program, samplerName);
+	GLfloat scales[MAX_TEXTURE_ARRAY_LAYERS * 2];
+
+	for (int i = 0; i < array.layers; ++i) {
+
+		scales[i * 2] = GLfloat(array.layerWidth[i]) / GLfloat(array.width);
+		scales[i * 2 + 1] = GLfloat(array.layerHeight[i]) / GLfloat(array.height);
+	}
+
+	glUseProgram(program);
+
+	if (array.layers > 0)
+		glUniform2fv(glGetUniformLocation(program, "layerScales"), array.layers, scales);
+
+	if (array.bindlessHandle) {
+
+		glUniformHandleui64ARB(location, array.bindlessHandle);
+
+	} else {
+
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+		glUniform1i(location, textureUnit);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	glUseProgram(0);
+}
+
+void deleteTextureArray(textureArray *array) {
+	if (array->bindlessHandle)
+		glMakeTextureHandleNonResidentARB(array->bindlessHandle);
+
+	if (array->texture)
+		glDeleteTextures(1, &array->texture);
+
+	array->texture = 0;
+	array->bindlessHandle = 0;
+	array->layers = 0;
+}
@@ -0,0 +1,34 @@
+//
+// Texture array loader.  Images of the same class (e.g. the scene's background and effect layers) are packed into one GL_TEXTURE_2D_ARRAY at their own size, so every draw that samples them can share a single binding and select its image by layer index
+//
+
+#pragma once
+
+#include <glew\glew.h>
+
+// Layers an array can hold - the shaders size their layerScales uniform with it
+#define MAX_TEXTURE_ARRAY_LAYERS	16
+
+struct textureArray {
+	GLuint			texture;
+	GLuint64		bindlessHandle; // resident ARB_bindless_texture handle, or 0 if the driver does not support bindless textures
+	int				layers;
+	unsigned		width, height; // size of the largest layer
+	unsigned		layerWidth[MAX_TEXTURE_ARRAY_LAYERS], layerHeight[MAX_TEXTURE_ARRAY_LAYERS]; // each image sits in the bottom left corner of its layer
+};
+
+class fipImage;
+
+// Load count images into one texture array, one layer each in the given order.  The array is the size of the largest image and each keeps its own size in the corner of its layer (at most MAX_TEXTURE_ARRAY_LAYERS).  flags holds the TEXTURE_LOAD_* options for each image, and targetWidths / targetHeights the size each is drawn at so JPEGs can be decoded at a reduced scale (see decodeImageScaled).  Any of them may be NULL
+bool fiLoadTextureArray(const char **filenames, const unsigned *flags, const unsigned *targetWidths, const unsigned *targetHeights, int count, textureArray *result);
+
+// Replace one layer with a decoded image (e.g. after its file changed), resampling it to the layer's size if it differs.  image is converted in place
+bool replaceTextureArrayLayer(const textureArray& array, int layer, fipImage& image, unsigned flags);
+
+// GL storage used by the array
+size_t textureArrayBytes(const textureArray& array);
+
+// Connect the array to a sampler2DArray uniform in program.  With bindless textures the handle is written straight into the uniform, otherwise the array is bound to textureUnit.  The part of each layer its image covers goes to the program's layerScales uniform.  Neither needs repeating per frame - only after the program is relinked or the unit is rebound
+void attachTextureArray(const textureArray& array, GLuint program, const char *samplerName, GLuint textureUnit);
+
+void deleteTextureArray(textureArray *array);
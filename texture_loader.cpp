@@ -1,8 +1,12 @@
 #include "stdafx.h"
 #include "texture_loader.h"
+#include "pixel_convert.h"
+#include "jpeg_decoder.h"
 #include <FreeImage\FreeImagePlus.h>
 #include <wincodec.h>
 #include <iostream>
+#include <chrono>
+#include <vector>
 
 using namespace std;
 
@@ -189,42 +193,199 @@ GLuint wicLoadTexture(const std::wstring& filename) {
 
 #pragma region FreeImagePlus texture loader
 
-GLuint fiLoadTexture(const char *filename) {
-	BOOL				fiOkay = FALSE;
-	GLuint				newTexture = 0;
-	fipImage			I;
+// Running totals for fiLoadTexture (see fiReportLoadStats)
+static fiLoadStats			fiStats = { 0, 0, 0, 0, 0.0, 0.0 };
+
+// Map the decoder's native pixel layout onto a GL upload format.  Returns false if the bitmap has no direct GL equivalent (palettised, 16-bit 555/565 etc.) and needs converting first
+static bool fiNativeGLFormat(fipImage& I, GLenum *format, GLint *internalFormat) {
+	if (I.getImageType() != FIT_BITMAP)
+		return false;
+
+	switch (I.getBitsPerPixel()) {
+
+	case 8:
+		// Only true greyscale maps straight onto a single channel texture - palettised images still need expanding
+		if (I.getColorType() != FIC_MINISBLACK)
+			return false;
+
+		*format = GL_RED;
+		*internalFormat = GL_R8;
+		return true;
+
+	case 24:
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		*format = GL_BGR;
+#else
+		*format = GL_RGB;
+#endif
+		*internalFormat = GL_RGBA;
+		return true;
+
+	case 32:
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		*format = GL_BGRA;
+#else
+		*format = GL_RGBA;
+#endif
+		*internalFormat = GL_RGBA;
+		return true;
+
+	default:
+		return false;
+	}
+}
 
-	fiOkay = I.load(filename);
+fipImage *fiDecodeImage(const char *filename, bool *converted) {
+	fipImage *I = new fipImage();
 
-	if (!fiOkay) {
+	if (converted)
+		*converted = false;
+
+	if (!I->load(filename)) {
 
 		cout << "FreeImagePlus: Cannot open image file.\n";
-		return 0;
+
+		delete I;
+		return NULL;
 	}
 
-	fiOkay = I.flipVertical();
-	fiOkay = I.convertTo24Bits();
+	if (!fiMakeUploadable(*I, converted)) {
 
-	if (!fiOkay) {
+		delete I;
+		return NULL;
+	}
 
-		cout << "FreeImagePlus: Conversion to 24 bits successful.\n";
-		return 0;
+	return I;
+}
+
+bool fiMakeUploadable(fipImage& I, bool *converted) {
+	GLenum format;
+	GLint internalFormat;
+
+	if (converted)
+		*converted = false;
+
+	// Only fall back to a full conversion when the native layout cannot be uploaded directly
+	if (fiNativeGLFormat(I, &format, &internalFormat))
+		return true;
+
+	if (!I.convertTo24Bits() || !fiNativeGLFormat(I, &format, &internalFormat)) {
+
+		cout << "FreeImagePlus: Conversion to 24 bits unsuccessful.\n";
+		return false;
+	}
+
+	if (converted)
+		*converted = true;
+
+	return true;
+}
+
+bool fiPrepareUpload(fipImage& I, unsigned flags, vector<unsigned char>& scratch, fiUploadSource *source) {
+	GLenum format = GL_BGR;
+	GLint internalFormat = GL_RGBA;
+
+	if (!fiNativeGLFormat(I, &format, &internalFormat)) {
+
+		cout << "FreeImagePlus: Image format cannot be uploaded directly - decode with fiDecodeImage.\n";
+		return false;
 	}
 
-	auto w = I.getWidth();
-	auto h = I.getHeight();
+	unsigned w = I.getWidth();
+	unsigned h = I.getHeight();
+	unsigned pitch = I.getScanWidth();
+	unsigned bytesPerPixel = I.getBitsPerPixel() / 8;
 
 	BYTE *buffer = I.accessPixels();
 
 	if (!buffer) {
 
 		cout << "FreeImagePlus: Cannot access bitmap data.\n";
+		return false;
+	}
+
+	// Colour keying needs an alpha channel the jpeg doesn't have, so 24 bit images are expanded to RGBA with the SIMD kernels.  This is the only path that copies the image
+	if ((flags & TEXTURE_LOAD_COLOUR_KEY_BLACK) && bytesPerPixel == 3) {
+
+		scratch.resize(size_t(w) * h * 4);
+
+		unsigned convertFlags = PIXEL_CONVERT_COLOUR_KEY_BLACK | ((format == GL_BGR) ? PIXEL_CONVERT_SWAP_RB : 0);
+
+		for (unsigned y = 0; y < h; ++y)
+			convertRGBToRGBA(&scratch[size_t(y) * w * 4], buffer + size_t(y) * pitch, w, convertFlags);
+
+		buffer = scratch.data();
+		format = GL_RGBA;
+		pitch = w * 4;
+		bytesPerPixel = 4;
+
+		fiStats.conversionCopies++;
+
+	} else if ((flags & TEXTURE_LOAD_PREMULTIPLY_ALPHA) && bytesPerPixel == 4) {
+
+		// alpha is the 4th byte in both BGRA and RGBA so this works in place on the decoded bitmap
+		for (unsigned y = 0; y < h; ++y)
+			premultiplyAlpha(buffer + size_t(y) * pitch, w);
+	}
+
+	source->pixels = buffer;
+	source->format = format;
+	source->internalFormat = internalFormat;
+	source->width = w;
+	source->height = h;
+	source->pitch = pitch;
+
+	// FreeImage pitch is always a multiple of 4 bytes (GL's default unpack alignment), but express it as a row length too in case it is wider than the packed row
+	source->rowLength = (pitch % bytesPerPixel == 0) ? pitch / bytesPerPixel : 0;
+
+	return true;
+}
+
+// Upload the bitmap exactly as FreeImage decoded it.  FreeImage stores scanlines bottom-up with each line padded to a 4 byte boundary, so rows are handed to GL as-is (bottom row first matches GL's t=0) and the padding is described with the unpack state rather than repacked.  Callers should use bottom-up texture coordinates
+GLuint fiUploadImage(fipImage& I, unsigned flags, GLuint texture) {
+	auto uploadStart = chrono::high_resolution_clock::now();
+
+	vector<unsigned char> scratch;
+	fiUploadSource source;
+
+	if (!fiPrepareUpload(I, flags, scratch, &source))
 		return 0;
+
+	auto w = source.width;
+	auto h = source.height;
+	auto format = source.format;
+	auto internalFormat = source.internalFormat;
+	auto buffer = source.pixels;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, source.rowLength);
+
+	GLuint newTexture = texture;
+
+	if (texture) {
+
+		// Re-specify an existing texture in place so anything holding the texture name stays valid.  Only the texel data is replaced when the size and format are unchanged
+		GLint oldW = 0, oldH = 0, oldFormat = 0;
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &oldW);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &oldH);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &oldFormat);
+
+		if (GLuint(oldW) == w && GLuint(oldH) == h && oldFormat == internalFormat)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, GL_UNSIGNED_BYTE, buffer);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, GL_UNSIGNED_BYTE, buffer);
+
+	} else {
+
+		glGenTextures(1, &newTexture);
+		glBindTexture(GL_TEXTURE_2D, newTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, GL_UNSIGNED_BYTE, buffer);
 	}
 
-	glGenTextures(1, &newTexture);
-	glBindTexture(GL_TEXTURE_2D, newTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_BGR, GL_UNSIGNED_BYTE, buffer);
+	// Restore default unpack state so other uploads are unaffected
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
 	// Setup default texture properties
 	if (newTexture) {
@@ -233,9 +394,138 @@ GLuint fiLoadTexture(const char *filename) {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		// Greyscale images are replicated across rgb so shaders see the same result as the old 24 bit conversion
+		GLint swizzle[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+
+		if (format == GL_RED) {
+
+			swizzle[1] = swizzle[2] = GL_RED;
+			swizzle[3] = GL_ONE;
+		}
+
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
 	}
 
+	auto uploadEnd = chrono::high_resolution_clock::now();
+
+	// Update load statistics
+	size_t imageBytes = size_t(source.pitch) * h;
+
+	fiStats.texturesLoaded++;
+	fiStats.bytesUploaded += imageBytes;
+
+	if (imageBytes > fiStats.peakImageBytes)
+		fiStats.peakImageBytes = imageBytes;
+
+	fiStats.uploadMs += chrono::duration<double, milli>(uploadEnd - uploadStart).count();
+
+	return newTexture;
+}
+
+GLuint fiLoadTexture(const char *filename, unsigned flags, unsigned targetWidth, unsigned targetHeight) {
+	auto decodeStart = chrono::high_resolution_clock::now();
+
+	bool converted = false;
+	fipImage *I = decodeImageScaled(filename, targetWidth, targetHeight, &converted);
+
+	fiStats.decodeMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - decodeStart).count();
+
+	if (!I)
+		return 0;
+
+	if (converted)
+		fiStats.conversionCopies++;
+
+	GLuint newTexture = fiUploadImage(*I, flags);
+
+	delete I;
+
 	return newTexture;
 }
 
+const fiLoadStats& fiGetLoadStats(void) {
+	return fiStats;
+}
+
+void fiReportLoadStats(void) {
+	cout << "FreeImagePlus: " << fiStats.texturesLoaded << " textures, " << fiStats.conversionCopies << " full-image conversion copies\n";
+	cout << "FreeImagePlus: peak image memory " << fiStats.peakImageBytes / 1024 << " KB (textureLoadBenchmark measures the old flip + convert path)\n";
+	cout << "FreeImagePlus: decode " << fiStats.decodeMs << " ms, upload " << fiStats.uploadMs << " ms\n\n";
+}
+
+void textureLoadBenchmark(void) {
+	const char *files[] = { "Assets\\sky.jpg", "Assets\\ground.jpg", "Assets\\grass.jpg", "Assets\\explosion.jpg", "Assets\\cloud.jpg" };
+	const int iterations = 10;
+
+	cout << "Texture load benchmark (old flip + convert path against decode + prepare upload, full size)\n";
+
+	for (const char *file : files) {
+
+		size_t legacyPeak = 0, peak = 0;
+		bool okay = true;
+
+		auto start = chrono::high_resolution_clock::now();
+
+		for (int n = 0; n < iterations && okay; ++n) {
+
+			fipImage I;
+
+			okay = I.load(file) && I.flipVertical();
+
+			// the old path's convertTo24Bits - fipImage makes the converted copy before it frees the original, so both are held at once
+			FIBITMAP *converted = okay ? FreeImage_ConvertTo24Bits(I) : NULL;
+
+			if (converted) {
+
+				size_t held = size_t(FreeImage_GetDIBSize(I)) + FreeImage_GetDIBSize(converted);
+
+				if (held > legacyPeak)
+					legacyPeak = held;
+
+				FreeImage_Unload(converted);
+
+			} else {
+
+				okay = false;
+			}
+		}
+
+		double legacyMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / iterations;
+
+		start = chrono::high_resolution_clock::now();
+
+		for (int n = 0; n < iterations && okay; ++n) {
+
+			fipImage *I = fiDecodeImage(file);
+			vector<unsigned char> scratch;
+			fiUploadSource source;
+
+			okay = I && fiPrepareUpload(*I, TEXTURE_LOAD_DEFAULT, scratch, &source);
+
+			if (okay) {
+
+				size_t held = size_t(FreeImage_GetDIBSize(*I)) + scratch.capacity();
+
+				if (held > peak)
+					peak = held;
+			}
+
+			delete I;
+		}
+
+		double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / iterations;
+
+		if (!okay) {
+
+			cout << "  " << file << ": could not be loaded\n";
+			continue;
+		}
+
+		cout << "  " << file << ": old path " << legacyMs << " ms, peak " << legacyPeak / 1024 << " KB - now " << ms << " ms, peak " << peak / 1024 << " KB\n";
+	}
+
+	cout << "\n";
+}
+
 #pragma endregion
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <glew\glew.h>
 #include <Windows.h>
 #include <string>
+#include <vector>
 
 // COM initialisation and shutdown methods
 HRESULT initCOM(void);
@@ -16,5 +17,52 @@ void shutdownCOM(void);
 GLuint wicLoadTexture(const std::wstring& filename);
 #endif
 
-// FreeImage texture loader
-GLuint fiLoadTexture(const char *filename);
\ No newline at end of file
+// FreeImage texture loader statistics
+struct fiLoadStats {
+	unsigned		texturesLoaded;
+	unsigned		conversionCopies; // number of images that needed a full-image format conversion before upload
+	size_t			bytesUploaded;
+	size_t			peakImageBytes; // largest decoded image held in memory at once
+	double			decodeMs;
+	double			uploadMs;
+};
+
+// fiLoadTexture options
+enum {
+
+	TEXTURE_LOAD_DEFAULT = 0,
+	TEXTURE_LOAD_COLOUR_KEY_BLACK = 0x01, // derive alpha from brightness so black backgrounds become transparent (output is premultiplied)
+	TEXTURE_LOAD_PREMULTIPLY_ALPHA = 0x02 // premultiply images that already carry an alpha channel
+};
+
+class fipImage;
+
+// FreeImage texture loader.  Images are uploaded in FreeImage's native bottom-up row order, so t=0 is the bottom of the image (unlike wicLoadTexture which is top-down).  If a target size is given, JPEGs are decoded at a reduced scale that still covers it (see decodeImageScaled)
+GLuint fiLoadTexture(const char *filename, unsigned flags = TEXTURE_LOAD_DEFAULT, unsigned targetWidth = 0, unsigned targetHeight = 0);
+
+// Split form of fiLoadTexture.  fiDecodeImage makes no GL calls so it can run on a worker thread; it returns a new image (delete when done) in a layout fiUploadImage accepts, or NULL on failure.  converted is set if a full-image format conversion was needed
+fipImage *fiDecodeImage(const char *filename, bool *converted = NULL);
+
+// Convert a decoded image to 24 bits in place if GL can't take its layout directly.  Returns false if it still can't be uploaded.  converted is set if a conversion was needed
+bool fiMakeUploadable(fipImage& image, bool *converted = NULL);
+
+// Pixel data ready for glTexImage / glTexSubImage.  pixels points either at the decoded bitmap or at the caller's scratch buffer when a conversion was needed
+struct fiUploadSource {
+	const BYTE		*pixels;
+	GLenum			format;
+	GLint			internalFormat;
+	unsigned		width, height;
+	unsigned		pitch; // bytes between rows
+	unsigned		rowLength; // GL_UNPACK_ROW_LENGTH for pixels (0 = tightly packed)
+};
+
+// Work out how to upload a decoded image, applying the TEXTURE_LOAD_* flags.  Returns false if the image cannot be uploaded
+bool fiPrepareUpload(fipImage& image, unsigned flags, std::vector<unsigned char>& scratch, fiUploadSource *source);
+
+// Upload a decoded image on the GL thread.  If texture is non-zero its contents are replaced in place (glTexSubImage2D when the size and format match) and the same name is returned
+GLuint fiUploadImage(fipImage& image, unsigned flags, GLuint texture = 0);
+const fiLoadStats& fiGetLoadStats(void);
+void fiReportLoadStats(void);
+
+// Time the old flipVertical + convertTo24Bits path against fiDecodeImage + fiPrepareUpload on the shipped images, and print the bitmap memory each path holds at its peak
+void textureLoadBenchmark(void);
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "stdafx.h"
+#include "texture_manager.h"
+#include "texture_array.h"
+#include "asset_watcher.h"
+#include "jpeg_decoder.h"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <iostream>
+
+using namespace std;
+
+// Default resident budget - comfortably above the built in scene, small enough that large background sets are streamed
+static const size_t DEFAULT_TEXTURE_BUDGET = 256 * 1024 * 1024;
+
+// Registered texture.  Resident entries are linked into an intrusive LRU list (head = most recently used) so touching and evicting are both O(1)
+struct textureEntry {
+	string			path;
+	unsigned		loadFlags;
+	unsigned		targetWidth, targetHeight;
+	GLuint			texture;
+	size_t			bytes;
+	unsigned		lastUsedFrame;
+	int				prev, next;
+};
+
+static vector<textureEntry>		textures;
+static int						lruHead = -1, lruTail = -1;
+static unsigned					currentFrame = 0;
+static textureStats				stats = { 0, 0, 0, 0, 0, 0, DEFAULT_TEXTURE_BUDGET, 0 };
+
+// Texture arrays handed to the manager, with the files and flags of their layers
+struct managedArray {
+	textureArray		*array;
+	vector<unsigned>	flags;
+};
+
+static vector<managedArray>		arrays;
+
+// What the watcher thread needs to decode a changed file for each handle or array layer loaded from it.  Kept apart from textures, which only the GL thread touches
+struct reloadTarget {
+	string			path; // normalised
+	TextureHandle	handle; // 0 for an array layer
+	int				array, layer;
+	unsigned		targetWidth, targetHeight;
+};
+
+// One handle's (or layer's) image, decoded for it alone - the upload premultiplies in place, so they must not share an image
+struct reloadImage {
+	reloadTarget	target;
+	fipImage		*image;
+};
+
+static mutex						reloadLock; // guards reloadTargets
+static vector<reloadTarget>			reloadTargets;
+
+#pragma region LRU list
+
+static void lruUnlink(int i) {
+	textureEntry& e = textures[i];
+
+	if (e.prev >= 0)
+		textures[e.prev].next = e.next;
+	else
+		lruHead = e.next;
+
+	if (e.next >= 0)
+		textures[e.next].prev = e.prev;
+	else
+		lruTail = e.prev;
+
+	e.prev = e.next = -1;
+}
+
+static void lruPushFront(int i) {
+	textureEntry& e = textures[i];
+
+	e.prev = -1;
+	e.next = lruHead;
+
+	if (lruHead >= 0)
+		textures[lruHead].prev = i;
+	else
+		lruTail = i;
+
+	lruHead = i;
+}
+
+#pragma endregion
+
+#pragma region residency
+
+// Estimate the GL storage for the currently bound texture from its level 0 size and internal format
+static size_t boundTextureBytes(void) {
+	GLint w = 0, h = 0, internalFormat = 0;
+
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+
+	// drivers store 3 channel textures padded to 4 bytes per texel
+	size_t texelBytes = (internalFormat == GL_R8 || internalFormat == GL_RED) ? 1 : 4;
+
+	return size_t(w) * size_t(h) * texelBytes;
+}
+
+static void evictTexture(int i) {
+	textureEntry& e = textures[i];
+
+	lruUnlink(i);
+
+	glDeleteTextures(1, &e.texture);
+	e.texture = 0;
+
+	stats.residentBytes -= e.bytes;
+	stats.resident--;
+	stats.evictions++;
+
+	e.bytes = 0;
+}
+
+// Evict from the cold end of the list until within budget.  Textures used this frame are kept even if that leaves the manager over budget, since draws already submitted this frame still reference them
+static void enforceBudget(void) {
+	while (stats.residentBytes > stats.budgetBytes && lruTail >= 0 && textures[lruTail].lastUsedFrame != currentFrame)
+		evictTexture(lruTail);
+}
+
+static bool loadTexture(int i) {
+	textureEntry& e = textures[i];
+
+	e.texture = fiLoadTexture(e.path.c_str(), e.loadFlags, e.targetWidth, e.targetHeight);
+
+	if (!e.texture) {
+
+		cout << "Texture manager: could not load " << e.path << "\n";
+		return false;
+	}
+
+	e.bytes = boundTextureBytes();
+
+	stats.residentBytes += e.bytes;
+	stats.resident++;
+
+	lruPushFront(i);
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region hot reload
+
+static void releaseTextureReload(void *payload) {
+	vector<reloadImage> *images = (vector<reloadImage>*)payload;
+
+	for (size_t i = 0; i < images->size(); ++i)
+		delete (*images)[i].image;
+
+	delete images;
+}
+
+// Decode on the watcher thread, once for each handle registered from path at the size it was registered with
+static void *prepareTextureReload(const string& path) {
+	vector<reloadTarget> targets;
+
+	{
+		lock_guard<mutex> guard(reloadLock);
+
+		for (size_t i = 0; i < reloadTargets.size(); ++i) {
+
+			if (reloadTargets[i].path == path)
+				targets.push_back(reloadTargets[i]);
+		}
+	}
+
+	vector<reloadImage> *images = new vector<reloadImage>();
+
+	for (size_t i = 0; i < targets.size(); ++i) {
+
+		const reloadTarget& t = targets[i];
+		fipImage *I = decodeImageScaled(path.c_str(), t.targetWidth, t.targetHeight);
+
+		if (I) {
+
+			reloadImage image = { t, I };
+			images->push_back(image);
+		}
+	}
+
+	return images;
+}
+
+// Replace the contents of every resident texture loaded from path in place.  The GL texture names (and so the handles) are unchanged.  Non-resident textures pick up the new file on their next load
+static void applyTextureReload(const string& path, void *payload) {
+	vector<reloadImage> *images = (vector<reloadImage>*)payload;
+
+	for (size_t i = 0; i < images->size(); ++i) {
+
+		const reloadTarget& t = (*images)[i].target;
+
+		if (!t.handle) {
+
+			const managedArray& a = arrays[t.array];
+
+			if (!replaceTextureArrayLayer(*a.array, t.layer, *(*images)[i].image, a.flags[t.layer]))
+				cout << "Texture manager: could not reload " << path << " into array layer " << t.layer << "\n";
+
+			continue;
+		}
+
+		textureEntry& e = textures[t.handle - 1];
+
+		if (!e.texture)
+			continue;
+
+		fiUploadImage(*(*images)[i].image, e.loadFlags, e.texture);
+
+		stats.residentBytes -= e.bytes;
+		e.bytes = boundTextureBytes();
+		stats.residentBytes += e.bytes;
+	}
+
+	releaseTextureReload(images);
+}
+
+// Hook the image types we load into the asset watcher the first time anything is registered, and watch the file
+static void watchTextureFile(const char *filename, const reloadTarget& target) {
+	static bool reloadHandlersAdded = false;
+
+	if (!reloadHandlersAdded) {
+
+		addAssetHandler(".jpg", prepareTextureReload, applyTextureReload, releaseTextureReload);
+		addAssetHandler(".png", prepareTextureReload, applyTextureReload, releaseTextureReload);
+		addAssetHandler(".bmp", prepareTextureReload, applyTextureReload, releaseTextureReload);
+
+		reloadHandlersAdded = true;
+	}
+
+	{
+		lock_guard<mutex> guard(reloadLock);
+		reloadTargets.push_back(target);
+	}
+
+	watchAssetFile(filename);
+}
+
+#pragma endregion
+
+TextureHandle registerTexture(const char *filename, unsigned loadFlags, unsigned targetWidth, unsigned targetHeight) {
+	for (size_t i = 0; i < textures.size(); ++i) {
+
+		const textureEntry& e = textures[i];
+
+		if (e.loadFlags == loadFlags && e.targetWidth == targetWidth && e.targetHeight == targetHeight && e.path == filename)
+			return TextureHandle(i + 1);
+	}
+
+	textureEntry e;
+
+	e.path = filename;
+	e.loadFlags = loadFlags;
+	e.targetWidth = targetWidth;
+	e.targetHeight = targetHeight;
+	e.texture = 0;
+	e.bytes = 0;
+	e.lastUsedFrame = 0;
+	e.prev = e.next = -1;
+
+	textures.push_back(e);
+	stats.registered++;
+
+	reloadTarget t = { normaliseAssetPath(filename), TextureHandle(textures.size()), -1, -1, targetWidth, targetHeight };
+
+	watchTextureFile(filename, t);
+
+	return TextureHandle(textures.size());
+}
+
+void manageTextureArray(textureArray *array, const char **filenames, const unsigned *flags, const unsigned *targetWidths, const unsigned *targetHeights, int count) {
+	managedArray a;
+
+	a.array = array;
+	a.flags.assign(count, TEXTURE_LOAD_DEFAULT);
+
+	if (flags)
+		a.flags.assign(flags, flags + count);
+
+	arrays.push_back(a);
+
+	// layers are decoded at their target size, as fiLoadTextureArray does, and resampled to their layer's size if the file's size changed
+	for (int i = 0; i < count; ++i) {
+
+		reloadTarget t = { normaliseAssetPath(filenames[i]), 0, int(arrays.size() - 1), i, targetWidths ? targetWidths[i] : 0, targetHeights ? targetHeights[i] : 0 };
+
+		watchTextureFile(filenames[i], t);
+	}
+
+	stats.arrayBytes += textureArrayBytes(*array);
+	stats.residentBytes += textureArrayBytes(*array);
+
+	enforceBudget();
+}
+
+GLuint useTexture(TextureHandle handle) {
+	if (handle == 0 || handle > textures.size())
+		return 0;
+
+	int i = int(handle - 1);
+
+	if (textures[i].texture) {
+
+		stats.hits++;
+
+		// move to the hot end of the list
+		if (lruHead != i) {
+
+			lruUnlink(i);
+			lruPushFront(i);
+		}
+
+	} else {
+
+		stats.misses++;
+
+		if (!loadTexture(i))
+			return 0;
+	}
+
+	textures[i].lastUsedFrame = currentFrame;
+
+	enforceBudget();
+
+	return textures[i].texture;
+}
+
+void textureManagerBeginFrame(void) {
+	currentFrame++;
+	enforceBudget();
+}
+
+void setTextureBudget(size_t bytes) {
+	stats.budgetBytes = bytes;
+	enforceBudget();
+}
+
+void evictAllTextures(void) {
+	while (lruTail >= 0)
+		evictTexture(lruTail);
+}
+
+const textureStats& getTextureStats(void) {
+	return stats;
+}
+
+void reportTextureStats(void) {
+	cout << "Texture manager: " << stats.resident << "/" << stats.registered << " textures resident, " << stats.residentBytes / 1024 << " KB of " << stats.budgetBytes / 1024 << " KB budget (" << arrays.size() << " texture arrays, " << stats.arrayBytes / 1024 << " KB)\n";
+	cout << "Texture manager: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evictions\n";
+
+	fiReportLoadStats();
+}
@@ -0,0 +1,46 @@
+//
+// Texture residency manager.  Textures are registered up front by path and handed out as lightweight handles.  The image is only decoded and uploaded the first time a handle is used, and the least recently used textures are evicted when the resident size exceeds the memory budget
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <cstddef>
+
+// Handle to a registered texture.  0 is never a valid handle
+typedef unsigned int TextureHandle;
+
+// Residency statistics
+struct textureStats {
+	unsigned		registered;
+	unsigned		resident;
+	unsigned		hits; // useTexture calls that found the texture resident
+	unsigned		misses; // useTexture calls that had to load the texture
+	unsigned		evictions;
+	size_t			residentBytes;
+	size_t			budgetBytes;
+	size_t			arrayBytes; // texture arrays - included in residentBytes, but never evicted
+};
+
+struct textureArray;
+
+// Register an image file (loaded with fiLoadTexture and the given TEXTURE_LOAD_* flags).  targetWidth / targetHeight give the largest size the texture is drawn at on screen, so JPEGs can be decoded at a reduced scale (0 = full size).  Registering the same path, flags and size twice returns the same handle
+TextureHandle registerTexture(const char *filename, unsigned loadFlags = 0, unsigned targetWidth = 0, unsigned targetHeight = 0);
+
+// Hand over a texture array loaded from filenames (with the same flags and target sizes, in layer order).  Its layers are re-uploaded when their files change and its storage counts against the budget, though it is never evicted since every draw from it shares it.  array must stay valid until the program exits
+void manageTextureArray(textureArray *array, const char **filenames, const unsigned *flags, const unsigned *targetWidths, const unsigned *targetHeights, int count);
+
+// Return the GL texture for handle, loading it if it is not resident, and mark it as used this frame.  Returns 0 if the handle is invalid or the image cannot be loaded
+GLuint useTexture(TextureHandle handle);
+
+// Advance the frame counter and evict least recently used textures until the resident size is within budget.  Call once at the start of each frame
+void textureManagerBeginFrame(void);
+
+// Set the resident memory budget in bytes (evicts immediately if over budget)
+void setTextureBudget(size_t bytes);
+
+// Release every resident texture.  Handles stay valid and reload on next use
+void evictAllTextures(void);
+
+const textureStats& getTextureStats(void);
+void reportTextureStats(void);
@@ -0,0 +1,170 @@
+#include "stdafx.h"
+#include "thread_pool.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+
+// Chunks per thread when the range is big enough - a few each so a thread that gets held up doesn't hold up the rest
+static const int				CHUNKS_PER_THREAD = 4;
+
+struct parallelJob {
+	const parallelJobFunc		*body;
+	int							count, chunkSize, chunks;
+	atomic<int>					nextChunk;
+};
+
+static vector<thread*>			workers;
+static mutex					poolLock; // guards everything below
+static condition_variable		poolWake, jobDone;
+static parallelJob				*currentJob = NULL;
+static unsigned					jobGeneration = 0; // bumped for each job so workers can tell a new one from the one they just did
+static int						busyWorkers = 0; // workers holding currentJob
+static bool						poolRunning = false;
+
+// Work through chunks of job until there are none left
+static void runChunks(parallelJob& job) {
+	for (;;) {
+
+		int c = job.nextChunk++;
+
+		if (c >= job.chunks)
+			return;
+
+		int begin = c * job.chunkSize;
+		int end = (begin + job.chunkSize < job.count) ? begin + job.chunkSize : job.count;
+
+		(*job.body)(begin, end, c);
+	}
+}
+
+static void workerMain(void) {
+	unsigned seen = 0;
+
+	for (;;) {
+
+		parallelJob *job;
+
+		{
+			unique_lock<mutex> lock(poolLock);
+
+			while (poolRunning && (jobGeneration == seen || !currentJob))
+				poolWake.wait(lock);
+
+			if (!poolRunning)
+				return;
+
+			seen = jobGeneration;
+			job = currentJob;
+			busyWorkers++;
+		}
+
+		runChunks(*job);
+
+		{
+			lock_guard<mutex> guard(poolLock);
+
+			if (--busyWorkers == 0)
+				jobDone.notify_all();
+		}
+	}
+}
+
+void startThreadPool(int threads) {
+	if (poolRunning)
+		return;
+
+	if (threads <= 0)
+		threads = int(thread::hardware_concurrency());
+
+	poolRunning = true;
+
+	// the calling thread is one of the threads
+	for (int i = 1; i < threads; ++i)
+		workers.push_back(new thread(workerMain));
+
+	// glutMainLoop leaves through exit(), so make sure the threads are joined before static destructors run
+	atexit(stopThreadPool);
+}
+
+void stopThreadPool(void) {
+	{
+		lock_guard<mutex> guard(poolLock);
+
+		if (!poolRunning)
+			return;
+
+		poolRunning = false;
+	}
+
+	poolWake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); ++i) {
+
+		workers[i]->join();
+		delete workers[i];
+	}
+
+	workers.clear();
+}
+
+int threadPoolSize(void) {
+	return int(workers.size()) + 1;
+}
+
+static int chunkSizeFor(int count, int grain) {
+	int maxChunks = threadPoolSize() * CHUNKS_PER_THREAD;
+	int size = (count + maxChunks - 1) / maxChunks;
+
+	return (size > grain) ? size : ((grain > 0) ? grain : 1);
+}
+
+int parallelChunks(int count, int grain) {
+	if (count <= 0)
+		return 0;
+
+	int size = chunkSizeFor(count, grain);
+
+	return (count + size - 1) / size;
+}
+
+void parallelFor(int count, int grain, const parallelJobFunc& job) {
+	if (count <= 0)
+		return;
+
+	parallelJob j;
+
+	j.body = &job;
+	j.count = count;
+	j.chunkSize = chunkSizeFor(count, grain);
+	j.chunks = (count + j.chunkSize - 1) / j.chunkSize;
+	j.nextChunk = 0;
+
+	if (j.chunks == 1 || workers.empty()) {
+
+		runChunks(j);
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(poolLock);
+
+		currentJob = &j;
+		jobGeneration++;
+	}
+
+	poolWake.notify_all();
+
+	runChunks(j);
+
+	// every chunk has been taken once runChunks returns, but workers may still be running theirs.  Unpublishing the job first stops any worker that is only now waking up from picking it up
+	unique_lock<mutex> lock(poolLock);
+
+	currentJob = NULL;
+
+	while (busyWorkers > 0)
+		jobDone.wait(lock);
+}
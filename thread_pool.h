@@ -0,0 +1,23 @@
+//
+// Worker thread pool for data parallel frame work.  Chunking only depends on the item count, grain and pool size, so per-chunk output merged in chunk order doesn't depend on timing
+//
+
+#pragma once
+
+#include <functional>
+
+// Called for items [begin, end) of chunk number chunk
+typedef std::function<void(int begin, int end, int chunk)> parallelJobFunc;
+
+// Start threads - 1 workers (0 = one per core besides the calling thread).  stopThreadPool is also registered to run at exit
+void startThreadPool(int threads = 0);
+void stopThreadPool(void);
+
+// Threads that work on a parallelFor, including the calling thread
+int threadPoolSize(void);
+
+// Number of chunks parallelFor(count, grain, ...) will use.  Chunks hold at least grain items, except the last
+int parallelChunks(int count, int grain);
+
+// Run job over [0, count) and wait for it.  Small ranges (a single chunk) run on the calling thread without waking the workers.  Only one parallelFor may run at a time, and job must not call parallelFor
+void parallelFor(int count, int grain, const parallelJobFunc& job);
@@ -0,0 +1,493 @@
+#include "stdafx.h"
+#include "tile_world.h"
+#include "scene_file.h"
+#include <cmath>
+#include <map>
+#include <set>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+static const int		CHUNK_QUADS = TILE_CHUNK_TILES * TILE_CHUNK_TILES;
+
+struct chunkCoord {
+	int					x, y;
+};
+
+// Rectangle of chunks (inclusive)
+struct chunkRange {
+	int					minX, minY, maxX, maxY;
+
+	bool contains(const chunkCoord& c) const { return c.x >= minX && c.x <= maxX && c.y >= minY && c.y <= maxY; }
+};
+
+// A chunk made by the worker, waiting to be uploaded
+struct generatedChunk {
+	chunkCoord			coord;
+	vector<sceneVertex>	vertices;
+	GLsizei				first[TILE_TYPE_COUNT], count[TILE_TYPE_COUNT];
+};
+
+// A buffer in the pool, and the chunk it holds when it is resident
+struct chunkSlot {
+	GLuint				vao, vertexBuffer;
+	chunkCoord			coord;
+	GLsizei				first[TILE_TYPE_COUNT], count[TILE_TYPE_COUNT];
+};
+
+static unsigned						worldSeed = 0;
+static bool							useBuffers = true; // false when streamed without a GL context
+
+// shared with the worker thread, guarded by streamLock
+static mutex						streamLock;
+static condition_variable			streamWake;
+static deque<chunkCoord>			requests;
+static vector<generatedChunk>		finished;
+static unsigned						workerGenerated = 0;
+static double						workerMs = 0.0;
+
+static thread						*worker = NULL;
+static atomic<bool>					workerRunning(false);
+
+// GL thread only
+static GLuint						quadIndexBuffer = 0; // indices for CHUNK_QUADS quads, shared by every slot
+static vector<chunkSlot>			slots;
+static vector<int>					freeSlots;
+static map<long long, int>			residentChunks; // chunk key -> slot
+static set<long long>				pendingChunks; // requested, generating or generated but not uploaded
+static vector<generatedChunk>		readyChunks; // collected from the worker, waiting for an upload slot in a later frame
+static tileWorldStats				stats = { 0, 0, 0, 0, 0, 0, 0.0 };
+
+static long long chunkKey(const chunkCoord& c) {
+	return ((long long)c.x << 32) | (long long)(unsigned)c.y;
+}
+
+static int floorDivide(int a, int b) {
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+#pragma region generation
+
+static unsigned hashCoordinate(int x, unsigned seed) {
+	unsigned h = unsigned(x) * 374761393u + seed * 668265263u;
+
+	h = (h ^ (h >> 13)) * 1274126177u;
+
+	return h ^ (h >> 16);
+}
+
+// Random values every period tiles, smoothly interpolated between (0 - 1)
+static float valueNoise(int x, int period, unsigned seed) {
+	int cell = floorDivide(x, period);
+	float t = float(x - cell * period) / float(period);
+
+	float a = float(hashCoordinate(cell, seed) & 0xFFFF) / 65535.0f;
+	float b = float(hashCoordinate(cell + 1, seed) & 0xFFFF) / 65535.0f;
+
+	return lerp(a, b, smoothstep(t, 0.0f, 1.0f));
+}
+
+// Row of the grass tile in tile column x.  Rolling hills with some smaller bumps, averaging around y = -0.5 where the scene's ground is
+static int surfaceRow(int x, unsigned seed) {
+	float height = valueNoise(x, 32, seed) * 16.0f + valueNoise(x, 8, seed + 1) * 4.0f;
+
+	return int(floorf(height)) - 14;
+}
+
+static void addTile(vector<sceneVertex>& vertices, int column, int row, int tileX, int tileY, tileType type) {
+	static const unsigned char colours[TILE_TYPE_COUNT][4] = {
+		{ 110, 170, 230, 255 },
+		{ 70, 160, 50, 255 },
+		{ 120, 80, 40, 255 }
+	};
+
+	// each texture spans 8 x 8 tiles
+	float u = float(tileX & 7) / 8.0f, v = float(tileY & 7) / 8.0f;
+	float x = float(column) * TILE_SIZE, y = float(row) * TILE_SIZE;
+
+	// same corner order as the scene's strips: bottom left, top left, bottom right, top right
+	sceneVertex corners[4] = {
+		{ x, y, { 0 }, u, v },
+		{ x, y + TILE_SIZE, { 0 }, u, v + 0.125f },
+		{ x + TILE_SIZE, y, { 0 }, u + 0.125f, v },
+		{ x + TILE_SIZE, y + TILE_SIZE, { 0 }, u + 0.125f, v + 0.125f }
+	};
+
+	for (int i = 0; i < 4; ++i) {
+
+		memcpy(corners[i].colour, colours[type], 4);
+		vertices.push_back(corners[i]);
+	}
+}
+
+static void generateChunk(const chunkCoord& c, unsigned seed, generatedChunk& chunk) {
+	int surface[TILE_CHUNK_TILES];
+
+	for (int column = 0; column < TILE_CHUNK_TILES; ++column)
+		surface[column] = surfaceRow(c.x * TILE_CHUNK_TILES + column, seed);
+
+	chunk.coord = c;
+	chunk.vertices.clear();
+	chunk.vertices.reserve(CHUNK_QUADS * 4);
+
+	// one pass per type so each type's tiles are contiguous
+	for (int type = 0; type < TILE_TYPE_COUNT; ++type) {
+
+		chunk.first[type] = GLsizei(chunk.vertices.size() / 4 * 6);
+
+		for (int row = 0; row < TILE_CHUNK_TILES; ++row) {
+
+			int tileY = c.y * TILE_CHUNK_TILES + row;
+
+			for (int column = 0; column < TILE_CHUNK_TILES; ++column) {
+
+				int tileX = c.x * TILE_CHUNK_TILES + column;
+				tileType t = (tileY > surface[column]) ? TILE_SKY : ((tileY == surface[column]) ? TILE_GRASS : TILE_GROUND);
+
+				if (t == type)
+					addTile(chunk.vertices, column, row, tileX, tileY, t);
+			}
+		}
+
+		chunk.count[type] = GLsizei(chunk.vertices.size() / 4 * 6) - chunk.first[type];
+	}
+}
+
+static void workerMain(void) {
+	for (;;) {
+
+		chunkCoord c;
+
+		{
+			unique_lock<mutex> lock(streamLock);
+
+			while (workerRunning && requests.empty())
+				streamWake.wait(lock);
+
+			if (!workerRunning)
+				return;
+
+			c = requests.front();
+			requests.pop_front();
+		}
+
+		generatedChunk chunk;
+
+		auto start = chrono::high_resolution_clock::now();
+		generateChunk(c, worldSeed, chunk);
+		double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+		lock_guard<mutex> guard(streamLock);
+
+		finished.push_back(move(chunk));
+		workerGenerated++;
+		workerMs += ms;
+	}
+}
+
+#pragma endregion
+
+#pragma region streaming
+
+static chunkRange chunksAround(const spatialBounds& view, int margin) {
+	chunkRange r = {
+		int(floorf(view.minX / TILE_CHUNK_SIZE)) - margin,
+		int(floorf(view.minY / TILE_CHUNK_SIZE)) - margin,
+		int(floorf(view.maxX / TILE_CHUNK_SIZE)) + margin,
+		int(floorf(view.maxY / TILE_CHUNK_SIZE)) + margin
+	};
+
+	return r;
+}
+
+// Add count buffers to the pool
+static void addChunkSlots(size_t count) {
+	size_t first = slots.size();
+
+	slots.resize(first + count);
+
+	for (size_t i = slots.size(); i-- > first;) {
+
+		freeSlots.push_back(int(i));
+
+		if (!useBuffers)
+			continue;
+
+		chunkSlot& s = slots[i];
+
+		glGenVertexArrays(1, &s.vao);
+		glBindVertexArray(s.vao);
+
+		glGenBuffers(1, &s.vertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, s.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, CHUNK_QUADS * 4 * sizeof(sceneVertex), NULL, GL_DYNAMIC_DRAW);
+
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(sceneVertex), (const GLvoid*)offsetof(sceneVertex, x));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(sceneVertex), (const GLvoid*)offsetof(sceneVertex, colour));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(sceneVertex), (const GLvoid*)offsetof(sceneVertex, u));
+		glEnableVertexAttribArray(2);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+	}
+
+	if (useBuffers) {
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+static void uploadChunk(const generatedChunk& chunk) {
+	int slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	chunkSlot& s = slots[slot];
+
+	s.coord = chunk.coord;
+	memcpy(s.first, chunk.first, sizeof(s.first));
+	memcpy(s.count, chunk.count, sizeof(s.count));
+
+	if (useBuffers) {
+
+		glBindBuffer(GL_ARRAY_BUFFER, s.vertexBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, chunk.vertices.size() * sizeof(sceneVertex), &chunk.vertices[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	residentChunks[chunkKey(chunk.coord)] = slot;
+}
+
+void startTileWorld(unsigned seed, bool createBuffers) {
+	if (worker)
+		return;
+
+	worldSeed = seed;
+	useBuffers = createBuffers;
+
+	// every chunk has the same number of quads, so one index buffer serves them all
+	if (useBuffers) {
+
+		vector<unsigned short> indices;
+		indices.reserve(CHUNK_QUADS * 6);
+
+		static const int quad[6] = { 0, 1, 2, 2, 1, 3 };
+
+		for (int q = 0; q < CHUNK_QUADS; ++q) {
+
+			for (int i = 0; i < 6; ++i)
+				indices.push_back((unsigned short)(q * 4 + quad[i]));
+		}
+
+		glGenBuffers(1, &quadIndexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+	}
+
+	// streaming only ever overwrites the pool's buffers - it is only added to when the view needs more chunks than it holds
+	addChunkSlots(INITIAL_TILE_CHUNKS);
+
+	workerRunning = true;
+	worker = new thread(workerMain);
+
+	// glutMainLoop leaves through exit(), so make sure the thread is joined before static destructors run
+	atexit(stopTileWorld);
+}
+
+void stopTileWorld(void) {
+	if (!worker)
+		return;
+
+	{
+		lock_guard<mutex> guard(streamLock);
+		workerRunning = false;
+	}
+
+	streamWake.notify_all();
+	worker->join();
+
+	delete worker;
+	worker = NULL;
+
+	requests.clear();
+	finished.clear();
+}
+
+void updateTileWorld(const spatialBounds& view) {
+	if (!worker)
+		return;
+
+	chunkRange keep = chunksAround(view, TILE_KEEP_MARGIN);
+	chunkRange load = chunksAround(view, TILE_LOAD_MARGIN);
+
+	// every chunk in the keep range can end up resident or pending at once, so the pool must hold that many
+	size_t keepChunks = size_t(keep.maxX - keep.minX + 1) * size_t(keep.maxY - keep.minY + 1);
+
+	if (keepChunks > slots.size())
+		addChunkSlots(keepChunks - slots.size());
+
+	// collect what the worker has finished, and forget requests it hasn't started that are no longer needed
+	{
+		lock_guard<mutex> guard(streamLock);
+
+		for (size_t i = 0; i < finished.size(); ++i)
+			readyChunks.push_back(move(finished[i]));
+
+		finished.clear();
+
+		stats.generated = workerGenerated;
+		stats.generateMs = workerMs;
+
+		size_t kept = 0;
+
+		for (size_t i = 0; i < requests.size(); ++i) {
+
+			if (keep.contains(requests[i]))
+				requests[kept++] = requests[i];
+			else
+				pendingChunks.erase(chunkKey(requests[i]));
+		}
+
+		requests.resize(kept);
+	}
+
+	// upload a few of the finished chunks.  The budget always leaves a free slot for every pending chunk
+	unsigned uploads = 0;
+	size_t waiting = 0;
+
+	for (size_t i = 0; i < readyChunks.size(); ++i) {
+
+		long long key = chunkKey(readyChunks[i].coord);
+
+		if (!keep.contains(readyChunks[i].coord)) {
+
+			pendingChunks.erase(key);
+			stats.dropped++;
+
+		} else if (uploads < TILE_UPLOADS_PER_FRAME) {
+
+			uploadChunk(readyChunks[i]);
+			pendingChunks.erase(key);
+
+			uploads++;
+			stats.uploaded++;
+
+		} else {
+
+			if (waiting != i)
+				swap(readyChunks[waiting], readyChunks[i]);
+
+			waiting++;
+		}
+	}
+
+	readyChunks.resize(waiting);
+
+	// drop resident chunks the camera has moved away from
+	for (map<long long, int>::iterator i = residentChunks.begin(); i != residentChunks.end();) {
+
+		if (keep.contains(slots[i->second].coord)) {
+
+			++i;
+
+		} else {
+
+			freeSlots.push_back(i->second);
+			residentChunks.erase(i++);
+			stats.evicted++;
+		}
+	}
+
+	// request the missing chunks, nearest the centre of the view first
+	vector<pair<int, chunkCoord> > missing;
+	int centreX = (load.minX + load.maxX) / 2, centreY = (load.minY + load.maxY) / 2;
+
+	for (int y = load.minY; y <= load.maxY; ++y) {
+
+		for (int x = load.minX; x <= load.maxX; ++x) {
+
+			chunkCoord c = { x, y };
+			long long key = chunkKey(c);
+
+			if (residentChunks.find(key) == residentChunks.end() && pendingChunks.find(key) == pendingChunks.end())
+				missing.push_back(make_pair((x - centreX) * (x - centreX) + (y - centreY) * (y - centreY), c));
+		}
+	}
+
+	if (!missing.empty()) {
+
+		sort(missing.begin(), missing.end(), [](const pair<int, chunkCoord>& a, const pair<int, chunkCoord>& b) { return a.first < b.first; });
+
+		{
+			lock_guard<mutex> guard(streamLock);
+
+			for (size_t i = 0; i < missing.size() && residentChunks.size() + pendingChunks.size() < slots.size(); ++i) {
+
+				requests.push_back(missing[i].second);
+				pendingChunks.insert(chunkKey(missing[i].second));
+			}
+		}
+
+		streamWake.notify_one();
+	}
+
+	stats.resident = unsigned(residentChunks.size());
+	stats.pending = unsigned(pendingChunks.size());
+}
+
+void visibleTileChunks(const spatialBounds& view, vector<tileChunkDraw>& chunks) {
+	chunks.clear();
+
+	// look up the chunks in view rather than walking the whole pool, so this costs the same however many are resident
+	chunkRange visible = chunksAround(view, 0);
+
+	for (int y = visible.minY; y <= visible.maxY; ++y) {
+
+		for (int x = visible.minX; x <= visible.maxX; ++x) {
+
+			chunkCoord c = { x, y };
+			map<long long, int>::const_iterator i = residentChunks.find(chunkKey(c));
+
+			if (i == residentChunks.end())
+				continue;
+
+			const chunkSlot& s = slots[i->second];
+			tileChunkDraw draw;
+
+			draw.vao = s.vao;
+			draw.originX = float(x) * TILE_CHUNK_SIZE;
+			draw.originY = float(y) * TILE_CHUNK_SIZE;
+			memcpy(draw.first, s.first, sizeof(draw.first));
+			memcpy(draw.count, s.count, sizeof(draw.count));
+
+			chunks.push_back(draw);
+		}
+	}
+}
+
+#pragma endregion
+
+const tileWorldStats& getTileWorldStats(void) {
+	return stats;
+}
+
+void reportTileWorldStats(void) {
+	if (!worker) {
+
+		cout << "Tile world: off (set param world.tiles 1 in the scene to stream it in)\n";
+		return;
+	}
+
+	size_t poolBytes = slots.size() * CHUNK_QUADS * 4 * sizeof(sceneVertex);
+
+	cout << "Tile world: " << stats.resident << " of " << slots.size() << " chunks resident (" << poolBytes / 1024 << " KB pool), " << stats.pending << " pending\n";
+	cout << "Tile world: " << stats.generated << " generated (" << (stats.generated ? stats.generateMs / stats.generated : 0.0) << " ms each on the worker), " << stats.uploaded << " uploaded, " << stats.evicted << " evicted, " << stats.dropped << " dropped before upload\n";
+}
@@ -0,0 +1,59 @@
+//
+// Streamed tile world.  An unbounded procedural world of sky, grass and ground tiles, generated in square chunks by a worker thread as the camera approaches and dropped once it moves away
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <vector>
+#include "spatial_hash.h"
+
+// Tiles along each side of a chunk, and the size of a tile in world units
+#define TILE_CHUNK_TILES		16
+#define TILE_SIZE				0.125f
+#define TILE_CHUNK_SIZE			(TILE_CHUNK_TILES * TILE_SIZE)
+
+// Chunks the buffer pool starts with.  It grows when the chunks kept around the view need more (a wide window zoomed out)
+#define INITIAL_TILE_CHUNKS		64
+
+// Chunks uploaded per frame at most.  The rest wait for later frames
+#define TILE_UPLOADS_PER_FRAME	4
+
+// Chunks within this many chunks of the view are requested, and chunks further out than the keep margin are dropped.  The gap between the two stops chunks on the edge of the view being dropped and regenerated as the camera moves back and forth
+#define TILE_LOAD_MARGIN		1
+#define TILE_KEEP_MARGIN		2
+
+enum tileType {
+	TILE_SKY,
+	TILE_GRASS,
+	TILE_GROUND,
+
+	TILE_TYPE_COUNT
+};
+
+// A resident chunk to draw.  Its tiles are GL_TRIANGLES with GL_UNSIGNED_SHORT indices, sorted by type so each type is one index range.  Vertices are relative to the chunk's origin
+struct tileChunkDraw {
+	GLuint			vao;
+	float			originX, originY; // world position of the chunk's bottom left corner
+	GLsizei			first[TILE_TYPE_COUNT], count[TILE_TYPE_COUNT];
+};
+
+struct tileWorldStats {
+	unsigned		resident, pending; // chunks in the pool, and chunks requested but not yet uploaded
+	unsigned		generated, uploaded, evicted;
+	unsigned		dropped; // generated but out of range by the time they were ready
+	double			generateMs; // worker time spent generating
+};
+
+// Create the buffer pool and start the worker thread.  Nothing is streamed or drawn until this is called.  The world is the same every time for the same seed.  Without createBuffers chunks are streamed in and out as usual but never given GL buffers, so --test can drive it without a GL context.  stopTileWorld is also registered to run at exit
+void startTileWorld(unsigned seed, bool createBuffers = true);
+void stopTileWorld(void);
+
+// Stream chunks in and out around the view: upload chunks the worker has finished, drop chunks that have gone out of range and request the missing ones nearest the centre first.  Call once per frame on the GL thread
+void updateTileWorld(const spatialBounds& view);
+
+// Replace chunks with the resident chunks overlapping view
+void visibleTileChunks(const spatialBounds& view, std::vector<tileChunkDraw>& chunks);
+
+const tileWorldStats& getTileWorldStats(void);
+void reportTileWorldStats(void);
@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "transform_buffer.h"
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace CoreStructures;
+
+// CPU copy of one page of the block, in std140 layout.  The camera is a column-major mat4, exactly GUMatrix4.  Each object transform is a row_major mat3x2, which std140 stores as two rows padded to vec4
+struct frameTransformBlock {
+	GUMatrix4		camera;
+	float			objectT[FRAME_TRANSFORM_CAPACITY][8];
+};
+
+static vector<frameTransformBlock>	pages(1);
+static GUMatrix4					frameCamera;
+static int							transformCount = 0;
+static int							uploadedCount = 0, uploadedPages = 0;
+static GLuint						transformBuffer = 0;
+static GLsizeiptr					bufferBytes = 0;
+static GLintptr						pageStride = sizeof(frameTransformBlock); // a page's offset in the buffer, rounded up to the driver's uniform buffer offset alignment
+static int							boundPage = -1;
+
+static int pagesFor(int count) {
+	return (count + FRAME_TRANSFORM_CAPACITY - 1) / FRAME_TRANSFORM_CAPACITY;
+}
+
+void setupTransformBuffer(void) {
+	GLint alignment = 256;
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	if (alignment > 0)
+		pageStride = (GLintptr(sizeof(frameTransformBlock)) + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &transformBuffer);
+
+	beginTransformFrame(GUMatrix4::identity());
+	uploadFrameTransforms();
+}
+
+void beginTransformFrame(const GUMatrix4& camera) {
+	frameCamera = camera;
+	transformCount = 0;
+}
+
+int reserveFrameTransforms(int count) {
+	int first = transformCount;
+
+	transformCount += count;
+
+	if (int(pages.size()) < pagesFor(transformCount))
+		pages.resize(pagesFor(transformCount));
+
+	return first;
+}
+
+int addFrameTransform(const GUAffine2D& T) {
+	int index = reserveFrameTransforms(1);
+
+	setFrameTransform(index, T);
+
+	return index;
+}
+
+void setFrameTransform(int index, const GUAffine2D& T) {
+	T.rowMajor3x2(pages[index / FRAME_TRANSFORM_CAPACITY].objectT[index % FRAME_TRANSFORM_CAPACITY]);
+}
+
+const float *frameTransformRows(int index) {
+	return pages[index / FRAME_TRANSFORM_CAPACITY].objectT[index % FRAME_TRANSFORM_CAPACITY];
+}
+
+void uploadFrameTransforms(void) {
+	int usedPages = (transformCount > 0) ? pagesFor(transformCount) : 1;
+	GLsizeiptr neededBytes = GLsizeiptr(pageStride) * usedPages;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, transformBuffer);
+
+	// orphaning lets the driver hand back fresh storage instead of waiting for last frame's draws to finish reading the old contents.  The buffer only grows
+	if (neededBytes > bufferBytes)
+		bufferBytes = neededBytes;
+
+	glBufferData(GL_UNIFORM_BUFFER, bufferBytes, NULL, GL_STREAM_DRAW);
+
+	// every page carries the camera, so whichever page is bound the block is complete.  Only the used part of each page is sent
+	for (int p = 0; p < usedPages; ++p) {
+
+		int used = (p < usedPages - 1) ? FRAME_TRANSFORM_CAPACITY : transformCount - p * FRAME_TRANSFORM_CAPACITY;
+
+		pages[p].camera = frameCamera;
+
+		glBufferSubData(GL_UNIFORM_BUFFER, pageStride * p, GLsizeiptr(sizeof(GUMatrix4) + sizeof(pages[p].objectT[0]) * used), &pages[p]);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	uploadedCount = transformCount;
+	uploadedPages = usedPages;
+
+	// the first page is left bound for anything that only reads the camera
+	boundPage = -1;
+	bindFrameTransform(0);
+}
+
+int bindFrameTransform(int index) {
+	int page = index / FRAME_TRANSFORM_CAPACITY;
+
+	if (page != boundPage) {
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_TRANSFORM_BINDING, transformBuffer, pageStride * page, sizeof(frameTransformBlock));
+		boundPage = page;
+	}
+
+	return index % FRAME_TRANSFORM_CAPACITY;
+}
+
+void bindTransformBlock(GLuint program) {
+	GLuint blockIndex = glGetUniformBlockIndex(program, "frameTransforms");
+
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, blockIndex, FRAME_TRANSFORM_BINDING);
+}
+
+int frameTransformCount(void) {
+	return uploadedCount;
+}
+
+int frameTransformPages(void) {
+	return uploadedPages;
+}
+
+void transformComposeBenchmark(void) {
+	const int count = 100000;
+
+	// a parent transform applied to many children, as the scene does per object
+	GUMatrix4 parent4 = GUMatrix4::translationMatrix(0.1f, 0.2f, 0.0f) * GUMatrix4::rotationMatrix(0.0f, 0.0f, 0.3f) * GUMatrix4::scaleMatrix(0.5f, 0.5f, 0.0f);
+	GUAffine2D parent2 = GUAffine2D::TRS(0.1f, 0.2f, 0.3f, 0.5f, 0.5f);
+
+	vector<GUMatrix4> children4(count), results4(count);
+	vector<GUAffine2D> children2(count), results2(count);
+
+	for (int i = 0; i < count; ++i) {
+
+		float x = float(i % 100) * 0.01f, y = float(i / 100) * 0.001f;
+
+		children4[i] = GUMatrix4::translationMatrix(x, y, 0.0f);
+		children2[i] = GUAffine2D::translation(x, y);
+	}
+
+	auto start = chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < count; ++i)
+		results4[i] = parent4 * children4[i];
+
+	double matrix4Ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	start = chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < count; ++i)
+		results2[i] = parent2 * children2[i];
+
+	double affineMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	// points through each type
+	vector<GUVector4> points4(count, GUVector4(0.5f, 0.5f, 0.0f, 1.0f));
+	vector<float> points2(count * 2, 0.5f);
+
+	start = chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < count; ++i)
+		points4[i] = parent4 * points4[i];
+
+	double matrix4PointMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	start = chrono::high_resolution_clock::now();
+
+	parent2.transformPoints(points2.data(), points2.data(), count);
+
+	double affinePointMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	cout << "Transform benchmark (" << count << " transforms)\n";
+	cout << "  compose:   GUMatrix4 " << matrix4Ms << " ms (" << sizeof(GUMatrix4) << " bytes), GUAffine2D " << affineMs << " ms (" << sizeof(GUAffine2D) << " bytes)\n";
+	cout << "  transform: GUMatrix4 " << matrix4PointMs << " ms, GUAffine2D " << affinePointMs << " ms\n\n";
+}
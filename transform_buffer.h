@@ -0,0 +1,53 @@
+//
+// Per-frame transform buffer.  The camera and the frame's 2D affine object transforms go up in one std140 uniform block update, and draws pick theirs by index
+//
+
+#pragma once
+
+#include <glew\glew.h>
+#include <CoreStructures\CoreStructures.h>
+
+// Number of object transforms one page of the block holds.  With the camera that fills the 16KB minimum uniform block size every GL 3.1+ driver supports.  Shaders see this as MAX_FRAME_TRANSFORMS
+#define FRAME_TRANSFORM_CAPACITY		510
+
+// Uniform buffer binding point the block is attached to
+#define FRAME_TRANSFORM_BINDING			0
+
+// Create the buffer and attach it to FRAME_TRANSFORM_BINDING
+void setupTransformBuffer(void);
+
+// Start a new frame's transforms with the given camera (view-projection) matrix
+void beginTransformFrame(const CoreStructures::GUMatrix4& camera);
+
+// Add an object transform for this frame and return its index.  Every transform gets its own slot - past FRAME_TRANSFORM_CAPACITY they go on further pages
+int addFrameTransform(const CoreStructures::GUAffine2D& T);
+
+// Reserve count consecutive transforms for this frame and return the index of the first, for filling in with setFrameTransform (e.g. from several threads at once)
+int reserveFrameTransforms(int count);
+
+// Fill in a reserved transform.  Safe to call from any thread as long as each index is only set once and nothing is reserved meanwhile
+void setFrameTransform(int index, const CoreStructures::GUAffine2D& T);
+
+// Index of item i of a block from reserveFrameTransforms
+inline int reservedFrameTransform(int first, int i) {
+	return first + i;
+}
+
+// The 8 floats stored for a transform this frame - two rows padded to vec4, as the shader reads them
+const float *frameTransformRows(int index);
+
+// Upload the camera and the transforms added since beginTransformFrame, and bind the first page.  Call once per frame, after the transforms are added and before anything is drawn
+void uploadFrameTransforms(void);
+
+// Bind the page holding transform index (if it isn't bound already) and return the value for the shader's "transformIndex" uniform.  GL thread only
+int bindFrameTransform(int index);
+
+// Connect program's frameTransforms block to the buffer.  Needed once per program link
+void bindTransformBlock(GLuint program);
+
+// Transforms written by the last uploadFrameTransforms, and the pages they took
+int frameTransformCount(void);
+int frameTransformPages(void);
+
+// Compare composing and transforming points with GUMatrix4 and GUAffine2D
+void transformComposeBenchmark(void);